@@ -312,7 +312,7 @@ public:
       return Quantity;
 
     if (Quantity == 0) {
-      NonExisting.back().insert(Key);
+      markNonExistingKey(Key);
     } else {
       markExistingKey(Key);
     }
@@ -324,8 +324,7 @@ public:
   value_type *tryGet(const key_type &Key) {
     auto Iter = Content.find(Key);
     if (Iter == Content.end()) {
-      if (TrackingIsActive)
-        NonExisting.back().insert(Key);
+      markNonExistingKey(Key);
       return nullptr;
     }
 
@@ -339,8 +338,7 @@ public:
 #endif
     auto Iter = Content.find(Key);
     if (Iter == Content.end()) {
-      if (TrackingIsActive)
-        NonExisting.back().insert(Key);
+      markNonExistingKey(Key);
       return nullptr;
     }
 
@@ -410,6 +408,18 @@ public:
   }
 
 private:
+  void markNonExistingKey(const key_type &Key) const {
+    if (not TrackingIsActive)
+      return;
+
+    if (DeferredReads *Reads = SharedTrackingScope::reads()) {
+      Reads->record([this, Key] { NonExisting.back().insert(Key); });
+      return;
+    }
+
+    NonExisting.back().insert(Key);
+  }
+
   void markExistingKey(const key_type &Key) const {
     if (not TrackingIsActive)
       return;
@@ -417,7 +427,16 @@ private:
     revng_assert(Iter != Content.end());
     revng_assert(Existing.back().size() == Content.size());
 
-    Existing.back()[std::distance(Content.begin(), Iter)] = true;
+    size_t Index = std::distance(Content.begin(), Iter);
+    if (DeferredReads *Reads = SharedTrackingScope::reads())
+      Reads->record(this, Index, &markExistingIndex);
+    else
+      Existing.back()[Index] = true;
+  }
+
+  static void markExistingIndex(const void *Object, size_t Index) {
+    auto *This = static_cast<const TrackingContainer *>(Object);
+    This->Existing.back()[Index] = true;
   }
 
   TrackingSet getNonExistingRequestedKeys() const {
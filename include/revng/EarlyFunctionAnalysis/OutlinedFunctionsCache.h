@@ -0,0 +1,123 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/MetaAddress.h"
+
+namespace efa {
+
+/// Cache of the functions outlined for the ABI analyses.
+///
+/// Functions are outlined on demand and at most `Budget` of them are alive at
+/// any time, the least recently used ones being deleted first. A budget of 0
+/// means no limit.
+///
+/// Functions are used in batches: each batch is announced with makeRoomFor,
+/// which evicts the functions not in the batch to make room for it. The
+/// functions of a batch are then never evicted until the next one is
+/// announced.
+template<typename FunctionT>
+class OutlinedFunctionsCache {
+public:
+  using Outliner = std::function<FunctionT(const MetaAddress &)>;
+
+private:
+  using LRUList = std::list<MetaAddress>;
+
+  struct Entry {
+    std::unique_ptr<FunctionT> Function;
+    typename LRUList::iterator Position;
+  };
+
+private:
+  Outliner Outline;
+  size_t Budget = 0;
+  /// The addresses of the outlined functions, the most recently used first
+  LRUList LRU;
+  std::map<MetaAddress, Entry> Entries;
+  size_t EvictedCount = 0;
+
+public:
+  OutlinedFunctionsCache(Outliner Outline, size_t Budget) :
+    Outline(std::move(Outline)), Budget(Budget) {}
+
+public:
+  size_t size() const { return LRU.size(); }
+  size_t budget() const { return Budget; }
+  size_t evictedCount() const { return EvictedCount; }
+
+  /// Splits \p Items in batches whose functions fit in the budget together
+  template<typename T>
+  std::vector<llvm::ArrayRef<T>> batches(llvm::ArrayRef<T> Items) const {
+    size_t BatchSize = Budget == 0 ? Items.size() : Budget;
+    std::vector<llvm::ArrayRef<T>> Result;
+    while (not Items.empty()) {
+      size_t Size = std::min(BatchSize, Items.size());
+      Result.push_back(Items.take_front(Size));
+      Items = Items.drop_front(Size);
+    }
+    return Result;
+  }
+
+  /// Evicts the least recently used functions not in \p Addresses, so that
+  /// outlining all of \p Addresses does not exceed the budget.
+  ///
+  /// \note this invalidates the references returned by get, but for the ones
+  ///       to the functions in \p Addresses
+  void makeRoomFor(llvm::ArrayRef<MetaAddress> Addresses) {
+    if (Budget == 0)
+      return;
+
+    revng_assert(Addresses.size() <= Budget);
+
+    // Make the functions of the batch the most recently used, so that they
+    // are not evicted
+    size_t Missing = 0;
+    for (const MetaAddress &Address : Addresses) {
+      auto It = Entries.find(Address);
+      if (It != Entries.end())
+        LRU.splice(LRU.begin(), LRU, It->second.Position);
+      else
+        ++Missing;
+    }
+
+    while (LRU.size() + Missing > Budget) {
+      ++EvictedCount;
+      Entries.erase(LRU.back());
+      LRU.pop_back();
+    }
+  }
+
+  /// \note the returned reference is valid until the next call to makeRoomFor
+  ///       not including \p Address
+  FunctionT &get(const MetaAddress &Address) {
+    auto It = Entries.find(Address);
+    if (It != Entries.end()) {
+      LRU.splice(LRU.begin(), LRU, It->second.Position);
+      return *It->second.Function;
+    }
+
+    auto Outlined = std::make_unique<FunctionT>(Outline(Address));
+    FunctionT &Result = *Outlined;
+    LRU.push_front(Address);
+    Entries[Address] = { std::move(Outlined), LRU.begin() };
+
+    // Functions must be requested through makeRoomFor first
+    revng_assert(Budget == 0 or LRU.size() <= Budget);
+    return Result;
+  }
+};
+
+} // namespace efa
@@ -0,0 +1,246 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/GraphTraits.h"
+
+#include "revng/ADT/ReversePostOrderTraversal.h"
+#include "revng/MFP/MFP.h"
+#include "revng/Support/Assert.h"
+
+namespace MFP {
+
+/// A monotone framework instance that can join a lattice element into another
+/// one without building a new element. combineInPlace(Target, Value) must have
+/// the same effect as Target = combineValues(Target, Value) and return true if
+/// and only if Value is not less or equal than the original Target.
+template<typename MFI, typename LatticeElement = typename MFI::LatticeElement>
+concept InPlaceMonotoneFrameworkInstance = MonotoneFrameworkInstance<MFI>
+  and requires(const MFI &I, LatticeElement &Target, LatticeElement Value) {
+        { I.combineInPlace(Target, Value) } -> std::same_as<bool>;
+      };
+
+/// The result of getDenseMaximalFixedPoint: the results of each label are
+/// stored in a vector, indexed by the reverse post order of the label.
+template<typename Label, typename LatticeElement>
+class DenseResultMap {
+private:
+  llvm::DenseMap<Label, unsigned> Indices;
+  std::vector<Label> Labels;
+  std::vector<MFPResult<LatticeElement>> Results;
+
+public:
+  DenseResultMap(llvm::DenseMap<Label, unsigned> &&Indices,
+                 std::vector<Label> &&Labels,
+                 std::vector<MFPResult<LatticeElement>> &&Results) :
+    Indices(std::move(Indices)),
+    Labels(std::move(Labels)),
+    Results(std::move(Results)) {
+    revng_assert(this->Indices.size() == this->Labels.size());
+    revng_assert(this->Results.size() == this->Labels.size());
+  }
+
+public:
+  size_t size() const { return Labels.size(); }
+
+  bool contains(Label L) const { return Indices.count(L) != 0; }
+
+  /// \return the index of \p L in reverse post order
+  unsigned index(Label L) const {
+    auto It = Indices.find(L);
+    revng_assert(It != Indices.end());
+    return It->second;
+  }
+
+  /// All the labels, in reverse post order
+  llvm::ArrayRef<Label> labels() const { return Labels; }
+
+  MFPResult<LatticeElement> &at(Label L) { return Results[index(L)]; }
+
+  const MFPResult<LatticeElement> &at(Label L) const {
+    return Results[index(L)];
+  }
+
+  /// Unlike std::map, \p L must have been visited
+  MFPResult<LatticeElement> &operator[](Label L) { return at(L); }
+
+  const MFPResult<LatticeElement> &operator[](Label L) const { return at(L); }
+
+  MFPResult<LatticeElement> &byIndex(unsigned Index) { return Results[Index]; }
+
+  const MFPResult<LatticeElement> &byIndex(unsigned Index) const {
+    return Results[Index];
+  }
+};
+
+template<MonotoneFrameworkInstance MFI>
+using MFIDenseResultMap = DenseResultMap<typename MFI::Label,
+                                         typename MFI::LatticeElement>;
+
+/// Same as getMaximalFixedPoint, but specialized for speed.
+///
+/// Labels are numbered in reverse post order and all the per-label state lives
+/// in vectors indexed by such number. The worklist is a bitmap: since the
+/// index of a label is its priority, the next label to process is the first
+/// set bit. If the instance supports it, the output of a label is joined in
+/// place into the input of its successors (see
+/// InPlaceMonotoneFrameworkInstance).
+template<MonotoneFrameworkInstance MFI,
+         typename GT = llvm::GraphTraits<typename MFI::GraphType>,
+         typename LGT = typename MFI::Label>
+MFIDenseResultMap<MFI>
+getDenseMaximalFixedPoint(const MFI &Instance,
+                          typename MFI::GraphType Flow,
+                          typename MFI::LatticeElement InitialValue,
+                          typename MFI::LatticeElement ExtremalValue,
+                          const std::vector<typename MFI::Label>
+                            &ExtremalLabels,
+                          const std::vector<typename MFI::Label>
+                            &InitialNodes) {
+  using Label = typename MFI::Label;
+  using LatticeElement = typename MFI::LatticeElement;
+  constexpr unsigned NoIndex = std::numeric_limits<unsigned>::max();
+
+  //
+  // Number the nodes in reverse post order, launching a visit from each
+  // initial node that has not been visited yet
+  //
+  llvm::DenseMap<Label, unsigned> Indices;
+  std::vector<Label> Labels;
+  llvm::DenseSet<Label> Visited;
+  for (Label Start : InitialNodes) {
+    if (Visited.contains(Start))
+      continue;
+
+    ReversePostOrderTraversalExt<LGT, GT, llvm::DenseSet<Label>>
+      RPOTE(Start, Visited);
+    for (Label Node : RPOTE) {
+      Indices[Node] = Labels.size();
+      Labels.push_back(Node);
+    }
+  }
+
+  const size_t Count = Labels.size();
+  revng_check(Count < NoIndex);
+
+  // Record the successors of each node as indices, in a single vector
+  std::vector<unsigned> SuccessorsStart;
+  std::vector<unsigned> Successors;
+  SuccessorsStart.reserve(Count + 1);
+  for (Label Node : Labels) {
+    SuccessorsStart.push_back(Successors.size());
+    for (Label Successor : successors<GT>(Node)) {
+      auto It = Indices.find(Successor);
+      revng_assert(It != Indices.end());
+      Successors.push_back(It->second);
+    }
+  }
+  SuccessorsStart.push_back(Successors.size());
+
+  //
+  // Initialize the values and the worklist
+  //
+  std::vector<MFPResult<LatticeElement>> Results(Count);
+  for (MFPResult<LatticeElement> &Entry : Results)
+    Entry.InValue = InitialValue;
+
+  for (Label ExtremalLabel : ExtremalLabels) {
+    auto It = Indices.find(ExtremalLabel);
+    revng_assert(It != Indices.end());
+    Results[It->second].InValue = ExtremalValue;
+  }
+
+  llvm::BitVector Worklist(Count, true);
+
+  //
+  // Iterate
+  //
+  int Next = Worklist.find_first();
+  while (Next != -1) {
+    unsigned Index = Next;
+    Worklist.reset(Index);
+
+    MFPResult<LatticeElement> &LabelAnalysis = Results[Index];
+    LabelAnalysis.OutValue = Instance.applyTransferFunction(Labels[Index],
+                                                            LabelAnalysis
+                                                              .InValue);
+
+    // Since Index was the lowest pending index, the next one is either a
+    // successor not following it (i.e., the target of a retreating edge) or
+    // the first pending index following it
+    unsigned Lowest = NoIndex;
+    for (unsigned I = SuccessorsStart[Index]; I < SuccessorsStart[Index + 1];
+         ++I) {
+      unsigned End = Successors[I];
+      LatticeElement &EndValue = Results[End].InValue;
+
+      bool Changed = false;
+      if constexpr (InPlaceMonotoneFrameworkInstance<MFI>) {
+        Changed = Instance.combineInPlace(EndValue, LabelAnalysis.OutValue);
+      } else if (not Instance.isLessOrEqual(LabelAnalysis.OutValue,
+                                            EndValue)) {
+        EndValue = Instance.combineValues(EndValue, LabelAnalysis.OutValue);
+        Changed = true;
+      }
+
+      if (Changed) {
+        Worklist.set(End);
+        if (End <= Index and End < Lowest)
+          Lowest = End;
+      }
+    }
+
+    if (Lowest != NoIndex)
+      Next = Lowest;
+    else
+      Next = Worklist.find_next(Index);
+  }
+
+  return MFIDenseResultMap<MFI>(std::move(Indices),
+                                std::move(Labels),
+                                std::move(Results));
+}
+
+template<MonotoneFrameworkInstance MFI,
+         typename GT = llvm::GraphTraits<typename MFI::GraphType>,
+         typename LGT = typename MFI::Label>
+MFIDenseResultMap<MFI>
+getDenseMaximalFixedPoint(const MFI &Instance,
+                          typename MFI::GraphType Flow,
+                          typename MFI::LatticeElement InitialValue,
+                          typename MFI::LatticeElement ExtremalValue,
+                          const std::vector<typename MFI::Label>
+                            &ExtremalLabels) {
+  using Label = typename MFI::Label;
+  std::vector<Label> InitialNodes(ExtremalLabels);
+
+  // Handle the special case that the graph has a single entry node
+  if (GT::getEntryNode(Flow) != nullptr)
+    InitialNodes.push_back(GT::getEntryNode(Flow));
+
+  // Start visits for nodes that we still haven't visited, prioritizing
+  // extremal nodes
+  for (Label Node :
+       llvm::make_range(GT::nodes_begin(Flow), GT::nodes_end(Flow)))
+    InitialNodes.push_back(Node);
+
+  return getDenseMaximalFixedPoint<MFI, GT, LGT>(Instance,
+                                                 Flow,
+                                                 InitialValue,
+                                                 ExtremalValue,
+                                                 ExtremalLabels,
+                                                 InitialNodes);
+}
+
+} // namespace MFP
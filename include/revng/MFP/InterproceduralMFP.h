@@ -0,0 +1,225 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/iterator_range.h"
+
+#include "revng/Support/Assert.h"
+
+namespace MFP {
+
+template<typename NodeRef>
+using WavesMap = llvm::DenseMap<NodeRef, size_t>;
+
+/// Assigns each node reachable from the entry node of \p Graph to a wave: all
+/// the nodes of an SCC share the same wave, which comes after the waves of all
+/// their successors outside of the SCC. Therefore, nodes in the same wave are
+/// not connected, unless they are part of the same SCC.
+template<typename GraphType, typename GT = llvm::GraphTraits<GraphType>>
+WavesMap<typename GT::NodeRef> computeWaves(const GraphType &Graph) {
+  using NodeRef = typename GT::NodeRef;
+  using SCCIterator = llvm::scc_iterator<GraphType, GT>;
+
+  // scc_iterator visits the SCCs bottom-up, therefore all the successors
+  // outside of an SCC already have their wave
+  WavesMap<NodeRef> Result;
+  for (auto It = SCCIterator::begin(Graph); not It.isAtEnd(); ++It) {
+    size_t Wave = 0;
+    for (NodeRef Node : *It) {
+      auto Successors = llvm::make_range(GT::child_begin(Node),
+                                         GT::child_end(Node));
+      for (NodeRef Successor : Successors) {
+        auto SuccessorIt = Result.find(Successor);
+        if (SuccessorIt != Result.end())
+          Wave = std::max(Wave, SuccessorIt->second + 1);
+      }
+    }
+
+    for (NodeRef Node : *It)
+      Result[Node] = Wave;
+  }
+
+  return Result;
+}
+
+/// Worklist of nodes grouped in waves (see computeWaves). Popping the lowest
+/// pending wave first processes a call graph bottom-up, while still allowing to
+/// go back to a callee whose summary has changed.
+template<typename NodeRef, typename Compare = std::less<NodeRef>>
+class WavefrontQueue {
+private:
+  const WavesMap<NodeRef> &Waves;
+  std::map<size_t, std::set<NodeRef, Compare>> Pending;
+  size_t Size = 0;
+
+public:
+  WavefrontQueue(const WavesMap<NodeRef> &Waves) : Waves(Waves) {}
+
+public:
+  void insert(NodeRef Node) {
+    auto It = Waves.find(Node);
+    revng_assert(It != Waves.end());
+    if (Pending[It->second].insert(Node).second)
+      ++Size;
+  }
+
+  bool empty() const { return Size == 0; }
+
+  size_t size() const { return Size; }
+
+  /// Pops the first pending node of the lowest wave
+  NodeRef pop() {
+    revng_assert(not empty());
+    auto It = Pending.begin();
+    NodeRef Result = *It->second.begin();
+    It->second.erase(It->second.begin());
+    if (It->second.empty())
+      Pending.erase(It);
+    --Size;
+    return Result;
+  }
+
+  /// Pops all the pending nodes of the lowest wave, sorted by Compare
+  std::vector<NodeRef> popWave() {
+    revng_assert(not empty());
+    auto It = Pending.begin();
+    std::vector<NodeRef> Result(It->second.begin(), It->second.end());
+    Size -= Result.size();
+    Pending.erase(It);
+    return Result;
+  }
+};
+
+/// The outcome of the analysis of a function
+template<typename Label, typename LatticeElement>
+struct FunctionAnalysisResult {
+  /// Contribution to the summary of the analyzed function
+  LatticeElement Summary;
+
+  /// Contributions to the summaries of other functions
+  std::vector<std::pair<Label, LatticeElement>> Contributions;
+};
+
+template<typename I>
+using InstanceResult = FunctionAnalysisResult<typename I::Label,
+                                              typename I::LatticeElement>;
+
+/// An instance of an interprocedural monotone framework. Each function is a
+/// node of a call graph (Label), whose successors are its callees, and has a
+/// summary, which is an element of a lattice.
+///
+/// Analyzing a function yields a contribution to the summary of the function
+/// itself and, possibly, to the ones of other functions (e.g., its callees):
+/// each contribution is combined with the current summary of its function.
+/// Functions are analyzed a wave at a time: analyze() returns the result of
+/// each function of the wave, in order.
+template<typename I>
+concept InterproceduralInstance = requires(I &Instance,
+                                           const typename I::LatticeElement &E,
+                                           typename I::Label L,
+                                           llvm::ArrayRef<typename I::Label>
+                                             Wave) {
+  {
+    Instance.combineValues(E, E)
+  } -> std::same_as<typename I::LatticeElement>;
+  { Instance.isLessOrEqual(E, E) } -> std::same_as<bool>;
+  {
+    Instance.getSummary(L)
+  } -> std::convertible_to<const typename I::LatticeElement &>;
+  Instance.setSummary(L, E);
+  {
+    Instance.analyze(Wave)
+  } -> std::same_as<std::vector<InstanceResult<I>>>;
+};
+
+/// Computes the fixed point of the summaries of \p Functions, starting from
+/// their current value.
+///
+/// Functions are analyzed starting from the lowest pending wave of \p Waves,
+/// i.e., bottom-up in the call graph. A contribution changes a summary only if
+/// it is not less or equal than it. When the summary of a function changes, its
+/// callers among \p Functions are re-enqueued. If the change is due to the
+/// analysis of another function, e.g., one of its callers, the function itself
+/// is re-enqueued too.
+///
+/// \return the number of times each function has been analyzed
+template<InterproceduralInstance I,
+         typename Compare = std::less<typename I::Label>,
+         typename IGT = llvm::GraphTraits<llvm::Inverse<typename I::Label>>>
+std::map<typename I::Label, size_t>
+getInterproceduralFixedPoint(I &Instance,
+                             const WavesMap<typename I::Label> &Waves,
+                             llvm::ArrayRef<typename I::Label> Functions) {
+  using Label = typename I::Label;
+  using LatticeElement = typename I::LatticeElement;
+
+  llvm::DenseSet<Label> Analyzed(Functions.begin(), Functions.end());
+  std::map<Label, size_t> Iterations;
+
+  WavefrontQueue<Label, Compare> Worklist(Waves);
+  for (Label Function : Functions)
+    Worklist.insert(Function);
+
+  // Combine Value into the summary of Function, returning true if it changed
+  auto Combine = [&Instance](Label Function, const LatticeElement &Value) {
+    const LatticeElement &Summary = Instance.getSummary(Function);
+    if (Instance.isLessOrEqual(Value, Summary))
+      return false;
+
+    Instance.setSummary(Function, Instance.combineValues(Summary, Value));
+    return true;
+  };
+
+  auto EnqueueCallers = [&Worklist, &Analyzed](Label Function) {
+    auto Callers = llvm::make_range(IGT::child_begin(Function),
+                                    IGT::child_end(Function));
+    for (Label Caller : Callers)
+      if (Analyzed.contains(Caller))
+        Worklist.insert(Caller);
+  };
+
+  while (not Worklist.empty()) {
+    std::vector<Label> Wave = Worklist.popWave();
+    std::vector<InstanceResult<I>> Results = Instance.analyze(Wave);
+    revng_assert(Results.size() == Wave.size());
+
+    // Commit the results in order, so that the fixed point does not depend on
+    // how the instance analyzes the functions of a wave
+    for (size_t Index = 0; Index < Wave.size(); ++Index) {
+      Label Function = Wave[Index];
+      InstanceResult<I> &Result = Results[Index];
+      ++Iterations[Function];
+
+      if (Combine(Function, Result.Summary))
+        EnqueueCallers(Function);
+
+      for (auto &[Target, Value] : Result.Contributions) {
+        revng_assert(Analyzed.contains(Target));
+        if (Combine(Target, Value)) {
+          Worklist.insert(Target);
+          EnqueueCallers(Target);
+        }
+      }
+    }
+  }
+
+  return Iterations;
+}
+
+} // namespace MFP
@@ -51,3 +51,66 @@ struct SetIntersectionLattice {
     return std::includes(Left.begin(), Left.end(), Right.begin(), Right.end());
   }
 };
+
+/// Like SetUnionLattice, for bit vectors (e.g., llvm::BitVector or
+/// LazySmallBitVector). Also supports joining in place.
+template<typename BV>
+struct BitVectorUnionLattice {
+  using LatticeElement = BV;
+
+  static LatticeElement combineValues(const LatticeElement &Left,
+                                      const LatticeElement &Right) {
+    LatticeElement Result = Left;
+    Result |= Right;
+    return Result;
+  }
+
+  static bool isLessOrEqual(const LatticeElement &Left,
+                            const LatticeElement &Right) {
+    if constexpr (requires { Left.test(Right); }) {
+      // BitVector::test checks if Left has bits that are not in Right
+      return not Left.test(Right);
+    } else {
+      LatticeElement Intersection = Left;
+      Intersection &= Right;
+      return Intersection == Left;
+    }
+  }
+
+  static bool combineInPlace(LatticeElement &Target,
+                             const LatticeElement &Value) {
+    if (isLessOrEqual(Value, Target))
+      return false;
+
+    Target |= Value;
+    return true;
+  }
+};
+
+/// Like SetIntersectionLattice, for bit vectors (e.g., llvm::BitVector or
+/// LazySmallBitVector). Also supports joining in place.
+template<typename BV>
+struct BitVectorIntersectionLattice {
+  using LatticeElement = BV;
+
+  static LatticeElement combineValues(const LatticeElement &Left,
+                                      const LatticeElement &Right) {
+    LatticeElement Result = Left;
+    Result &= Right;
+    return Result;
+  }
+
+  static bool isLessOrEqual(const LatticeElement &Left,
+                            const LatticeElement &Right) {
+    return BitVectorUnionLattice<BV>::isLessOrEqual(Right, Left);
+  }
+
+  static bool combineInPlace(LatticeElement &Target,
+                             const LatticeElement &Value) {
+    if (isLessOrEqual(Value, Target))
+      return false;
+
+    Target &= Value;
+    return true;
+  }
+};
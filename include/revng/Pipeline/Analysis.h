@@ -4,8 +4,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "llvm/ADT/ArrayRef.h"
 
+#include "revng/Pipeline/GlobalsAccess.h"
 #include "revng/Pipeline/Invokable.h"
 #include "revng/Pipeline/Pipe.h"
 
@@ -31,6 +36,9 @@ public:
   virtual std::unique_ptr<AnalysisWrapperBase>
   clone(std::vector<std::string> NewRunningContainersNames = {}) const = 0;
 
+  /// Returns the parts of the globals accessed by the analysis, if declared
+  virtual std::optional<GlobalsAccess> getAccessedGlobals() const = 0;
+
   void invalidate(const GlobalTupleTreeDiff &Diff,
                   ContainerToTargetsMap &Map,
                   const ContainerSet &Containers) const override {
@@ -73,6 +81,13 @@ public:
     return Invokable.getPipe().AcceptedKinds.at(ContainerIndex);
   }
 
+  std::optional<GlobalsAccess> getAccessedGlobals() const override {
+    if constexpr (DeclaresAccessedGlobals<Analysis>)
+      return Invokable.getPipe().AccessedGlobals;
+    else
+      return std::nullopt;
+  }
+
   void dump(std::ostream &OS, size_t Indentation) const override {
     Invokable.dump(OS, Indentation);
   }
@@ -97,6 +112,10 @@ public:
     return Invokable.getOptionsTypes();
   }
 
+  std::vector<std::string> getOptionsValues() const override {
+    return Invokable.getOptionsValues();
+  }
+
   std::vector<std::string> getRunningContainersNames() const override {
     return Invokable.getRunningContainersNames();
   }
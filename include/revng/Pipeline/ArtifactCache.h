@@ -0,0 +1,86 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "llvm/ADT/StringMap.h"
+
+#include "revng/Pipeline/ContainerSet.h"
+#include "revng/Pipeline/PathTargetBimap.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/Storage/Path.h"
+
+namespace pipeline {
+
+class Context;
+struct PipeWrapper;
+
+/// A cache of the targets produced by pipes, which can be shared by multiple
+/// pipelines (e.g., different workdirs analyzing the same binary).
+///
+/// Each target produced by a pipe is identified by a key obtained hashing the
+/// name and the configuration of the pipe, together with the content of the
+/// input targets it is produced from.
+/// Since the fields of the globals that are read to produce a target are known
+/// only after the pipe has run, each key is associated to a list of artifacts,
+/// each one recording the paths that have been read along with the hash of
+/// their values. An artifact is reused only if all such hashes match the
+/// current content of the globals.
+class ArtifactCache {
+public:
+  using KeysMap = std::map<TargetInContainer, std::string>;
+  using FetchedMap = llvm::StringMap<std::unique_ptr<ContainerBase>>;
+
+private:
+  /// Where the cache lives on the local filesystem, next to the lock files
+  std::string LocalPath;
+  revng::DirectoryPath Directory;
+
+public:
+  /// The cache is kept in the local directory \p Path, so that the updates to
+  /// the index of a key from multiple processes can be serialized through a
+  /// lock file.
+  explicit ArtifactCache(llvm::StringRef Path) :
+    LocalPath(Path.str()),
+    Directory(revng::DirectoryPath::fromLocalStorage(Path)) {}
+
+  /// Returns the cache set up through the command line, if any
+  static const ArtifactCache *fromCommandLine();
+
+public:
+  /// Computes the keys of the targets in \p Output, which \p Pipe is about to
+  /// produce starting from \p Input.
+  ///
+  /// Targets whose inputs cannot be hashed have no key.
+  KeysMap computeKeys(const Context &Context,
+                      const PipeWrapper &Pipe,
+                      const ContainerSet &Input,
+                      const ContainerToTargetsMap &Output) const;
+
+  /// Looks up in the cache the targets of \p ToProduce.
+  ///
+  /// The targets that are found are removed from \p ToProduce and the paths
+  /// they depend on are registered in the invalidation metadata of \p Pipe.
+  /// Their content is returned, so that it can be merged in \p Containers
+  /// after \p Pipe has produced the remaining targets.
+  FetchedMap fetch(const Context &Context,
+                   PipeWrapper &Pipe,
+                   const KeysMap &Keys,
+                   ContainerSet &Containers,
+                   ContainerToTargetsMap &ToProduce) const;
+
+  /// Stores in the cache the targets in \p Produced, which \p Pipe has just
+  /// produced in \p Containers.
+  void store(const Context &Context,
+             const PipeWrapper &Pipe,
+             const KeysMap &Keys,
+             const ContainerSet &Containers,
+             const ContainerToTargetsMap &Produced) const;
+};
+
+} // namespace pipeline
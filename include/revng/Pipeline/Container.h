@@ -123,6 +123,17 @@ public:
   /// loaded from the provided path.
   virtual llvm::Error load(const revng::FilePath &Path);
 
+  /// Loads from the provided path only what is needed to provide \p Targets,
+  /// if the format of the file allows it. All of \p Targets must be in the
+  /// file, otherwise an error is returned.
+  ///
+  /// \return false if the file can only be loaded as a whole through load, in
+  ///         which case nothing is loaded.
+  virtual llvm::Expected<bool> loadFiltered(const revng::FilePath &Path,
+                                            const TargetsList &Targets) {
+    return false;
+  }
+
   /// Checks that the content of the this container is valid.
   virtual llvm::Error verify() const { return enumerate().verify(*this); }
 
@@ -5,14 +5,18 @@
 //
 
 #include <memory>
+#include <concepts>
 #include <optional>
+#include <string>
 #include <tuple>
 #include <utility>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
 
 #include "revng/Pipeline/Container.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/Error.h"
 
 namespace pipeline {
 class ContainerFactoryBase {
@@ -22,9 +26,19 @@ public:
 
   virtual llvm::StringRef mimeType() const = 0;
 
+  /// Returns false if containers created by this factory share state with
+  /// other containers (e.g., a LLVMContext) and therefore cannot be used
+  /// concurrently with them.
+  virtual bool isThreadSafe() const = 0;
+
   virtual std::vector<revng::FilePath>
   getWrittenFiles(const revng::FilePath &Path) const = 0;
 
+  /// Selects the format in which the containers created by this factory are
+  /// stored on disk, as specified by the `Encoding` of a container declaration.
+  /// Fails if the container does not support \p Encoding.
+  virtual llvm::Error setEncoding(llvm::StringRef Encoding) = 0;
+
   virtual ~ContainerFactoryBase() = default;
 
   virtual std::unique_ptr<ContainerFactoryBase> clone() const = 0;
@@ -33,7 +47,14 @@ public:
 template<typename ContainerT, typename... Args>
 class ContainerFactoryWithArgs : public ContainerFactoryBase {
 private:
+  static constexpr bool HasEncodings = requires(ContainerT &C,
+                                                llvm::StringRef E) {
+    { ContainerT::isValidEncoding(E) } -> std::same_as<bool>;
+    C.setEncoding(E);
+  };
+
   std::tuple<Args...> GlobalValue;
+  std::string Encoding;
 
 public:
   ContainerFactoryWithArgs(Args &&...GlobalValue) :
@@ -44,16 +65,40 @@ public:
     auto Creator = [Name]<typename... T>(T &&...Values) {
       return std::make_unique<ContainerT>(Name, std::forward<T>(Values)...);
     };
-    return std::apply(Creator, GlobalValue);
+    std::unique_ptr<ContainerBase> Result = std::apply(Creator, GlobalValue);
+    if constexpr (HasEncodings) {
+      if (not Encoding.empty())
+        llvm::cast<ContainerT>(*Result).setEncoding(Encoding);
+    }
+    return Result;
   }
 
   llvm::StringRef mimeType() const override { return ContainerT::MIMEType; }
 
+  bool isThreadSafe() const override {
+    if constexpr (requires { ContainerT::IsThreadSafe; })
+      return ContainerT::IsThreadSafe;
+    else
+      return true;
+  }
+
   std::vector<revng::FilePath>
   getWrittenFiles(const revng::FilePath &Path) const override {
     return ContainerT::getWrittenFiles(Path);
   }
 
+  llvm::Error setEncoding(llvm::StringRef NewEncoding) override {
+    if constexpr (HasEncodings) {
+      if (ContainerT::isValidEncoding(NewEncoding)) {
+        Encoding = NewEncoding.str();
+        return llvm::Error::success();
+      }
+    }
+
+    return revng::createError("Unsupported encoding %s",
+                              NewEncoding.str().c_str());
+  }
+
   std::unique_ptr<ContainerFactoryBase> clone() const override {
     return std::make_unique<ContainerFactoryWithArgs>(*this);
   }
@@ -111,9 +156,15 @@ public:
 
   llvm::StringRef mimeType() const { return Content->mimeType(); }
 
+  bool isThreadSafe() const { return Content->isThreadSafe(); }
+
   std::vector<revng::FilePath>
   getWrittenFiles(const revng::FilePath &Path) const {
     return Content->getWrittenFiles(Path);
   }
+
+  llvm::Error setEncoding(llvm::StringRef Encoding) {
+    return Content->setEncoding(Encoding);
+  }
 };
 } // namespace pipeline
@@ -7,6 +7,7 @@
 #include <cstddef>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <set>
 #include <sstream>
@@ -24,6 +25,7 @@
 #include "revng/Pipeline/ContainerFactory.h"
 #include "revng/Pipeline/Kind.h"
 #include "revng/Pipeline/Target.h"
+#include "revng/Storage/Path.h"
 #include "revng/Support/Assert.h"
 
 namespace pipeline {
@@ -36,26 +38,52 @@ namespace pipeline {
 ///
 /// This class contains both the containers and a pointer to a factory that is
 /// used to create that container when it does not exists.
+///
+/// Containers can be loaded lazily: in that case only the list of their targets
+/// is known up front, while their content is deserialized the first time it is
+/// accessed. Until then, they appear as null while iterating over the set.
+/// Deserializing them is guarded by a mutex, so const methods can be invoked
+/// from multiple threads at the same time, while non-const ones still require
+/// exclusive access.
 class ContainerSet {
 private:
   using Map = llvm::StringMap<std::unique_ptr<ContainerBase>>;
 
+  /// A container that has not been deserialized yet
+  struct PendingContainer {
+    revng::FilePath File;
+    TargetsList Enumeration;
+  };
+
 public:
   using const_iterator = Map::const_iterator;
   using iterator = Map::iterator;
   using value_type = Map::value_type;
 
 private:
-  Map Content;
+  // Lazily loaded containers can be deserialized by const methods too
+  mutable Map Content;
   llvm::StringMap<const ContainerFactory *> Factories;
+  mutable llvm::StringMap<PendingContainer> Pending;
+  /// Guards Pending and the containers of Content that are pending
+  mutable std::mutex PendingMutex;
 
 public:
   ContainerSet() = default;
 
   ContainerSet(Map Content) : Content(std::move(Content)) {}
 
-  ContainerSet(ContainerSet &&) = default;
-  ContainerSet &operator=(ContainerSet &&) = default;
+  ContainerSet(ContainerSet &&Other) :
+    Content(std::move(Other.Content)),
+    Factories(std::move(Other.Factories)),
+    Pending(std::move(Other.Pending)) {}
+
+  ContainerSet &operator=(ContainerSet &&Other) {
+    Content = std::move(Other.Content);
+    Factories = std::move(Other.Factories);
+    Pending = std::move(Other.Pending);
+    return *this;
+  }
 
   ContainerSet(const ContainerSet &) = delete;
   ContainerSet &operator=(const ContainerSet &) = delete;
@@ -69,22 +97,41 @@ public:
   iterator begin() { return Content.begin(); }
   iterator end() { return Content.end(); }
 
-  iterator find(llvm::StringRef Name) { return Content.find(Name); }
+  iterator find(llvm::StringRef Name) {
+    materializeOrAbort(Name);
+    return Content.find(Name);
+  }
 
   size_t size() const { return Factories.size(); }
 
 public:
-  ContainerSet cloneFiltered(const ContainerToTargetsMap &Targets);
+  /// Clones the targets of \p Targets into a new ContainerSet.
+  ///
+  /// If \p CloneUnrequested is false, containers that do not appear in
+  /// \p Targets are left empty in the result, rather than being cloned with no
+  /// targets.
+  ContainerSet cloneFiltered(const ContainerToTargetsMap &Targets,
+                             bool CloneUnrequested = true);
+
+  /// Clones the targets \p Targets of the container \p Name.
+  ///
+  /// If \p Name has been loaded lazily and its file supports it, only the
+  /// requested targets are deserialized and \p Name is left pending.
+  std::unique_ptr<ContainerBase>
+  cloneFiltered(llvm::StringRef Name, const TargetsList &Targets) const;
 
   void mergeBack(ContainerSet &&Other) {
     for (auto &Entry : Other.Content) {
       revng_assert(containsOrCanCreate(Entry.first()));
 
-      auto &LContainer = Content.find(Entry.first())->second;
+      Other.materializeOrAbort(Entry.first());
       auto &RContainer = Entry.second;
       if (RContainer == nullptr)
         continue;
 
+      materializeOrAbort(Entry.first());
+      auto &LContainer = Content.find(Entry.first())->second;
+
       if (LContainer == nullptr)
         LContainer = std::move(RContainer);
       else
@@ -94,6 +141,7 @@ public:
 
   ContainerBase &operator[](llvm::StringRef Name) {
     revng_assert(containsOrCanCreate(Name));
+    materializeOrAbort(Name);
     if (Content[Name] == nullptr)
       Content[Name] = (*Factories[Name])(Name);
     auto &Pointer = Content.find(Name)->second;
@@ -103,11 +151,13 @@ public:
 
   ContainerBase &at(llvm::StringRef Name) {
     revng_assert(contains(Name));
+    materializeOrAbort(Name);
     return *Content.find(Name)->second;
   }
 
   const ContainerBase &at(llvm::StringRef Name) const {
     revng_assert(contains(Name));
+    materializeOrAbort(Name);
     return *Content.find(Name)->second;
   }
 
@@ -115,22 +165,40 @@ public:
     return Factories.find(Name) != Factories.end();
   }
 
+  bool isThreadSafe(llvm::StringRef Name) const {
+    revng_assert(isContainerRegistered(Name));
+    return Factories.find(Name)->second->isThreadSafe();
+  }
+
   bool contains(llvm::StringRef Name) const {
+    std::lock_guard Lock(PendingMutex);
+    if (Pending.count(Name) != 0)
+      return true;
+
     auto Iterator = Content.find(Name);
     return Iterator != Content.end() and Iterator->second != nullptr;
   }
 
+  /// \return true if the container \p Name has been loaded lazily and it has
+  ///         not been deserialized yet.
+  bool isPending(llvm::StringRef Name) const {
+    std::lock_guard Lock(PendingMutex);
+    return Pending.count(Name) != 0;
+  }
+
   bool containsOrCanCreate(llvm::StringRef Name) const {
     return Content.find(Name) != Content.end();
   }
 
   template<typename T>
   const T &get(llvm::StringRef Name) const {
+    materializeOrAbort(Name);
     return llvm::cast<T>(*Content.find(Name)->second);
   }
 
   template<typename T>
   T &get(llvm::StringRef Name) {
+    materializeOrAbort(Name);
     return llvm::cast<T>(*Content.find(Name)->second);
   }
 
@@ -143,6 +211,10 @@ public:
 
   ContainerToTargetsMap enumerate() const;
 
+  /// Enumerates the targets of the container \p Name, without deserializing
+  /// it if it has been loaded lazily.
+  TargetsList enumerate(llvm::StringRef Name) const;
+
   llvm::Error verify() const;
 
 public:
@@ -159,6 +231,18 @@ public:
 public:
   llvm::Error store(const revng::DirectoryPath &DirectoryPath) const;
   llvm::Error load(const revng::DirectoryPath &DirectoryPath);
+  llvm::Error load(const revng::DirectoryPath &DirectoryPath,
+                   llvm::StringRef Name);
+
+  /// Registers \p File as the serialized content of the container \p Name,
+  /// whose targets are \p Enumeration. The content is deserialized only when
+  /// the container is first accessed.
+  void loadLazily(llvm::StringRef Name,
+                  const revng::FilePath &File,
+                  TargetsList Enumeration);
+
+  /// Deserializes the container \p Name, if it has been loaded lazily
+  llvm::Error materialize(llvm::StringRef Name) const;
 
   std::vector<revng::FilePath>
   getWrittenFiles(const revng::DirectoryPath &DirectoryPath) const;
@@ -169,12 +253,31 @@ public:
     for (const auto &Entry : Content) {
       indent(OS, Indentation);
       OS << Entry.first().str() << "\n";
-      if (Entry.second != nullptr)
-        Entry.second->enumerate().dump(OS, Indentation + 1);
+      if (contains(Entry.first()))
+        enumerate(Entry.first()).dump(OS, Indentation + 1);
     }
   }
 
   void dump() const debug_function { dump(dbg); }
+
+private:
+  /// Loads only \p Targets from the file of the pending container \p Name
+  ///
+  /// \return nullptr if the file of \p Name cannot be partially loaded, or if
+  ///         \p Name is no longer pending, an error if partially loading it
+  ///         failed.
+  llvm::Expected<std::unique_ptr<ContainerBase>>
+  loadPendingFiltered(llvm::StringRef Name, const TargetsList &Targets) const;
+
+  /// Like loadPendingFiltered, but failures are logged and reported as nullptr,
+  /// so that the caller falls back to materializing the whole container
+  std::unique_ptr<ContainerBase>
+  tryLoadPendingFiltered(llvm::StringRef Name,
+                         const TargetsList &Targets) const;
+
+  void materializeOrAbort(llvm::StringRef Name) const {
+    llvm::cantFail(materialize(Name));
+  }
 };
 
 } // namespace pipeline
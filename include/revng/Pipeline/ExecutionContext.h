@@ -4,13 +4,18 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <functional>
+#include <vector>
+
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Pass.h"
 
 #include "revng/Pipeline/Container.h"
 #include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Profiler.h"
 #include "revng/Pipeline/Target.h"
+#include "revng/Support/AccessTracker.h"
 #include "revng/Support/Generator.h"
 
 namespace pipeline {
@@ -71,6 +76,21 @@ concept IsTargetToGlobal = requires {
 // }
 //
 class ExecutionContext {
+public:
+  using CommitListener = std::function<void(const Target &,
+                                            llvm::StringRef ContainerName)>;
+
+private:
+  /// A target committed by a worker, waiting to be committed by its parent
+  struct WorkerCommit {
+    Target Committed;
+    std::string ContainerName;
+    /// The fields read to produce the target
+    revng::DeferredReads Reads;
+    Profiler::Clock::time_point Start;
+    Profiler::Clock::time_point End;
+  };
+
 private:
   Context *TheContext = nullptr;
   PipeWrapper *Pipe = nullptr;
@@ -78,6 +98,17 @@ private:
   ContainerToTargetsMap Committed;
   // false when running on a analysis
   bool RunningOnPipe = true;
+  // true when this is the execution context of a worker processing a shard of
+  // the targets of another execution context
+  bool IsWorker = false;
+  // The reads of a worker, recorded within a SharedTrackingScope
+  revng::DeferredReads WorkerReads;
+  // The targets committed by a worker, in commit order
+  std::vector<WorkerCommit> WorkerCommits;
+  // When the last target has been committed, used for profiling
+  Profiler::Clock::time_point LastCommit = Profiler::Clock::now();
+  // Invoked after each commit, not inherited by workers
+  CommitListener OnCommit;
 
 public:
   ~ExecutionContext();
@@ -87,6 +118,28 @@ public:
                    PipeWrapper *Pipe,
                    const ContainerToTargetsMap &RequestedTargets = {});
 
+  /// Creates the execution context of a worker processing \p RequestedTargets,
+  /// a subset of the targets requested to \p Parent.
+  ///
+  /// The worker shares the context of \p Parent, which it must only read from
+  /// within the SharedTrackingScope returned by trackReads. Its commits only
+  /// record the committed targets and the fields read to produce each of them:
+  /// the parent is in charge of committing them once the worker is done, see
+  /// join.
+  ExecutionContext(const ExecutionContext &Parent,
+                   const ContainerToTargetsMap &RequestedTargets);
+
+private:
+  void recordTarget(const Target &Target,
+                    llvm::StringRef ContainerName,
+                    Profiler::Clock::time_point Start,
+                    Profiler::Clock::time_point End);
+  void notifyCommit(const Target &Target, llvm::StringRef ContainerName);
+
+  /// Accounts to \p Target the fields read so far, plus the ones in \p Extra
+  void collectReadFields(const TargetInContainer &Target,
+                         const revng::DeferredReads *Extra = nullptr);
+
 public:
   void commit(const Target &Target, llvm::StringRef ContainerName);
   void commit(const Target &Target, const ContainerBase &Container) {
@@ -146,10 +199,32 @@ public:
     }
   }
 
+  /// Sets a function to invoke each time a target is committed.
+  ///
+  /// When the listener is invoked, the committed target is already in its
+  /// container and it can be extracted.
+  void setCommitListener(CommitListener Listener) {
+    OnCommit = std::move(Listener);
+  }
+
 public:
   /// Verifies all the requested targets have been committed
   void verify() const;
 
+  bool isWorker() const { return IsWorker; }
+
+  /// Makes the reads of the globals performed by the current thread be
+  /// recorded by this worker, until the returned scope is destroyed
+  [[nodiscard]] revng::SharedTrackingScope trackReads() {
+    revng_assert(IsWorker);
+    return revng::SharedTrackingScope(WorkerReads);
+  }
+
+  /// Commits the targets committed by \p Worker, in the same order, each one
+  /// depending on the fields read by \p Worker to produce it, in addition to
+  /// the ones read by this execution context so far.
+  void join(ExecutionContext &&Worker);
+
 public:
   const Context &getContext() const { return *TheContext; }
   Context &getContext() { return *TheContext; }
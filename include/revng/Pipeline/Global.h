@@ -15,6 +15,7 @@
 #include "revng/Pipeline/GlobalTupleTreeDiff.h"
 #include "revng/Pipeline/PathTargetBimap.h"
 #include "revng/Storage/Path.h"
+#include "revng/Support/CommonOptions.h"
 #include "revng/Support/Error.h"
 #include "revng/Support/YAMLTraits.h"
 #include "revng/TupleTree/Tracking.h"
@@ -59,6 +60,10 @@ public:
 
   virtual std::unique_ptr<Global> clone() const = 0;
 
+  /// Makes reading the global free of side effects on it, so that multiple
+  /// threads can read it concurrently
+  virtual void prepareForConcurrentReads() = 0;
+
   virtual llvm::Error store(const revng::FilePath &Path) const;
   virtual llvm::Error load(const revng::FilePath &Path);
 
@@ -68,6 +73,11 @@ public:
   virtual std::optional<std::string>
   serializePath(const TupleTreePath &Path) const = 0;
 
+  /// Returns a hash of the content of the global pointed by \p Path, which
+  /// changes whenever a diff would report a change on \p Path.
+  virtual std::optional<uint64_t>
+  hashPath(const TupleTreePath &Path) const = 0;
+
   virtual void collectReadFields(const TargetInContainer &Target,
                                  PathTargetBimap &Out) = 0;
   virtual void clearAndResume() const = 0;
@@ -114,6 +124,8 @@ public:
     return std::unique_ptr<Global>(Ptr);
   }
 
+  void prepareForConcurrentReads() override { Value.cacheReferences(); }
+
   void clear() override {
     Value.evictCachedReferences();
     *Value = Object();
@@ -124,6 +136,18 @@ public:
     return llvm::Error::success();
   }
 
+  llvm::Error store(const revng::FilePath &Path) const override {
+    if (not BinaryTupleTrees)
+      return Global::store(Path);
+
+    auto MaybeWritableFile = Path.getWritableFile();
+    if (not MaybeWritableFile)
+      return MaybeWritableFile.takeError();
+
+    Value.serializeBinary(MaybeWritableFile.get()->os());
+    return MaybeWritableFile.get()->commit();
+  }
+
   llvm::Error fromString(llvm::StringRef String) override {
     auto MaybeTupleTree = TupleTree<Object>::fromString(String);
     if (!MaybeTupleTree)
@@ -188,6 +212,10 @@ public:
     return pathAsString<Object>(Path);
   }
 
+  std::optional<uint64_t> hashPath(const TupleTreePath &Path) const override {
+    return hashByPath<Object>(Path, *Value);
+  }
+
   void collectReadFields(const TargetInContainer &Target,
                          PathTargetBimap &Out) override {
     const TupleTree<Object> &AsConst = Value;
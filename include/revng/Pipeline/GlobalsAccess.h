@@ -0,0 +1,46 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <concepts>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace pipeline {
+
+/// The parts of the globals a pipe or an analysis reads and writes.
+///
+/// Each entry is the name of a global, optionally followed by a path in it
+/// (e.g., `model.yml/Functions`), and covers the whole subtree rooted there.
+struct GlobalsAccess {
+  std::vector<std::string> Read;
+  std::vector<std::string> Written;
+
+public:
+  /// Returns true if running the analysis accessing \p After right after the
+  /// one accessing this cannot be told apart from running them on the same
+  /// globals and combining their changes.
+  bool isIndependentFrom(const GlobalsAccess &After) const;
+
+  /// Returns true if \p Path (e.g., `model.yml/Functions/0x1000:Code_x86_64`)
+  /// is covered by an entry of Written
+  bool allowsWriting(llvm::StringRef Path) const;
+
+  /// Returns the names of the globals covered by an entry of Written
+  std::vector<std::string> getWrittenGlobals() const;
+};
+
+/// Analyses can declare the parts of the globals they access through an
+/// `AccessedGlobals` member, so that independent analyses can run concurrently.
+/// Pipes are only allowed to change the parts of the globals they declare this
+/// way, and they must not change any global if they declare nothing.
+template<typename T>
+concept DeclaresAccessedGlobals = requires(const T &Invokable) {
+  { Invokable.AccessedGlobals } -> std::convertible_to<GlobalsAccess>;
+};
+
+} // namespace pipeline
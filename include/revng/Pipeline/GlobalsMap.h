@@ -168,5 +168,9 @@ public:
     for (const auto &Global : Map)
       Global.second->stopTracking();
   }
+  void prepareForConcurrentReads() {
+    for (const auto &Global : Map)
+      Global.second->prepareForConcurrentReads();
+  }
 };
 } // namespace pipeline
@@ -326,6 +326,42 @@ std::vector<std::string> getOptionsTypes() {
   return getOptionsTypesImpl<T>(&T::run);
 }
 
+inline std::string optionValueToString(const std::string &Value) {
+  return Value;
+}
+
+inline std::string optionValueToString(std::integral auto Value) {
+  return std::to_string(Value);
+}
+
+template<typename T, size_t... S>
+void getOptionValueFromIndexes(std::vector<std::string> &Out,
+                               const std::integer_sequence<size_t, S...> &) {
+  (Out.push_back(optionValueToString(getOption<T, S>({}))), ...);
+}
+
+template<typename T, typename ContextT, typename... Args>
+std::vector<std::string>
+getOptionsValuesImpl(auto (T::*F)(ContextT &, Args...)) {
+
+  using OptionArgsTypes = detail::FilterNonContainers<Args...>;
+  constexpr size_t OptionArgsCount = std::tuple_size<OptionArgsTypes>::value;
+  constexpr auto
+    OptionArgsIndexes = std::make_integer_sequence<size_t, OptionArgsCount>();
+
+  std::vector<std::string> Out;
+  getOptionValueFromIndexes<T>(Out, OptionArgsIndexes);
+
+  return Out;
+}
+
+/// Returns the values the options of T would have if it was run without extra
+/// arguments, that is, the values set on the command line or the defaults.
+template<typename T>
+std::vector<std::string> getOptionsValues() {
+  return getOptionsValuesImpl<T>(&T::run);
+}
+
 template<typename First, typename... Rest>
 constexpr bool isNthTypeConst(size_t I) {
   if (I == 0)
@@ -443,6 +479,7 @@ public:
   virtual bool isContainerArgumentConst(size_t ArgumentIndex) const = 0;
   virtual std::vector<std::string> getOptionsNames() const = 0;
   virtual std::vector<std::string> getOptionsTypes() const = 0;
+  virtual std::vector<std::string> getOptionsValues() const = 0;
 };
 
 template<typename T>
@@ -542,6 +579,10 @@ public:
     return detail::getOptionsTypes<InvokableType>();
   }
 
+  std::vector<std::string> getOptionsValues() const override {
+    return detail::getOptionsValues<InvokableType>();
+  }
+
 public:
   void dump(std::ostream &OS, size_t Indentation) const override {
     indent(OS, Indentation);
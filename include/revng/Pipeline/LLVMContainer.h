@@ -30,11 +30,17 @@ private:
 
 private:
   std::unique_ptr<llvm::Module> Module;
+  /// The number of compile units in llvm.dbg.cu the last time it has been
+  /// pruned by mergeBackImpl
+  size_t PrunedCompileUnits = 0;
 
 public:
   inline static const llvm::StringRef MIMEType = "application/x.llvm.bc+zstd";
   inline static const char *Name = "llvm-container";
 
+  /// All the LLVMContainers of a pipeline share the same LLVMContext
+  static constexpr bool IsThreadSafe = false;
+
   LLVMContainer(llvm::StringRef Name,
                 Context *Context,
                 llvm::LLVMContext *LLVMContext) :
@@ -70,13 +76,21 @@ public:
 
   llvm::Error deserialize(const llvm::MemoryBuffer &Buffer) final;
 
+  llvm::Expected<bool> loadFiltered(const revng::FilePath &Path,
+                                    const TargetsList &Targets) final;
+
   void clear() final {
     Module = std::make_unique<llvm::Module>("revng.module",
                                             Module->getContext());
+    PrunedCompileUnits = 0;
   }
 
 private:
   void mergeBackImpl(ThisType &&OtherContainer) final;
+
+  /// Loads a split bitcode file, linking only the functions of \p Targets, or
+  /// all of them if \p Targets is nullptr
+  llvm::Error loadSplit(llvm::StringRef Data, const TargetsList *Targets);
 };
 
 } // namespace pipeline
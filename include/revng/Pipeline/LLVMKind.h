@@ -46,6 +46,16 @@ public:
     return false;
   }
 
+  /// Returns the targets associated to \p Symbol by any of the registered
+  /// kinds
+  static TargetsList owners(const llvm::Function &Symbol) {
+    TargetsList ToReturn;
+    for (const auto &I : getRegisteredInspectors())
+      if (auto MaybeTarget = I->symbolToTarget(Symbol))
+        ToReturn.push_back(std::move(*MaybeTarget));
+    return ToReturn;
+  }
+
   llvm::Error verify(const ContainerBase &Container,
                      const Target &T) const override {
     if (const auto *Casted = llvm::dyn_cast<LLVMContainer>(&Container))
@@ -29,6 +29,8 @@ struct ContainerDeclaration {
   std::string Name;
   std::string Type;
   std::string Role = "";
+  /// How the container is stored on disk, the default one if empty
+  std::string Encoding = "";
 };
 
 struct AnalysisDeclaration {
@@ -231,13 +233,14 @@ private:
 };
 } // namespace pipeline
 
-INTROSPECTION_NS(pipeline, ContainerDeclaration, Name, Type, Role);
+INTROSPECTION_NS(pipeline, ContainerDeclaration, Name, Type, Role, Encoding);
 template<>
 struct llvm::yaml::MappingTraits<pipeline::ContainerDeclaration> {
   static void mapping(IO &TheIO, pipeline::ContainerDeclaration &Info) {
     TheIO.mapRequired("Name", Info.Name);
     TheIO.mapRequired("Type", Info.Type);
     TheIO.mapOptional("Role", Info.Role);
+    TheIO.mapOptional("Encoding", Info.Encoding);
   }
 };
 
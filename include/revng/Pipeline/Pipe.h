@@ -6,6 +6,7 @@
 
 #include <iterator>
 #include <memory>
+#include <optional>
 #include <set>
 #include <string>
 #include <type_traits>
@@ -26,6 +27,7 @@
 #include "revng/Pipeline/Contract.h"
 #include "revng/Pipeline/ExecutionContext.h"
 #include "revng/Pipeline/Global.h"
+#include "revng/Pipeline/GlobalsAccess.h"
 #include "revng/Pipeline/Invokable.h"
 #include "revng/Pipeline/Target.h"
 #include "revng/Support/Debug.h"
@@ -119,6 +121,9 @@ public:
 
   virtual llvm::Error checkPrecondition(const Context &Context) const = 0;
 
+  /// Returns the parts of the globals accessed by the pipe, if declared
+  virtual std::optional<GlobalsAccess> getAccessedGlobals() const = 0;
+
   virtual size_t getContainerArgumentsCount() const = 0;
 
   virtual llvm::StringRef getContainerName(size_t Index) const = 0;
@@ -270,6 +275,13 @@ public:
     }
   }
 
+  std::optional<GlobalsAccess> getAccessedGlobals() const override {
+    if constexpr (DeclaresAccessedGlobals<PipeType>)
+      return Invokable.getPipe().AccessedGlobals;
+    else
+      return std::nullopt;
+  }
+
   size_t getContainerArgumentsCount() const override {
     return countArgs(&PipeType::run);
   }
@@ -304,6 +316,10 @@ public:
     return Invokable.getOptionsTypes();
   }
 
+  std::vector<std::string> getOptionsValues() const override {
+    return Invokable.getOptionsValues();
+  }
+
   std::vector<std::string> getRunningContainersNames() const override {
     return Invokable.getRunningContainersNames();
   }
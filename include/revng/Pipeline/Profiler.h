@@ -0,0 +1,92 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace pipeline {
+
+/// Records wall time, CPU time, memory usage and I/O of the phases of the
+/// execution of a pipeline: steps, pipes, single targets, analyses and the
+/// (de)serialization of containers.
+///
+/// Profiling is enabled by `-pipeline-trace`, which emits all the events in
+/// the Chrome trace event format, and/or by `-pipeline-profile`, which emits a
+/// YAML summary aggregating the events by category, parent and name. Both
+/// files are written upon program termination.
+///
+/// \note On Linux, CPU time is measured on the thread that opened the scope,
+///       hence it does not include the work the scope offloads to other
+///       threads. Elsewhere it is measured on the whole process. Peak RSS is
+///       always measured on the whole process: if multiple steps or shards
+///       run concurrently, their memory usage is accounted to all the scopes
+///       active at the same time.
+class Profiler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Event {
+    std::string Category;
+    /// Name of the scope enclosing this event, if any
+    std::string Parent;
+    std::string Name;
+    uint64_t ThreadID = 0;
+    Clock::time_point Start;
+    Clock::duration WallTime = Clock::duration::zero();
+    std::chrono::microseconds CPUTime = std::chrono::microseconds::zero();
+    /// How much the peak resident set size grew during the event, in bytes
+    uint64_t PeakRSSDelta = 0;
+    uint64_t BytesRead = 0;
+    uint64_t BytesWritten = 0;
+  };
+
+  /// Records an event spanning the lifetime of this object
+  ///
+  /// The parent of the event is the innermost Scope active on the same thread.
+  class Scope {
+  private:
+    bool Enabled = false;
+    Event Recorded;
+    std::chrono::microseconds StartCPUTime = std::chrono::microseconds::zero();
+    uint64_t StartPeakRSS = 0;
+
+  public:
+    Scope(llvm::StringRef Category, llvm::StringRef Name);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+    Scope(Scope &&) = delete;
+    Scope &operator=(Scope &&) = delete;
+
+  public:
+    void addBytesRead(uint64_t Bytes) { Recorded.BytesRead += Bytes; }
+    void addBytesWritten(uint64_t Bytes) { Recorded.BytesWritten += Bytes; }
+
+    llvm::StringRef name() const { return Recorded.Name; }
+  };
+
+public:
+  static bool isEnabled();
+
+  /// Records the production of \p Target in \p ContainerName by \p Pipe.
+  ///
+  /// Only the wall time is recorded for targets, since measuring the resource
+  /// usage for each of them would be too expensive.
+  static void recordTarget(llvm::StringRef Pipe,
+                           llvm::StringRef ContainerName,
+                           llvm::StringRef Target,
+                           Clock::time_point Start,
+                           Clock::time_point End);
+
+private:
+  static void record(Event &&ToRecord);
+};
+
+} // namespace pipeline
@@ -180,11 +180,31 @@ public:
               pipeline::TargetInStepSet &InvalidationsMap,
               const llvm::StringMap<std::string> &Options = {});
 
+  /// Runs the analyses of \p List in order.
+  ///
+  /// When running with multiple jobs, consecutive analyses declaring to access
+  /// independent parts of the globals are run concurrently.
   llvm::Expected<DiffMap>
   runAnalyses(const AnalysesList &List,
               pipeline::TargetInStepSet &InvalidationsMap,
               const llvm::StringMap<std::string> &Options = {});
 
+private:
+  ContainerToTargetsMap getAnalysisTargets(const AnalysisReference &Ref) const;
+
+  llvm::Error runListedAnalysis(const AnalysisReference &Ref,
+                                pipeline::TargetInStepSet &InvalidationsMap,
+                                const llvm::StringMap<std::string> &Options);
+
+  /// Runs \p Wave, a list of independent analyses, each one on its own copy
+  /// of the globals, and applies their changes in order
+  llvm::Error
+  runAnalysesConcurrently(llvm::ArrayRef<const AnalysisReference *> Wave,
+                          pipeline::TargetInStepSet &InvalidationsMap,
+                          const llvm::StringMap<std::string> &Options);
+
+public:
+
   void addContainerFactory(llvm::StringRef Name, ContainerFactory Entry) {
     ContainerFactoriesRegistry.registerContainerFactory(Name, std::move(Entry));
   }
@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <functional>
 #include <memory>
 #include <optional>
 #include <set>
@@ -42,6 +43,8 @@ public:
   using AnalysisIterator = AnalysisMapType::iterator;
   using AnalysisValueType = AnalysisMapType::value_type;
   using ConstAnalysisIterator = AnalysisMapType::const_iterator;
+  using CommitListener = std::function<void(const Target &,
+                                            const ContainerBase &)>;
 
 private:
   struct ArtifactsInfo {
@@ -71,6 +74,8 @@ private:
   ArtifactsInfo Artifacts;
   AnalysisMapType AnalysisMap;
   Context *TheContext = nullptr;
+  std::string ListenedContainer;
+  CommitListener Listener;
 
 public:
   template<typename... PipeWrapperTypes>
@@ -122,9 +127,8 @@ public:
 
     for (auto &Container : ToInvalidateMap) {
       if (Containers.contains(Container.first())) {
-        Container.second = Container.second.intersect(Containers
-                                                        .at(Container.first())
-                                                        .enumerate());
+        Container.second = Container.second.intersect(Containers.enumerate(
+          Container.first()));
       }
     }
 
@@ -133,13 +137,19 @@ public:
 
 private:
   llvm::Error loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
-                                           ContainerSet::value_type &Pair);
+                                           ContainerSet::value_type &Pair,
+                                           ContainerToTargetsMap &Stale);
 
 private:
-  llvm::Error loadInvalidationMetadata(const revng::DirectoryPath &Path);
+  llvm::Error loadInvalidationMetadata(const revng::DirectoryPath &Path,
+                                       ContainerToTargetsMap &Stale);
 
   llvm::Error storeInvalidationMetadata(const revng::DirectoryPath &Path) const;
 
+  llvm::Error loadContainer(const revng::DirectoryPath &Path,
+                            llvm::StringRef ContainerName);
+  llvm::Error storeTargetsIndex(const revng::DirectoryPath &Path) const;
+
 public:
   void addAnalysis(llvm::StringRef Name, AnalysisWrapper Analysis) {
     AnalysisMap.try_emplace(Name, std::move(Analysis));
@@ -189,6 +199,30 @@ public:
     return MutableContainers;
   }
 
+  /// Returns true if none of the containers used by the pipes of this step
+  /// shares state with containers of other steps.
+  bool usesOnlyThreadSafeContainers() const {
+    for (const auto &Pipe : Pipes)
+      for (const std::string &Name : Pipe.Pipe->getRunningContainersNames())
+        if (not Containers.isThreadSafe(Name))
+          return false;
+
+    return true;
+  }
+
+  /// Returns the parts of the globals the pipes of this step declare to access
+  GlobalsAccess getAccessedGlobals() const {
+    GlobalsAccess Result;
+    for (const auto &Pipe : Pipes) {
+      if (auto Access = Pipe.Pipe->getAccessedGlobals()) {
+        llvm::append_range(Result.Read, Access->Read);
+        llvm::append_range(Result.Written, Access->Written);
+      }
+    }
+
+    return Result;
+  }
+
   llvm::Error setArtifacts(std::string ContainerName,
                            const Kind *ArtifactsKind,
                            std::string SingleTargetFilename) {
@@ -259,11 +293,53 @@ public:
                           const ContainerToTargetsMap &Targets,
                           const llvm::StringMap<std::string> &ExtraArgs = {});
 
+  /// Clones the \p Targets an analysis of this step has to run on
+  ContainerSet cloneAnalysisInputs(const ContainerToTargetsMap &Targets) const;
+
+  /// Runs an analysis on \p Inputs, obtained through cloneAnalysisInputs,
+  /// against \p RunContext instead of the context of the step.
+  ///
+  /// This is used to run analyses concurrently, each one changing its own copy
+  /// of the globals.
+  llvm::Error runAnalysis(Context &RunContext,
+                          llvm::StringRef AnalysisName,
+                          ContainerSet &Inputs,
+                          const llvm::StringMap<std::string> &ExtraArgs = {});
+
+  /// Returns true if none of the containers used by the analysis \p Name
+  /// shares state with containers of other steps.
+  bool analysisUsesOnlyThreadSafeContainers(llvm::StringRef Name) const {
+    const AnalysisWrapper &Analysis = getAnalysis(Name);
+    for (const std::string &Container : Analysis->getRunningContainersNames())
+      if (not Containers.isThreadSafe(Container))
+        return false;
+
+    return true;
+  }
+
   /// Executes all the pipes of this step, merges the results in the final
   /// containers and returns the containers filtered according to the request.
   ContainerSet run(ContainerSet &&Targets,
                    const std::vector<PipeExecutionEntry> &ExecutionInfos);
 
+  /// Invokes \p Listener on each target the last pipe writing \p ContainerName
+  /// commits into it, as soon as that pipe completes, while run is executing.
+  ///
+  /// The container passed to the listener is the one the pipes are working on,
+  /// hence the committed target can be extracted from it immediately, before
+  /// the step completes. Targets the pipes do not commit (e.g., because they
+  /// have been fetched from the cache) are not notified.
+  void setCommitListener(llvm::StringRef ContainerName,
+                         CommitListener Listener) {
+    ListenedContainer = ContainerName.str();
+    this->Listener = std::move(Listener);
+  }
+
+  void clearCommitListener() {
+    ListenedContainer.clear();
+    Listener = nullptr;
+  }
+
   void pipeInvalidate(const GlobalTupleTreeDiff &Diff,
                       ContainerToTargetsMap &Map) const;
 
@@ -289,7 +365,15 @@ public:
 
 public:
   llvm::Error store(const revng::DirectoryPath &DirPath) const;
-  llvm::Error load(const revng::DirectoryPath &DirPath);
+
+  /// Loads the containers and the invalidation metadata of this step.
+  ///
+  /// Targets that have been produced reading parts of the globals that have
+  /// changed since they were stored are reported in \p Stale. They are not
+  /// removed from the containers, since the invalidation must be propagated to
+  /// the following steps too.
+  llvm::Error load(const revng::DirectoryPath &DirPath,
+                   ContainerToTargetsMap &Stale);
 
   std::vector<revng::FilePath>
   getWrittenFiles(const revng::DirectoryPath &DirPath) const;
@@ -316,13 +400,16 @@ public:
 
 private:
   static void removeSatisfiedGoals(TargetsList &RequiredInputs,
-                                   const ContainerBase &CachedSymbols,
+                                   const TargetsList &EnumeratedSymbols,
                                    TargetsList &ToLoad);
 
 private:
   void removeSatisfiedGoals(ContainerToTargetsMap &Targets,
                             ContainerToTargetsMap &ToLoad) const;
 
+  /// Returns the last pipe that can alter \p ContainerName, nullptr if none
+  const PipeWrapper *getLastPipeWriting(llvm::StringRef ContainerName) const;
+
   void explainExecutedPipe(const InvokableWrapperBase &Wrapper,
                            size_t Indentation = 0) const;
   void explainStartStep(const ContainerToTargetsMap &Wrapper,
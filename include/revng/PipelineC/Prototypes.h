@@ -190,6 +190,95 @@ rp_manager_produce_targets(rp_manager *manager,
                            rp_error *error);
 LENGTH_HINT(rp_manager_produce_targets, 4, 3)
 
+/**
+ * Function invoked by rp_manager_produce_targets_streaming() for each
+ * produced target.
+ *
+ * \param target the produced target, one of the elements of the targets
+ *        array passed to rp_manager_produce_targets_streaming()
+ * \param buffer the extracted content of \p target, only valid until the
+ *        function returns
+ * \param buffer_size the number of bytes contained in \p buffer
+ * \param user_data the pointer passed to
+ *        rp_manager_produce_targets_streaming()
+ */
+typedef void (*rp_produced_target_callback)(const rp_target *target,
+                                            const char *buffer,
+                                            uint64_t buffer_size,
+                                            void *user_data);
+
+/**
+ * Like rp_manager_produce_targets(), but rather than serializing the whole
+ * container at the end, \p callback is invoked once for each target, as soon
+ * as the pipe producing it commits it.
+ *
+ * Invocations of \p callback never overlap, but they can take place on a
+ * thread other than the calling one. The callback must not invoke functions
+ * of this library.
+ *
+ * \param callback the function receiving the targets, can be \c NULL in
+ *        which case the targets are only produced
+ * \param user_data opaque pointer passed as is to \p callback
+ *
+ * \return false if an error was encountered, true otherwise
+ */
+bool rp_manager_produce_targets_streaming(rp_manager *manager,
+                                          const rp_step *step,
+                                          const rp_container *container,
+                                          uint64_t targets_count,
+                                          const rp_target *targets[],
+                                          rp_produced_target_callback callback,
+                                          void *user_data,
+                                          rp_error *error);
+LENGTH_HINT(rp_manager_produce_targets_streaming, 4, 3)
+
+/**
+ * Function invoked by rp_manager_produce_targets_chunked() and
+ * rp_container_extract_one_chunked() with a chunk of the content of a target.
+ *
+ * The chunks of a target are delivered in order, without interleaving them
+ * with the ones of other targets. After the last chunk of a target, the
+ * function is invoked once more with \p buffer_size equal to 0. This happens
+ * even if extracting the target fails midway, in which case the content
+ * received is incomplete and the function delivering the chunks reports the
+ * error.
+ *
+ * \param target the target the chunk belongs to
+ * \param buffer the chunk, only valid until the function returns
+ * \param buffer_size the number of bytes contained in \p buffer
+ * \param user_data the pointer passed along with the callback
+ */
+typedef void (*rp_target_chunk_callback)(const rp_target *target,
+                                         const char *buffer,
+                                         uint64_t buffer_size,
+                                         void *user_data);
+
+/**
+ * Like rp_manager_produce_targets_streaming(), but the content of each target
+ * is handed to \p callback in chunks as it is extracted, so that it never
+ * needs to be entirely in memory. This is the preferred way of exporting big
+ * artifacts, e.g., by writing the chunks to a file.
+ *
+ * Invocations of \p callback never overlap, but they can take place on a
+ * thread other than the calling one. The callback must not invoke functions
+ * of this library.
+ *
+ * \param callback the function receiving the chunks, can be \c NULL in which
+ *        case the targets are only produced
+ * \param user_data opaque pointer passed as is to \p callback
+ *
+ * \return false if an error was encountered, true otherwise
+ */
+bool rp_manager_produce_targets_chunked(rp_manager *manager,
+                                        const rp_step *step,
+                                        const rp_container *container,
+                                        uint64_t targets_count,
+                                        const rp_target *targets[],
+                                        rp_target_chunk_callback callback,
+                                        void *user_data,
+                                        rp_error *error);
+LENGTH_HINT(rp_manager_produce_targets_chunked, 4, 3)
+
 /**
  * Request to run the required analysis
  *
@@ -381,6 +470,46 @@ rp_buffer * /*owning*/
 rp_container_extract_one(const rp_container *container,
                          const rp_target *target);
 
+/**
+ * Extracts many targets at once, in a single buffer laid out as follows:
+ * * the size of the content of each target, in the order of \p targets, as
+ *   64-bit little-endian integers
+ * * the content of each target, in the same order, without any padding
+ *
+ * This avoids a call (and a copy) for each target when extracting many of
+ * them, e.g., all the functions of a binary.
+ *
+ * \param targets_count must be equal to the size of targets.
+ *
+ * \return the buffer, or NULL if the content of any of \p targets hasn't been
+ *         produced yet or if an error was encountered while extracting it, in
+ *         which case \p error is set
+ */
+rp_buffer * /*owning*/
+rp_container_extract_many(const rp_container *container,
+                          uint64_t targets_count,
+                          const rp_target *targets[],
+                          rp_error *error);
+LENGTH_HINT(rp_container_extract_many, 2, 1)
+
+/**
+ * Like rp_container_extract_one(), but the content is handed to \p callback
+ * in chunks, see rp_target_chunk_callback.
+ *
+ * \param callback the function receiving the chunks, can be \c NULL in which
+ *        case the content is not extracted
+ * \param user_data opaque pointer passed as is to \p callback
+ *
+ * \return false if the content hasn't been produced yet or if an error was
+ *         encountered while extracting it, in which case \p error is set and
+ *         the final empty chunk is not handed to \p callback; true otherwise
+ */
+bool rp_container_extract_one_chunked(const rp_container *container,
+                                      const rp_target *target,
+                                      rp_target_chunk_callback callback,
+                                      void *user_data,
+                                      rp_error *error);
+
 /** \} */
 
 /**
@@ -5,7 +5,9 @@
 //
 
 #include <concepts>
+#include <functional>
 
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Pass.h"
 
 #include "revng/Model/Function.h"
@@ -15,6 +17,7 @@ class LoadModelWrapperPass;
 namespace pipeline {
 class LoadExecutionContextPass;
 class ExecutionContext;
+class LLVMContainer;
 class TargetsList;
 } // namespace pipeline
 
@@ -55,6 +58,38 @@ namespace detail {
 bool runOnModule(llvm::Module &Module, FunctionPassImpl &Pipe);
 } // namespace detail
 
+/// Populates \p Manager with the passes to run on the module of \p Container.
+/// \p EC and \p Container are the ones the passes must use, which are not
+/// necessarily the ones originally passed to the pipe.
+using FunctionPipePopulator = std::function<
+  void(llvm::legacy::PassManager &Manager, ExecutionContext &EC,
+       LLVMContainer &Container)>;
+
+/// Runs the passes added by \p Populate, which are expected to contain a
+/// FunctionPass, on \p Container.
+///
+/// If `-function-pass-jobs` is greater than one, the targets requested for
+/// \p Container are split into contiguous shards and each shard is processed
+/// by a worker thread on its own copy of the module (living in a private
+/// LLVMContext). Workers share the pipeline context, which they only read,
+/// recording the fields read to produce each target on their own. The results
+/// are merged back in shard order, so the output does not depend on
+/// scheduling, and the targets are then committed from the calling thread.
+///
+/// \note Only use this for FunctionPassImpl that do not touch anything but the
+///       function they are run on, and that do not rely on module-wide state
+///       in prologue and epilogue.
+void runFunctionPipe(ExecutionContext &EC,
+                     LLVMContainer &Container,
+                     const FunctionPipePopulator &Populate);
+
+/// Same as above, but using \p Jobs threads instead of `-function-pass-jobs`.
+/// Zero means one per core.
+void runFunctionPipe(ExecutionContext &EC,
+                     LLVMContainer &Container,
+                     const FunctionPipePopulator &Populate,
+                     unsigned Jobs);
+
 /// Wrap your clas deriving from a FunctionPassImpl with this class to turn it
 /// compatible with a llvm passmanager
 template<IsFunctionPipeImpl T>
@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 
+#include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
@@ -16,6 +17,7 @@
 #include "revng/Pipes/ModelGlobal.h"
 #include "revng/Storage/Path.h"
 #include "revng/Storage/StorageClient.h"
+#include "revng/Support/ChunkedOstream.h"
 
 namespace revng::pipes {
 
@@ -172,6 +174,42 @@ public:
                  const Container &TheContainer,
                  const pipeline::TargetsList &List);
 
+  using ProducedTargetCallback = llvm::function_ref<
+    void(const pipeline::Target &, llvm::StringRef Serialized)>;
+
+  /// Like produceTargets, but instead of returning the container at the end,
+  /// \p OnProduced is invoked with the extracted content of each target as
+  /// soon as it has been committed by the pipe producing it.
+  ///
+  /// Each target of \p List is delivered exactly once, targets that were
+  /// already available or that have not been committed while the pipeline was
+  /// running are delivered after the pipeline completes.
+  /// Invocations of \p OnProduced never overlap, but they can take place on
+  /// threads other than the calling one.
+  llvm::Error produceTargets(const llvm::StringRef StepName,
+                             const Container &TheContainer,
+                             const pipeline::TargetsList &List,
+                             ProducedTargetCallback OnProduced);
+
+  using TargetChunkCallback = llvm::function_ref<
+    void(const pipeline::Target &, llvm::StringRef Chunk)>;
+
+  /// Like produceTargets, but the content of each target is extracted directly
+  /// into chunks of at most \p ChunkSize bytes, handed to \p OnChunk as soon
+  /// as they are ready, so that targets never need to be entirely in memory.
+  ///
+  /// The chunks of a target are delivered in order, without interleaving them
+  /// with the ones of other targets, and are followed by an empty one. This is
+  /// the case even if extracting the target fails: the error is returned once
+  /// all the targets have been delivered.
+  llvm::Error
+  produceTargetsInChunks(const llvm::StringRef StepName,
+                         const Container &TheContainer,
+                         const pipeline::TargetsList &List,
+                         TargetChunkCallback OnChunk,
+                         size_t ChunkSize =
+                           revng::ChunkedOstream::DefaultChunkSize);
+
   llvm::Expected<pipeline::DiffMap>
   runAnalyses(const pipeline::AnalysesList &List,
               pipeline::TargetInStepSet &Map,
@@ -206,5 +244,15 @@ public:
 private:
   llvm::Error produceAllPossibleTargets(bool ExpandTargets);
   llvm::Error computeDescription();
+
+  using ExtractCallback = llvm::function_ref<
+    llvm::Error(const pipeline::Target &, const pipeline::ContainerBase &)>;
+
+  /// Produces the targets of \p List, invoking \p Extract exactly once for
+  /// each of them, as soon as they have been committed
+  llvm::Error deliverTargets(const llvm::StringRef StepName,
+                             const Container &TheContainer,
+                             const pipeline::TargetsList &List,
+                             ExtractCallback Extract);
 };
 } // namespace revng::pipes
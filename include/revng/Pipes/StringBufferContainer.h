@@ -3,6 +3,7 @@
 //
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
+#include <memory>
 #include <optional>
 
 #include "llvm/Support/FileSystem.h"
@@ -11,8 +12,11 @@
 
 #include "revng/Pipeline/ContainerSet.h"
 #include "revng/Pipeline/LLVMContainerFactory.h"
+#include "revng/Pipeline/Profiler.h"
 #include "revng/Pipeline/Target.h"
 #include "revng/Pipes/Kinds.h"
+#include "revng/Storage/Path.h"
+#include "revng/Storage/ReadableFile.h"
 #include "revng/Support/Assert.h"
 
 namespace revng::pipes {
@@ -26,6 +30,12 @@ class StringBufferContainer
       StringBufferContainer<K, TypeName, MIME, Suffix>> {
 private:
   std::string Content;
+  // When the container is loaded from a file, its content is a view of the
+  // file buffer (usually a memory mapping), which is copied into Content only
+  // once the container is mutated.
+  // The buffer stays valid even if the file is stored again, since files are
+  // replaced only once fully written.
+  std::shared_ptr<revng::ReadableFile> File;
 
 public:
   inline static char ID = '0';
@@ -45,7 +55,7 @@ public:
   }
 
   pipeline::TargetsList enumerate() const final {
-    if (Content.empty())
+    if (content().empty())
       return {};
 
     return pipeline::TargetsList({ getOnlyPossibleTarget() });
@@ -61,18 +71,49 @@ public:
     return true;
   }
 
-  void setContent(std::string NewString) { Content = std::move(NewString); }
+  void setContent(std::string NewString) {
+    Content = std::move(NewString);
+    File.reset();
+  }
+
+  llvm::StringRef content() const {
+    if (File != nullptr)
+      return File->buffer().getBuffer();
+
+    return Content;
+  }
 
   void clear() override { *this = StringBufferContainer(this->name()); }
 
   llvm::Error serialize(llvm::raw_ostream &OS) const override {
-    OS << Content;
+    OS << content();
     OS.flush();
     return llvm::Error::success();
   }
 
   llvm::Error deserialize(const llvm::MemoryBuffer &Buffer) override {
-    Content = Buffer.getBuffer().str();
+    setContent(Buffer.getBuffer().str());
+    return llvm::Error::success();
+  }
+
+  llvm::Error load(const revng::FilePath &Path) override {
+    auto MaybeExists = Path.exists();
+    if (not MaybeExists)
+      return MaybeExists.takeError();
+
+    clear();
+    if (not MaybeExists.get())
+      return llvm::Error::success();
+
+    auto MaybeFile = Path.getReadableFile();
+    if (not MaybeFile)
+      return MaybeFile.takeError();
+
+    // The content is mapped rather than parsed, still account for it as the
+    // default implementation does
+    pipeline::Profiler::Scope Scope("deserialize", this->name());
+    File = std::move(MaybeFile.get());
+    Scope.addBytesRead(File->buffer().getBufferSize());
     return llvm::Error::success();
   }
 
@@ -83,20 +124,24 @@ public:
   }
 
   llvm::raw_string_ostream asStream() {
+    if (File != nullptr)
+      setContent(content().str());
+
     return llvm::raw_string_ostream(Content);
   }
 
   static std::vector<pipeline::Kind *> possibleKinds() { return { K }; }
 
 public:
-  void dump() const debug_function { dbg << Content << "\n"; }
+  void dump() const debug_function { dbg << content() << "\n"; }
 
 private:
   void mergeBackImpl(StringBufferContainer &&Container) override {
-    if (Container.Content.empty())
+    if (Container.content().empty())
       return;
 
     Content = std::move(Container.Content);
+    File = std::move(Container.File);
   }
 
   pipeline::Target getOnlyPossibleTarget() const {
@@ -4,11 +4,20 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <utility>
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/xxhash.h"
 
 #include "revng/Pipeline/Container.h"
 #include "revng/Pipeline/ContainerSet.h"
@@ -18,18 +27,30 @@
 #include "revng/Pipes/Kinds.h"
 #include "revng/Pipes/ModelGlobal.h"
 #include "revng/Pipes/TypeKind.h"
+#include "revng/Storage/Path.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/Error.h"
+#include "revng/Support/GzipStream.h"
 #include "revng/Support/GzipTarFile.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/MetaAddress/YAMLTraits.h"
+#include "revng/Support/OffsetIndex.h"
 #include "revng/Support/YAMLTraits.h"
+#include "revng/Support/ZstdArchive.h"
 #include "revng/TupleTree/TupleTree.h"
 
+/// The number of threads used to compress the entries of GenericStringMap
+extern llvm::cl::opt<unsigned> StringMapJobs;
+
 namespace detail {
 
 struct DataOffset {
   size_t UncompressedSize;
   size_t Start;
   size_t End;
+  /// Set if the data is in the delta of the archive, rather than in the
+  /// archive itself
+  bool FromDelta = false;
 };
 
 template<typename T>
@@ -69,6 +90,9 @@ struct CustomMappingTraits<::detail::OffsetMap<T>> {
 
 namespace revng::pipes {
 
+/// When enabled, string maps also store their index as YAML, for debugging
+inline Logger<> StringMapIndexLog("string-map-index");
+
 namespace detail {
 
 template<auto *Rank,
@@ -98,11 +122,203 @@ public:
 
 private:
   using OffsetMap = ::detail::OffsetMap<KeyType>;
-  MapType Map;
+
+  /// The entries of an archive that have not been decompressed yet. Those
+  /// listed in the index of a tar.gz archive are looked up in the index itself
+  /// on access, rather than being copied out of it. The others (e.g., the ones
+  /// of a ZstdArchive) are recorded explicitly.
+  class PendingEntries {
+  private:
+    OffsetMap Entries;
+    std::shared_ptr<revng::ReadableFile> IndexFile;
+    std::optional<revng::OffsetIndexReader> Index;
+    // The keys in Index that are no longer pending
+    std::set<KeyType> Dropped;
+
+  public:
+    /// Makes all the entries of \p Reader, the index in \p File, pending
+    void setIndex(std::shared_ptr<revng::ReadableFile> File,
+                  const revng::OffsetIndexReader &Reader) {
+      clear();
+      IndexFile = std::move(File);
+      Index = Reader;
+    }
+
+    void clear() {
+      Entries.clear();
+      IndexFile.reset();
+      Index.reset();
+      Dropped.clear();
+    }
+
+    size_t size() const {
+      size_t Result = Entries.size();
+      if (Index.has_value())
+        Result += Index->size() - Dropped.size();
+      return Result;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    std::optional<::detail::DataOffset> find(const KeyType &Key) const {
+      if (auto It = Entries.find(Key); It != Entries.end())
+        return It->second;
+
+      if (not Index.has_value() or Dropped.contains(Key))
+        return std::nullopt;
+
+      if (auto Entry = Index->find(keyToString(Key)))
+        return toDataOffset(*Entry);
+
+      return std::nullopt;
+    }
+
+    bool contains(const KeyType &Key) const { return find(Key).has_value(); }
+
+    /// \return the number of entries that have been erased
+    size_t erase(const KeyType &Key) {
+      if (Entries.erase(Key) != 0)
+        return 1;
+
+      if (not Index.has_value() or Dropped.contains(Key)
+          or not Index->find(keyToString(Key)).has_value())
+        return 0;
+
+      Dropped.insert(Key);
+      return 1;
+    }
+
+    void set(const KeyType &Key, const ::detail::DataOffset &Offset) {
+      erase(Key);
+      Entries[Key] = Offset;
+    }
+
+    /// Invokes \p Callable on each entry, in key order
+    template<typename CallableT>
+    void forEach(CallableT &&Callable) const {
+      // The index is sorted by the string representation of the keys, which
+      // is not necessarily the order of KeyType
+      std::vector<std::pair<KeyType, ::detail::DataOffset>> FromIndex;
+      if (Index.has_value()) {
+        FromIndex.reserve(Index->size() - Dropped.size());
+        for (size_t I = 0; I < Index->size(); ++I) {
+          revng::OffsetIndexEntry Entry = (*Index)[I];
+          KeyType Key = keyFromString(Entry.Key);
+          if (not Dropped.contains(Key))
+            FromIndex.emplace_back(std::move(Key), toDataOffset(Entry));
+        }
+        llvm::sort(FromIndex, [](const auto &LHS, const auto &RHS) {
+          return LHS.first < RHS.first;
+        });
+      }
+
+      auto It = Entries.begin();
+      for (const auto &[Key, Offset] : FromIndex) {
+        for (; It != Entries.end() and It->first < Key; ++It)
+          Callable(It->first, It->second);
+        Callable(Key, Offset);
+      }
+
+      for (; It != Entries.end(); ++It)
+        Callable(It->first, It->second);
+    }
+
+  private:
+    static ::detail::DataOffset
+    toDataOffset(const revng::OffsetIndexEntry &Entry) {
+      return { .UncompressedSize = Entry.UncompressedSize,
+               .Start = Entry.Start,
+               .End = Entry.End };
+    }
+  };
+
+  /// The format used by store. Regardless of it, serialize always produces a
+  /// tar.gz archive and load accepts all of them.
+  enum class StorageEncoding {
+    /// A tar.gz archive with a gzip stream per entry and a YAML index
+    TarGzip,
+    /// A ZstdArchive with a zstd frame per entry. Storing the container where
+    /// it has been loaded from or last stored only writes the entries that
+    /// changed since then, see storeDelta.
+    Zstd,
+    /// Like Zstd, but the entries are compressed with a trained dictionary
+    ZstdDictionary
+  };
+
+  // When the container is loaded along with its index, the entries are
+  // decompressed from the archive the first time they are accessed, possibly
+  // through const methods. Until then, they are in Pending.
+  // Storing the container over the archive it has been loaded from is fine,
+  // since files are replaced only once fully written.
+  // Const methods can be invoked from multiple threads at the same time, hence
+  // they take LazyStateLock before touching any of the mutable members.
+  mutable MapType Map;
+  mutable PendingEntries Pending;
+  mutable std::shared_ptr<revng::ReadableFile> Archive;
+  // Set if Archive is a ZstdArchive rather than a tar.gz one
+  mutable std::shared_ptr<revng::ZstdArchiveReader> ZstdReader;
+  // Set if the pending entries are fetched one at a time from the tar.gz
+  // archive at this path, rather than from Archive, which has not been read.
+  // This happens on storages preferring ranged reads (e.g., S3), where reading
+  // the whole archive means downloading it. Shared among the clones, like
+  // Archive, to tell whether their entries come from the same archive.
+  mutable std::shared_ptr<const revng::FilePath> RemoteArchive;
+  StorageEncoding Encoding = StorageEncoding::TarGzip;
+
+  // The entries of Map that have been decompressed from a ZstdArchive, along
+  // with the hash of their content at that time. As long as the hash matches,
+  // they are clean, i.e., their frame can be reused as is.
+  struct MaterializedEntry {
+    ::detail::DataOffset Offset;
+    uint64_t Hash = 0;
+  };
+  mutable std::map<KeyType, MaterializedEntry> Materialized;
+
+  // The ZstdArchive holding the changes to Archive written by storeDelta
+  mutable std::shared_ptr<revng::ReadableFile> Delta;
+  mutable std::shared_ptr<revng::ZstdArchiveReader> DeltaReader;
+  mutable size_t DeltaEntriesCount = 0;
+  mutable size_t DeltaRemovedCount = 0;
+
+  // Where Archive and Delta are stored, if they are still there. After a
+  // store, they are reopened from there, so that the entries that have just
+  // been written are clean.
+  mutable std::optional<revng::FilePath> ArchivePath;
+
+  /// A recursive mutex, since const methods call each other, that is not
+  /// copied along with the container
+  struct LazyStateMutex : public std::recursive_mutex {
+    LazyStateMutex() = default;
+    LazyStateMutex(const LazyStateMutex &) {}
+    LazyStateMutex &operator=(const LazyStateMutex &) { return *this; }
+  };
+  mutable LazyStateMutex LazyStateLock;
+
+  inline static constexpr llvm::StringLiteral DeltaBaseEntry = "/base";
+  inline static constexpr llvm::StringLiteral DeltaRemovedEntry = "/removed";
+
+  /// What store has written
+  enum class WrittenFiles {
+    /// Nothing changed since the last store
+    Nothing,
+    /// The delta next to the archive
+    Delta,
+    /// The whole archive
+    Archive
+  };
+
+  // Below this number of entries, compressing them on a thread pool costs more
+  // than it saves
+  static constexpr size_t MinimumParallelEntries = 64;
 
 public:
   inline static char ID = '0';
 
+  /// The delta is compacted into the archive once it gets bigger than
+  /// 1/CompactionRatio of it, or it removes more than 1/CompactionRatio of its
+  /// entries
+  static constexpr size_t CompactionRatio = 2;
+
 public:
   GenericStringMap(llvm::StringRef Name) :
     pipeline::Container<GenericStringMap>(Name), Map() {
@@ -118,11 +334,28 @@ public:
   ~GenericStringMap() override = default;
 
 public:
-  void clear() override { Map.clear(); }
+  void clear() override {
+    Map.clear();
+    Pending.clear();
+    Materialized.clear();
+    resetArchive();
+  }
+
+  static bool isValidEncoding(llvm::StringRef Name) {
+    return parseEncoding(Name).has_value();
+  }
+
+  void setEncoding(llvm::StringRef Name) {
+    std::optional<StorageEncoding> NewEncoding = parseEncoding(Name);
+    revng_assert(NewEncoding.has_value());
+    Encoding = *NewEncoding;
+  }
 
   std::unique_ptr<pipeline::ContainerBase>
   cloneFiltered(const pipeline::TargetsList &Targets) const override {
+    std::unique_lock Lock(LazyStateLock);
     auto Clone = std::make_unique<GenericStringMap>(*this);
+    Lock.unlock();
 
     // Returns true if Targets contains a Target that matches the Entry in the
     // Map
@@ -134,6 +367,21 @@ public:
 
     // Drop all the entries in Map that are not in Targets
     std::erase_if(Clone->Map, std::not_fn(EntryIsInTargets));
+    std::erase_if(Clone->Materialized, std::not_fn(EntryIsInTargets));
+
+    // Look up the pending entries in Targets, rather than going through all of
+    // them
+    Clone->Pending.clear();
+    for (const pipeline::Target &Target : Targets) {
+      if (&Target.getKind() != K)
+        continue;
+
+      KeyType Key = keyFromString(Target.getPathComponents().back());
+      if (auto Offset = Pending.find(Key))
+        Clone->Pending.set(Key, *Offset);
+    }
+    if (Clone->Pending.empty() and Clone->Materialized.empty())
+      Clone->resetArchive();
 
     return Clone;
   }
@@ -143,19 +391,16 @@ public:
     revng_check(&Target.getKind() == K);
 
     std::string KeyString = Target.getPathComponents().back();
-
-    auto It = find(keyFromString(KeyString));
-    revng_check(It != end());
-
-    OS << It->second;
-
-    return llvm::Error::success();
+    return extract(OS, keyFromString(KeyString));
   }
 
   pipeline::TargetsList enumerate() const override {
+    std::lock_guard Lock(LazyStateLock);
     pipeline::TargetsList::List Result;
-    for (const auto &[Key, Value] : Map)
+    const auto Push = [&](const KeyType &Key, const auto &) {
       Result.push_back({ keyToString(Key), *K });
+    };
+    forEachEntry(Push, Push);
 
     return Result;
   }
@@ -168,9 +413,13 @@ public:
       revng_assert(&T.getKind() == K);
 
       std::string KeyString = T.getPathComponents().back();
-      auto It = Map.find(keyFromString(KeyString));
+      KeyType Key = keyFromString(KeyString);
+      auto It = Map.find(Key);
       if (It != End) {
         Map.erase(It);
+        Materialized.erase(Key);
+        Changed = true;
+      } else if (Pending.erase(Key) != 0) {
         Changed = true;
       }
     }
@@ -179,6 +428,10 @@ public:
   }
 
   llvm::Error serialize(llvm::raw_ostream &OS) const override {
+    std::lock_guard Lock(LazyStateLock);
+    if (auto Error = downloadArchive())
+      return Error;
+
     serializeWithOffsets(OS);
     return llvm::Error::success();
   }
@@ -189,28 +442,28 @@ public:
     return llvm::Error::success();
   }
 
+  /// The content of the container is not changed. Once the files have been
+  /// written, the entries are rebased on them (see rebase), which only changes
+  /// where the pending entries are decompressed from.
   llvm::Error store(const revng::FilePath &Path) const override {
-    auto MaybeWritableFile = Path.getWritableFile(ContentEncoding::Gzip);
-    if (not MaybeWritableFile)
-      return MaybeWritableFile.takeError();
-
-    OffsetMap Offsets = serializeWithOffsets(MaybeWritableFile.get()->os());
-
-    if (auto Error = MaybeWritableFile.get()->commit())
+    std::lock_guard Lock(LazyStateLock);
+    if (auto Error = downloadArchive())
       return Error;
 
-    revng::FilePath IndexPath = Path.addExtension("idx");
-    auto MaybeWritableIndexFile = IndexPath.getWritableFile();
-    if (MaybeWritableIndexFile) {
-      llvm::yaml::Output IndexOutput(MaybeWritableIndexFile.get()->os());
-      IndexOutput << Offsets;
-
-      if (auto Error = MaybeWritableIndexFile.get()->commit())
-        return Error;
-    } else {
-      llvm::consumeError(MaybeWritableIndexFile.takeError());
+    llvm::Expected<WrittenFiles> MaybeWritten = [&]() {
+      if (Encoding != StorageEncoding::TarGzip and canStoreDelta(Path))
+        return storeDelta(Path);
+      return storeFull(Path);
+    }();
+
+    if (not MaybeWritten) {
+      // The archive at Path might have been partially replaced
+      if (ArchivePath.has_value() and *ArchivePath == Path)
+        ArchivePath.reset();
+      return MaybeWritten.takeError();
     }
 
+    rebase(Path, *MaybeWritten);
     return llvm::Error::success();
   }
 
@@ -224,24 +477,74 @@ public:
       return llvm::Error::success();
     }
 
+    // With the index, the archive is not even read until an entry is needed
+    if (Path.prefersRangedReads() and loadIndex(Path, nullptr))
+      return llvm::Error::success();
+
     auto MaybeBuffer = Path.getReadableFile();
     if (not MaybeBuffer)
       return MaybeBuffer.takeError();
 
-    GzipTarReader Reader(MaybeBuffer.get()->buffer());
+    clear();
+    std::shared_ptr<revng::ReadableFile> File = std::move(MaybeBuffer.get());
+
+    // The format is detected from the content, regardless of Encoding, so that
+    // changing the encoding of a container does not invalidate existing files
+    const llvm::MemoryBuffer &Buffer = File->buffer();
+    llvm::ArrayRef<char> Data{ Buffer.getBufferStart(),
+                               Buffer.getBufferSize() };
+    if (revng::ZstdArchiveReader::isZstdArchive(Data)) {
+      if (auto Error = openZstd(Path, std::move(File))) {
+        clear();
+        return Error;
+      }
+
+      return llvm::Error::success();
+    }
+
+    // With the index, there's no need to decompress the entries upfront
+    if (loadIndex(Path, File))
+      return llvm::Error::success();
+
+    GzipTarReader Reader(File->buffer());
     deserializeImpl(Reader);
     return llvm::Error::success();
   }
 
   static std::vector<revng::FilePath>
   getWrittenFiles(const revng::FilePath &Path) {
-    return { Path, Path.addExtension("idx") };
+    return { Path,
+             Path.addExtension("idx"),
+             Path.addExtension("idx.yml"),
+             Path.addExtension("delta") };
   }
 
   static std::vector<pipeline::Kind *> possibleKinds() { return { K }; }
 
 protected:
   void mergeBackImpl(GenericStringMap &&Other) override {
+    bool SameArchive = Other.Archive != nullptr and Other.Archive == Archive
+                       and Other.Delta == Delta;
+    bool SameRemoteArchive = Other.RemoteArchive != nullptr
+                             and Other.RemoteArchive == RemoteArchive;
+    if (SameArchive or SameRemoteArchive) {
+      // Pending entries of Other come from the same archive, keep them pending
+      Other.Pending.forEach([this](const KeyType &Key,
+                                   const ::detail::DataOffset &Offset) {
+        Map.erase(Key);
+        Pending.set(Key, Offset);
+      });
+      Other.Pending.clear();
+
+      for (auto &[Key, Entry] : Other.Materialized)
+        Materialized.insert_or_assign(Key, Entry);
+    } else {
+      Other.materializeAll();
+    }
+
+    for (auto &Entry : Other.Map)
+      Pending.erase(Entry.first);
+
     // Stuff in Other should overwrite what's in this container.
     // We first merge this->Map into Other.Map (which keeps Other's version if
     // present), and then we replace this->Map with the newly merged version of
@@ -253,10 +556,20 @@ protected:
 public:
   /// std::map-like methods
 
-  std::string &operator[](KeyType M) { return Map[M]; };
+  std::string &operator[](KeyType M) {
+    materialize(M);
+    return Map[M];
+  };
 
-  std::string &at(KeyType M) { return Map.at(M); };
-  const std::string &at(KeyType M) const { return Map.at(M); };
+  std::string &at(KeyType M) {
+    materialize(M);
+    return Map.at(M);
+  };
+  const std::string &at(KeyType M) const {
+    std::lock_guard Lock(LazyStateLock);
+    materialize(M);
+    return Map.at(M);
+  };
 
 private:
   using IteratedValue = std::pair<const KeyType &, std::string &>;
@@ -280,57 +593,808 @@ public:
   };
 
   auto insert_or_assign(KeyType Key, const std::string &Value) {
+    Pending.erase(Key);
     auto [Iterator, Success] = Map.insert_or_assign(Key, Value);
     return std::pair{ revng::map_iterator(Iterator, mapIt), Success };
   };
   auto insert_or_assign(KeyType Key, std::string &&Value) {
+    Pending.erase(Key);
     auto [Iterator, Success] = Map.insert_or_assign(Key, std::move(Value));
     return std::pair{ revng::map_iterator(Iterator, mapIt), Success };
   };
 
-  bool contains(KeyType Key) const { return Map.contains(Key); }
+  bool contains(KeyType Key) const {
+    std::lock_guard Lock(LazyStateLock);
+    return Map.contains(Key) or Pending.contains(Key);
+  }
+
+  /// Writes the value of \p Key to \p OS. Unlike at, if the entry has not
+  /// been decompressed yet, it's decompressed directly into \p OS, in chunks,
+  /// without keeping it in memory.
+  ///
+  /// \return an error if the entry is corrupt in the archive
+  llvm::Error extract(llvm::raw_ostream &OS, const KeyType &Key) const {
+    std::lock_guard Lock(LazyStateLock);
+    if (auto Offset = Pending.find(Key))
+      return decompress(OS, *Offset);
+
+    auto It = Map.find(Key);
+    revng_check(It != Map.end());
+    OS << It->second;
+    return llvm::Error::success();
+  }
+
+  /// Invokes \p Callable on each key, in order, without decompressing the
+  /// entries, unlike iterating over the container
+  template<typename CallableT>
+  void forEachKey(CallableT &&Callable) const {
+    std::lock_guard Lock(LazyStateLock);
+    const auto OnKey = [&Callable](const KeyType &Key, const auto &) {
+      Callable(Key);
+    };
+    forEachEntry(OnKey, OnKey);
+  }
 
   auto find(KeyType Key) {
+    materialize(Key);
     return revng::map_iterator(Map.find(Key), this->mapIt);
   }
 
   auto find(KeyType Key) const {
+    std::lock_guard Lock(LazyStateLock);
+    materialize(Key);
     return revng::map_iterator(Map.find(Key), this->mapCIt);
   }
 
-  auto begin() { return revng::map_iterator(Map.begin(), this->mapIt); }
-  auto end() { return revng::map_iterator(Map.end(), this->mapIt); }
+  auto begin() {
+    materializeAll();
+    return revng::map_iterator(Map.begin(), this->mapIt);
+  }
+  auto end() {
+    materializeAll();
+    return revng::map_iterator(Map.end(), this->mapIt);
+  }
 
-  auto begin() const { return revng::map_iterator(Map.begin(), this->mapCIt); }
-  auto end() const { return revng::map_iterator(Map.end(), this->mapCIt); }
+  auto begin() const {
+    std::lock_guard Lock(LazyStateLock);
+    materializeAll();
+    return revng::map_iterator(Map.begin(), this->mapCIt);
+  }
+  auto end() const {
+    std::lock_guard Lock(LazyStateLock);
+    materializeAll();
+    return revng::map_iterator(Map.end(), this->mapCIt);
+  }
 
 private:
+  static std::optional<StorageEncoding> parseEncoding(llvm::StringRef Name) {
+    using OptionalEncoding = std::optional<StorageEncoding>;
+    return llvm::StringSwitch<OptionalEncoding>(Name)
+      .Case("tar.gz", StorageEncoding::TarGzip)
+      .Case("zstd", StorageEncoding::Zstd)
+      .Case("zstd-dictionary", StorageEncoding::ZstdDictionary)
+      .Default(std::nullopt);
+  }
+
+  llvm::Error storeTarGzip(const revng::FilePath &Path) const {
+    auto MaybeWritableFile = Path.getWritableFile(ContentEncoding::Gzip);
+    if (not MaybeWritableFile)
+      return MaybeWritableFile.takeError();
+
+    OffsetMap Offsets = serializeWithOffsets(MaybeWritableFile.get()->os());
+
+    if (auto Error = MaybeWritableFile.get()->commit())
+      return Error;
+
+    if (auto Error = storeIndex(Path.addExtension("idx"), Offsets))
+      return Error;
+
+    if (StringMapIndexLog.isEnabled()) {
+      revng::FilePath YAMLIndexPath = Path.addExtension("idx.yml");
+      auto MaybeWritableFile = YAMLIndexPath.getWritableFile();
+      if (MaybeWritableFile) {
+        llvm::yaml::Output IndexOutput(MaybeWritableFile.get()->os());
+        IndexOutput << Offsets;
+
+        if (auto Error = MaybeWritableFile.get()->commit())
+          return Error;
+      } else {
+        llvm::consumeError(MaybeWritableFile.takeError());
+      }
+    }
+
+    return llvm::Error::success();
+  }
+
+  llvm::Error storeZstd(const revng::FilePath &Path) const {
+    // Keep using the dictionary of the archive the container has been loaded
+    // from as long as most of the entries still come from it, so that they
+    // don't need to be recompressed
+    llvm::SmallVector<char> TrainedDictionary;
+    llvm::ArrayRef<char> Dictionary;
+    if (Encoding == StorageEncoding::ZstdDictionary) {
+      if (ZstdReader != nullptr and not ZstdReader->dictionary().empty()
+          and Pending.size() >= Map.size()) {
+        Dictionary = ZstdReader->dictionary();
+      } else {
+        TrainedDictionary = trainDictionary();
+        Dictionary = TrainedDictionary;
+      }
+    }
+
+    // Frames can be copied as is only if they use the same dictionary
+    bool CanCopy = ZstdReader != nullptr
+                   and ZstdReader->dictionary() == Dictionary;
+
+    auto MaybeWritableFile = Path.getWritableFile();
+    if (not MaybeWritableFile)
+      return MaybeWritableFile.takeError();
+
+    revng::ZstdArchiveWriter Writer(MaybeWritableFile.get()->os(), Dictionary);
+
+    const auto Copy = [&](const KeyType &Key,
+                          const ::detail::DataOffset &Offset) {
+      std::string Name = keyToString(Key) + ArchiveSuffix;
+      if (CanCopy) {
+        size_t Size = Offset.UncompressedSize;
+        Writer.appendCompressed(Name, compressedData(Offset), Size);
+      } else {
+        std::string Data = decompress(Offset);
+        Writer.append(Name, { Data.data(), Data.size() });
+      }
+    };
+
+    const auto Append = [&](const KeyType &Key, const std::string &Data) {
+      if (const ::detail::DataOffset *Offset = cleanOffset(Key, Data)) {
+        Copy(Key, *Offset);
+        return;
+      }
+
+      std::string Name = keyToString(Key) + ArchiveSuffix;
+      Writer.append(Name, { Data.data(), Data.size() });
+    };
+
+    forEachEntry(Append, Copy);
+    Writer.close();
+
+    if (auto Error = MaybeWritableFile.get()->commit())
+      return Error;
+
+    // The index is part of the archive, drop the one of a previous tar.gz
+    return removeIfExists(Path.addExtension("idx"));
+  }
+
+  /// Writes the whole container to \p Path, dropping the delta stored there,
+  /// if any
+  llvm::Expected<WrittenFiles> storeFull(const revng::FilePath &Path) const {
+    if (Encoding == StorageEncoding::TarGzip) {
+      if (auto Error = storeTarGzip(Path))
+        return std::move(Error);
+    } else {
+      if (auto Error = storeZstd(Path))
+        return std::move(Error);
+    }
+
+    if (auto Error = removeIfExists(Path.addExtension("delta")))
+      return std::move(Error);
+
+    return WrittenFiles::Archive;
+  }
+
+  /// Returns true if \p Path holds the ZstdArchive the entries refer to, and
+  /// new entries would be compressed with the same dictionary
+  bool canStoreDelta(const revng::FilePath &Path) const {
+    if (ZstdReader == nullptr or not ArchivePath.has_value()
+        or not(*ArchivePath == Path))
+      return false;
+
+    bool HasDictionary = not ZstdReader->dictionary().empty();
+    return HasDictionary == (Encoding == StorageEncoding::ZstdDictionary);
+  }
+
+  /// Instead of rewriting the archive at \p Path, writes next to it a delta,
+  /// i.e., a ZstdArchive holding the entries that changed since the archive
+  /// has been written and the list of the entries that have been removed since
+  /// then. Each delta replaces the previous one, copying its frames as is, so
+  /// only the entries that changed since the last store are compressed. Once
+  /// the delta gets too big, the archive is compacted, i.e., rewritten in full.
+  llvm::Expected<WrittenFiles> storeDelta(const revng::FilePath &Path) const {
+    std::vector<std::pair<KeyType, ::detail::DataOffset>> Copied;
+    std::vector<std::pair<KeyType, const std::string *>> Changed;
+    // The size of changed entries is an upper bound of their compressed size
+    size_t DeltaSize = 0;
+
+    const auto OnPending = [&](const KeyType &Key,
+                               const ::detail::DataOffset &Offset) {
+      // Entries of the archive are left where they are
+      if (not Offset.FromDelta)
+        return;
+
+      Copied.emplace_back(Key, Offset);
+      DeltaSize += Offset.End + 1 - Offset.Start;
+    };
+
+    const auto OnEntry = [&](const KeyType &Key, const std::string &Data) {
+      if (const ::detail::DataOffset *Offset = cleanOffset(Key, Data)) {
+        OnPending(Key, *Offset);
+        return;
+      }
+
+      Changed.emplace_back(Key, &Data);
+      DeltaSize += Data.size();
+    };
+
+    forEachEntry(OnEntry, OnPending);
+
+    std::string Removed;
+    size_t RemovedCount = 0;
+    for (const revng::ZstdArchiveEntry &Entry : ZstdReader->entries()) {
+      llvm::StringRef Name = Entry.Name;
+      revng_assert(Name.consume_back(ArchiveSuffix));
+      if (contains(keyFromString(Name)))
+        continue;
+
+      Removed += Name;
+      Removed += '\n';
+      ++RemovedCount;
+    }
+
+    // Entries coming from the delta can only be dropped, if their number did
+    // not change neither did the delta
+    if (Changed.empty() and Copied.size() == DeltaEntriesCount
+        and RemovedCount == DeltaRemovedCount)
+      return WrittenFiles::Nothing;
+
+    size_t ArchiveSize = Archive->buffer().getBufferSize();
+    size_t ArchiveEntries = ZstdReader->entries().size();
+    if (DeltaSize * CompactionRatio > ArchiveSize
+        or RemovedCount * CompactionRatio > ArchiveEntries)
+      return storeFull(Path);
+
+    revng::FilePath DeltaPath = Path.addExtension("delta");
+    auto MaybeWritableFile = DeltaPath.getWritableFile();
+    if (not MaybeWritableFile)
+      return MaybeWritableFile.takeError();
+
+    revng::ZstdArchiveWriter Writer(MaybeWritableFile.get()->os(),
+                                    ZstdReader->dictionary());
+
+    std::string Fingerprint = fingerprint(Archive->buffer());
+    Writer.append(DeltaBaseEntry, { Fingerprint.data(), Fingerprint.size() });
+    Writer.append(DeltaRemovedEntry, { Removed.data(), Removed.size() });
+
+    for (const auto &[Key, Offset] : Copied) {
+      std::string Name = keyToString(Key) + ArchiveSuffix;
+      Writer.appendCompressed(Name,
+                              compressedData(Offset),
+                              Offset.UncompressedSize);
+    }
+
+    for (const auto &[Key, Data] : Changed) {
+      std::string Name = keyToString(Key) + ArchiveSuffix;
+      Writer.append(Name, { Data->data(), Data->size() });
+    }
+
+    Writer.close();
+
+    if (auto Error = MaybeWritableFile.get()->commit())
+      return std::move(Error);
+
+    return WrittenFiles::Delta;
+  }
+
+  /// Makes the entries refer to the \p Written files that have just been
+  /// stored at \p Path, so that the entries that have been written are clean
+  void rebase(const revng::FilePath &Path, WrittenFiles Written) const {
+    switch (Written) {
+    case WrittenFiles::Nothing:
+      return;
+
+    case WrittenFiles::Delta:
+      reopen(Path, Archive);
+      return;
+
+    case WrittenFiles::Archive:
+      // The archive the entries refer to, if any, is no longer at Path
+      if (ArchivePath.has_value() and *ArchivePath == Path)
+        ArchivePath.reset();
+
+      if (Encoding != StorageEncoding::TarGzip)
+        reopen(Path, nullptr);
+      return;
+    }
+
+    revng_abort();
+  }
+
+  /// Opens again the archive at \p Path, along with its delta. \p File is the
+  /// archive at \p Path, if it's already open.
+  ///
+  /// Failing to do so is not an error, it only makes the next store a full one.
+  void reopen(const revng::FilePath &Path,
+              std::shared_ptr<revng::ReadableFile> File) const {
+    if (File == nullptr) {
+      // For the local storage, this is just a mapping of the file
+      auto MaybeFile = Path.getReadableFile();
+      if (not MaybeFile) {
+        llvm::consumeError(MaybeFile.takeError());
+        ArchivePath.reset();
+        return;
+      }
+
+      File = std::move(MaybeFile.get());
+    }
+
+    if (auto Error = openZstd(Path, std::move(File))) {
+      llvm::consumeError(std::move(Error));
+      ArchivePath.reset();
+    }
+  }
+
+  /// Opens \p File, the ZstdArchive stored at \p Path, along with its delta,
+  /// if any. The entries in the archive that are in Map too are recorded as
+  /// clean, the others become pending.
+  ///
+  /// Nothing is changed in case of error.
+  llvm::Error openZstd(const revng::FilePath &Path,
+                       std::shared_ptr<revng::ReadableFile> File) const {
+    using revng::ZstdArchiveReader;
+
+    const auto GetData = [](const revng::ReadableFile &File) {
+      const llvm::MemoryBuffer &Buffer = File.buffer();
+      return llvm::ArrayRef<char>{ Buffer.getBufferStart(),
+                                   Buffer.getBufferSize() };
+    };
+
+    auto MaybeReader = ZstdArchiveReader::create(GetData(*File));
+    if (not MaybeReader)
+      return MaybeReader.takeError();
+
+    auto Reader = std::make_shared<ZstdArchiveReader>(std::move(*MaybeReader));
+
+    OffsetMap Offsets;
+    const auto AddEntries = [&Offsets](llvm::ArrayRef<revng::ZstdArchiveEntry>
+                                         Entries,
+                                       bool FromDelta) -> llvm::Error {
+      for (const revng::ZstdArchiveEntry &Entry : Entries) {
+        llvm::StringRef Name = Entry.Name;
+        if (not Name.consume_back(ArchiveSuffix))
+          return revng::createError("Unexpected entry %s in zstd archive",
+                                    Entry.Name.c_str());
+
+        uint64_t End = Entry.Start + Entry.CompressedSize - 1;
+        Offsets[keyFromString(Name)] = { .UncompressedSize = Entry.Size,
+                                         .Start = Entry.Start,
+                                         .End = End,
+                                         .FromDelta = FromDelta };
+      }
+
+      return llvm::Error::success();
+    };
+
+    // Entries are decompressed on demand, as with the index of a tar.gz
+    if (auto Error = AddEntries(Reader->entries(), false))
+      return Error;
+
+    std::shared_ptr<revng::ReadableFile> NewDelta;
+    std::shared_ptr<ZstdArchiveReader> NewDeltaReader;
+    size_t RemovedCount = 0;
+    size_t DeltaEntries = 0;
+
+    revng::FilePath DeltaPath = Path.addExtension("delta");
+    auto MaybeExists = DeltaPath.exists();
+    if (not MaybeExists)
+      return MaybeExists.takeError();
+
+    if (MaybeExists.get()) {
+      auto MaybeDelta = DeltaPath.getReadableFile();
+      if (not MaybeDelta)
+        return MaybeDelta.takeError();
+
+      NewDelta = std::move(MaybeDelta.get());
+      auto MaybeDeltaReader = ZstdArchiveReader::create(GetData(*NewDelta));
+      if (not MaybeDeltaReader)
+        return MaybeDeltaReader.takeError();
+
+      NewDeltaReader = std::make_shared<ZstdArchiveReader>(std::move(
+        *MaybeDeltaReader));
+      auto DeltaEntriesList = llvm::ArrayRef(NewDeltaReader->entries());
+      if (DeltaEntriesList.size() < 2
+          or DeltaEntriesList[0].Name != DeltaBaseEntry
+          or DeltaEntriesList[1].Name != DeltaRemovedEntry)
+        return revng::createError("Malformed zstd archive delta");
+
+      std::string Base;
+      llvm::raw_string_ostream BaseStream(Base);
+      if (auto Error = NewDeltaReader->decompress(BaseStream,
+                                                  DeltaEntriesList[0]))
+        return Error;
+      BaseStream.flush();
+
+      // A delta left behind by a compaction that failed to remove it refers
+      // to a previous version of the archive
+      if (Base != fingerprint(File->buffer())
+          or NewDeltaReader->dictionary() != Reader->dictionary()) {
+        NewDelta.reset();
+        NewDeltaReader.reset();
+      }
+    }
+
+    if (NewDeltaReader != nullptr) {
+      auto DeltaEntriesList = llvm::ArrayRef(NewDeltaReader->entries());
+
+      std::string Removed;
+      llvm::raw_string_ostream RemovedStream(Removed);
+      if (auto Error = NewDeltaReader->decompress(RemovedStream,
+                                                  DeltaEntriesList[1]))
+        return Error;
+      RemovedStream.flush();
+
+      llvm::SmallVector<llvm::StringRef> RemovedKeys;
+      llvm::StringRef(Removed).split(RemovedKeys, '\n', -1, false);
+      for (llvm::StringRef Key : RemovedKeys)
+        Offsets.erase(keyFromString(Key));
+      RemovedCount = RemovedKeys.size();
+
+      DeltaEntriesList = DeltaEntriesList.drop_front(2);
+      if (auto Error = AddEntries(DeltaEntriesList, true))
+        return Error;
+      DeltaEntries = DeltaEntriesList.size();
+    }
+
+    Pending.clear();
+    Materialized.clear();
+    for (const auto &[Key, Offset] : Offsets) {
+      if (auto It = Map.find(Key); It != Map.end())
+        Materialized[Key] = { .Offset = Offset, .Hash = hash(It->second) };
+      else
+        Pending.set(Key, Offset);
+    }
+
+    Archive = std::move(File);
+    ZstdReader = std::move(Reader);
+    Delta = std::move(NewDelta);
+    DeltaReader = std::move(NewDeltaReader);
+    DeltaEntriesCount = DeltaEntries;
+    DeltaRemovedCount = RemovedCount;
+    ArchivePath = Path;
+    return llvm::Error::success();
+  }
+
+  void resetArchive() {
+    Archive.reset();
+    ZstdReader.reset();
+    RemoteArchive.reset();
+    Delta.reset();
+    DeltaReader.reset();
+    DeltaEntriesCount = 0;
+    DeltaRemovedCount = 0;
+    ArchivePath.reset();
+  }
+
+  /// \return the frame \p Data has been decompressed from, if it's clean
+  const ::detail::DataOffset *cleanOffset(const KeyType &Key,
+                                          const std::string &Data) const {
+    auto It = Materialized.find(Key);
+    if (It == Materialized.end()
+        or It->second.Offset.UncompressedSize != Data.size()
+        or It->second.Hash != hash(Data))
+      return nullptr;
+
+    return &It->second.Offset;
+  }
+
+  static uint64_t hash(llvm::StringRef Data) { return llvm::xxHash64(Data); }
+
+  /// Identifies an archive, so that a delta can be matched with the archive it
+  /// has been written for
+  static std::string fingerprint(const llvm::MemoryBuffer &Buffer) {
+    // The index of a ZstdArchive is at its end, so hashing the tail of the
+    // archive covers the names and the positions of all of its entries
+    constexpr size_t TailSize = 64 * 1024;
+    llvm::StringRef Data = Buffer.getBuffer();
+    return std::to_string(Data.size()) + " "
+           + std::to_string(hash(Data.take_back(TailSize)));
+  }
+
+  static llvm::Error removeIfExists(const revng::FilePath &Path) {
+    auto MaybeExists = Path.exists();
+    if (not MaybeExists)
+      return MaybeExists.takeError();
+
+    if (MaybeExists.get())
+      return Path.remove();
+
+    return llvm::Error::success();
+  }
+
+  /// Trains a zstd dictionary on (a prefix of) the entries
+  llvm::SmallVector<char> trainDictionary() const {
+    // zstd suggests training on about a hundred times the dictionary size
+    constexpr size_t MaxSamplesSize = 16 * 1024 * 1024;
+
+    std::deque<std::string> Decompressed;
+    std::vector<llvm::ArrayRef<char>> Samples;
+    size_t SamplesSize = 0;
+    const auto Add = [&](const KeyType &, const std::string &Data) {
+      if (SamplesSize >= MaxSamplesSize)
+        return;
+
+      Samples.push_back({ Data.data(), Data.size() });
+      SamplesSize += Data.size();
+    };
+
+    const auto AddPending = [&](const KeyType &Key,
+                                const ::detail::DataOffset &Offset) {
+      if (SamplesSize < MaxSamplesSize)
+        Add(Key, Decompressed.emplace_back(decompress(Offset)));
+    };
+
+    forEachEntry(Add, AddPending);
+    return revng::zstdTrainDictionary(Samples);
+  }
+
   void deserializeImpl(GzipTarReader &Reader) {
     for (ArchiveEntry &Entry : Reader.entries()) {
       llvm::StringRef Name = Entry.Filename;
       revng_assert(Name.consume_back(ArchiveSuffix));
       KeyType Key = keyFromString(Name);
-      std::string Data = std::string(Entry.Data.data(), Entry.Data.size());
-      Map[Key] = Data;
+      Map[Key].assign(Entry.Data.begin(), Entry.Data.end());
+      Pending.erase(Key);
     }
   }
 
   OffsetMap serializeWithOffsets(llvm::raw_ostream &OS) const {
-    OffsetMap Result;
-    revng::GzipTarWriter Writer(OS);
-    for (auto &[Key, Data] : Map) {
+    // Entries are compressed in parallel, their offsets are known at the end
+    std::vector<std::pair<KeyType, size_t>> Written;
+    bool IsSmall = Map.size() + Pending.size() < MinimumParallelEntries;
+    revng::ParallelGzipTarWriter Writer(OS, IsSmall ? 1 : StringMapJobs);
+
+    const auto Append = [&](const KeyType &Key, const std::string &Data) {
       std::string Name = keyToString(Key) + ArchiveSuffix;
-      OffsetDescriptor Offsets = Writer.append(Name,
-                                               { Data.data(), Data.size() });
-      Result[Key] = { .UncompressedSize = Data.size(),
-                      .Start = Offsets.DataStart,
-                      .End = Offsets.PaddingStart - 1 };
+      Writer.append(Name, { Data.data(), Data.size() });
+      Written.emplace_back(Key, Data.size());
+    };
+
+    // Pending entries are copied without recompressing them, unless they
+    // come from a ZstdArchive. In that case, the decompressed data must stay
+    // alive until the writer is closed.
+    std::deque<std::string> Decompressed;
+    const auto Copy = [&](const KeyType &Key,
+                          const ::detail::DataOffset &Offset) {
+      std::string Name = keyToString(Key) + ArchiveSuffix;
+      size_t Size = Offset.UncompressedSize;
+      if (ZstdReader != nullptr) {
+        const std::string &Data = Decompressed.emplace_back(decompress(Offset));
+        Writer.append(Name, { Data.data(), Data.size() });
+      } else {
+        Writer.appendCompressed(Name, compressedData(Offset), Size);
+      }
+      Written.emplace_back(Key, Size);
+    };
+
+    forEachEntry(Append, Copy);
+    std::vector<OffsetDescriptor> Offsets = Writer.close();
+    revng_assert(Offsets.size() == Written.size());
+
+    OffsetMap Result;
+    for (const auto &[Entry, Offset] : llvm::zip(Written, Offsets)) {
+      Result[Entry.first] = { .UncompressedSize = Entry.second,
+                              .Start = Offset.DataStart,
+                              .End = Offset.PaddingStart - 1 };
     }
-    Writer.close();
 
     return Result;
   }
 
+  /// Invokes \p OnEntry on the entries of Map and \p OnPending on the pending
+  /// ones, visiting them in key order.
+  template<typename OnEntryT, typename OnPendingT>
+  void forEachEntry(OnEntryT &&OnEntry, OnPendingT &&OnPending) const {
+    auto MapIt = Map.begin();
+    auto MapEnd = Map.end();
+    Pending.forEach([&](const KeyType &Key,
+                        const ::detail::DataOffset &Offset) {
+      for (; MapIt != MapEnd and MapIt->first < Key; ++MapIt)
+        OnEntry(MapIt->first, MapIt->second);
+      OnPending(Key, Offset);
+    });
+
+    for (; MapIt != MapEnd; ++MapIt)
+      OnEntry(MapIt->first, MapIt->second);
+  }
+
+
+  llvm::ArrayRef<char>
+  compressedData(const ::detail::DataOffset &Offset) const {
+    const auto &File = Offset.FromDelta ? Delta : Archive;
+    revng_assert(File != nullptr);
+    const llvm::MemoryBuffer &Buffer = File->buffer();
+    return { Buffer.getBufferStart() + Offset.Start,
+             Offset.End + 1 - Offset.Start };
+  }
+
+  void materialize(const KeyType &Key) const {
+    std::lock_guard Lock(LazyStateLock);
+    std::optional<::detail::DataOffset> Offset = Pending.find(Key);
+    if (not Offset.has_value())
+      return;
+
+    const std::string &Data = Map[Key] = decompress(*Offset);
+    if (ZstdReader != nullptr)
+      Materialized[Key] = { .Offset = *Offset, .Hash = hash(Data) };
+    Pending.erase(Key);
+  }
+
+  llvm::Error decompress(llvm::raw_ostream &OS,
+                         const ::detail::DataOffset &Offset) const {
+    if (RemoteArchive != nullptr)
+      return fetchAndDecompress(OS, Offset);
+
+    size_t Size = Offset.UncompressedSize;
+    if (Offset.FromDelta)
+      return DeltaReader->decompress(OS, compressedData(Offset), Size);
+    else if (ZstdReader != nullptr)
+      return ZstdReader->decompress(OS, compressedData(Offset), Size);
+
+    gzipDecompress(OS, compressedData(Offset));
+    return llvm::Error::success();
+  }
+
+  /// Downloads the gzip stream of a pending entry of RemoteArchive and
+  /// decompresses it into \p OS
+  llvm::Error fetchAndDecompress(llvm::raw_ostream &OS,
+                                 const ::detail::DataOffset &Offset) const {
+    size_t Size = Offset.End + 1 - Offset.Start;
+    auto MaybeFile = RemoteArchive->getReadableFileRange(Offset.Start, Size);
+    if (not MaybeFile)
+      return MaybeFile.takeError();
+
+    // The archive has not been read, hence the index has not been checked
+    // against it when loaded
+    llvm::StringRef Stream = MaybeFile.get()->buffer().getBuffer();
+    if (not Stream.startswith("\x1f\x8b"))
+      return revng::createError("The index does not match the archive");
+
+    gzipDecompress(OS, Stream);
+    return llvm::Error::success();
+  }
+
+  /// Reads the whole RemoteArchive, if the entries are fetched from there, so
+  /// that all of them can be accessed at once
+  llvm::Error downloadArchive() const {
+    if (RemoteArchive == nullptr or Pending.empty())
+      return llvm::Error::success();
+
+    auto MaybeFile = RemoteArchive->getReadableFile();
+    if (not MaybeFile)
+      return MaybeFile.takeError();
+
+    Archive = std::move(MaybeFile.get());
+    RemoteArchive.reset();
+    return llvm::Error::success();
+  }
+
+  /// Like the other overload, but aborts if the entry is corrupt, since the
+  /// accessors materializing it have no way of reporting it
+  std::string decompress(const ::detail::DataOffset &Offset) const {
+    std::string Result;
+    Result.reserve(Offset.UncompressedSize);
+    llvm::raw_string_ostream OS(Result);
+    if (auto Error = decompress(OS, Offset)) {
+      std::string Message = llvm::toString(std::move(Error));
+      revng_abort(Message.c_str());
+    }
+    OS.flush();
+    revng_assert(Result.size() == Offset.UncompressedSize);
+    return Result;
+  }
+
+  void materializeAll() const {
+    std::lock_guard Lock(LazyStateLock);
+
+    // Fetching the entries one at a time is a last resort
+    if (Pending.size() > 1)
+      llvm::consumeError(downloadArchive());
+
+    std::vector<KeyType> Keys;
+    Keys.reserve(Pending.size());
+    Pending.forEach([&Keys](const KeyType &Key, const auto &) {
+      Keys.push_back(Key);
+    });
+
+    for (const KeyType &Key : Keys)
+      materialize(Key);
+  }
+
+  /// Makes the entries of \p File, the tar.gz archive at \p Path, pending,
+  /// using the index stored next to it. The index is used as is, entries are
+  /// looked up in it when accessed. If \p File is null, the archive is not
+  /// read at all and entries are fetched from \p Path when needed.
+  ///
+  /// \return false if there is no index, or it does not match the archive
+  bool loadIndex(const revng::FilePath &Path,
+                 std::shared_ptr<revng::ReadableFile> File) {
+    revng::FilePath IndexPath = Path.addExtension("idx");
+    auto MaybeExists = IndexPath.exists();
+    if (not MaybeExists) {
+      llvm::consumeError(MaybeExists.takeError());
+      return false;
+    }
+
+    if (not MaybeExists.get())
+      return false;
+
+    auto MaybeIndex = IndexPath.getReadableFile();
+    if (not MaybeIndex) {
+      llvm::consumeError(MaybeIndex.takeError());
+      return false;
+    }
+
+    // Indexes in an unknown format are ignored, the archive is read in full
+    std::shared_ptr<revng::ReadableFile> IndexFile = std::move(*MaybeIndex);
+    const llvm::MemoryBuffer &Buffer = IndexFile->buffer();
+    llvm::ArrayRef<char> Data{ Buffer.getBufferStart(),
+                               Buffer.getBufferSize() };
+    auto MaybeReader = revng::OffsetIndexReader::create(Data);
+    if (not MaybeReader) {
+      llvm::consumeError(MaybeReader.takeError());
+      return false;
+    }
+
+    // Check that each entry of the index points to a gzip stream, as a
+    // safeguard against an index that does not match the archive. Without the
+    // archive, each entry is checked once fetched.
+    for (size_t I = 0; I < MaybeReader->size(); ++I) {
+      revng::OffsetIndexEntry Entry = (*MaybeReader)[I];
+      if (Entry.Start > Entry.End)
+        return false;
+
+      if (File == nullptr)
+        continue;
+
+      llvm::StringRef ArchiveData = File->buffer().getBuffer();
+      if (Entry.End >= ArchiveData.size())
+        return false;
+
+      llvm::StringRef Stream = ArchiveData.slice(Entry.Start, Entry.End + 1);
+      if (not Stream.startswith("\x1f\x8b"))
+        return false;
+    }
+
+    clear();
+    if (File == nullptr)
+      RemoteArchive = std::make_shared<const revng::FilePath>(Path);
+    Archive = std::move(File);
+    Pending.setIndex(std::move(IndexFile), *MaybeReader);
+    return true;
+  }
+
+  static llvm::Error storeIndex(const revng::FilePath &IndexPath,
+                                const OffsetMap &Offsets) {
+    std::vector<std::string> Keys;
+    Keys.reserve(Offsets.size());
+    std::vector<revng::OffsetIndexEntry> Entries;
+    Entries.reserve(Offsets.size());
+    for (const auto &[Key, Offset] : Offsets) {
+      Keys.push_back(keyToString(Key));
+      Entries.push_back({ .Key = Keys.back(),
+                          .UncompressedSize = Offset.UncompressedSize,
+                          .Start = Offset.Start,
+                          .End = Offset.End });
+    }
+
+    // The index is optional, being unable to write it is not an error
+    auto MaybeWritableFile = IndexPath.getWritableFile();
+    if (not MaybeWritableFile) {
+      llvm::consumeError(MaybeWritableFile.takeError());
+      return llvm::Error::success();
+    }
+
+    revng::writeOffsetIndex(MaybeWritableFile.get()->os(), std::move(Entries));
+    return MaybeWritableFile.get()->commit();
+  }
+
 public:
   static std::string keyToString(const KeyType &Key) { return toString(Key); }
 
@@ -16,6 +16,7 @@
 #include "revng/Pipeline/Kind.h"
 #include "revng/Pipeline/Target.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/CommonOptions.h"
 #include "revng/TupleTree/TupleTree.h"
 
 namespace revng::pipes {
@@ -153,7 +154,15 @@ public:
       return llvm::Error::success();
     }
 
-    return Base::store(Path);
+    if (not BinaryTupleTrees)
+      return Base::store(Path);
+
+    auto MaybeWritableFile = Path.getWritableFile();
+    if (not MaybeWritableFile)
+      return MaybeWritableFile.takeError();
+
+    Content.value().serializeBinary(MaybeWritableFile.get()->os());
+    return MaybeWritableFile.get()->commit();
   }
 
   llvm::Error load(const revng::FilePath &Path) override {
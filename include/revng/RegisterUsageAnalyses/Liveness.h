@@ -6,7 +6,9 @@
 
 #include "llvm/ADT/BitVector.h"
 
+#include "revng/MFP/DenseMFP.h"
 #include "revng/MFP/MFP.h"
+#include "revng/MFP/SetLattices.h"
 #include "revng/RegisterUsageAnalyses/Function.h"
 
 namespace rua {
@@ -15,6 +17,7 @@ class Liveness {
 private:
   using Set = llvm::BitVector;
   using RegisterSet = Set;
+  using RegistersLattice = BitVectorUnionLattice<Set>;
 
 public:
   using LatticeElement = Set;
@@ -41,16 +44,15 @@ public:
 
 public:
   Set combineValues(const Set &LHS, const Set &RHS) const {
-    Set Result = LHS;
-    Result |= RHS;
-    return Result;
+    return RegistersLattice::combineValues(LHS, RHS);
   }
 
   bool isLessOrEqual(const Set &LHS, const Set &RHS) const {
-    // RHS must contain or be equal to LHS
-    Set Intersection = RHS;
-    Intersection &= LHS;
-    return Intersection == LHS;
+    return RegistersLattice::isLessOrEqual(LHS, RHS);
+  }
+
+  bool combineInPlace(Set &Target, const Set &Value) const {
+    return RegistersLattice::combineInPlace(Target, Value);
   }
 
   RegisterSet applyTransferFunction(const BlockNode *Block,
@@ -80,6 +82,6 @@ public:
   }
 };
 
-static_assert(MFP::MonotoneFrameworkInstance<Liveness>);
+static_assert(MFP::InPlaceMonotoneFrameworkInstance<Liveness>);
 
 } // namespace rua
@@ -7,6 +7,7 @@
 #include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/SmallVector.h"
 
+#include "revng/MFP/DenseMFP.h"
 #include "revng/MFP/MFP.h"
 #include "revng/RegisterUsageAnalyses/Function.h"
 
@@ -120,12 +121,20 @@ public:
   }
 
   bool isLessOrEqual(const WritersSet &LHS, const WritersSet &RHS) const {
-    for (const auto &[LHSEntry, RHSEntry] : zip(LHS, RHS)) {
-      auto Intersection = LHSEntry;
-      Intersection &= RHSEntry;
-      if (Intersection != LHSEntry)
+    for (const auto &[LHSEntry, RHSEntry] : zip(LHS, RHS))
+      if (LHSEntry.Reaching.test(RHSEntry.Reaching)
+          or LHSEntry.Read.test(RHSEntry.Read))
         return false;
-    }
+
+    return true;
+  }
+
+  bool combineInPlace(WritersSet &Target, const WritersSet &Value) const {
+    if (isLessOrEqual(Value, Target))
+      return false;
+
+    for (const auto &[TargetEntry, ValueEntry] : zip(Target, Value))
+      TargetEntry |= ValueEntry;
 
     return true;
   }
@@ -158,6 +167,6 @@ public:
   }
 };
 
-static_assert(MFP::MonotoneFrameworkInstance<ReachingDefinitions>);
+static_assert(MFP::InPlaceMonotoneFrameworkInstance<ReachingDefinitions>);
 
 } // namespace rua
@@ -33,6 +33,10 @@ public:
   }
 
   bool isValid() const { return Client != nullptr; }
+
+  bool operator==(const PathBase &Other) const {
+    return Client == Other.Client and SubPath == Other.SubPath;
+  }
 };
 
 class FilePath : public PathBase {
@@ -74,6 +78,16 @@ public:
     return Client->getReadableFile(SubPath);
   };
 
+  /// Like getReadableFile, but reads only the \p Size bytes starting at
+  /// \p Offset
+  llvm::Expected<std::unique_ptr<ReadableFile>>
+  getReadableFileRange(uint64_t Offset, uint64_t Size) const {
+    return Client->getReadableFileRange(SubPath, Offset, Size);
+  }
+
+  /// \see StorageClient::prefersRangedReads
+  bool prefersRangedReads() const { return Client->prefersRangedReads(); }
+
   /// This function will allow the user of a FilePath to obtain a wrapped
   /// llvm::raw_ostream that can be used to write to the file (reminder to then
   /// call WritableFile::commit). The Encoding parameter is useful only on some
@@ -101,6 +101,17 @@ public:
   virtual llvm::Expected<std::unique_ptr<ReadableFile>>
   getReadableFile(llvm::StringRef Path) = 0;
 
+  /// Like ::getReadableFile, but the buffer holds only the \p Size bytes
+  /// starting at \p Offset. Backends can use this to avoid transferring the
+  /// rest of the file, e.g., to fetch a single entry of an indexed archive.
+  virtual llvm::Expected<std::unique_ptr<ReadableFile>>
+  getReadableFileRange(llvm::StringRef Path, uint64_t Offset, uint64_t Size);
+
+  /// Returns true if reading a whole file costs much more than reading a part
+  /// of it, e.g., because it has to be downloaded. In that case, users should
+  /// read the parts of large files they need through ::getReadableFileRange.
+  virtual bool prefersRangedReads() const { return false; }
+
   virtual llvm::Expected<std::unique_ptr<WritableFile>>
   getWritableFile(llvm::StringRef Path, ContentEncoding Encoding) = 0;
 
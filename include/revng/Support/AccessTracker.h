@@ -5,7 +5,13 @@
 //
 
 #include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 
 #include "revng/Support/Assert.h"
@@ -16,6 +22,127 @@ void onFieldAccess(llvm::StringRef FieldName,
 
 namespace revng {
 
+class AccessTracker;
+
+/// The reads of tuple trees performed within a SharedTrackingScope.
+///
+/// They are recorded here, rather than in the tracking state of the tuple
+/// trees, so that they can later be replayed on it by the thread owning it.
+/// Like the tracking state, reads are recorded in a stack of levels.
+class DeferredReads {
+public:
+  /// Marks as read the element at \p Index of the keyed container \p Object
+  using ReplayFunction = void (*)(const void *Object, size_t Index);
+
+private:
+  struct Level {
+    llvm::DenseSet<AccessTracker *> Trackers;
+    llvm::DenseMap<std::pair<const void *, size_t>, ReplayFunction> Elements;
+    std::vector<std::function<void()>> Others;
+  };
+
+private:
+  std::vector<Level> Levels = std::vector<Level>(1);
+
+public:
+  void record(AccessTracker &Tracker) {
+    Levels.back().Trackers.insert(&Tracker);
+  }
+
+  void record(const void *Object, size_t Index, ReplayFunction Replay) {
+    Levels.back().Elements[{ Object, Index }] = Replay;
+  }
+
+  void record(std::function<void()> Replay) {
+    Levels.back().Others.push_back(std::move(Replay));
+  }
+
+  void push() { Levels.emplace_back(); }
+
+  void pop() {
+    Levels.pop_back();
+    if (Levels.empty())
+      Levels.emplace_back();
+  }
+
+  /// Returns the reads of all the levels and forgets the ones of the innermost
+  /// one, as Tracking::collect does with the tracking state
+  DeferredReads collect() {
+    DeferredReads Result;
+    Level &Destination = Result.Levels.back();
+    for (const Level &Source : Levels) {
+      Destination.Trackers.insert(Source.Trackers.begin(),
+                                  Source.Trackers.end());
+      Destination.Elements.insert(Source.Elements.begin(),
+                                  Source.Elements.end());
+      llvm::append_range(Destination.Others, Source.Others);
+    }
+
+    clear();
+    return Result;
+  }
+
+  /// Forgets the reads of the innermost level, as Tracking::clearAndResume
+  /// does with the tracking state
+  void clear() { Levels.back() = Level(); }
+
+  /// Marks all the recorded reads in the tracking state of the tuple trees
+  ///
+  /// \note this must not be invoked within a SharedTrackingScope
+  void replay() const;
+};
+
+namespace detail {
+
+inline thread_local DeferredReads *CurrentDeferredReads = nullptr;
+
+} // namespace detail
+
+/// While alive, the reads of tuple trees performed by the current thread are
+/// recorded in a DeferredReads, without touching their tracking state.
+///
+/// This allows multiple threads to read the same tuple trees concurrently,
+/// while still keeping track of what each of them read. Pushing and popping
+/// the tracking state of the tuple trees affects the DeferredReads, while
+/// collecting or clearing it is not allowed.
+class SharedTrackingScope {
+private:
+  DeferredReads *Previous;
+
+public:
+  SharedTrackingScope(DeferredReads &Reads) :
+    Previous(detail::CurrentDeferredReads) {
+    detail::CurrentDeferredReads = &Reads;
+  }
+  ~SharedTrackingScope() { detail::CurrentDeferredReads = Previous; }
+
+  SharedTrackingScope(const SharedTrackingScope &) = delete;
+  SharedTrackingScope &operator=(const SharedTrackingScope &) = delete;
+
+public:
+  static bool isActive() { return detail::CurrentDeferredReads != nullptr; }
+
+  /// Returns where the reads of the current thread are recorded, or nullptr if
+  /// the current thread is not within a SharedTrackingScope
+  static DeferredReads *reads() { return detail::CurrentDeferredReads; }
+};
+
+/// While alive, the current thread is not within the SharedTrackingScope it
+/// was in, if any, and it can access the tracking state of tuple trees.
+class SuspendedTrackingScope {
+private:
+  DeferredReads *Suspended;
+
+public:
+  SuspendedTrackingScope() : Suspended(detail::CurrentDeferredReads) {
+    detail::CurrentDeferredReads = nullptr;
+  }
+  ~SuspendedTrackingScope() { detail::CurrentDeferredReads = Suspended; }
+
+  SuspendedTrackingScope(const SuspendedTrackingScope &) = delete;
+  SuspendedTrackingScope &operator=(const SuspendedTrackingScope &) = delete;
+};
+
 ///
 /// A AccessCounter is optimized std::stack<bool> that can contain up to 8
 /// elements.
@@ -38,7 +165,12 @@ public:
     Counter &= ~0x1;
     IsTracking = true;
   }
-  void access() { Counter |= (0x1 & IsTracking); }
+  void access() {
+    if (DeferredReads *Reads = SharedTrackingScope::reads())
+      Reads->record(*this);
+    else
+      Counter |= (0x1 & IsTracking);
+  }
   void push() {
     bool HasLeadingZeroes = llvm::countLeadingZeros(Counter) != 0;
     revng_assert(HasLeadingZeroes, "More than 8 pushes have been performed");
@@ -51,4 +183,16 @@ public:
   void stopTracking() { IsTracking = false; }
 };
 
+inline void DeferredReads::replay() const {
+  revng_assert(not SharedTrackingScope::isActive());
+  for (const Level &Level : Levels) {
+    for (AccessTracker *Tracker : Level.Trackers)
+      Tracker->access();
+    for (const auto &[Key, Replay] : Level.Elements)
+      Replay(Key.first, Key.second);
+    for (const std::function<void()> &Replay : Level.Others)
+      Replay();
+  }
+}
+
 } // namespace revng
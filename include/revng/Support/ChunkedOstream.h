@@ -0,0 +1,41 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstddef>
+#include <cstdint>
+
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace revng {
+
+/// raw_ostream handing what is written to it to a callback, in chunks of at
+/// most ChunkSize bytes. This allows to write big outputs (e.g., to a file
+/// descriptor or through a C API) without ever holding them in memory.
+///
+/// The callback is never invoked with an empty chunk.
+class ChunkedOstream : public llvm::raw_ostream {
+public:
+  using ChunkCallback = llvm::function_ref<void(llvm::StringRef Chunk)>;
+  static constexpr size_t DefaultChunkSize = 1024 * 1024;
+
+private:
+  ChunkCallback Callback;
+  size_t ChunkSize = 0;
+  uint64_t Position = 0;
+
+public:
+  ChunkedOstream(ChunkCallback Callback,
+                 size_t ChunkSize = DefaultChunkSize);
+  ~ChunkedOstream() override;
+
+private:
+  void write_impl(const char *Ptr, size_t Size) override;
+  uint64_t current_pos() const override { return Position; }
+};
+
+} // namespace revng
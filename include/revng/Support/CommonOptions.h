@@ -8,3 +8,4 @@
 
 // Options used by many users
 extern llvm::cl::opt<bool> DebugNames;
+extern llvm::cl::opt<bool> BinaryTupleTrees;
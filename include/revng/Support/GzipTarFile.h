@@ -4,9 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <deque>
+#include <memory>
+#include <optional>
+#include <vector>
+
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/Assert.h"
@@ -68,7 +74,70 @@ public:
   GzipTarWriter &operator=(GzipTarWriter &&Other) = default;
 
   OffsetDescriptor append(llvm::StringRef Name, llvm::ArrayRef<char> Data);
+
+  /// Like append, but \p CompressedData is a gzip stream that decompresses to
+  /// \p Size bytes, such as the one of a file of another archive produced by
+  /// this class. The stream is copied as is, without recompressing it.
+  OffsetDescriptor appendCompressed(llvm::StringRef Name,
+                                    llvm::ArrayRef<char> CompressedData,
+                                    size_t Size);
+
   void close();
+
+private:
+  OffsetDescriptor appendImpl(llvm::StringRef Name,
+                              llvm::ArrayRef<char> Data,
+                              size_t Size,
+                              bool IsCompressed);
+};
+
+/// A GzipTarWriter that compresses the files on a pool of threads.
+///
+/// The archive produced is the same that GzipTarWriter would produce appending
+/// the same files in the same order. However, the offsets of a file are known
+/// only once all the files preceding it have been written, therefore they are
+/// returned by ::close rather than by ::append.
+///
+/// \note the data passed to ::append and ::appendCompressed must stay valid
+///       until ::close is invoked.
+class ParallelGzipTarWriter {
+private:
+  struct PendingFile;
+
+  llvm::raw_ostream *OS = nullptr;
+  llvm::StringSet<> Filenames;
+  // Not created when using a single thread, in that case files are compressed
+  // and written right away
+  std::optional<llvm::ThreadPool> Pool;
+  // Files being compressed, or waiting to be written, in order
+  std::deque<std::unique_ptr<PendingFile>> InFlight;
+  size_t MaxInFlight = 0;
+  std::vector<OffsetDescriptor> Offsets;
+
+public:
+  /// \param Jobs the number of threads to use, 0 to use all the cores
+  ParallelGzipTarWriter(llvm::raw_ostream &OS, unsigned Jobs = 0);
+  ~ParallelGzipTarWriter();
+
+  ParallelGzipTarWriter(const ParallelGzipTarWriter &Other) = delete;
+  ParallelGzipTarWriter &operator=(const ParallelGzipTarWriter &Other) = delete;
+
+  ParallelGzipTarWriter(ParallelGzipTarWriter &&Other) = delete;
+  ParallelGzipTarWriter &operator=(ParallelGzipTarWriter &&Other) = delete;
+
+  void append(llvm::StringRef Name, llvm::ArrayRef<char> Data);
+  void appendCompressed(llvm::StringRef Name,
+                        llvm::ArrayRef<char> CompressedData,
+                        size_t Size);
+
+  /// Writes the remaining files and terminates the archive.
+  ///
+  /// \return the offsets of the files, in the order they have been appended
+  std::vector<OffsetDescriptor> close();
+
+private:
+  void enqueue(std::unique_ptr<PendingFile> &&File);
+  void writeOldest();
 };
 
 struct ArchiveEntry {
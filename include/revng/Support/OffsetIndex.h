@@ -0,0 +1,65 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace revng {
+
+struct OffsetIndexEntry {
+  llvm::StringRef Key;
+  uint64_t UncompressedSize = 0;
+  uint64_t Start = 0;
+  uint64_t End = 0;
+};
+
+/// Writes a binary index mapping each key to the position of its data in an
+/// archive. The index is laid out as follows:
+/// * a header, holding a magic, the format version and the number of entries
+/// * a fixed-width record per entry, sorted by key
+/// * the keys, referenced by the records through their offset and size
+///
+/// Since the records are sorted and fixed-width, the index can be used as is
+/// (e.g., from a memory mapped file) and binary-searched, without parsing it.
+void writeOffsetIndex(llvm::raw_ostream &OS,
+                      std::vector<OffsetIndexEntry> Entries);
+
+class OffsetIndexReader {
+private:
+  llvm::ArrayRef<char> Data;
+  size_t Count = 0;
+
+private:
+  OffsetIndexReader(llvm::ArrayRef<char> Data, size_t Count) :
+    Data(Data), Count(Count) {}
+
+public:
+  /// Returns true if \p Data starts with the magic of an offset index
+  static bool isOffsetIndex(llvm::ArrayRef<char> Data);
+
+  /// Validates the index in \p Data, which must outlive the returned object
+  static llvm::Expected<OffsetIndexReader> create(llvm::ArrayRef<char> Data);
+
+public:
+  size_t size() const { return Count; }
+  bool empty() const { return Count == 0; }
+
+  /// \return the \p Index-th entry, in key order
+  OffsetIndexEntry operator[](size_t Index) const;
+
+  std::optional<OffsetIndexEntry> find(llvm::StringRef Key) const;
+
+private:
+  llvm::StringRef key(size_t Index) const;
+};
+
+} // namespace revng
@@ -5,6 +5,7 @@
 //
 
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -102,6 +103,8 @@ private:
   double OldS = 0.0;
   double NewS = 0.0;
   double Sum = 0.0;
+  /// Statistics can be recorded by multiple threads
+  std::mutex Lock;
 
 public:
   RunningStatistics() = default;
@@ -118,6 +121,7 @@ public:
   // TODO: make a template
   /// Record a new value
   void push(double X) {
+    std::lock_guard Guard(Lock);
     N++;
     Sum += X;
 
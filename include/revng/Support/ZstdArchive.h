@@ -0,0 +1,146 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+
+#include "zstd.h"
+
+namespace revng {
+
+struct ZstdArchiveEntry {
+  std::string Name;
+  /// Offset of the zstd frame of the file from the start of the archive
+  uint64_t Start = 0;
+  uint64_t CompressedSize = 0;
+  uint64_t Size = 0;
+};
+
+/// Trains a zstd dictionary of at most \p MaxSize bytes out of \p Samples.
+///
+/// \return the dictionary, or an empty vector if the samples are not suitable
+///         for training (e.g., there are too few of them)
+llvm::SmallVector<char>
+zstdTrainDictionary(llvm::ArrayRef<llvm::ArrayRef<char>> Samples,
+                    size_t MaxSize = 112 * 1024);
+
+/// Class that writes a seekable archive where each file is compressed in a
+/// stand-alone zstd frame, optionally using a dictionary shared by all the
+/// files. The archive is laid out as follows:
+/// * a header, holding a magic, the format version and the dictionary (if any)
+/// * the zstd frames of the files, in the order they have been appended
+/// * a binary index, holding name, offset and sizes of each file
+/// * a fixed-size footer, holding the offset of the index
+///
+/// Since the index is at the end of the archive, a single file can be
+/// decompressed reading only the footer, the index and its frame.
+class ZstdArchiveWriter {
+private:
+  using CDictDeleter = void (*)(ZSTD_CDict *);
+  using CCtxDeleter = void (*)(ZSTD_CCtx *);
+
+  llvm::raw_ostream *OS = nullptr;
+  uint64_t ArchiveStart = 0;
+  int CompressionLevel = 0;
+  llvm::StringSet<> Filenames;
+  std::vector<ZstdArchiveEntry> Entries;
+  std::unique_ptr<ZSTD_CCtx, CCtxDeleter> Ctx;
+  std::unique_ptr<ZSTD_CDict, CDictDeleter> Dictionary;
+  llvm::SmallVector<char> Buffer;
+
+public:
+  ZstdArchiveWriter(llvm::raw_ostream &OS,
+                    llvm::ArrayRef<char> Dictionary = {},
+                    int CompressionLevel = 3);
+  ~ZstdArchiveWriter() { revng_assert(OS == nullptr); }
+
+  ZstdArchiveWriter(const ZstdArchiveWriter &Other) = delete;
+  ZstdArchiveWriter &operator=(const ZstdArchiveWriter &Other) = delete;
+
+  /// The moved-from writer is left closed
+  ZstdArchiveWriter(ZstdArchiveWriter &&Other);
+  ZstdArchiveWriter &operator=(ZstdArchiveWriter &&Other);
+
+  void append(llvm::StringRef Name, llvm::ArrayRef<char> Data);
+
+  /// Like append, but \p Frame is a zstd frame that decompresses to \p Size
+  /// bytes, such as the one of a file of another archive produced with the
+  /// same dictionary. The frame is copied as is, without recompressing it.
+  void appendCompressed(llvm::StringRef Name,
+                        llvm::ArrayRef<char> Frame,
+                        size_t Size);
+
+  /// Writes the index and the footer, terminating the archive.
+  void close();
+
+private:
+  void write(llvm::StringRef Name, llvm::ArrayRef<char> Frame, size_t Size);
+};
+
+class ZstdArchiveReader {
+private:
+  using DDictDeleter = void (*)(ZSTD_DDict *);
+  using DCtxDeleter = void (*)(ZSTD_DCtx *);
+
+  llvm::ArrayRef<char> Data;
+  llvm::ArrayRef<char> DictionaryData;
+  std::vector<ZstdArchiveEntry> Entries;
+  std::unique_ptr<ZSTD_DDict, DDictDeleter> Dictionary;
+
+private:
+  ZstdArchiveReader(llvm::ArrayRef<char> Data);
+
+public:
+  /// Returns true if \p Data starts with the magic of an archive produced by
+  /// ZstdArchiveWriter.
+  static bool isZstdArchive(llvm::ArrayRef<char> Data);
+
+  /// Parses the header and the index of the archive in \p Data, which must
+  /// outlive the returned object.
+  static llvm::Expected<ZstdArchiveReader> create(llvm::ArrayRef<char> Data);
+
+  ZstdArchiveReader(const ZstdArchiveReader &Other) = delete;
+  ZstdArchiveReader &operator=(const ZstdArchiveReader &Other) = delete;
+
+  ZstdArchiveReader(ZstdArchiveReader &&Other) = default;
+  ZstdArchiveReader &operator=(ZstdArchiveReader &&Other) = default;
+
+public:
+  const std::vector<ZstdArchiveEntry> &entries() const { return Entries; }
+
+  /// The dictionary the files have been compressed with, empty if none
+  llvm::ArrayRef<char> dictionary() const { return DictionaryData; }
+
+  llvm::ArrayRef<char> compressedData(const ZstdArchiveEntry &Entry) const {
+    return Data.slice(Entry.Start, Entry.CompressedSize);
+  }
+
+  /// Decompresses \p Frame, a frame of this archive holding \p Size bytes,
+  /// writing it to \p OS in chunks
+  ///
+  /// \return an error if the frame is corrupt, truncated or does not hold
+  ///         \p Size bytes. In this case, part of it might have been written.
+  llvm::Error decompress(llvm::raw_ostream &OS,
+                         llvm::ArrayRef<char> Frame,
+                         size_t Size) const;
+
+  llvm::Error decompress(llvm::raw_ostream &OS,
+                         const ZstdArchiveEntry &Entry) const {
+    return decompress(OS, compressedData(Entry), Entry.Size);
+  }
+};
+
+} // namespace revng
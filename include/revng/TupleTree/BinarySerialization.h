@@ -0,0 +1,500 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include "revng/ADT/KeyedObjectContainer.h"
+#include "revng/ADT/STLExtras.h"
+#include "revng/ADT/UpcastablePointer.h"
+#include "revng/Support/Error.h"
+#include "revng/Support/YAMLTraits.h"
+#include "revng/TupleTree/TupleLikeTraits.h"
+
+/// Compact binary encoding of tuple trees, round-trip equivalent to YAML.
+///
+/// The encoding is driven by the same metadata driving the YAML one, i.e., the
+/// TupleLikeTraits emitted by the tuple-tree-generator, the KeyedObjectTraits
+/// and the YAML scalar traits:
+/// * integers are LEB128-encoded, booleans are a byte;
+/// * strings and scalars having YAML traits (enums, MetaAddress, references
+///   and so on) are their YAML representation, prefixed by its size;
+/// * structs are the sequence of all their fields, optional ones included;
+/// * polymorphic pointers are the name of their concrete type (empty if null),
+///   followed by its fields;
+/// * containers are the number of elements, followed by the elements.
+///
+/// The whole tree is preceded by a magic, which can never start a YAML
+/// document, the version of the format, a hash of the schema and the name of
+/// the root type. Since fields are not named, a tree can only be read back by
+/// code generated from the same schema: a mismatching hash is an error.
+namespace tupletree::binary {
+
+namespace detail {
+
+inline constexpr char Magic[4] = { '\0', 'R', 'T', 'T' };
+inline constexpr uint64_t Version = 2;
+
+template<typename T>
+concept Sequence = requires(T &S) {
+  typename T::value_type;
+  { S.size() } -> std::convertible_to<size_t>;
+  S.emplace_back();
+  S.begin();
+  S.end();
+};
+
+template<typename T>
+llvm::StringRef rootName() {
+  if constexpr (TraitedTupleLike<T>)
+    return TupleLikeTraits<T>::Name;
+  else
+    return "";
+}
+
+/// Describes the schema of a tuple tree, as seen by the encoding: the names and
+/// types of the fields of all the reachable tuple-like types, the concrete
+/// types of polymorphic pointers and the values of enumerations
+class SchemaDescriber {
+private:
+  std::string Description;
+  llvm::StringSet<> Visited;
+
+public:
+  template<typename T>
+  static std::string describe() {
+    SchemaDescriber Describer;
+    Describer.add<T>();
+    return std::move(Describer.Description);
+  }
+
+private:
+  // The cases must match the ones of Writer::write
+  template<typename T>
+  void add() {
+    if constexpr (std::is_same_v<T, bool>) {
+      Description += "bool;";
+    } else if constexpr (std::signed_integral<T>) {
+      Description += "i" + std::to_string(sizeof(T)) + ";";
+    } else if constexpr (std::unsigned_integral<T>) {
+      Description += "u" + std::to_string(sizeof(T)) + ";";
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      Description += "string;";
+    } else if constexpr (UpcastablePointerLike<T>) {
+      using ConcreteTypes = concrete_types_traits_t<typename T::element_type>;
+      Description += "polymorphic(";
+      addConcrete<ConcreteTypes>();
+      Description += ");";
+    } else if constexpr (TraitedTupleLike<T>) {
+      llvm::StringRef Name = TupleLikeTraits<T>::FullName;
+      Description += Name;
+
+      // Types can be recursive, describe their fields only once
+      if (not Visited.insert(Name).second) {
+        Description += ";";
+        return;
+      }
+
+      Description += "{";
+      addFields<T>();
+      Description += "};";
+    } else if constexpr (HasScalarTraits<T>) {
+      Description += "scalar;";
+    } else if constexpr (HasScalarOrEnumTraits<T>) {
+      struct EnumerationIO {
+        std::string &Description;
+        void enumCase(T &,
+                      llvm::StringRef Name,
+                      const T &,
+                      llvm::yaml::QuotingType = llvm::yaml::QuotingType::None) {
+          Description += Name;
+          Description += ",";
+        }
+      };
+
+      Description += "enum(";
+      T Value{};
+      EnumerationIO IO{ Description };
+      llvm::yaml::ScalarEnumerationTraits<T>::enumeration(IO, Value);
+      Description += ");";
+    } else if constexpr (KeyedObjectContainer<T> or Sequence<T>) {
+      Description += "[";
+      add<typename T::value_type>();
+      Description += "];";
+    } else {
+      static_assert(type_always_false_v<T>, "Unsupported tuple tree node");
+    }
+  }
+
+  template<typename T, size_t I = 0>
+  void addFields() {
+    if constexpr (I < std::tuple_size_v<T>) {
+      Description += TupleLikeTraits<T>::FieldNames[I];
+      Description += ":";
+      add<std::remove_cvref_t<std::tuple_element_t<I, T>>>();
+      addFields<T, I + 1>();
+    }
+  }
+
+  template<typename Tuple, size_t I = 0>
+  void addConcrete() {
+    if constexpr (I < std::tuple_size_v<Tuple>) {
+      add<std::tuple_element_t<I, Tuple>>();
+      addConcrete<Tuple, I + 1>();
+    }
+  }
+};
+
+template<typename T>
+uint64_t schemaHash() {
+  static const uint64_t Result = llvm::xxHash64(SchemaDescriber::describe<T>());
+  return Result;
+}
+
+class Writer {
+private:
+  llvm::raw_ostream &OS;
+
+public:
+  Writer(llvm::raw_ostream &OS) : OS(OS) {}
+
+public:
+  void writeSize(uint64_t Size) { llvm::encodeULEB128(Size, OS); }
+
+  void writeString(llvm::StringRef String) {
+    writeSize(String.size());
+    OS << String;
+  }
+
+  template<typename T>
+  void write(const T &Value) {
+    if constexpr (std::is_same_v<T, bool>) {
+      OS << static_cast<char>(Value ? 1 : 0);
+    } else if constexpr (std::signed_integral<T>) {
+      llvm::encodeSLEB128(Value, OS);
+    } else if constexpr (std::unsigned_integral<T>) {
+      llvm::encodeULEB128(Value, OS);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      writeString(Value);
+    } else if constexpr (UpcastablePointerLike<T>) {
+      if (Value.isEmpty()) {
+        writeString("");
+        return;
+      }
+
+      Value.upcast([this](const auto &Upcasted) {
+        using Concrete = std::remove_cvref_t<decltype(Upcasted)>;
+        writeString(TupleLikeTraits<Concrete>::Name);
+        writeFields(Upcasted);
+      });
+    } else if constexpr (TraitedTupleLike<T>) {
+      writeFields(Value);
+    } else if constexpr (HasScalarOrEnumTraits<T>) {
+      writeString(getNameFromYAMLScalar(Value));
+    } else if constexpr (KeyedObjectContainer<T> or Sequence<T>) {
+      writeSize(Value.size());
+      for (const auto &Element : Value)
+        write(Element);
+    } else {
+      static_assert(type_always_false_v<T>, "Unsupported tuple tree node");
+    }
+  }
+
+private:
+  template<size_t I = 0, typename T>
+  void writeFields(const T &Value) {
+    if constexpr (I < std::tuple_size_v<T>) {
+      write(get<I>(Value));
+      writeFields<I + 1>(Value);
+    }
+  }
+};
+
+class Reader {
+private:
+  const uint8_t *Cursor = nullptr;
+  const uint8_t *End = nullptr;
+  std::string ErrorMessage;
+
+public:
+  Reader(llvm::StringRef Buffer) :
+    Cursor(reinterpret_cast<const uint8_t *>(Buffer.data())),
+    End(Cursor + Buffer.size()) {}
+
+public:
+  size_t remaining() const { return End - Cursor; }
+
+  llvm::Error takeError() {
+    revng_assert(not ErrorMessage.empty());
+    return revng::createError("Invalid binary tuple tree: " + ErrorMessage);
+  }
+
+  bool fail(const llvm::Twine &Message) {
+    if (ErrorMessage.empty())
+      ErrorMessage = Message.str();
+    return false;
+  }
+
+  bool readSize(uint64_t &Result) {
+    unsigned Size = 0;
+    const char *Error = nullptr;
+    Result = llvm::decodeULEB128(Cursor, &Size, End, &Error);
+    if (Error != nullptr)
+      return fail(Error);
+
+    Cursor += Size;
+    return true;
+  }
+
+  bool readString(llvm::StringRef &Result) {
+    uint64_t Size = 0;
+    if (not readSize(Size))
+      return false;
+
+    if (Size > remaining())
+      return fail("truncated string");
+
+    Result = { reinterpret_cast<const char *>(Cursor), Size };
+    Cursor += Size;
+    return true;
+  }
+
+  template<typename T>
+  bool read(T &Value) {
+    if constexpr (std::is_same_v<T, bool>) {
+      if (Cursor == End or *Cursor > 1)
+        return fail("invalid boolean");
+
+      Value = *Cursor != 0;
+      ++Cursor;
+      return true;
+    } else if constexpr (std::signed_integral<T>) {
+      unsigned Size = 0;
+      const char *Error = nullptr;
+      int64_t Result = llvm::decodeSLEB128(Cursor, &Size, End, &Error);
+      if (Error != nullptr)
+        return fail(Error);
+
+      if (Result < std::numeric_limits<T>::min()
+          or Result > std::numeric_limits<T>::max())
+        return fail("integer out of range");
+
+      Cursor += Size;
+      Value = Result;
+      return true;
+    } else if constexpr (std::unsigned_integral<T>) {
+      uint64_t Result = 0;
+      if (not readSize(Result))
+        return false;
+
+      if (Result > std::numeric_limits<T>::max())
+        return fail("integer out of range");
+
+      Value = Result;
+      return true;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      llvm::StringRef String;
+      if (not readString(String))
+        return false;
+
+      Value = String.str();
+      return true;
+    } else if constexpr (UpcastablePointerLike<T>) {
+      llvm::StringRef Kind;
+      if (not readString(Kind))
+        return false;
+
+      if (Kind.empty()) {
+        Value.reset();
+        return true;
+      }
+
+      return readPolymorphic(Kind, Value);
+    } else if constexpr (TraitedTupleLike<T>) {
+      return readFields(Value);
+    } else if constexpr (HasScalarOrEnumTraits<T>) {
+      llvm::StringRef String;
+      if (not readString(String))
+        return false;
+
+      return readScalar(String, Value);
+    } else if constexpr (KeyedObjectContainer<T>) {
+      using value_type = typename T::value_type;
+      using KOT = KeyedObjectTraits<value_type>;
+      using key_type = decltype(KOT::key(std::declval<value_type>()));
+
+      uint64_t Size = 0;
+      if (not readSize(Size))
+        return false;
+
+      // Each element takes at least a byte
+      if (Size > remaining())
+        return fail("truncated container");
+
+      auto Inserter = Value.batch_insert();
+      for (uint64_t I = 0; I < Size; ++I) {
+        value_type Element = KOT::fromKey(key_type());
+        if (not read(Element))
+          return false;
+
+        if constexpr (requires { Inserter.emplace(std::move(Element)); })
+          Inserter.emplace(std::move(Element));
+        else
+          Inserter.insert(Element);
+      }
+
+      return true;
+    } else if constexpr (Sequence<T>) {
+      uint64_t Size = 0;
+      if (not readSize(Size))
+        return false;
+
+      if (Size > remaining())
+        return fail("truncated sequence");
+
+      Value.clear();
+      for (uint64_t I = 0; I < Size; ++I)
+        if (not read(Value.emplace_back()))
+          return false;
+
+      return true;
+    } else {
+      static_assert(type_always_false_v<T>, "Unsupported tuple tree node");
+    }
+  }
+
+private:
+  template<size_t I = 0, typename T>
+  bool readFields(T &Value) {
+    if constexpr (I < std::tuple_size_v<T>) {
+      if (not read(get<I>(Value)))
+        return false;
+
+      return readFields<I + 1>(Value);
+    } else {
+      return true;
+    }
+  }
+
+  template<size_t I = 0, UpcastablePointerLike T>
+  bool readPolymorphic(llvm::StringRef Kind, T &Value) {
+    using ConcreteTypes = concrete_types_traits_t<typename T::element_type>;
+    if constexpr (I < std::tuple_size_v<ConcreteTypes>) {
+      using Concrete = std::tuple_element_t<I, ConcreteTypes>;
+      if (llvm::StringRef(TupleLikeTraits<Concrete>::Name) != Kind)
+        return readPolymorphic<I + 1>(Kind, Value);
+
+      auto *Object = new Concrete;
+      Value.reset(Object);
+      return readFields(*Object);
+    } else {
+      return fail("unknown kind " + Kind);
+    }
+  }
+
+  template<HasScalarOrEnumTraits T>
+  bool readScalar(llvm::StringRef String, T &Value) {
+    if constexpr (HasScalarTraits<T>) {
+      using Traits = llvm::yaml::ScalarTraits<T>;
+      llvm::StringRef Error = Traits::input(String, nullptr, Value);
+      if (not Error.empty())
+        return fail(Error);
+
+      return true;
+    } else {
+      struct GetScalarIO {
+        llvm::StringRef TargetName;
+        bool Found = false;
+        void enumCase(T &V,
+                      llvm::StringRef Name,
+                      const T &M,
+                      llvm::yaml::QuotingType = llvm::yaml::QuotingType::None) {
+          if (not Found and TargetName == Name) {
+            Found = true;
+            V = M;
+          }
+        }
+      };
+
+      GetScalarIO ExtractValue{ String };
+      llvm::yaml::ScalarEnumerationTraits<T>::enumeration(ExtractValue, Value);
+      if (not ExtractValue.Found)
+        return fail("unknown enumeration value " + String);
+
+      return true;
+    }
+  }
+};
+
+} // namespace detail
+
+inline bool isBinary(llvm::StringRef Buffer) {
+  return Buffer.startswith({ detail::Magic, sizeof(detail::Magic) });
+}
+
+template<typename T>
+void serialize(llvm::raw_ostream &OS, const T &Root) {
+  detail::Writer Writer(OS);
+  OS.write(detail::Magic, sizeof(detail::Magic));
+  Writer.writeSize(detail::Version);
+  Writer.writeSize(detail::schemaHash<T>());
+  Writer.writeString(detail::rootName<T>());
+  Writer.write(Root);
+}
+
+template<typename T>
+llvm::Error deserialize(llvm::StringRef Buffer, T &Root) {
+  if (not isBinary(Buffer))
+    return revng::createError("Not a binary tuple tree");
+
+  detail::Reader Reader(Buffer.drop_front(sizeof(detail::Magic)));
+  uint64_t Version = 0;
+  if (not Reader.readSize(Version))
+    return Reader.takeError();
+
+  if (Version != detail::Version)
+    return revng::createError("Unsupported binary tuple tree version %zu",
+                              static_cast<size_t>(Version));
+
+  uint64_t SchemaHash = 0;
+  if (not Reader.readSize(SchemaHash))
+    return Reader.takeError();
+
+  if (SchemaHash != detail::schemaHash<T>())
+    return revng::createError("The binary tuple tree has been written with a "
+                              "different schema");
+
+  llvm::StringRef RootName;
+  if (not Reader.readString(RootName))
+    return Reader.takeError();
+
+  if (RootName != detail::rootName<T>())
+    return revng::createError("Expected a binary tuple tree of type %s",
+                              detail::rootName<T>().str().c_str());
+
+  if (not Reader.read(Root))
+    return Reader.takeError();
+
+  if (Reader.remaining() != 0)
+    return revng::createError("Trailing data after binary tuple tree");
+
+  return llvm::Error::success();
+}
+
+} // namespace tupletree::binary
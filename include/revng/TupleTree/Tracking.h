@@ -13,9 +13,10 @@
 /// The exact vectors contains the paths of all vectors that were marked as
 /// requiring being identical.
 ///
-/// We divide into read and exact vectors because when we will introduce the
-/// cold start invalidation based on the hash, the hash will be different
-/// depending if they are just read or if they are vectors required to be exact.
+/// We divide into read and exact vectors because they are checked differently
+/// by the cold start invalidation: for exact vectors only the set of keys is
+/// hashed (see `hashByPath`), since changes to their elements are tracked on
+/// the paths of the elements themselves.
 struct ReadFields {
   std::set<TupleTreePath> Read;
   std::set<TupleTreePath> ExactVectors;
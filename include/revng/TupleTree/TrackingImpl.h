@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <tuple>
 
+#include "revng/Support/AccessTracker.h"
 #include "revng/TupleTree/Tracking.h"
 #include "revng/TupleTree/Visits.h"
 
@@ -172,21 +173,29 @@ ReadFields Tracking::collect(const M &LHS) {
 
 template<typename M>
 void Tracking::clearAndResume(const M &LHS) {
+  revng_assert(not SharedTrackingScope::isActive());
   TrackingImpl::visitTuple<M, TrackingImpl::ClearVisitor>(LHS);
 }
 
 template<typename M>
 void Tracking::push(const M &LHS) {
-  TrackingImpl::visitTuple<M, TrackingImpl::PushVisitor>(LHS);
+  if (DeferredReads *Reads = SharedTrackingScope::reads())
+    Reads->push();
+  else
+    TrackingImpl::visitTuple<M, TrackingImpl::PushVisitor>(LHS);
 }
 
 template<typename M>
 void Tracking::pop(const M &LHS) {
-  TrackingImpl::visitTuple<M, TrackingImpl::PopVisitor>(LHS);
+  if (DeferredReads *Reads = SharedTrackingScope::reads())
+    Reads->pop();
+  else
+    TrackingImpl::visitTuple<M, TrackingImpl::PopVisitor>(LHS);
 }
 
 template<typename M>
 void Tracking::stop(const M &LHS) {
+  revng_assert(not SharedTrackingScope::isActive());
   TrackingImpl::visitTuple<M, TrackingImpl::StopTrackingVisitor>(LHS);
 }
 
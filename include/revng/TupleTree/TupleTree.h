@@ -25,6 +25,7 @@
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
 #include "revng/Support/YAMLTraits.h"
+#include "revng/TupleTree/BinarySerialization.h"
 #include "revng/TupleTree/Tracking.h"
 #include "revng/TupleTree/TupleTreeCompatible.h"
 #include "revng/TupleTree/TupleTreePath.h"
@@ -149,14 +150,22 @@ public:
   }
 
 public:
-  static llvm::Expected<TupleTree> fromString(llvm::StringRef YAMLString) {
+  /// Deserializes \p String, which can be either YAML or the binary format
+  /// produced by serializeBinary
+  static llvm::Expected<TupleTree> fromString(llvm::StringRef String) {
     TupleTree Result{};
 
-    auto MaybeRoot = revng::detail::fromStringImpl<T>(YAMLString);
-    if (not MaybeRoot)
-      return MaybeRoot.takeError();
+    if (tupletree::binary::isBinary(String)) {
+      if (llvm::Error Error = tupletree::binary::deserialize(String,
+                                                             *Result.Root))
+        return std::move(Error);
+    } else {
+      auto MaybeRoot = revng::detail::fromStringImpl<T>(String);
+      if (not MaybeRoot)
+        return MaybeRoot.takeError();
 
-    *Result.Root = std::move(*MaybeRoot);
+      *Result.Root = std::move(*MaybeRoot);
+    }
 
     // Update references to root
     Result.initializeReferences();
@@ -198,6 +207,14 @@ public:
     serialize(Stream);
   }
 
+  /// Serializes the tree in a compact binary format, which fromString can
+  /// read back
+  void serializeBinary(llvm::raw_ostream &Stream) const {
+    revng_assert(Root);
+
+    tupletree::binary::serialize(Stream, *Root);
+  }
+
 public:
   const T *get() const noexcept { return Root.get(); }
   T *get() noexcept {
@@ -395,6 +395,17 @@ template<typename ResultT, typename RootT>
 tupletree::detail::getByPathRV<ResultT, RootT> *
 getByPath(const TupleTreePath &Path, RootT &M);
 
+//
+// hashByPath
+//
+
+/// Returns a hash of the element of \p M pointed by \p Path, or nothing if
+/// the path does not exist.
+///
+/// The hash changes if and only if `diff` would report a change on \p Path.
+template<typename RootT>
+std::optional<uint64_t> hashByPath(const TupleTreePath &Path, const RootT &M);
+
 //
 // pathAsString
 //
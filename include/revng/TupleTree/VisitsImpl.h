@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/Support/xxhash.h"
+
 #include "revng/TupleTree/Visits.h"
 
 //
@@ -57,6 +59,70 @@ getByPath(const TupleTreePath &Path, RootT &M) {
   return GBPV.Result;
 }
 
+//
+// hashByPath
+//
+namespace tupletree::detail {
+
+/// Describes an element in the same terms in which `diff` reports changes on
+/// its path: containers through the list of their keys (elements are
+/// reported on their own paths), polymorphic pointers through their kind and
+/// leaves through their value. Structs are never reported by themselves.
+struct HashByPathVisitor {
+  std::optional<std::string> Description;
+
+  template<typename T>
+  static std::string describe(const T &Element) {
+    if constexpr (revng::SetOrKOC<T>) {
+      std::string Result;
+      using KOT = KeyedObjectTraits<typename T::value_type>;
+      for (const auto &Entry : Element) {
+        Result += getNameFromYAMLScalar(KOT::key(Entry));
+        Result += "\n";
+      }
+      return Result;
+    } else if constexpr (StrictSpecializationOf<T, UpcastablePointer>) {
+      std::string Result;
+      if (not Element.isEmpty())
+        Element.upcast([&](auto &Upcasted) {
+          Result = getNameFromYAMLScalar(Upcasted.Kind());
+        });
+      return Result;
+    } else if constexpr (TupleSizeCompatible<T>) {
+      return std::string();
+    } else {
+      return ::toString(Element);
+    }
+  }
+
+  template<typename, size_t, typename K>
+  void visitTupleElement(K &Element) {
+    Description = describe(Element);
+  }
+
+  template<typename, size_t, typename K, typename KindType>
+  void visitPolymorphicElement(KindType, K &Element) {
+    Description = describe(Element);
+  }
+
+  template<typename, typename KeyT, typename K>
+  void visitContainerElement(KeyT, K &Element) {
+    Description = describe(Element);
+  }
+};
+
+} // namespace tupletree::detail
+
+template<typename RootT>
+std::optional<uint64_t> hashByPath(const TupleTreePath &Path, const RootT &M) {
+  using namespace tupletree::detail;
+  HashByPathVisitor HBPV;
+  if (not callByPath(HBPV, Path, M) or not HBPV.Description.has_value())
+    return std::nullopt;
+
+  return llvm::xxHash64(*HBPV.Description);
+}
+
 //
 // stringAsPath
 //
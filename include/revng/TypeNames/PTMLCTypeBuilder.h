@@ -159,6 +159,9 @@ public:
 
 public:
   void append(std::string &&Text) { *Out << std::move(Text); }
+  /// The stream append writes to, to print text that is not worth building
+  /// as a string first (e.g., because it's big)
+  llvm::raw_ostream &getOutputStream() { return *Out; }
   void appendLineComment(std::string &&Text) {
     append(getLineComment(std::move(Text)));
   }
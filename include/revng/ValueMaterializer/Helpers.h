@@ -14,6 +14,7 @@ class APInt;
 }
 
 inline Logger<> ValueMaterializerLogger("value-materializer");
+inline Logger<> AVILogger("avi");
 
 std::string aviFormatter(const llvm::APInt &Value);
 
@@ -17,15 +17,23 @@ void printSingleCFile(ptml::CTypeBuilder &B,
   B.append(B.getIncludeQuote("types-and-globals.h")
            + B.getIncludeQuote("helpers.h") + "\n");
 
+  // The bodies are decompressed directly into the output, rather than being
+  // materialized in Functions
+  const auto Print = [&B, &Functions](const MetaAddress &Entry) {
+    if (auto Error = Functions.extract(B.getOutputStream(), Entry)) {
+      std::string Message = llvm::toString(std::move(Error));
+      revng_abort(Message.c_str());
+    }
+    B.append("\n");
+  };
+
   if (Targets.empty()) {
     // If Targets is empty print all the Functions' bodies
-    for (const auto &[MetaAddress, CFunction] : Functions)
-      B.append(CFunction + '\n');
+    Functions.forEachKey(Print);
   } else {
     // Otherwise only print the bodies of the Targets
-    auto End = Functions.end();
     for (const auto &MetaAddress : Targets)
-      if (auto It = Functions.find(MetaAddress); It != End)
-        B.append(It->second + '\n');
+      if (Functions.contains(MetaAddress))
+        Print(MetaAddress);
   }
 }
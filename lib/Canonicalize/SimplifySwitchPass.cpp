@@ -263,13 +263,16 @@ void SimplifySwitch::run(pipeline::ExecutionContext &EC,
   auto Buffer = cantFail(errorOrToExpected(std::move(BufferOrError)));
   RawBinaryView RawBinary(*Model, Buffer->getBuffer());
 
-  legacy::PassManager PM;
-  PM.add(new LoadModelWrapperPass(Model));
-  PM.add(new pipeline::LoadExecutionContextPass(&EC, TargetsList.name()));
-  PM.add(new LoadBinaryWrapperPass(Buffer->getBuffer()));
-  PM.add(new DominatorTreeWrapperPass);
-  PM.add(new pipeline::FunctionPass<SimplifySwitchPassImpl>);
-  PM.run(TargetsList.getModule());
+  auto Populate = [&Buffer](legacy::PassManager &PM,
+                            pipeline::ExecutionContext &EC,
+                            pipeline::LLVMContainer &TargetsList) {
+    PM.add(new LoadModelWrapperPass(getModelFromContext(EC)));
+    PM.add(new pipeline::LoadExecutionContextPass(&EC, TargetsList.name()));
+    PM.add(new LoadBinaryWrapperPass(Buffer->getBuffer()));
+    PM.add(new DominatorTreeWrapperPass);
+    PM.add(new pipeline::FunctionPass<SimplifySwitchPassImpl>);
+  };
+  pipeline::runFunctionPipe(EC, TargetsList, Populate);
 }
 
 } // namespace revng::pipes
@@ -262,10 +262,12 @@ RUAResults analyzeRegisterUsage(Function *F,
     // Run the liveness analysis
     revng_log(Log, "Running Liveness");
     rua::Liveness Liveness(Function.Function);
-    auto AnalysisResult = MFP::getMaximalFixedPoint(Liveness,
+    using MFP::getDenseMaximalFixedPoint;
+    auto DefaultValue = Liveness.defaultValue();
+    auto AnalysisResult = getDenseMaximalFixedPoint(Liveness,
                                                     &Function.Function,
-                                                    Liveness.defaultValue(),
-                                                    Liveness.defaultValue(),
+                                                    DefaultValue,
+                                                    DefaultValue,
                                                     { Function.ReturnNode });
 
     // Collect registers alive at the entry
@@ -304,7 +306,8 @@ RUAResults analyzeRegisterUsage(Function *F,
     rua::ReachingDefinitions ReachingDefinitions(Function.Function);
     auto DefaultValue = ReachingDefinitions.defaultValue();
     auto *EntryNode = Function.Function.getEntryNode();
-    auto AnalysisResult = MFP::getMaximalFixedPoint(ReachingDefinitions,
+    using MFP::getDenseMaximalFixedPoint;
+    auto AnalysisResult = getDenseMaximalFixedPoint(ReachingDefinitions,
                                                     &Function.Function,
                                                     DefaultValue,
                                                     DefaultValue,
@@ -7,6 +7,7 @@
 #include <fstream>
 #include <iterator>
 #include <memory>
+#include <optional>
 
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -17,11 +18,14 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/GraphWriter.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/ABI/Definition.h"
 #include "revng/ABI/FunctionType/Layout.h"
 #include "revng/ADT/Queue.h"
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/EarlyFunctionAnalysis/AnalyzeRegisterUsage.h"
 #include "revng/EarlyFunctionAnalysis/CFGAnalyzer.h"
 #include "revng/EarlyFunctionAnalysis/CallEdge.h"
 #include "revng/EarlyFunctionAnalysis/CallGraph.h"
@@ -32,6 +36,8 @@
 #include "revng/EarlyFunctionAnalysis/DetectABI.h"
 #include "revng/EarlyFunctionAnalysis/FunctionEdgeBase.h"
 #include "revng/EarlyFunctionAnalysis/FunctionSummaryOracle.h"
+#include "revng/EarlyFunctionAnalysis/OutlinedFunctionsCache.h"
+#include "revng/MFP/InterproceduralMFP.h"
 #include "revng/Model/Binary.h"
 #include "revng/Model/Pass/PromoteOriginalName.h"
 #include "revng/Model/Register.h"
@@ -44,6 +50,7 @@
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/OpaqueRegisterUser.h"
+#include "revng/Support/Statistics.h"
 
 using namespace llvm;
 using namespace llvm::cl;
@@ -53,6 +60,22 @@ static opt<std::string> CallGraphOutputPath("cg-output",
                                                  "call graph."),
                                             value_desc("filename"));
 
+static opt<unsigned> DetectABIJobs("detect-abi-jobs",
+                                   desc("Number of threads to use to run the "
+                                        "ABI analyses of independent "
+                                        "functions. 0 means one per core."),
+                                   init(1));
+
+static opt<unsigned> OutlinedFunctionsBudget("detect-abi-outlined-functions",
+                                             desc("Maximum number of functions "
+                                                  "outlined at the same time "
+                                                  "by the ABI analyses. Larger "
+                                                  "waves are analyzed in "
+                                                  "batches. Evicted functions "
+                                                  "are outlined again when "
+                                                  "needed. 0 means no limit."),
+                                             init(0));
+
 enum ABIEnforcementOption {
   NoABIEnforcement = 0,
   SoftABIEnforcement,
@@ -84,10 +107,9 @@ static opt<ABIOpt> ABIEnforcement("abi-enforcement-level",
 
 static Logger<> Log("detect-abi");
 
-struct Changes {
-  bool Function = false;
-  std::set<MetaAddress> Callees;
-};
+static CounterMap<std::string> OutliningStatistics("detect-abi-outlining");
+
+static CounterMap<std::string> IterationsStatistics("detect-abi-iterations");
 
 class DetectABIAnalysis {
 public:
@@ -134,10 +156,57 @@ static bool isWritingToMemory(llvm::Instruction &I) {
   return false;
 }
 
-using BasicBlockQueue = UniquedQueue<const BasicBlockNode *>;
+/// Sorts functions by address, so that the order in which they are analyzed
+/// does not depend on where their nodes have been allocated
+struct ByAddress {
+  bool operator()(const BasicBlockNode *LHS, const BasicBlockNode *RHS) const {
+    return LHS->Address < RHS->Address;
+  }
+};
+
+using WavesMap = MFP::WavesMap<BasicBlockNode *>;
+using WavefrontQueue = MFP::WavefrontQueue<BasicBlockNode *, ByAddress>;
+
+using FunctionsCache = OutlinedFunctionsCache<OutlinedFunction>;
+
+/// The results of the data-flow analyses of a function, before they are
+/// committed to the oracle
+struct ABIAnalysesResults {
+  CSVSet WrittenRegisters;
+  RUAResults ABIResults;
+};
+
+using ABIResult = MFP::FunctionAnalysisResult<BasicBlockNode *, RUAResults>;
+
+static bool isSubset(const CSVSet &LHS, const CSVSet &RHS) {
+  return std::includes(RHS.begin(), RHS.end(), LHS.begin(), LHS.end());
+}
+
+/// \return true if combining \p LHS into \p RHS would not change it
+static bool isLessOrEqual(const RUAResults &LHS, const RUAResults &RHS) {
+  if (not isSubset(LHS.ArgumentsRegisters, RHS.ArgumentsRegisters)
+      or not isSubset(LHS.ReturnValuesRegisters, RHS.ReturnValuesRegisters))
+    return false;
+
+  for (const auto &[BlockID, CallSite] : LHS.CallSites) {
+    auto It = RHS.CallSites.find(BlockID);
+    if (It == RHS.CallSites.end())
+      return false;
+
+    const RUAResults::CallSiteResults &Other = It->second;
+    if (not isSubset(CallSite.ArgumentsRegisters, Other.ArgumentsRegisters)
+        or not isSubset(CallSite.ReturnValuesRegisters,
+                        Other.ReturnValuesRegisters))
+      return false;
+  }
+
+  return true;
+}
 
 class DetectABI {
 private:
+  class ABIFixedPoint;
+
   using BasicBlockToNodeMap = llvm::DenseMap<llvm::BasicBlock *,
                                              BasicBlockNode *>;
 
@@ -152,6 +221,7 @@ private:
 
   CallGraph ApproximateCallGraph;
   BasicBlockToNodeMap BasicBlockNodeMap;
+  WavesMap Waves;
 
 public:
   DetectABI(llvm::Module &M,
@@ -207,9 +277,9 @@ private:
   void computeApproximateCallGraph();
   void preliminaryFunctionAnalysis();
   void analyzeABI();
-  Changes analyzeFunctionABI(const model::Function &Function,
-                             OutlinedFunction &OutlinedFunction,
-                             OpaqueRegisterUser &Clobberer);
+  void enrichCallSites(const model::Function &Function,
+                       OutlinedFunction &OutlinedFunction,
+                       OpaqueRegisterUser &Clobberer);
   void applyABIDeductions();
 
   /// Finish the population of the model by building the prototype
@@ -229,10 +299,21 @@ private:
   TrackingSortedVector<model::Register::Values>
   computePreservedRegisters(const CSVSet &ClobberedRegisters) const;
 
-  Changes runAnalyses(MetaAddress EntryAddress,
-                      OutlinedFunction &OutlinedFunction);
+  /// Runs the data-flow analyses on \p OutlinedFunction. This only reads the
+  /// IR and does not access the oracle, therefore it can be run concurrently
+  /// on different functions.
+  ABIAnalysesResults runAnalyses(OutlinedFunction &OutlinedFunction) const;
 
-  CSVSet findWrittenRegisters(llvm::Function *F);
+  /// Refines \p Results and records the parts of them which are not part of
+  /// the ABI summary of the function, e.g., the results for indirect call
+  /// sites.
+  ///
+  /// \return the contributions to the ABI summaries of the function and of its
+  ///         callees
+  ABIResult finalizeAnalyses(MetaAddress EntryAddress,
+                             ABIAnalysesResults &&Results);
+
+  CSVSet findWrittenRegisters(llvm::Function *F) const;
 
   model::UpcastableType
   buildPrototypeForIndirectCall(const FunctionSummary &CallerSummary,
@@ -241,6 +322,118 @@ private:
   bool getRegisterState(model::Register::Values, const CSVSet &);
 };
 
+/// The ABI analysis as an interprocedural monotone framework: the summary of
+/// each function are the registers used as arguments and return values by it
+/// and at its call sites.
+class DetectABI::ABIFixedPoint {
+public:
+  using Label = BasicBlockNode *;
+  using LatticeElement = RUAResults;
+
+private:
+  DetectABI &Parent;
+  FunctionsCache &Functions;
+  OpaqueRegisterUser &RegisterUser;
+  std::optional<llvm::ThreadPool> &Pool;
+  llvm::Task &FixedPointTask;
+  model::NameBuilder NameBuilder;
+
+public:
+  ABIFixedPoint(DetectABI &Parent,
+                FunctionsCache &Functions,
+                OpaqueRegisterUser &RegisterUser,
+                std::optional<llvm::ThreadPool> &Pool,
+                llvm::Task &FixedPointTask) :
+    Parent(Parent),
+    Functions(Functions),
+    RegisterUser(RegisterUser),
+    Pool(Pool),
+    FixedPointTask(FixedPointTask),
+    NameBuilder(*Parent.Binary) {}
+
+public:
+  RUAResults combineValues(const RUAResults &LHS, const RUAResults &RHS) const {
+    RUAResults Result = LHS;
+    Result.combine(RHS);
+    return Result;
+  }
+
+  bool isLessOrEqual(const RUAResults &LHS, const RUAResults &RHS) const {
+    return efa::isLessOrEqual(LHS, RHS);
+  }
+
+  const RUAResults &getSummary(BasicBlockNode *Function) const {
+    return Parent.Oracle.getLocalFunction(Function->Address).ABIResults;
+  }
+
+  void setSummary(BasicBlockNode *Function, const RUAResults &Summary) {
+    Parent.Oracle.getLocalFunction(Function->Address).ABIResults = Summary;
+  }
+
+  std::vector<ABIResult> analyze(llvm::ArrayRef<BasicBlockNode *> Wave) {
+    revng_log(Log, "Analyzing a wave of " << Wave.size() << " functions");
+    LoggerIndent<> Indent(Log);
+
+    // The functions of a wave are analyzed in batches fitting the budget of
+    // outlined functions. Summaries are only updated once the whole wave has
+    // been analyzed, so all the batches see the same ones.
+    std::vector<ABIAnalysesResults> Results;
+    Results.reserve(Wave.size());
+    for (llvm::ArrayRef<BasicBlockNode *> Batch : Functions.batches(Wave))
+      analyzeBatch(Batch, Results);
+
+    std::vector<ABIResult> Result;
+    for (size_t Index = 0; Index < Wave.size(); ++Index) {
+      MetaAddress Entry = Wave[Index]->Address;
+      Result.push_back(Parent.finalizeAnalyses(Entry,
+                                               std::move(Results[Index])));
+    }
+
+    return Result;
+  }
+
+private:
+  /// Runs the analyses of the functions of \p Batch, appending their results
+  /// to \p Results
+  void analyzeBatch(llvm::ArrayRef<BasicBlockNode *> Batch,
+                    std::vector<ABIAnalysesResults> &Results) {
+    std::vector<MetaAddress> Addresses;
+    for (const BasicBlockNode *Node : Batch)
+      Addresses.push_back(Node->Address);
+    Functions.makeRoomFor(Addresses);
+
+    // Enrich the call sites with the current summaries of the callees
+    std::vector<OutlinedFunction *> Outlined;
+    for (const BasicBlockNode *Node : Batch) {
+      const auto &Function = Parent.Binary->Functions().at(Node->Address);
+      revng_log(Log, "Analyzing " << Function.Entry().toString());
+      FixedPointTask.advance(NameBuilder.name(Function));
+      Outlined.push_back(&Functions.get(Node->Address));
+      Parent.enrichCallSites(Function, *Outlined.back(), RegisterUser);
+    }
+
+    // Run the analyses
+    size_t Offset = Results.size();
+    Results.resize(Offset + Batch.size());
+    auto Analyze = [this, &Outlined, &Results, Offset](size_t Index) {
+      Results[Offset + Index] = Parent.runAnalyses(*Outlined[Index]);
+    };
+
+    if (Pool.has_value() and Batch.size() > 1) {
+      for (size_t Index = 0; Index < Batch.size(); ++Index)
+        Pool->async(Analyze, Index);
+      Pool->wait();
+    } else {
+      for (size_t Index = 0; Index < Batch.size(); ++Index)
+        Analyze(Index);
+    }
+
+    // Once the instructions created by RegisterUser are purged, functions can
+    // be safely deleted by the next batch
+    RegisterUser.purgeCreated();
+  }
+};
+
 void DetectABI::computeApproximateCallGraph() {
   using llvm::BasicBlock;
 
@@ -310,6 +503,9 @@ void DetectABI::computeApproximateCallGraph() {
   for (const auto &[_, Node] : BasicBlockNodeMap)
     RootNode->addSuccessor(Node);
 
+  // Assign each function to a wave, callees first
+  Waves = MFP::computeWaves(&ApproximateCallGraph);
+
   // Dump the call-graph, if requested
   if (CallGraphOutputPath.getNumOccurrences() == 1) {
     std::ifstream File(CallGraphOutputPath.c_str());
@@ -324,7 +520,7 @@ void DetectABI::preliminaryFunctionAnalysis() {
   revng_log(Log, "Running the preliminary function analysis");
   LoggerIndent<> LodIndent(Log);
 
-  BasicBlockQueue EntrypointsQueue;
+  WavefrontQueue EntrypointsQueue(Waves);
 
   //
   // Populate queue of entry points
@@ -349,8 +545,10 @@ void DetectABI::preliminaryFunctionAnalysis() {
   // Process the queue
   //
 
+  // Note: CFGAnalyzer::analyze outlines the function in the module, therefore
+  //       functions are analyzed one at a time, even if in the same wave
   while (!EntrypointsQueue.empty()) {
-    const BasicBlockNode *EntryNode = EntrypointsQueue.pop();
+    BasicBlockNode *EntryNode = EntrypointsQueue.pop();
     MetaAddress EntryPointAddress = EntryNode->Address;
     revng_log(Log, "Analyzing " << EntryPointAddress.toString());
     LoggerIndent<> Indent(Log);
@@ -392,11 +590,11 @@ void DetectABI::preliminaryFunctionAnalysis() {
       revng_log(Log,
                 "Entry " << EntryPointAddress.toString() << " has changed");
       LoggerIndent<> Indent(Log);
-      OnceQueue<const BasicBlockNode *> InlineFunctionWorklist;
+      OnceQueue<BasicBlockNode *> InlineFunctionWorklist;
       InlineFunctionWorklist.insert(EntryNode);
 
       while (!InlineFunctionWorklist.empty()) {
-        const BasicBlockNode *Node = InlineFunctionWorklist.pop();
+        BasicBlockNode *Node = InlineFunctionWorklist.pop();
         MetaAddress NodeAddress = Node->Address;
         revng_log(Log,
                   "Re-enqueuing callers of " << NodeAddress.toString() << ":");
@@ -451,26 +649,22 @@ void DetectABI::analyzeABI() {
   revng_log(Log, "Running ABI analyses");
   LoggerIndent<> Indent(Log);
 
-  llvm::Task Task(2, "analyzeABI");
-  std::map<MetaAddress, std::unique_ptr<OutlinedFunction>> Functions;
+  llvm::Task Task(1, "analyzeABI");
 
-  // Create all temporary functions
-  Task.advance("Create temporary functions");
-  for (model::Function &Function : Binary->Functions()) {
-    const MetaAddress &Entry = Function.Entry();
-    auto NewFunction = make_unique<OutlinedFunction>(Analyzer.outline(Entry));
-    Functions[Function.Entry()] = std::move(NewFunction);
-  }
+  // Functions are outlined when they are analyzed and, if there's a budget,
+  // deleted once they have not been used recently, so that large binaries do
+  // not need all of them at the same time
+  auto Outline = [this](const MetaAddress &Address) {
+    OutliningStatistics.push("outlined");
+    return Analyzer.outline(Address);
+  };
+  FunctionsCache Functions(Outline, OutlinedFunctionsBudget);
 
   // Push this into analyzeFunction
   OpaqueRegisterUser RegisterUser(&M);
 
-  // TODO: this really needs to become a monotone framework
   Task.advance("Run fixed-point analyses");
   llvm::Task FixedPointTask({}, "Fixed-point analysis");
-  UniquedQueue<model::Function *> ToAnalyze;
-  for (model::Function &Function : Binary->Functions())
-    ToAnalyze.insert(&Function);
 
   // Change the oracle default prototype to have no arguments nor return values
   {
@@ -480,50 +674,43 @@ void DetectABI::analyzeABI() {
     Oracle.setDefault(std::move(NewDefault));
   }
 
-  unsigned Runs = 0;
-  model::NameBuilder NameBuilder = *Binary;
-  while (not ToAnalyze.empty()) {
-    model::Function &Function = *ToAnalyze.pop();
-    revng_log(Log, "Analyzing " << Function.Entry().toString());
-    FixedPointTask.advance(NameBuilder.name(Function));
-    OutlinedFunction &OutlinedFunction = *Functions.at(Function.Entry());
-    Changes Changes = analyzeFunctionABI(Function,
-                                         OutlinedFunction,
-                                         RegisterUser);
-
-    if (Changes.Function) {
-      revng_log(Log, "The function has changed, re-enqueing all callers:");
-      LoggerIndent<> Indent(Log);
-      // The prototype of the function we analyzed has changed, reanalyze
-      // callers
-      auto &FunctionNode = BasicBlockNodeMap[GCBI.getBlockAt(Function.Entry())];
-      for (auto &CallerNode : FunctionNode->predecessors()) {
-        if (CallerNode->Address.isValid()) {
-          revng_log(Log, CallerNode->Address.toString());
-          ToAnalyze.insert(&Binary->Functions().at(CallerNode->Address));
-        }
-      }
-    }
+  // The data-flow analyses of the functions of a wave are independent from
+  // each other, run them concurrently, if requested. Everything else,
+  // including all the accesses to the oracle, happens on this thread.
+  unsigned Jobs = DetectABIJobs;
+  if (Jobs == 0)
+    Jobs = llvm::hardware_concurrency().compute_thread_count();
 
-    // Register for re-analysis all the callees for which we have new
-    // information
-    for (const MetaAddress &ToReanalyze : Changes.Callees) {
-      revng_assert(ToReanalyze.isValid());
-      revng_log(Log, "Re-enqueing callee " << ToReanalyze.toString());
-      ToAnalyze.insert(&Binary->Functions().at(ToReanalyze));
-    }
-  }
-}
+  std::optional<llvm::ThreadPool> Pool;
+  if (Jobs > 1 and not Log.isEnabled())
+    Pool.emplace(llvm::hardware_concurrency(Jobs));
 
-Changes DetectABI::analyzeFunctionABI(const model::Function &Function,
-                                      OutlinedFunction &OutlinedFunction,
-                                      OpaqueRegisterUser &RegisterReader) {
-  revng_log(Log, "Analyzing the ABI of " << Function.Entry().toString());
+  std::vector<BasicBlockNode *> ToAnalyze;
+  for (model::Function &Function : Binary->Functions())
+    ToAnalyze.push_back(BasicBlockNodeMap[GCBI.getBlockAt(Function.Entry())]);
 
-  //
-  // Enrich all the call sites
-  //
+  ABIFixedPoint Instance(*this, Functions, RegisterUser, Pool, FixedPointTask);
+  auto Iterations = MFP::getInterproceduralFixedPoint<ABIFixedPoint,
+                                                      ByAddress>(Instance,
+                                                                 Waves,
+                                                                 ToAnalyze);
+
+  OutliningStatistics.push("evicted", Functions.evictedCount());
+
+  size_t Total = 0;
+  for (const auto &[Node, Count] : Iterations) {
+    IterationsStatistics.push(Node->Address.toString(), Count);
+    Total += Count;
+  }
+
+  revng_log(Log,
+            Total << " analyses of " << Iterations.size()
+                  << " functions were needed to reach the fixed point");
+}
 
+void DetectABI::enrichCallSites(const model::Function &Function,
+                                OutlinedFunction &OutlinedFunction,
+                                OpaqueRegisterUser &RegisterReader) {
   // Collect all calls to precall_hook and postcall_hook
   SmallVector<std::pair<CallInst *, bool>> Hooks;
   for (Instruction &I : instructions(OutlinedFunction.Function.get())) {
@@ -572,13 +759,6 @@ Changes DetectABI::analyzeFunctionABI(const model::Function &Function,
       }
     }
   }
-
-  // Perform the analysis
-  Changes Changes = runAnalyses(Function.Entry(), OutlinedFunction);
-
-  RegisterReader.purgeCreated();
-
-  return Changes;
 }
 
 // TODO: drop this.
@@ -906,7 +1086,7 @@ bool DetectABI::getRegisterState(model::Register::Values RegisterValue,
   return false;
 }
 
-CSVSet DetectABI::findWrittenRegisters(llvm::Function *F) {
+CSVSet DetectABI::findWrittenRegisters(llvm::Function *F) const {
   using namespace llvm;
 
   CSVSet WrittenRegisters;
@@ -989,25 +1169,30 @@ static auto zeroOrOne(const T &Range, const F &Predicate)
   return Result;
 }
 
-Changes DetectABI::runAnalyses(MetaAddress EntryAddress,
-                               OutlinedFunction &OutlinedFunction) {
-  using namespace llvm;
-  using llvm::BasicBlock;
-
-  IRBuilder<> Builder(M.getContext());
-  RUAResults ABIResults;
+ABIAnalysesResults
+DetectABI::runAnalyses(OutlinedFunction &OutlinedFunction) const {
+  ABIAnalysesResults Results;
 
   // Find registers that may be target of at least one store. This helps
   // refine the final results.
-  auto WrittenRegisters = findWrittenRegisters(OutlinedFunction.Function.get());
+  llvm::Function *F = OutlinedFunction.Function.get();
+  Results.WrittenRegisters = findWrittenRegisters(F);
 
   // Run ABI-independent data-flow analyses
-  ABIResults = analyzeRegisterUsage(OutlinedFunction.Function.get(),
-                                    GCBI,
-                                    Binary->Architecture(),
-                                    Analyzer.preCallHook(),
-                                    Analyzer.postCallHook(),
-                                    Analyzer.retHook());
+  Results.ABIResults = analyzeRegisterUsage(F,
+                                            GCBI,
+                                            Binary->Architecture(),
+                                            Analyzer.preCallHook(),
+                                            Analyzer.postCallHook(),
+                                            Analyzer.retHook());
+
+  return Results;
+}
+
+ABIResult DetectABI::finalizeAnalyses(MetaAddress EntryAddress,
+                                      ABIAnalysesResults &&Results) {
+  RUAResults &ABIResults = Results.ABIResults;
+  CSVSet &WrittenRegisters = Results.WrittenRegisters;
 
   // We say that a register is callee-saved when, besides being preserved by
   // the callee, there is at least a write onto this register.
@@ -1020,50 +1205,39 @@ Changes DetectABI::runAnalyses(MetaAddress EntryAddress,
   // pointer registers.
   suppressCalleeSaved(ABIResults, ActualCalleeSavedRegs);
 
-  // Commit ABI analysis results to the oracle
-  auto Old = Summary.ABIResults;
-  Summary.ABIResults.combine(ABIResults);
   Summary.WrittenRegisters = WrittenRegisters;
 
-  Changes Changes;
-  Changes.Function = Old != Summary.ABIResults;
-
+  ABIResult Result;
   for (auto &[BlockID, CallSite] : ABIResults.CallSites) {
     // TODO: why are we ignoring inlined call sites?
     if (BlockID.isInlined())
       continue;
 
-    MetaAddress Callee = CallSite.CalleeAddress;
+    // Contribute the registers used at the call site to the callee
+    RUAResults CalleeResults;
+    CalleeResults.ArgumentsRegisters = CallSite.ArgumentsRegisters;
+    CalleeResults.ReturnValuesRegisters = CallSite.ReturnValuesRegisters;
 
-    // TODO: eventually we'll want to add arguments/return values to dynamic
-    //       functions too
-    FunctionSummary *Summary = nullptr;
+    MetaAddress Callee = CallSite.CalleeAddress;
     if (Callee.isValid()) {
-      Summary = &Oracle.getLocalFunction(Callee);
-      revng_assert(Summary != nullptr);
-    } else {
-      Summary = Oracle.getExactCallSite(EntryAddress, BlockID).first;
+      BasicBlockNode *CalleeNode = BasicBlockNodeMap[GCBI.getBlockAt(Callee)];
+      revng_assert(CalleeNode != nullptr);
+      Result.Contributions.emplace_back(CalleeNode, std::move(CalleeResults));
+      continue;
     }
 
+    // TODO: eventually we'll want to add arguments/return values to dynamic
+    //       functions too
     // TODO: are longjmps calls? Do we want to collect prototype for them?
     //       Right now, they are in the IR, but we do not register them as call
     //       sites in the Oracle.
-    if (Summary != nullptr) {
-      bool Changed = false;
-      RUAResults &ToAdjust = Summary->ABIResults;
-
-      for (auto *CSV : CallSite.ArgumentsRegisters)
-        Changed = Changed or ToAdjust.ArgumentsRegisters.insert(CSV).second;
-
-      for (auto *CSV : CallSite.ReturnValuesRegisters)
-        Changed = Changed or ToAdjust.ReturnValuesRegisters.insert(CSV).second;
-
-      if (Changed and Callee.isValid())
-        Changes.Callees.insert(Callee);
-    }
+    auto [CallSiteSummary, _] = Oracle.getExactCallSite(EntryAddress, BlockID);
+    if (CallSiteSummary != nullptr)
+      CallSiteSummary->ABIResults.combine(CalleeResults);
   }
 
-  return Changes;
+  Result.Summary = std::move(ABIResults);
+  return Result;
 }
 
 bool DetectABIPass::runOnModule(Module &M) {
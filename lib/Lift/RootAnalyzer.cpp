@@ -4,18 +4,27 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+
 #include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/Analysis/BasicAliasAnalysis.h"
 #include "llvm/Analysis/ScopedNoAliasAA.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/CodeGen/UnreachableBlockElim.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/PatternMatch.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar/EarlyCSE.h"
 #include "llvm/Transforms/Scalar/JumpThreading.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/Mem2Reg.h"
 
@@ -23,12 +32,15 @@
 #include "revng/ABI/FunctionType/Layout.h"
 #include "revng/BasicAnalyses/ShrinkInstructionOperandsPass.h"
 #include "revng/FunctionCallIdentification/FunctionCallIdentification.h"
+#include "revng/Support/BlockType.h"
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/OpaqueRegisterUser.h"
 #include "revng/Support/Statistics.h"
 #include "revng/TypeShrinking/BitLiveness.h"
 #include "revng/TypeShrinking/TypeShrinking.h"
 #include "revng/ValueMaterializer/DataFlowGraph.h"
+#include "revng/ValueMaterializer/Helpers.h"
 
 #include "CPUStateAccessAnalysisPass.h"
 #include "JumpTargetManager.h"
@@ -45,6 +57,24 @@ RunningStatistics LoadAddressStatistics("load-address");
 
 Logger<> NewEdgesLog("new-edges");
 
+static cl::opt<unsigned> RootAnalyzerJobs("root-analyzer-jobs",
+                                          cl::desc("Number of threads to use "
+                                                   "to optimize independent "
+                                                   "parts of the root. 0 "
+                                                   "means one per core."),
+                                          cl::cat(MainCategory),
+                                          cl::init(1));
+
+static cl::opt<unsigned>
+  MinimumPartitionSize("root-analyzer-minimum-partition-size",
+                       cl::desc("Minimum number of instructions of each "
+                                "partition of the root, which are "
+                                "optimized independently, in parallel if "
+                                "possible."),
+                       cl::cat(MainCategory),
+                       cl::init(10000),
+                       cl::Hidden);
+
 // NOTE: Setting this to 1 gives us performance improvement. We have tested and
 // realized that there is an impact on performance if setting it to 2.
 constexpr unsigned InstCombineMaxIterations = 1;
@@ -527,8 +557,8 @@ RootAnalyzer::promoteCSVsToAlloca(Function *OptimizedFunction) {
   return CSVMap;
 }
 
-SummaryCallsBuilder RootAnalyzer::optimize(llvm::Function *OptimizedFunction,
-                                           const Features &CommonFeatures) {
+SummaryCallsBuilder
+RootAnalyzer::prepareForOptimization(llvm::Function *OptimizedFunction) {
   using namespace model::Architecture;
   using namespace model::Register;
 
@@ -560,23 +590,7 @@ SummaryCallsBuilder RootAnalyzer::optimize(llvm::Function *OptimizedFunction,
       eraseFromParent(I);
   }
 
-  // The StaticDataMemoryOracle provide the contents of memory areas that are
-  // mapped statically (i.e., in segments). This is critical to capture, e.g.,
-  // virtual tables
-  StaticDataMemoryOracle MO(TheModule.getDataLayout(), JTM, CommonFeatures);
-
   {
-    // Note: it is important to let the pass manager go out of scope ASAP:
-    //       LazyValueInfo registers a lot of callbacks to get notified when a
-    //       Value is destroyed, slowing down OptimizedFunction->eraseFromParent
-    //       enormously.
-
-    // The order of the passes, when and how many times they are run are
-    // inspired by the -O2 pipeline. You can see it in action as follows:
-    //
-    //       clang test.c -emit-llvm -o- -Xclang -disable-O0-optnone | \
-    //         opt -O2 -S -debug-pass-manager
-
     FunctionPassManager FPM;
 
     // Drop all markers except exitTB
@@ -585,63 +599,9 @@ SummaryCallsBuilder RootAnalyzer::optimize(llvm::Function *OptimizedFunction,
     // Summarize calls to helpers
     FPM.addPass(DropHelperCallsPass(SyscallHelper, SyscallIDCSV, SCB));
 
-    // TODO: do we still need this?
-    FPM.addPass(ShrinkInstructionOperandsPass());
-
-    // Canonicalization
-    FPM.addPass(PromotePass());
-    FPM.addPass(EarlyCSEPass(true));
-    FPM.addPass(InstCombinePass(InstCombineMaxIterations));
-
-    // This ensures we have in the IR values from constant pools, which will
-    // then get collected by collectValuesStoredIntoMemory
-    FPM.addPass(ConstantLoadsFolderPass(MO));
-
-    // Running JumpThreading is important to merge multiple instructions with
-    // the same predicate in a single "if" (in particular in ARM) and obtain
-    // more accurate constraints.
-    FPM.addPass(JumpThreadingPass());
-
-    // Shrink instructions
-
-    // InstCombine should not run after TypeShrinking since it undoes its work.
-    // Specifically it turns icmp that have been shrank to 32-bit by
-    // TypeShrinking back to 64-bits.
-    FPM.addPass(TypeShrinking::TypeShrinkingPass());
-
-    // It is important to run EarlyCSE *after* JumpThreading. This has the
-    // side effect of invalidating LazyValueInfo (which would otherwise be
-    // shared between JumpThreadingPass and ValueMaterializerPass).
-    // If we don't run it we get failures on ARM.
-    // It is also important to run EarlyCSE after TypeShrinking to factor trunc
-    // instructions and have more accurate constraints.
-    FPM.addPass(EarlyCSEPass(true));
-
-    // Drop range metadata
-    FPM.addPass(DropRangeMetadataPass());
-
-    // Run ValueMaterializer!
-    FPM.addPass(ValueMaterializerPass(MO));
-
     FunctionAnalysisManager FAM;
-    FAM.registerPass([]() { return TypeShrinking::BitLivenessPass(); });
-    FAM.registerPass([] {
-      AAManager AA;
-      AA.registerFunctionAnalysis<BasicAA>();
-      AA.registerFunctionAnalysis<ScopedNoAliasAA>();
-
-      return AA;
-    });
-
-    ModuleAnalysisManager MAM;
-    auto MAMFunactionProxyFactory = [&MAM] {
-      return ModuleAnalysisManagerFunctionProxy(MAM);
-    };
-    FAM.registerPass(MAMFunactionProxyFactory);
-
     PassBuilder PB;
     PB.registerFunctionAnalyses(FAM);
-    PB.registerModuleAnalyses(MAM);
 
     FPM.run(*OptimizedFunction, FAM);
   }
@@ -649,6 +609,84 @@ SummaryCallsBuilder RootAnalyzer::optimize(llvm::Function *OptimizedFunction,
   return SCB;
 }
 
+/// Optimizes \p F, prepared by RootAnalyzer::prepareForOptimization, and runs
+/// ValueMaterializerPass on it. \p F can live in a module other than the one
+/// of the JumpTargetManager.
+static void runOptimizationPipeline(Function &F, StaticDataMemoryOracle &MO) {
+  // Note: it is important to let the pass manager go out of scope ASAP:
+  //       LazyValueInfo registers a lot of callbacks to get notified when a
+  //       Value is destroyed, slowing down OptimizedFunction->eraseFromParent
+  //       enormously.
+
+  // The order of the passes, when and how many times they are run are
+  // inspired by the -O2 pipeline. You can see it in action as follows:
+  //
+  //       clang test.c -emit-llvm -o- -Xclang -disable-O0-optnone | \
+  //         opt -O2 -S -debug-pass-manager
+
+  FunctionPassManager FPM;
+
+  // TODO: do we still need this?
+  FPM.addPass(ShrinkInstructionOperandsPass());
+
+  // Canonicalization
+  FPM.addPass(PromotePass());
+  FPM.addPass(EarlyCSEPass(true));
+  FPM.addPass(InstCombinePass(InstCombineMaxIterations));
+
+  // This ensures we have in the IR values from constant pools, which will
+  // then get collected by collectValuesStoredIntoMemory
+  FPM.addPass(ConstantLoadsFolderPass(MO));
+
+  // Running JumpThreading is important to merge multiple instructions with
+  // the same predicate in a single "if" (in particular in ARM) and obtain
+  // more accurate constraints.
+  FPM.addPass(JumpThreadingPass());
+
+  // Shrink instructions
+
+  // InstCombine should not run after TypeShrinking since it undoes its work.
+  // Specifically it turns icmp that have been shrank to 32-bit by
+  // TypeShrinking back to 64-bits.
+  FPM.addPass(TypeShrinking::TypeShrinkingPass());
+
+  // It is important to run EarlyCSE *after* JumpThreading. This has the
+  // side effect of invalidating LazyValueInfo (which would otherwise be
+  // shared between JumpThreadingPass and ValueMaterializerPass).
+  // If we don't run it we get failures on ARM.
+  // It is also important to run EarlyCSE after TypeShrinking to factor trunc
+  // instructions and have more accurate constraints.
+  FPM.addPass(EarlyCSEPass(true));
+
+  // Drop range metadata
+  FPM.addPass(DropRangeMetadataPass());
+
+  // Run ValueMaterializer!
+  FPM.addPass(ValueMaterializerPass(MO));
+
+  FunctionAnalysisManager FAM;
+  FAM.registerPass([]() { return TypeShrinking::BitLivenessPass(); });
+  FAM.registerPass([] {
+    AAManager AA;
+    AA.registerFunctionAnalysis<BasicAA>();
+    AA.registerFunctionAnalysis<ScopedNoAliasAA>();
+
+    return AA;
+  });
+
+  ModuleAnalysisManager MAM;
+  auto MAMFunactionProxyFactory = [&MAM] {
+    return ModuleAnalysisManagerFunctionProxy(MAM);
+  };
+  FAM.registerPass(MAMFunactionProxyFactory);
+
+  PassBuilder PB;
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerModuleAnalyses(MAM);
+
+  FPM.run(F, FAM);
+}
+
 void RootAnalyzer::collectMaterializedValues(AnalysisRegistry &AR) {
   // Iterate over all the ValueMaterializer markers
   Function *ValueMaterializerMarker = AR.aviMarker();
@@ -657,126 +695,457 @@ void RootAnalyzer::collectMaterializedValues(AnalysisRegistry &AR) {
     // type
     Value *LastArgument = Call->getArgOperand(Call->arg_size() - 1);
     uint32_t ValueMaterializerID = getLimitedValue(LastArgument);
-    auto TV = AR.rootInstructionById(ValueMaterializerID);
-    auto TIT = TV.Type;
-    Instruction *I = TV.I;
 
     // Did ValueMaterializer produce any info?
     auto *T = dyn_cast_or_null<MDTuple>(Call->getMetadata("revng.avi"));
     if (T == nullptr)
       continue;
 
-    // Is this a direct write to PC?
-    bool IsComposedIntegerPC = (TIT == TrackedInstructionType::WrittenInPC);
+    harvestMaterializedValues(AR, ValueMaterializerID, T);
+  }
+}
+
+void RootAnalyzer::harvestMaterializedValues(AnalysisRegistry &AR,
+                                             uint32_t ValueMaterializerID,
+                                             MDTuple *T) {
+  auto TV = AR.rootInstructionById(ValueMaterializerID);
+  auto TIT = TV.Type;
+
+  // Is this a direct write to PC?
+  bool IsComposedIntegerPC = (TIT == TrackedInstructionType::WrittenInPC);
+
+  // We want to register the results only if *all* of them are good
+  bool AllValid = true;
+  bool AllPCs = true;
+
+  SmallVector<MetaAddress, 16> Targets;
+  QuickMetadata QMD(TheModule.getContext());
+
+  // Iterate over all the generated values
+  for (const MDOperand &Operand : cast<MDTuple>(T)->operands()) {
+    // Extract the value
+    auto *Tuple = QMD.extract<MDTuple *>(Operand.get());
+    auto SymbolName = QMD.extract<StringRef>(Tuple->getOperand(0).get());
+    auto *Value = QMD.extract<ConstantInt *>(Tuple->getOperand(1).get());
+
+    bool HasDynamicSymbol = SymbolName.size() != 0;
+    if (not HasDynamicSymbol) {
+      // Deserialize value into a MetaAddress, depending on the tracked
+      // instruction type
+      auto MA = (IsComposedIntegerPC ?
+                   MetaAddress::decomposeIntegerPC(Value) :
+                   MetaAddress::fromPC(TV.Address, getLimitedValue(Value)));
+
+      if (MA.isInvalid()) {
+        AllValid = false;
+      } else {
+        if (not JTM.isPC(MA))
+          AllPCs = false;
+
+        Targets.push_back(MA);
+      }
+    }
+  }
 
-    // We want to register the results only if *all* of them are good
-    bool AllValid = true;
-    bool AllPCs = true;
+  // Proceed only if all the results are valid
+  if (not AllValid)
+    return;
 
-    SmallVector<MetaAddress, 16> Targets;
-    QuickMetadata QMD(TheModule.getContext());
+  // If it's supposed to be a PC, all of them have to be a PC
+  bool ShouldBePC = (TIT == TrackedInstructionType::WrittenInPC
+                     or TIT == TrackedInstructionType::StoredInMemory);
+  if (ShouldBePC and not AllPCs)
+    return;
 
-    // Iterate over all the generated values
-    for (const MDOperand &Operand : cast<MDTuple>(T)->operands()) {
-      // Extract the value
-      auto *Tuple = QMD.extract<MDTuple *>(Operand.get());
-      auto SymbolName = QMD.extract<StringRef>(Tuple->getOperand(0).get());
-      auto *Value = QMD.extract<ConstantInt *>(Tuple->getOperand(1).get());
+  // Register the resulting addresses
+  unsigned RegisteredAddresses = 0;
 
-      bool HasDynamicSymbol = SymbolName.size() != 0;
-      if (not HasDynamicSymbol) {
-        // Deserialize value into a MetaAddress, depending on the tracked
-        // instruction type
-        auto MA = (IsComposedIntegerPC ?
-                     MetaAddress::decomposeIntegerPC(Value) :
-                     MetaAddress::fromPC(TV.Address, getLimitedValue(Value)));
-
-        if (MA.isInvalid()) {
-          AllValid = false;
-        } else {
-          if (not JTM.isPC(MA))
-            AllPCs = false;
-
-          Targets.push_back(MA);
-        }
-      }
+  auto RegisterJT = [this, &RegisteredAddresses](MetaAddress Address,
+                                                 JTReason::Values Reason) {
+    bool IsNew = not JTM.hasJT(Address);
+    if (JTM.registerJT(Address, Reason) != nullptr and IsNew) {
+      ++RegisteredAddresses;
     }
+  };
+
+  switch (TIT) {
+  case TrackedInstructionType::WrittenInPC:
+    for (const MetaAddress &MA : Targets)
+      RegisterJT(MA, JTReason::PCStore);
+    WrittenInPCStatistics.push(RegisteredAddresses);
+    break;
+
+  case TrackedInstructionType::StoredInMemory:
+    for (const MetaAddress &MA : Targets)
+      RegisterJT(MA, JTReason::MemoryStore);
+    StoredInMemoryStatistics.push(RegisteredAddresses);
+    break;
+
+  case TrackedInstructionType::StoreTarget:
+  case TrackedInstructionType::LoadTarget:
+    for (const MetaAddress &MA : Targets)
+      if (JTM.markJT(MA, JTReason::LoadAddress))
+        ++RegisteredAddresses;
+    LoadAddressStatistics.push(RegisteredAddresses);
+    break;
+
+  case TrackedInstructionType::Invalid:
+    revng_abort();
+  }
+
+  if (TIT == TrackedInstructionType::WrittenInPC) {
+    // This is a call to `exit_tb`, transfer the revng.avi metadata on the
+    // call as revng.targets for later processing
+    revng_assert(TV.I != nullptr);
+    TV.I->setMetadata("revng.targets", T);
+    DetectedEdgesStatistics.push(Targets.size());
+    revng_log(NewEdgesLog, Targets.size() << " targets from " << getName(TV.I));
+  }
+}
+
+using JTM2 = RootAnalyzer;
+
+void JTM2::collectValuesStoredIntoMemory(Function *F,
+                                         const Features &CommonFeatures) {
+  for (Instruction &I : llvm::instructions(F)) {
+    if (auto *Store = dyn_cast<StoreInst>(&I)) {
+      auto *Pointer = Store->getPointerOperand();
+      auto *Address = dyn_cast<ConstantInt>(Store->getValueOperand());
+      if (isMemory(Pointer) and Address != nullptr)
+        registerValueStoredIntoMemory(Address, CommonFeatures);
+    }
+  }
+}
+
+void JTM2::registerValueStoredIntoMemory(ConstantInt *Address,
+                                         const Features &CommonFeatures) {
+  if (not JTM.programCounterHandler()->isPCSizedType(Address->getType()))
+    return;
+
+  auto MA = MetaAddress::fromPC(Address->getLimitedValue(), CommonFeatures);
+  if (MA.isValid()) {
+    JTM.registerJT(MA, JTReason::MemoryStore);
+  }
+}
+
+/// Blocks that do not belong to any partition of the temporary root, i.e., the
+/// entry block, the root dispatcher and its helper blocks
+static bool isSharedBlock(const BasicBlock *BB) {
+  switch (getType(BB)) {
+  case BlockType::JumpTargetBlock:
+  case BlockType::TranslatedBlock:
+  case BlockType::IndirectBranchDispatcherHelperBlock:
+    return false;
+  default:
+    return true;
+  }
+}
+
+/// Splits the blocks of \p F in partitions of similar size, having at least
+/// MinimumPartitionSize instructions each.
+///
+/// Each partition is a set of weakly connected components of the CFG of \p F
+/// deprived of the shared blocks (see isSharedBlock): code in a partition
+/// reaches other partitions only through the root dispatcher. Since the entry
+/// block initializes all the CSVs with opaque values before jumping to the
+/// dispatcher, everything flowing through the dispatcher is unknown anyway and
+/// each partition can be analyzed together with the shared blocks only.
+///
+/// The partitions depend on \p F only, and not on how many threads are going
+/// to optimize them, so that the results do not depend on the latter either.
+///
+/// \return the partitions, or an empty vector if \p F is too small to be worth
+///         splitting
+static std::vector<RootAnalyzer::Partition>
+partitionTemporaryRoot(Function *F) {
+  using Partition = RootAnalyzer::Partition;
+
+  // Group blocks connected by an edge not involving shared blocks
+  DenseSet<const BasicBlock *> Shared;
+  EquivalenceClasses<BasicBlock *> Components;
+  size_t TotalSize = 0;
+  for (BasicBlock &BB : *F) {
+    TotalSize += BB.size();
+    if (isSharedBlock(&BB)) {
+      // Values tracked in a shared block would be materialized once per
+      // partition, each time considering only some of its predecessors
+      for (Instruction &I : BB)
+        if (getCallTo(&I, ValueMaterializerPass::MarkerName) != nullptr)
+          return {};
+
+      Shared.insert(&BB);
+    } else {
+      Components.insert(&BB);
+    }
+  }
+
+  // Do not bother splitting functions that can be optimized quickly
+  size_t MinimumSize = std::max<size_t>(MinimumPartitionSize, 1);
+  size_t Count = TotalSize / MinimumSize;
+  if (Count < 2)
+    return {};
 
-    // Proceed only if all the results are valid
-    if (not AllValid)
+  for (BasicBlock &BB : *F) {
+    if (Shared.contains(&BB))
       continue;
 
-    // If it's supposed to be a PC, all of them have to be a PC
-    bool ShouldBePC = (TIT == TrackedInstructionType::WrittenInPC
-                       or TIT == TrackedInstructionType::StoredInMemory);
-    if (ShouldBePC and not AllPCs)
+    for (BasicBlock *Successor : successors(&BB))
+      if (not Shared.contains(Successor))
+        Components.unionSets(&BB, Successor);
+  }
+
+  // Collect the blocks of each component, in function order
+  DenseMap<BasicBlock *, unsigned> ComponentIndex;
+  std::vector<Partition> ComponentBlocks;
+  std::vector<size_t> ComponentSize;
+  for (BasicBlock &BB : *F) {
+    if (Shared.contains(&BB))
       continue;
 
-    // Register the resulting addresses
-    unsigned RegisteredAddresses = 0;
+    BasicBlock *Leader = Components.getLeaderValue(&BB);
+    auto [It, New] = ComponentIndex.try_emplace(Leader,
+                                                ComponentBlocks.size());
+    if (New) {
+      ComponentBlocks.emplace_back();
+      ComponentSize.push_back(0);
+    }
 
-    auto RegisterJT = [this, &RegisteredAddresses](MetaAddress Address,
-                                                   JTReason::Values Reason) {
-      bool IsNew = not JTM.hasJT(Address);
-      if (JTM.registerJT(Address, Reason) != nullptr and IsNew) {
-        ++RegisteredAddresses;
+    ComponentBlocks[It->second].push_back(&BB);
+    ComponentSize[It->second] += BB.size();
+  }
+
+  // Assign the components, largest first, to the smallest partition
+  std::vector<unsigned> Order(ComponentBlocks.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  llvm::stable_sort(Order, [&ComponentSize](unsigned LHS, unsigned RHS) {
+    return ComponentSize[LHS] > ComponentSize[RHS];
+  });
+
+  std::vector<Partition> Result(Count);
+  std::vector<size_t> PartitionSize(Count, 0);
+  for (unsigned Index : Order) {
+    auto It = std::min_element(PartitionSize.begin(), PartitionSize.end());
+    auto Smallest = It - PartitionSize.begin();
+    llvm::append_range(Result[Smallest], ComponentBlocks[Index]);
+    PartitionSize[Smallest] += ComponentSize[Index];
+  }
+
+  llvm::erase_if(Result, [](const Partition &P) { return P.empty(); });
+  if (Result.size() < 2)
+    return {};
+
+  return Result;
+}
+
+/// Serializes a module containing a copy of \p F holding only the shared
+/// blocks and \p Blocks, along with declarations of everything else \p F uses
+static SmallVector<char, 0>
+serializePartition(Function *F, const RootAnalyzer::Partition &Blocks) {
+  Module &M = *F->getParent();
+  LLVMContext &Context = M.getContext();
+
+  // Clone the definitions of F and of the constants it uses (e.g., the strings
+  // read by ValueMaterializerPass)
+  SmallPtrSet<const GlobalValue *, 16> ToClone;
+  ToClone.insert(F);
+  SmallPtrSet<const Constant *, 16> Visited;
+  SmallVector<const Constant *, 16> Worklist;
+  for (Instruction &I : instructions(F))
+    for (Value *Operand : I.operands())
+      if (auto *C = dyn_cast<Constant>(Operand))
+        Worklist.push_back(C);
+
+  while (not Worklist.empty()) {
+    const Constant *C = Worklist.pop_back_val();
+    if (not Visited.insert(C).second)
+      continue;
+
+    if (auto *GV = dyn_cast<GlobalVariable>(C)) {
+      if (GV->isConstant() and GV->hasInitializer()) {
+        ToClone.insert(GV);
+        Worklist.push_back(GV->getInitializer());
       }
-    };
+    } else if (not isa<GlobalValue>(C)) {
+      for (const Use &U : C->operands())
+        Worklist.push_back(cast<Constant>(U.get()));
+    }
+  }
 
-    switch (TIT) {
-    case TrackedInstructionType::WrittenInPC:
-      for (const MetaAddress &MA : Targets)
-        RegisterJT(MA, JTReason::PCStore);
-      WrittenInPCStatistics.push(RegisteredAddresses);
-      break;
+  ValueToValueMapTy VMap;
+  auto ShouldClone = [&ToClone](const GlobalValue *GV) {
+    return ToClone.contains(GV);
+  };
+  std::unique_ptr<Module> NewModule = CloneModule(M, VMap, ShouldClone);
 
-    case TrackedInstructionType::StoredInMemory:
-      for (const MetaAddress &MA : Targets)
-        RegisterJT(MA, JTReason::MemoryStore);
-      StoredInMemoryStatistics.push(RegisteredAddresses);
-      break;
+  // CloneModule does not preserve the metadata of the functions whose body
+  // has been dropped, but that's where FunctionTags live
+  for (Function &Original : M) {
+    if (Original.isDeclaration() or ToClone.contains(&Original))
+      continue;
 
-    case TrackedInstructionType::StoreTarget:
-    case TrackedInstructionType::LoadTarget:
-      for (const MetaAddress &MA : Targets)
-        if (JTM.markJT(MA, JTReason::LoadAddress))
-          ++RegisteredAddresses;
-      LoadAddressStatistics.push(RegisteredAddresses);
-      break;
+    auto *Declaration = cast<Function>(VMap.lookup(&Original));
+    SmallVector<std::pair<unsigned, MDNode *>, 2> MDs;
+    Original.getAllMetadata(MDs);
+    for (auto &[Kind, Node] : MDs)
+      if (Kind != LLVMContext::MD_dbg)
+        Declaration->setMetadata(Kind, MapMetadata(Node, VMap));
+  }
 
-    case TrackedInstructionType::Invalid:
-      revng_abort();
+  // Detach from the shared blocks all the blocks of the other partitions
+  auto *NewF = cast<Function>(VMap.lookup(F));
+  DenseSet<BasicBlock *> Kept;
+  for (BasicBlock *BB : Blocks)
+    Kept.insert(cast<BasicBlock>(VMap.lookup(BB)));
+
+  SmallVector<BasicBlock *, 16> SharedBlocks;
+  for (BasicBlock &BB : *NewF) {
+    if (isSharedBlock(&BB)) {
+      Kept.insert(&BB);
+      SharedBlocks.push_back(&BB);
+    }
+  }
+
+  BasicBlock *Unreachable = nullptr;
+  for (BasicBlock *BB : SharedBlocks) {
+    Instruction *Terminator = BB->getTerminator();
+    if (auto *Switch = dyn_cast<SwitchInst>(Terminator)) {
+      for (auto It = Switch->case_begin(); It != Switch->case_end();) {
+        if (Kept.contains(It->getCaseSuccessor()))
+          ++It;
+        else
+          It = Switch->removeCase(It);
+      }
     }
 
-    if (TIT == TrackedInstructionType::WrittenInPC) {
-      // This is a call to `exit_tb`, transfer the revng.avi metadata on the
-      // call as revng.targets for later processing
-      revng_assert(TV.I != nullptr);
-      TV.I->setMetadata("revng.targets", T);
-      DetectedEdgesStatistics.push(Targets.size());
-      revng_log(NewEdgesLog,
-                Targets.size() << " targets from " << getName(Call));
+    for (unsigned I = 0; I < Terminator->getNumSuccessors(); ++I) {
+      if (Kept.contains(Terminator->getSuccessor(I)))
+        continue;
+
+      if (Unreachable == nullptr) {
+        Unreachable = BasicBlock::Create(Context, "", NewF);
+        new UnreachableInst(Context, Unreachable);
+      }
+
+      Terminator->setSuccessor(I, Unreachable);
     }
   }
+
+  EliminateUnreachableBlocks(*NewF);
+
+  SmallVector<char, 0> Result;
+  raw_svector_ostream Stream(Result);
+  WriteBitcodeToFile(*NewModule, Stream);
+  return Result;
 }
 
-using JTM2 = RootAnalyzer;
+/// The results of the analysis of a partition, detached from the LLVMContext
+/// it has been analyzed in
+struct PartitionResults {
+  using MaterializedValue = std::pair<std::string, APInt>;
 
-void JTM2::collectValuesStoredIntoMemory(Function *F,
-                                         const Features &CommonFeatures) {
-  for (Instruction &I : llvm::instructions(F)) {
+  /// For each tracked value, its ID and the values materialized for it
+  std::vector<std::pair<uint32_t, std::vector<MaterializedValue>>> Values;
+
+  /// Constants stored into memory
+  std::vector<APInt> StoredIntoMemory;
+};
+
+/// Deserializes a partition produced by serializePartition in a new
+/// LLVMContext, optimizes it and collects the results
+static PartitionResults
+optimizePartition(ArrayRef<char> Bitcode,
+                  StringRef FunctionName,
+                  JumpTargetManager &JTM,
+                  std::mutex &JTMLock,
+                  const MetaAddress::Features &CommonFeatures) {
+  LLVMContext Context;
+  MemoryBufferRef Buffer(StringRef(Bitcode.data(), Bitcode.size()),
+                         FunctionName);
+  std::unique_ptr<Module> M = cantFail(parseBitcodeFile(Buffer, Context));
+  Function *F = M->getFunction(FunctionName);
+  revng_assert(F != nullptr);
+
+  StaticDataMemoryOracle MO(M->getDataLayout(), JTM, CommonFeatures, &JTMLock);
+  runOptimizationPipeline(*F, MO);
+
+  revng::verify(F);
+
+  PartitionResults Result;
+
+  QuickMetadata QMD(Context);
+  Function *Marker = ValueMaterializerPass::createMarker(M.get());
+  for (CallBase *Call : callersIn(Marker, F)) {
+    auto *T = dyn_cast_or_null<MDTuple>(Call->getMetadata("revng.avi"));
+    if (T == nullptr)
+      continue;
+
+    Value *LastArgument = Call->getArgOperand(Call->arg_size() - 1);
+    auto &[ID, Values] = Result.Values.emplace_back();
+    ID = getLimitedValue(LastArgument);
+    for (const MDOperand &Operand : T->operands()) {
+      auto *Tuple = QMD.extract<MDTuple *>(Operand.get());
+      auto SymbolName = QMD.extract<StringRef>(Tuple->getOperand(0).get());
+      auto *Value = QMD.extract<ConstantInt *>(Tuple->getOperand(1).get());
+      Values.emplace_back(SymbolName.str(), Value->getValue());
+    }
+  }
+
+  for (Instruction &I : instructions(F)) {
     if (auto *Store = dyn_cast<StoreInst>(&I)) {
-      auto *Pointer = Store->getPointerOperand();
       auto *Address = dyn_cast<ConstantInt>(Store->getValueOperand());
-      if (isMemory(Pointer) and Address != nullptr
-          and JTM.programCounterHandler()->isPCSizedType(Address->getType())) {
-        auto MA = MetaAddress::fromPC(Address->getLimitedValue(),
-                                      CommonFeatures);
-        if (MA.isValid()) {
-          JTM.registerJT(MA, JTReason::MemoryStore);
-        }
-      }
+      if (isMemory(Store->getPointerOperand()) and Address != nullptr)
+        Result.StoredIntoMemory.push_back(Address->getValue());
+    }
+  }
+
+  return Result;
+}
+
+void RootAnalyzer::optimizeInParallel(Function *OptimizedFunction,
+                                      ArrayRef<Partition> Partitions,
+                                      unsigned Jobs,
+                                      AnalysisRegistry &AR,
+                                      const Features &CommonFeatures) {
+  // LLVMContext is not thread-safe: each partition is optimized in its own
+  // context, hence serialize them all beforehand
+  std::vector<SmallVector<char, 0>> Bitcodes;
+  for (const Partition &Blocks : Partitions)
+    Bitcodes.push_back(serializePartition(OptimizedFunction, Blocks));
+
+  std::string FunctionName = OptimizedFunction->getName().str();
+  std::mutex JTMLock;
+  std::vector<PartitionResults> Results(Partitions.size());
+  {
+    ThreadPool Pool(hardware_concurrency(std::min<size_t>(Jobs,
+                                                          Partitions.size())));
+    for (size_t Index = 0; Index < Partitions.size(); ++Index) {
+      Pool.async([&, Index] {
+        Results[Index] = optimizePartition(Bitcodes[Index],
+                                           FunctionName,
+                                           JTM,
+                                           JTMLock,
+                                           CommonFeatures);
+      });
     }
+    Pool.wait();
+  }
+
+  // Harvest the results in order, so that they do not depend on scheduling
+  LLVMContext &Context = TheModule.getContext();
+  QuickMetadata QMD(Context);
+  for (PartitionResults &Result : Results) {
+    for (auto &[ID, Values] : Result.Values) {
+      std::vector<Metadata *> ValuesMD;
+      ValuesMD.reserve(Values.size());
+      for (auto &[SymbolName, Value] : Values)
+        ValuesMD.push_back(QMD.tuple({ QMD.get(SymbolName), QMD.get(Value) }));
+
+      harvestMaterializedValues(AR, ID, QMD.tuple(ValuesMD));
+    }
+
+    for (const APInt &Value : Result.StoredIntoMemory)
+      registerValueStoredIntoMemory(ConstantInt::get(Context, Value),
+                                    CommonFeatures);
   }
 }
 
@@ -838,17 +1207,44 @@ void RootAnalyzer::cloneOptimizeAndHarvest(Function *TheFunction) {
   for (CallBase *Call : ToErase)
     eraseFromParent(Call);
 
-  // Optimize the hell out of it and collect the possible values of indirect
-  // branches.
-  auto SCB = optimize(OptimizedFunction, CommonFeatures);
-
-  revng::verify(OptimizedFunction);
-
-  // Collect the results
-  collectMaterializedValues(AR);
-
-  // Collect pointer-sized values being stored in memory
-  collectValuesStoredIntoMemory(OptimizedFunction, CommonFeatures);
+  auto SCB = prepareForOptimization(OptimizedFunction);
+
+  unsigned Jobs = RootAnalyzerJobs;
+  if (Jobs == 0)
+    Jobs = hardware_concurrency().compute_thread_count();
+
+  // Loggers are not thread-safe: optimize one partition at a time if the ones
+  // used while materializing values are enabled
+  if (AVILogger.isEnabled() or ValueMaterializerLogger.isEnabled())
+    Jobs = 1;
+
+  auto Partitions = partitionTemporaryRoot(OptimizedFunction);
+  if (Partitions.size() > 1) {
+    // Optimize and collect the results of each partition, concurrently if
+    // multiple jobs are allowed
+    optimizeInParallel(OptimizedFunction,
+                       Partitions,
+                       Jobs,
+                       AR,
+                       CommonFeatures);
+  } else {
+    // The StaticDataMemoryOracle provide the contents of memory areas that
+    // are mapped statically (i.e., in segments). This is critical to capture,
+    // e.g., virtual tables
+    StaticDataMemoryOracle MO(TheModule.getDataLayout(), JTM, CommonFeatures);
+
+    // Optimize the hell out of it and collect the possible values of indirect
+    // branches.
+    runOptimizationPipeline(*OptimizedFunction, MO);
+
+    revng::verify(OptimizedFunction);
+
+    // Collect the results
+    collectMaterializedValues(AR);
+
+    // Collect pointer-sized values being stored in memory
+    collectValuesStoredIntoMemory(OptimizedFunction, CommonFeatures);
+  }
 
   // Drop the optimized function
   eraseFromParent(OptimizedFunction);
@@ -5,6 +5,7 @@
 //
 
 #include <unordered_set>
+#include <vector>
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/IRBuilder.h"
@@ -20,6 +21,9 @@ class AnalysisRegistry;
 class JumpTargetManager;
 
 class RootAnalyzer {
+public:
+  using Partition = std::vector<llvm::BasicBlock *>;
+
 private:
   using MetaAddressSet = std::unordered_set<MetaAddress>;
   using Features = MetaAddress::Features;
@@ -47,13 +51,25 @@ private:
   void promoteHelpersToIntrinsics(llvm::Function *OptimizedFunction,
                                   llvm::IRBuilder<> &Builder);
 
-  SummaryCallsBuilder optimize(llvm::Function *OptimizedFunction,
-                               const Features &CommonFeatures);
+  SummaryCallsBuilder prepareForOptimization(llvm::Function *OptimizedFunction);
+
+  void optimizeInParallel(llvm::Function *OptimizedFunction,
+                          llvm::ArrayRef<Partition> Partitions,
+                          unsigned Jobs,
+                          AnalysisRegistry &AR,
+                          const Features &CommonFeatures);
 
   GlobalToAllocaTy promoteCSVsToAlloca(llvm::Function *OptimizedFunction);
 
   void collectMaterializedValues(AnalysisRegistry &AR);
 
+  void harvestMaterializedValues(AnalysisRegistry &AR,
+                                 uint32_t ValueMaterializerID,
+                                 llvm::MDTuple *T);
+
   void collectValuesStoredIntoMemory(llvm::Function *F,
                                      const Features &CommonFeatures);
+
+  void registerValueStoredIntoMemory(llvm::ConstantInt *Address,
+                                     const Features &CommonFeatures);
 };
@@ -25,8 +25,9 @@ using SDMO = StaticDataMemoryOracle;
 
 SDMO::StaticDataMemoryOracle(const DataLayout &DL,
                              JumpTargetManager &JTM,
-                             const MetaAddress::Features &Features) :
-  JTM(JTM), Features(Features) {
+                             const MetaAddress::Features &Features,
+                             std::mutex *JTMLock) :
+  JTM(JTM), Features(Features), JTMLock(JTMLock) {
   // Read the value using the endianness of the destination architecture,
   // since, if there's a mismatch, in the stack we will also have a byteswap
   // instruction
@@ -36,6 +37,11 @@ SDMO::StaticDataMemoryOracle(const DataLayout &DL,
 MaterializedValue StaticDataMemoryOracle::load(uint64_t LoadAddress,
                                                unsigned LoadSize) {
   auto Address = MetaAddress::fromGeneric(LoadAddress, Features);
+  if (JTMLock != nullptr) {
+    std::lock_guard Guard(*JTMLock);
+    return JTM.readFromPointer(Address, LoadSize, IsLittleEndian);
+  }
+
   return JTM.readFromPointer(Address, LoadSize, IsLittleEndian);
 }
 
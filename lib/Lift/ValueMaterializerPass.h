@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <mutex>
+
 #include "llvm/IR/PassManager.h"
 
 #include "revng/BasicAnalyses/MaterializedValue.h"
@@ -21,11 +23,14 @@ private:
   JumpTargetManager &JTM;
   const MetaAddress::Features &Features;
   bool IsLittleEndian = false;
+  /// If not null, held while accessing JTM, which is not thread safe
+  std::mutex *JTMLock = nullptr;
 
 public:
   StaticDataMemoryOracle(const llvm::DataLayout &DL,
                          JumpTargetManager &JTM,
-                         const MetaAddress::Features &Features);
+                         const MetaAddress::Features &Features,
+                         std::mutex *JTMLock = nullptr);
   ~StaticDataMemoryOracle() final = default;
 
   MaterializedValue load(uint64_t LoadAddress, unsigned LoadSize) final;
@@ -6,6 +6,7 @@
 
 #include "revng/Model/Binary.h"
 #include "revng/Model/Importer/TypeCopier.h"
+#include "revng/Pipeline/Analysis.h"
 #include "revng/Pipeline/RegisterAnalysis.h"
 #include "revng/Pipes/ModelGlobal.h"
 #include "revng/Support/ResourceFinder.h"
@@ -45,6 +46,16 @@ public:
 public:
   std::vector<std::vector<pipeline::Kind *>> AcceptedKinds;
 
+  /// Only dynamic functions and the types of their prototypes are affected
+  pipeline::GlobalsAccess AccessedGlobals = {
+    .Read = { "model.yml/Architecture",
+              "model.yml/DefaultABI",
+              "model.yml/ImportedDynamicFunctions",
+              "model.yml/TypeDefinitions" },
+    .Written = { "model.yml/ImportedDynamicFunctions",
+                 "model.yml/TypeDefinitions" }
+  };
+
 public:
   llvm::Error run(pipeline::ExecutionContext &Context) {
     std::vector<std::unique_ptr<WellKnownModel>> WellKnownModels;
@@ -0,0 +1,629 @@
+/// \file ArtifactCache.cpp
+/// A cache of the targets produced by pipes, shared across pipelines.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <link.h>
+
+#include <mutex>
+#include <optional>
+#include <sstream>
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/ArtifactCache.h"
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Global.h"
+#include "revng/Pipeline/Pipe.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/YAMLTraits.h"
+
+using namespace llvm;
+using namespace pipeline;
+
+static Logger<> Log("artifact-cache");
+
+static cl::opt<std::string> ArtifactCachePath("artifact-cache",
+                                              cl::desc("Directory where the "
+                                                       "targets produced by "
+                                                       "pipes are cached, so "
+                                                       "that they can be "
+                                                       "reused across "
+                                                       "pipelines."),
+                                              cl::init(""));
+
+/// Maximum number of artifacts recorded for the same key, that is, for the
+/// same inputs but different values of the read fields of the globals
+static constexpr size_t MaxArtifactsPerKey = 16;
+
+namespace {
+
+class CachedReadPath {
+public:
+  std::string GlobalName;
+  std::string Path;
+  std::string Hash;
+
+  bool operator<(const CachedReadPath &Other) const {
+    const auto &Tied = std::tie(GlobalName, Path, Hash);
+    return Tied < std::tie(Other.GlobalName, Other.Path, Other.Hash);
+  }
+};
+
+class CachedArtifact {
+public:
+  std::string Name;
+  std::vector<CachedReadPath> ReadPaths;
+};
+
+using CacheIndex = std::vector<CachedArtifact>;
+
+} // namespace
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(CachedReadPath);
+LLVM_YAML_IS_SEQUENCE_VECTOR(CachedArtifact);
+
+namespace llvm {
+namespace yaml {
+
+template<>
+struct MappingTraits<CachedReadPath> {
+  static void mapping(IO &IO, CachedReadPath &Entry) {
+    IO.mapRequired("GlobalName", Entry.GlobalName);
+    IO.mapRequired("Path", Entry.Path);
+    IO.mapRequired("Hash", Entry.Hash);
+  }
+};
+
+template<>
+struct MappingTraits<CachedArtifact> {
+  static void mapping(IO &IO, CachedArtifact &Entry) {
+    IO.mapRequired("Name", Entry.Name);
+    IO.mapRequired("ReadPaths", Entry.ReadPaths);
+  }
+};
+
+} // namespace yaml
+} // namespace llvm
+
+/// Feeds \p Data to \p Hasher, prefixed by its size, so that the boundaries
+/// between the hashed components are not ambiguous
+static void update(SHA1 &Hasher, StringRef Data) {
+  Hasher.update(std::to_string(Data.size()) + ":");
+  Hasher.update(Data);
+}
+
+namespace {
+
+/// A stream feeding what is written to it to a SHA1, without storing it
+class HashingStream : public raw_ostream {
+private:
+  SHA1 &Hasher;
+  uint64_t Position = 0;
+
+public:
+  explicit HashingStream(SHA1 &Hasher) : Hasher(Hasher) {}
+  ~HashingStream() override { flush(); }
+
+private:
+  void write_impl(const char *Pointer, size_t Size) override {
+    Hasher.update(StringRef(Pointer, Size));
+    Position += Size;
+  }
+
+  uint64_t current_pos() const override { return Position; }
+};
+
+/// Exclusive access to the index and the artifacts of a key of the cache.
+///
+/// The lock file excludes other processes, while the mutex excludes other
+/// threads, since POSIX record locks are held per process.
+class KeyLock {
+private:
+  static inline std::mutex ThreadsLock;
+
+private:
+  std::unique_lock<std::mutex> Guard;
+  int FD = -1;
+
+public:
+  explicit KeyLock(StringRef LockPath) : Guard(ThreadsLock) {
+    using namespace llvm::sys::fs;
+    if (std::error_code Error = openFileForReadWrite(LockPath,
+                                                     FD,
+                                                     CD_OpenAlways,
+                                                     OF_None)) {
+      revng_log(Log, "Cannot open " << LockPath << ": " << Error.message());
+      FD = -1;
+      return;
+    }
+
+    if (std::error_code Error = lockFile(FD)) {
+      revng_log(Log, "Cannot lock " << LockPath << ": " << Error.message());
+      sys::Process::SafelyCloseFileDescriptor(FD);
+      FD = -1;
+    }
+  }
+
+  ~KeyLock() {
+    if (FD == -1)
+      return;
+
+    sys::fs::unlockFile(FD);
+    sys::Process::SafelyCloseFileDescriptor(FD);
+  }
+
+  KeyLock(const KeyLock &) = delete;
+  KeyLock &operator=(const KeyLock &) = delete;
+
+public:
+  bool isLocked() const { return FD != -1; }
+};
+
+} // namespace
+
+static std::string toHex(SHA1 &Hasher) {
+  auto Digest = Hasher.final();
+  return llvm::toHex(ArrayRef<uint8_t>(Digest), true);
+}
+
+/// Returns the GNU build ID of the object described by \p Info, if any
+static std::optional<StringRef> getGNUBuildID(const dl_phdr_info &Info) {
+  for (ElfW(Half) I = 0; I < Info.dlpi_phnum; ++I) {
+    const ElfW(Phdr) &Header = Info.dlpi_phdr[I];
+    if (Header.p_type != PT_NOTE)
+      continue;
+
+    const char *Cursor = reinterpret_cast<const char *>(Info.dlpi_addr
+                                                        + Header.p_vaddr);
+    const char *End = Cursor + Header.p_memsz;
+    while (Cursor + sizeof(ElfW(Nhdr)) <= End) {
+      const auto *Note = reinterpret_cast<const ElfW(Nhdr) *>(Cursor);
+      const char *Name = Cursor + sizeof(ElfW(Nhdr));
+      const char *Descriptor = Name + alignTo(Note->n_namesz, 4);
+      if (Note->n_type == NT_GNU_BUILD_ID and Note->n_namesz == 4
+          and StringRef(Name, 4) == StringRef("GNU", 4))
+        return StringRef(Descriptor, Note->n_descsz);
+
+      Cursor = Descriptor + alignTo(Note->n_descsz, 4);
+    }
+  }
+
+  return std::nullopt;
+}
+
+/// Returns an identifier of the build of the rev.ng libraries in use, so that
+/// artifacts produced by a different build are not reused
+static const std::string &getBuildID() {
+  static const std::string BuildID = []() {
+    std::map<std::string, std::string> IDs;
+    auto Collect = [](dl_phdr_info *Info, size_t, void *Data) -> int {
+      StringRef Path = Info->dlpi_name;
+      if (not sys::path::filename(Path).contains("revng"))
+        return 0;
+
+      auto &IDs = *static_cast<std::map<std::string, std::string> *>(Data);
+      if (std::optional<StringRef> ID = getGNUBuildID(*Info)) {
+        IDs[Path.str()] = ID->str();
+        return 0;
+      }
+
+      // Fall back to the size and the modification time of the library
+      sys::fs::file_status Status;
+      if (not sys::fs::status(Path, Status)) {
+        auto Time = Status.getLastModificationTime().time_since_epoch();
+        IDs[Path.str()] = std::to_string(Status.getSize()) + ":"
+                          + std::to_string(Time.count());
+      }
+      return 0;
+    };
+    dl_iterate_phdr(Collect, &IDs);
+
+    SHA1 Hasher;
+    for (const auto &[Path, ID] : IDs) {
+      update(Hasher, sys::path::filename(Path));
+      update(Hasher, ID);
+    }
+
+    std::string Result = toHex(Hasher);
+    revng_log(Log, "Build ID: " << Result);
+    return Result;
+  }();
+
+  return BuildID;
+}
+
+static std::string hashPath(const Global &Global, const TupleTreePath &Path) {
+  std::optional<uint64_t> Hash = Global.hashPath(Path);
+  return Hash.has_value() ? llvm::utohexstr(*Hash) : std::string();
+}
+
+/// Returns the paths recorded in \p Artifact grouped by global, if they still
+/// have the same hash in \p Context
+static std::optional<std::vector<std::pair<std::string, TupleTreePath>>>
+matchReadPaths(const Context &Context, const CachedArtifact &Artifact) {
+  std::vector<std::pair<std::string, TupleTreePath>> Result;
+  for (const CachedReadPath &ReadPath : Artifact.ReadPaths) {
+    auto MaybeGlobal = Context.getGlobals().get(ReadPath.GlobalName);
+    if (not MaybeGlobal) {
+      consumeError(MaybeGlobal.takeError());
+      return std::nullopt;
+    }
+
+    const Global &Global = **MaybeGlobal;
+    std::optional<TupleTreePath> Path = Global.deserializePath(ReadPath.Path);
+    if (not Path.has_value() or hashPath(Global, *Path) != ReadPath.Hash)
+      return std::nullopt;
+
+    Result.emplace_back(ReadPath.GlobalName, std::move(*Path));
+  }
+
+  return Result;
+}
+
+static std::string getLockPath(StringRef Directory, StringRef Key) {
+  SmallString<128> Result(Directory);
+  sys::path::append(Result, Key + ".lock");
+  return Result.str().str();
+}
+
+static std::optional<CacheIndex> readIndex(const revng::FilePath &Path) {
+  auto MaybeExists = Path.exists();
+  if (not MaybeExists) {
+    revng_log(Log, "Cannot access the index: " << consumeToString(MaybeExists));
+    return std::nullopt;
+  }
+
+  if (not *MaybeExists)
+    return CacheIndex();
+
+  auto MaybeFile = Path.getReadableFile();
+  if (not MaybeFile) {
+    revng_log(Log, "Cannot read the index: " << consumeToString(MaybeFile));
+    return std::nullopt;
+  }
+
+  auto MaybeIndex = ::fromString<CacheIndex>(MaybeFile->get()
+                                               ->buffer()
+                                               .getBuffer());
+  if (not MaybeIndex) {
+    revng_log(Log, "Cannot parse the index: " << consumeToString(MaybeIndex));
+    return std::nullopt;
+  }
+
+  return std::move(*MaybeIndex);
+}
+
+const ArtifactCache *ArtifactCache::fromCommandLine() {
+  if (ArtifactCachePath.empty())
+    return nullptr;
+
+  static std::optional<ArtifactCache> Cache = []() {
+    ArtifactCache Result(ArtifactCachePath);
+    if (llvm::Error Error = Result.Directory.create()) {
+      dbg << "Cannot use the artifact cache: "
+          << consumeToString(std::move(Error)) << "\n";
+      return std::optional<ArtifactCache>();
+    }
+
+    return std::optional<ArtifactCache>(std::move(Result));
+  }();
+
+  return Cache.has_value() ? &*Cache : nullptr;
+}
+
+ArtifactCache::KeysMap
+ArtifactCache::computeKeys(const Context &Context,
+                           const PipeWrapper &Pipe,
+                           const ContainerSet &Input,
+                           const ContainerToTargetsMap &Output) const {
+  // Everything that identifies what the pipe does, regardless of its inputs
+  std::stringstream Configuration;
+  Pipe.Pipe->dump(Configuration, 0);
+  for (const std::string &Value : Pipe.Pipe->getOptionsValues())
+    Configuration << Value << "\n";
+
+  // Enumerating a container is expensive, do it once for each one
+  std::map<std::string, TargetsList> Enumerated;
+
+  // Hashes of the inputs, since multiple targets often share the same ones
+  using MaybeHash = std::optional<std::string>;
+  std::map<std::string, MaybeHash> InputHashes;
+  auto HashInput = [&](StringRef Name,
+                       const TargetsList &Targets) -> MaybeHash {
+    if (not Input.contains(Name))
+      return std::string();
+
+    const ContainerBase &Container = Input.at(Name);
+    auto [Available, NotEnumerated] = Enumerated.try_emplace(Name.str());
+    if (NotEnumerated)
+      Available->second = Container.enumerate();
+
+    TargetsList ToHash;
+    for (const Target &Target : Targets)
+      if (Available->second.contains(Target))
+        ToHash.push_back(Target);
+
+    std::string Description = Name.str();
+    for (const Target &Target : ToHash)
+      Description += "\n" + Target.toString();
+
+    auto [It, New] = InputHashes.try_emplace(Description);
+    if (not New)
+      return It->second;
+
+    // Hash each target on its own, rather than serializing a filtered clone of
+    // the container
+    SHA1 Hasher;
+    for (const Target &Target : ToHash) {
+      update(Hasher, Target.toString());
+
+      uint64_t Size = 0;
+      {
+        HashingStream OS(Hasher);
+        if (llvm::Error Error = Container.extractOne(OS, Target)) {
+          revng_log(Log,
+                    "Cannot hash " << Target.toString() << " in "
+                                   << Name.str() << ": "
+                                   << consumeToString(std::move(Error)));
+          return std::nullopt;
+        }
+        Size = OS.tell();
+      }
+      update(Hasher, std::to_string(Size));
+    }
+
+    It->second = toHex(Hasher);
+    return It->second;
+  };
+
+  KeysMap Result;
+  for (const auto &[ContainerName, Targets] : Output) {
+    for (const Target &Target : Targets) {
+      ContainerToTargetsMap Single;
+      Single.add(ContainerName, Target);
+      PipeExecutionEntry Entry = Pipe.Pipe->getRequirements(Context, Single);
+
+      SHA1 Hasher;
+      update(Hasher, getBuildID());
+      update(Hasher, Pipe.Pipe->getName());
+      update(Hasher, Configuration.str());
+      update(Hasher, ContainerName);
+      update(Hasher, Target.toString());
+
+      // Do not rely on the iteration order of the StringMap
+      std::vector<std::string> InputNames;
+      for (StringRef Name : Entry.Input.keys())
+        InputNames.push_back(Name.str());
+      llvm::sort(InputNames);
+
+      bool Hashable = true;
+      for (const std::string &Name : InputNames) {
+        MaybeHash Hash = HashInput(Name, Entry.Input.at(Name));
+        if (not Hash.has_value()) {
+          Hashable = false;
+          break;
+        }
+
+        update(Hasher, Name);
+        update(Hasher, *Hash);
+      }
+
+      if (Hashable)
+        Result[TargetInContainer(Target, ContainerName.str())] = toHex(Hasher);
+    }
+  }
+
+  return Result;
+}
+
+ArtifactCache::FetchedMap
+ArtifactCache::fetch(const Context &Context,
+                     PipeWrapper &Pipe,
+                     const KeysMap &Keys,
+                     ContainerSet &Containers,
+                     ContainerToTargetsMap &ToProduce) const {
+  FetchedMap Result;
+  for (const auto &[Located, Key] : Keys) {
+    const Target &Target = Located.getTarget();
+    StringRef ContainerName = Located.getContainerName();
+
+    KeyLock Lock(getLockPath(LocalPath, Key));
+    if (not Lock.isLocked())
+      continue;
+
+    std::optional<CacheIndex> Index = readIndex(Directory.getFile(Key
+                                                                  + ".yml"));
+    if (not Index.has_value())
+      continue;
+
+    for (const CachedArtifact &Artifact : *Index) {
+      auto ReadPaths = matchReadPaths(Context, Artifact);
+      if (not ReadPaths.has_value())
+        continue;
+
+      auto MaybeFile = Directory.getFile(Artifact.Name).getReadableFile();
+      if (not MaybeFile) {
+        revng_log(Log,
+                  "Cannot read " << Artifact.Name << ": "
+                                 << consumeToString(MaybeFile));
+        continue;
+      }
+
+      const MemoryBuffer &Buffer = MaybeFile->get()->buffer();
+      std::unique_ptr<ContainerBase>
+        Content = Containers[ContainerName].cloneFiltered({});
+      if (llvm::Error Error = Content->deserialize(Buffer)) {
+        revng_log(Log,
+                  "Cannot deserialize " << Artifact.Name << ": "
+                                        << consumeToString(std::move(Error)));
+        continue;
+      }
+
+      if (not Content->enumerate().contains(Target)) {
+        revng_log(Log, Artifact.Name << " does not contain the target");
+        continue;
+      }
+
+      revng_log(Log,
+                "Reusing " << Target.toString() << " in "
+                           << ContainerName.str() << " from "
+                           << Artifact.Name);
+
+      for (const auto &[GlobalName, Path] : *ReadPaths)
+        Pipe.InvalidationMetadata.getPathCache(GlobalName).insert(Located,
+                                                                  Path);
+
+      std::unique_ptr<ContainerBase> &Fetched = Result[ContainerName];
+      if (Fetched == nullptr)
+        Fetched = std::move(Content);
+      else
+        Fetched->mergeBack(std::move(*Content));
+
+      ToProduce[ContainerName].erase_if([&Target](const class Target &T) {
+        return T == Target;
+      });
+      break;
+    }
+  }
+
+  return Result;
+}
+
+void ArtifactCache::store(const Context &Context,
+                          const PipeWrapper &Pipe,
+                          const KeysMap &Keys,
+                          const ContainerSet &Containers,
+                          const ContainerToTargetsMap &Produced) const {
+  std::map<TargetInContainer, std::vector<CachedReadPath>> ToStore;
+  for (const auto &[ContainerName, Targets] : Produced) {
+    for (const Target &Target : Targets) {
+      TargetInContainer Located(Target, ContainerName.str());
+      if (Keys.count(Located) != 0)
+        ToStore[Located] = {};
+    }
+  }
+
+  if (ToStore.empty())
+    return;
+
+  // Collect the paths read to produce each target
+  for (const auto &[GlobalName, Bimap] :
+       Pipe.InvalidationMetadata.getPathCache()) {
+    const Global *Global = cantFail(Context.getGlobals().get(GlobalName));
+    for (const auto &[Path, Targets] : Bimap) {
+      std::optional<CachedReadPath> ReadPath;
+      for (const TargetInContainer &Located : Targets) {
+        auto It = ToStore.find(Located);
+        if (It == ToStore.end())
+          continue;
+
+        if (not ReadPath.has_value()) {
+          std::optional<std::string> Serialized = Global->serializePath(Path);
+          revng_check(Serialized.has_value());
+          ReadPath = CachedReadPath{ GlobalName.str(),
+                                     *Serialized,
+                                     hashPath(*Global, Path) };
+        }
+
+        It->second.push_back(*ReadPath);
+      }
+    }
+  }
+
+  for (auto &[Located, ReadPaths] : ToStore) {
+    const std::string &Key = Keys.at(Located);
+    llvm::sort(ReadPaths);
+
+    CachedArtifact Artifact;
+    Artifact.ReadPaths = std::move(ReadPaths);
+
+    SHA1 Hasher;
+    for (const CachedReadPath &ReadPath : Artifact.ReadPaths) {
+      update(Hasher, ReadPath.GlobalName);
+      update(Hasher, ReadPath.Path);
+      update(Hasher, ReadPath.Hash);
+    }
+    Artifact.Name = Key + "-" + toHex(Hasher);
+
+    // Hold the lock until the index is written, so that concurrent updates
+    // are not lost
+    KeyLock Lock(getLockPath(LocalPath, Key));
+    if (not Lock.isLocked())
+      continue;
+
+    revng::FilePath IndexPath = Directory.getFile(Key + ".yml");
+    std::optional<CacheIndex> Index = readIndex(IndexPath);
+    if (not Index.has_value())
+      continue;
+
+    auto HasSameName = [&Artifact](const CachedArtifact &Other) {
+      return Other.Name == Artifact.Name;
+    };
+    if (llvm::any_of(*Index, HasSameName))
+      continue;
+
+    // Store the artifact first, so that the index never refers to missing
+    // artifacts
+    const ContainerBase &Container = Containers.at(Located.getContainerName());
+    auto Clone = Container.cloneFiltered(TargetsList({ Located.getTarget() }));
+    auto File = Directory.getFile(Artifact.Name).getWritableFile();
+    if (not File) {
+      revng_log(Log, "Cannot write the artifact: " << consumeToString(File));
+      continue;
+    }
+
+    if (auto Error = Clone->serialize(File->get()->os())) {
+      revng_log(Log,
+                "Cannot serialize the artifact: "
+                  << consumeToString(std::move(Error)));
+      continue;
+    }
+
+    if (auto Error = File->get()->commit()) {
+      revng_log(Log,
+                "Cannot write the artifact: "
+                  << consumeToString(std::move(Error)));
+      continue;
+    }
+
+    Index->push_back(std::move(Artifact));
+    std::vector<std::string> Evicted;
+    while (Index->size() > MaxArtifactsPerKey) {
+      Evicted.push_back(std::move(Index->front().Name));
+      Index->erase(Index->begin());
+    }
+
+    auto IndexFile = IndexPath.getWritableFile();
+    if (not IndexFile) {
+      revng_log(Log, "Cannot write the index: " << consumeToString(IndexFile));
+      continue;
+    }
+
+    ::serialize(IndexFile->get()->os(), *Index);
+    if (auto Error = IndexFile->get()->commit()) {
+      revng_log(Log,
+                "Cannot write the index: "
+                  << consumeToString(std::move(Error)));
+      continue;
+    }
+
+    // Remove the evicted artifacts only now that the index does not refer to
+    // them anymore
+    for (const std::string &Name : Evicted) {
+      if (auto Error = Directory.getFile(Name).remove()) {
+        revng_log(Log,
+                  "Cannot remove " << Name << ": "
+                                   << consumeToString(std::move(Error)));
+      }
+    }
+  }
+}
@@ -11,24 +11,49 @@
 
 #include "revng/Pipeline/ContainerSet.h"
 #include "revng/Pipeline/Errors.h"
+#include "revng/Pipeline/Profiler.h"
+#include "revng/Support/Debug.h"
 
 using namespace pipeline;
 using namespace llvm;
 using namespace std;
 
-ContainerSet ContainerSet::cloneFiltered(const ContainerToTargetsMap &Targets) {
+static Logger<> Log("container-set");
+
+ContainerSet ContainerSet::cloneFiltered(const ContainerToTargetsMap &Targets,
+                                         bool CloneUnrequested) {
   ContainerSet ToReturn;
   for (const auto &Pair : Content) {
     const auto &ContainerName = Pair.first();
     const auto &Container = Pair.second;
 
-    auto ExtractedNames = Targets.contains(ContainerName) ?
-                            Targets.at(ContainerName) :
-                            TargetsList();
+    bool IsRequested = Targets.contains(ContainerName);
+    auto ExtractedNames = IsRequested ? Targets.at(ContainerName) :
+                                        TargetsList();
+
+    // Containers that have not been deserialized yet are left out unless some
+    // of their targets are actually requested
+    if (isPending(ContainerName)) {
+      if (ExtractedNames.empty()) {
+        ToReturn.add(ContainerName, *Factories[ContainerName]);
+        continue;
+      }
+
+      auto Partial = tryLoadPendingFiltered(ContainerName, ExtractedNames);
+      if (Partial != nullptr) {
+        ToReturn.add(ContainerName,
+                     *Factories[ContainerName],
+                     std::move(Partial));
+        continue;
+      }
+
+      materializeOrAbort(ContainerName);
+    }
 
-    auto Cloned = Container != nullptr ?
-                    Container->cloneFiltered(ExtractedNames) :
-                    nullptr;
+    bool ShouldClone = Container != nullptr
+                       and (CloneUnrequested or IsRequested);
+    auto Cloned = ShouldClone ? Container->cloneFiltered(ExtractedNames) :
+                                nullptr;
 
     ToReturn.add(ContainerName, *Factories[Pair.first()], std::move(Cloned));
   }
@@ -36,9 +61,67 @@ ContainerSet ContainerSet::cloneFiltered(const ContainerToTargetsMap &Targets) {
   return ToReturn;
 }
 
+std::unique_ptr<ContainerBase>
+ContainerSet::cloneFiltered(llvm::StringRef Name,
+                            const TargetsList &Targets) const {
+  if (isPending(Name)) {
+    auto Partial = tryLoadPendingFiltered(Name, Targets);
+    if (Partial != nullptr)
+      return Partial;
+  }
+
+  return at(Name).cloneFiltered(Targets);
+}
+
+llvm::Expected<std::unique_ptr<ContainerBase>>
+ContainerSet::loadPendingFiltered(llvm::StringRef Name,
+                                  const TargetsList &Targets) const {
+  // Targets that are not in the container are ignored, as in cloneFiltered,
+  // while loadFiltered requires all of them to be in the file
+  std::optional<revng::FilePath> File;
+  TargetsList Existing;
+  {
+    std::lock_guard Lock(PendingMutex);
+    auto It = Pending.find(Name);
+    if (It == Pending.end())
+      return nullptr;
+    File = It->second.File;
+    for (const Target &Target : Targets)
+      if (It->second.Enumeration.contains(Target))
+        Existing.push_back(Target);
+  }
+
+  auto Result = (*Factories.find(Name)->second)(Name);
+  auto MaybeLoaded = Result->loadFiltered(*File, Existing);
+  if (not MaybeLoaded)
+    return MaybeLoaded.takeError();
+
+  if (not *MaybeLoaded)
+    return nullptr;
+
+  return Result;
+}
+
+std::unique_ptr<ContainerBase>
+ContainerSet::tryLoadPendingFiltered(llvm::StringRef Name,
+                                     const TargetsList &Targets) const {
+  auto MaybePartial = loadPendingFiltered(Name, Targets);
+  if (not MaybePartial) {
+    // Loading the whole file reports the error again, if it is not specific to
+    // partial loading
+    revng_log(Log,
+              "Cannot partially load " << Name.str() << ", loading it all: "
+                                       << consumeToString(MaybePartial));
+    return nullptr;
+  }
+
+  return std::move(*MaybePartial);
+}
+
 bool ContainerSet::contains(const Target &Target) const {
-  return llvm::any_of(Content, [&Target](const auto &Container) {
-    return Container.second->enumerate().contains(Target);
+  return llvm::any_of(Content, [this, &Target](const auto &Container) {
+    return contains(Container.first())
+           and enumerate(Container.first()).contains(Target);
   });
 }
 
@@ -68,8 +151,7 @@ void ContainerSet::intersect(ContainerToTargetsMap &ToIntersect) const {
       continue;
     }
 
-    const auto &Container = at(ContainerName);
-    auto Enumerated = Container.enumerate();
+    auto Enumerated = enumerate(ContainerName);
     erase_if(Names, [&Enumerated](const Target &Target) {
       return not Enumerated.contains(Target);
     });
@@ -79,6 +161,38 @@ void ContainerSet::intersect(ContainerToTargetsMap &ToIntersect) const {
 llvm::Error ContainerSet::store(const revng::DirectoryPath &Directory) const {
   for (const auto &Pair : Content) {
     revng::FilePath Filename = Directory.getFile(Pair.first());
+
+    // Containers that have not been deserialized yet did not change since they
+    // have been loaded: copy their files, if they are stored elsewhere
+    std::optional<revng::FilePath> Source;
+    {
+      std::lock_guard Lock(PendingMutex);
+      if (auto It = Pending.find(Pair.first()); It != Pending.end())
+        Source = It->second.File;
+    }
+
+    if (Source.has_value()) {
+      if (*Source == Filename)
+        continue;
+
+      const ContainerFactory &Factory = *Factories.find(Pair.first())->second;
+      auto Sources = Factory.getWrittenFiles(*Source);
+      auto Destinations = Factory.getWrittenFiles(Filename);
+      revng_assert(Sources.size() == Destinations.size());
+      for (size_t I = 0; I < Sources.size(); ++I) {
+        auto MaybeExists = Sources[I].exists();
+        if (not MaybeExists)
+          return MaybeExists.takeError();
+
+        if (not MaybeExists.get())
+          continue;
+
+        if (auto Error = Sources[I].copyTo(Destinations[I]))
+          return Error;
+      }
+      continue;
+    }
+
     const auto &Container = Pair.second;
     if (Container == nullptr)
       continue;
@@ -90,21 +204,54 @@ llvm::Error ContainerSet::store(const revng::DirectoryPath &Directory) const {
 }
 
 llvm::Error ContainerSet::load(const revng::DirectoryPath &Directory) {
-  for (auto &Pair : Content) {
-    revng::FilePath Filename = Directory.getFile(Pair.first());
-    auto MaybeExists = Filename.exists();
-    if (!MaybeExists)
-      return MaybeExists.takeError();
+  for (auto &Pair : Content)
+    if (auto Error = load(Directory, Pair.first()))
+      return Error;
 
-    if (not MaybeExists.get()) {
-      Pair.second = nullptr;
-      continue;
-    }
+  return Error::success();
+}
 
-    if (auto Error = (*this)[Pair.first()].load(Filename); !!Error)
-      return Error;
+llvm::Error ContainerSet::load(const revng::DirectoryPath &Directory,
+                               llvm::StringRef Name) {
+  revng_assert(containsOrCanCreate(Name));
+  Pending.erase(Name);
+
+  revng::FilePath Filename = Directory.getFile(Name);
+  auto MaybeExists = Filename.exists();
+  if (!MaybeExists)
+    return MaybeExists.takeError();
+
+  if (not MaybeExists.get()) {
+    Content[Name] = nullptr;
+    return Error::success();
   }
-  return Error::success();
+
+  return (*this)[Name].load(Filename);
+}
+
+void ContainerSet::loadLazily(llvm::StringRef Name,
+                              const revng::FilePath &File,
+                              TargetsList Enumeration) {
+  revng_assert(containsOrCanCreate(Name));
+  Content[Name] = nullptr;
+  Pending.erase(Name);
+  Pending.try_emplace(Name, PendingContainer{ File, std::move(Enumeration) });
+}
+
+llvm::Error ContainerSet::materialize(llvm::StringRef Name) const {
+  // The lock is held while loading, so that other threads accessing the
+  // container wait for it to be ready rather than loading it again
+  std::lock_guard Lock(PendingMutex);
+  auto It = Pending.find(Name);
+  if (It == Pending.end())
+    return Error::success();
+
+  revng::FilePath File = It->second.File;
+  Pending.erase(It);
+
+  auto &Container = Content.find(Name)->second;
+  Container = (*Factories.find(Name)->second)(Name);
+  return Container->load(File);
 }
 
 std::vector<revng::FilePath>
@@ -135,22 +282,38 @@ ContainerToTargetsMap ContainerSet::enumerate() const {
 
   for (const auto &Pair : *this) {
     const auto &Name = Pair.first();
-    const auto &MaybeCont = Pair.second;
-
-    if (MaybeCont != nullptr)
-      Status[Name] = MaybeCont->enumerate();
+    if (contains(Name))
+      Status[Name] = enumerate(Name);
   }
   return Status;
 }
 
+TargetsList ContainerSet::enumerate(llvm::StringRef Name) const {
+  const ContainerBase *Container = nullptr;
+  {
+    std::lock_guard Lock(PendingMutex);
+    if (auto It = Pending.find(Name); It != Pending.end())
+      return It->second.Enumeration;
+
+    Container = Content.find(Name)->second.get();
+  }
+
+  revng_assert(Container != nullptr);
+  return Container->enumerate();
+}
+
 llvm::Error ContainerBase::store(const revng::FilePath &Path) const {
+  Profiler::Scope Scope("serialize", name());
   auto MaybeWritableFile = Path.getWritableFile();
   if (not MaybeWritableFile) {
     return MaybeWritableFile.takeError();
   }
 
-  if (auto Error = serialize(MaybeWritableFile.get()->os()))
+  llvm::raw_ostream &OS = MaybeWritableFile.get()->os();
+  uint64_t StartOffset = OS.tell();
+  if (auto Error = serialize(OS))
     return Error;
+  Scope.addBytesWritten(OS.tell() - StartOffset);
 
   return MaybeWritableFile.get()->commit();
 }
@@ -170,6 +333,8 @@ llvm::Error ContainerBase::load(const revng::FilePath &Path) {
     return MaybeBuffer.takeError();
 
   auto &Buffer = MaybeBuffer.get();
+  Profiler::Scope Scope("deserialize", name());
+  Scope.addBytesRead(Buffer->buffer().getBufferSize());
   auto Error = deserialize(Buffer->buffer());
   return Error;
 }
@@ -5,12 +5,18 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <mutex>
+
 #include "revng/Pipeline/ExecutionContext.h"
 #include "revng/Pipeline/Step.h"
 #include "revng/Pipeline/Target.h"
 
 using namespace pipeline;
 
+/// Serializes the accesses to the tracking state of globals shared by steps
+/// running concurrently, see ExecutionContext::collectReadFields
+static std::mutex SharedGlobalsTrackingMutex;
+
 ExecutionContext::ExecutionContext(Context &Context,
                                    PipeWrapper *Pipe,
                                    const ContainerToTargetsMap
@@ -22,19 +28,40 @@ ExecutionContext::ExecutionContext(Context &Context,
   // pipe is null when execution a analysis. We could just provide a context to
   // analyses, for the sake of uniformity we pass a execution context to them
   // too.
-  if (RunningOnPipe)
+  if (not RunningOnPipe)
+    return;
+
+  // The globals might be shared with other threads, in which case only the
+  // reads of this thread are tracked
+  if (revng::DeferredReads *Reads = revng::SharedTrackingScope::reads())
+    Reads->clear();
+  else
     getContext().clearAndResume();
 }
 
+ExecutionContext::ExecutionContext(const ExecutionContext &Parent,
+                                   const ContainerToTargetsMap
+                                     &RequestedTargets) :
+  TheContext(Parent.TheContext),
+  Pipe(Parent.Pipe),
+  Requested(RequestedTargets),
+  RunningOnPipe(Parent.RunningOnPipe),
+  IsWorker(true) {
+  revng_assert(RunningOnPipe and not Parent.IsWorker);
+}
+
 pipeline::ExecutionContext::~ExecutionContext() {
-  if (RunningOnPipe)
+  // The tracking state belongs to the parent of a worker, and it is not touched
+  // at all while the globals are shared with other threads
+  if (RunningOnPipe and not IsWorker
+      and not revng::SharedTrackingScope::isActive())
     getContext().stopTracking();
 }
 
-void ExecutionContext::commit(const Target &Target,
-                              llvm::StringRef ContainerName) {
-  revng_assert(Pipe != nullptr);
-
+void ExecutionContext::recordTarget(const Target &Target,
+                                    llvm::StringRef ContainerName,
+                                    Profiler::Clock::time_point Start,
+                                    Profiler::Clock::time_point End) {
   revng_log(InvalidationLog,
             "Committing " << Target.toString() << " into "
                           << ContainerName.str());
@@ -43,9 +70,101 @@ void ExecutionContext::commit(const Target &Target,
   //       performance
   Committed.add(ContainerName.str(), Target);
 
-  TargetInContainer ToCollect(Target, ContainerName.str());
-  getContext().collectReadFields(ToCollect,
-                                 Pipe->InvalidationMetadata.getPathCache());
+  if (Profiler::isEnabled())
+    Profiler::recordTarget(Pipe->Pipe->getName(),
+                           ContainerName,
+                           Target.toString(),
+                           Start,
+                           End);
+}
+
+void ExecutionContext::notifyCommit(const Target &Target,
+                                    llvm::StringRef ContainerName) {
+  // Whatever the listener reads must not be accounted to the next target
+  if (OnCommit) {
+    getContext().pushReadFields();
+    OnCommit(Target, ContainerName);
+    getContext().popReadFields();
+  }
+}
+
+void ExecutionContext::commit(const Target &Target,
+                              llvm::StringRef ContainerName) {
+  revng_assert(Pipe != nullptr);
+
+  // Targets are assumed to be produced one after the other, hence each one is
+  // accounted the time elapsed since the previous commit
+  auto Now = Profiler::Clock::now();
+
+  // The parent commits the targets of a worker once the worker is done
+  if (IsWorker) {
+    Committed.add(ContainerName.str(), Target);
+    WorkerCommits.push_back({ Target,
+                              ContainerName.str(),
+                              WorkerReads.collect(),
+                              LastCommit,
+                              Now });
+    LastCommit = Now;
+    return;
+  }
+
+  recordTarget(Target, ContainerName, LastCommit, Now);
+  LastCommit = Now;
+
+  collectReadFields(TargetInContainer(Target, ContainerName.str()));
+
+  notifyCommit(Target, ContainerName);
+}
+
+void ExecutionContext::collectReadFields(const TargetInContainer &Target,
+                                         const revng::DeferredReads *Extra) {
+  auto &PathCache = Pipe->InvalidationMetadata.getPathCache();
+
+  revng::DeferredReads *Shared = revng::SharedTrackingScope::reads();
+  if (Shared == nullptr) {
+    if (Extra == nullptr) {
+      getContext().collectReadFields(Target, PathCache);
+    } else {
+      getContext().pushReadFields();
+      Extra->replay();
+      getContext().collectReadFields(Target, PathCache);
+      getContext().popReadFields();
+    }
+    return;
+  }
+
+  // The globals are shared with steps running concurrently, which only record
+  // what they read: replay what has been read by this thread on the tracking
+  // state of the globals, which is otherwise untouched
+  revng::DeferredReads Reads = Extra == nullptr ? Shared->collect() : *Shared;
+  std::lock_guard Lock(SharedGlobalsTrackingMutex);
+  revng::SuspendedTrackingScope Suspended;
+  getContext().clearAndResume();
+  Reads.replay();
+  if (Extra != nullptr)
+    Extra->replay();
+  getContext().collectReadFields(Target, PathCache);
+  getContext().stopTracking();
+}
+
+void ExecutionContext::join(ExecutionContext &&Worker) {
+  revng_assert(Pipe != nullptr and not IsWorker);
+  revng_assert(Worker.IsWorker and Worker.Pipe == Pipe);
+
+  for (WorkerCommit &Commit : Worker.WorkerCommits) {
+    const Target &Target = Commit.Committed;
+    recordTarget(Target, Commit.ContainerName, Commit.Start, Commit.End);
+
+    // Account what the worker read in addition to what has been read so far,
+    // as if the target had been produced here
+    collectReadFields(TargetInContainer(Target, Commit.ContainerName),
+                      &Commit.Reads);
+
+    notifyCommit(Target, Commit.ContainerName);
+  }
+
+  LastCommit = Profiler::Clock::now();
+  Worker.WorkerCommits.clear();
 }
 
 void ExecutionContext::commitUniqueTarget(llvm::StringRef ContainerName) {
@@ -0,0 +1,58 @@
+/// \file GlobalsAccess.cpp
+/// Declarations of the parts of the globals accessed by pipes and analyses.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/Pipeline/GlobalsAccess.h"
+
+using namespace pipeline;
+
+/// Returns true if \p Prefix is \p Path or one of its ancestors
+static bool isPrefixOf(llvm::StringRef Prefix, llvm::StringRef Path) {
+  if (not Path.startswith(Prefix))
+    return false;
+
+  return Path.size() == Prefix.size() or Path[Prefix.size()] == '/'
+         or Prefix.endswith("/");
+}
+
+static bool overlap(llvm::ArrayRef<std::string> LHS,
+                    llvm::ArrayRef<std::string> RHS) {
+  for (const std::string &Left : LHS)
+    for (const std::string &Right : RHS)
+      if (isPrefixOf(Left, Right) or isPrefixOf(Right, Left))
+        return true;
+
+  return false;
+}
+
+bool GlobalsAccess::isIndependentFrom(const GlobalsAccess &After) const {
+  // What is written first must not be observed by the second analysis, nor
+  // overwritten by it. What the second analysis writes is not observed by the
+  // first one either way.
+  return not overlap(Written, After.Read)
+         and not overlap(Written, After.Written);
+}
+
+bool GlobalsAccess::allowsWriting(llvm::StringRef Path) const {
+  return llvm::any_of(Written, [Path](const std::string &Prefix) {
+    return isPrefixOf(Prefix, Path);
+  });
+}
+
+std::vector<std::string> GlobalsAccess::getWrittenGlobals() const {
+  std::vector<std::string> Result;
+  for (const std::string &Entry : Written) {
+    std::string Name = llvm::StringRef(Entry).split('/').first.str();
+    if (not llvm::is_contained(Result, Name))
+      Result.push_back(std::move(Name));
+  }
+
+  return Result;
+}
@@ -7,20 +7,28 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
 #include <memory>
+#include <set>
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Linker/Linker.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/EndianStream.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 
@@ -34,6 +42,16 @@
 const char pipeline::LLVMContainer::ID = '0';
 using namespace pipeline;
 
+static llvm::cl::opt<bool> SplitBitcode("split-llvm-containers",
+                                        llvm::cl::desc("Store LLVM containers "
+                                                       "as a set of "
+                                                       "independent modules, "
+                                                       "one per function, so "
+                                                       "that single functions "
+                                                       "can be loaded on "
+                                                       "their own."),
+                                        llvm::cl::init(false));
+
 void pipeline::makeGlobalObjectsArray(llvm::Module &Module,
                                       llvm::StringRef GlobalArrayName) {
   auto *IntegerTy = llvm::IntegerType::get(Module.getContext(),
@@ -61,26 +79,16 @@ void pipeline::makeGlobalObjectsArray(llvm::Module &Module,
                            GlobalArrayName);
 }
 
-std::unique_ptr<ContainerBase>
-LLVMContainer::cloneFiltered(const TargetsList &Targets) const {
-  using InspectorT = LLVMKind;
-  auto ToClone = InspectorT::functions(Targets, *this->self());
-  auto ToClonedNotOwned = InspectorT::untrackedFunctions(*this->self());
-
-  const auto Filter = [&ToClone, &ToClonedNotOwned](const auto &GlobalSym) {
-    if (not llvm::isa<llvm::Function>(GlobalSym))
-      return true;
-
-    const auto &F = llvm::cast<llvm::Function>(GlobalSym);
-    return ToClone.contains(F) or ToClonedNotOwned.contains(F);
-  };
+using ShouldCloneT = llvm::function_ref<bool(const llvm::GlobalValue *)>;
 
+/// Clones \p Module, dropping the definitions rejected by \p ShouldClone but
+/// preserving the metadata attached to the functions
+static std::unique_ptr<llvm::Module> cloneModule(const llvm::Module &Module,
+                                                 ShouldCloneT ShouldClone) {
   llvm::ValueToValueMapTy Map;
+  auto Cloned = llvm::CloneModule(Module, Map, ShouldClone);
 
-  revng::verify(Module.get());
-  auto Cloned = llvm::CloneModule(*Module, Map, Filter);
-
-  for (auto &Function : Module->functions()) {
+  for (auto &Function : Module.functions()) {
     auto *Other = Cloned->getFunction(Function.getName());
     if (not Other)
       continue;
@@ -98,6 +106,224 @@ LLVMContainer::cloneFiltered(const TargetsList &Targets) const {
     }
   }
 
+  return Cloned;
+}
+
+/// Requests involving less than a module size over this ratio are served by
+/// cloneClosure and merged back by linkSmallModule
+static constexpr size_t SmallModuleRatio = 8;
+
+static bool isMuchSmaller(size_t Size, const llvm::Module &Module) {
+  return Size * SmallModuleRatio < Module.size() and Module.alias_empty()
+         and Module.ifunc_empty();
+}
+
+namespace {
+
+/// Creates in the destination module a declaration for each global value the
+/// cloned code refers to, the first time it is encountered, and records it so
+/// that its definition can be cloned later on.
+///
+/// \note Definitions are not cloned here since the ValueMapper is not
+///       reentrant.
+class ClosureMaterializer final : public llvm::ValueMaterializer {
+private:
+  llvm::Module &Destination;
+  llvm::ValueToValueMapTy &Map;
+  std::vector<const llvm::GlobalValue *> &Declared;
+
+public:
+  ClosureMaterializer(llvm::Module &Destination,
+                      llvm::ValueToValueMapTy &Map,
+                      std::vector<const llvm::GlobalValue *> &Declared) :
+    Destination(Destination), Map(Map), Declared(Declared) {}
+
+public:
+  llvm::Value *materialize(llvm::Value *V) final {
+    if (auto *Global = llvm::dyn_cast<llvm::GlobalValue>(V))
+      return declare(*Global);
+    return nullptr;
+  }
+
+  llvm::GlobalValue *declare(const llvm::GlobalValue &Global) {
+    using namespace llvm;
+    if (Value *Existing = Map.lookup(&Global))
+      return cast<GlobalValue>(Existing);
+
+    GlobalValue *Result = nullptr;
+    if (const auto *F = dyn_cast<Function>(&Global)) {
+      auto *NewF = Function::Create(F->getFunctionType(),
+                                    F->getLinkage(),
+                                    F->getAddressSpace(),
+                                    F->getName(),
+                                    &Destination);
+      NewF->copyAttributesFrom(F);
+      Result = NewF;
+    } else {
+      const auto *GV = cast<GlobalVariable>(&Global);
+      auto *NewGV = new GlobalVariable(Destination,
+                                       GV->getValueType(),
+                                       GV->isConstant(),
+                                       GV->getLinkage(),
+                                       nullptr,
+                                       GV->getName(),
+                                       nullptr,
+                                       GV->getThreadLocalMode(),
+                                       GV->getType()->getAddressSpace());
+      NewGV->copyAttributesFrom(GV);
+      Result = NewGV;
+    }
+
+    Map[&Global] = Result;
+    Declared.push_back(&Global);
+    return Result;
+  }
+};
+
+} // namespace
+
+static void copyComdat(llvm::GlobalObject &Destination,
+                       const llvm::GlobalObject &Source) {
+  const llvm::Comdat *SourceComdat = Source.getComdat();
+  if (SourceComdat == nullptr)
+    return;
+
+  llvm::Module &M = *Destination.getParent();
+  llvm::Comdat *NewComdat = M.getOrInsertComdat(SourceComdat->getName());
+  NewComdat->setSelectionKind(SourceComdat->getSelectionKind());
+  Destination.setComdat(NewComdat);
+}
+
+/// Clones \p Roots and all the global values they transitively refer to,
+/// dropping the definitions rejected by \p ShouldClone, as cloneModule does.
+///
+/// The cost is proportional to the size of what is cloned, as opposed to the
+/// size of \p Module. \p Module must not contain aliases or ifuncs.
+static std::unique_ptr<llvm::Module>
+cloneClosure(const llvm::Module &Module,
+             llvm::ArrayRef<const llvm::GlobalValue *> Roots,
+             ShouldCloneT ShouldClone) {
+  using namespace llvm;
+  revng_assert(Module.alias_empty() and Module.ifunc_empty());
+
+  auto Result = std::make_unique<llvm::Module>(Module.getModuleIdentifier(),
+                                               Module.getContext());
+  Result->setSourceFileName(Module.getSourceFileName());
+  Result->setDataLayout(Module.getDataLayout());
+  Result->setTargetTriple(Module.getTargetTriple());
+  Result->setModuleInlineAsm(Module.getModuleInlineAsm());
+
+  ValueToValueMapTy Map;
+  std::vector<const GlobalValue *> Declared;
+  ClosureMaterializer Materializer(*Result, Map, Declared);
+  auto Remap = [&](const MDNode *Node) {
+    return MapMetadata(Node, Map, RF_None, nullptr, &Materializer);
+  };
+
+  // Compile units are added by CloneFunctionInto, only if actually used
+  for (const NamedMDNode &Named : Module.named_metadata()) {
+    if (Named.getName() == "llvm.dbg.cu")
+      continue;
+
+    NamedMDNode *NewNamed = Result->getOrInsertNamedMetadata(Named.getName());
+    for (const MDNode *Operand : Named.operands())
+      NewNamed->addOperand(Remap(Operand));
+  }
+
+  for (const GlobalValue *Root : Roots)
+    Materializer.declare(*Root);
+
+  // Cloning a definition might declare further global values
+  for (size_t I = 0; I < Declared.size(); ++I) {
+    const GlobalValue *Global = Declared[I];
+    auto *New = cast<GlobalObject>(Map[Global]);
+    bool Define = not Global->isDeclaration() and ShouldClone(Global);
+    if (not Global->isDeclaration() and not Define)
+      New->setLinkage(GlobalValue::ExternalLinkage);
+
+    if (const auto *F = dyn_cast<Function>(Global)) {
+      auto *NewF = cast<Function>(New);
+      if (Define) {
+        auto NewArgument = NewF->arg_begin();
+        for (const Argument &OldArgument : F->args()) {
+          NewArgument->setName(OldArgument.getName());
+          Map[&OldArgument] = &*NewArgument++;
+        }
+
+        SmallVector<ReturnInst *, 8> Returns;
+        CloneFunctionInto(NewF,
+                          F,
+                          Map,
+                          CloneFunctionChangeType::DifferentModule,
+                          Returns,
+                          "",
+                          nullptr,
+                          nullptr,
+                          &Materializer);
+        copyComdat(*NewF, *F);
+      } else {
+        SmallVector<std::pair<unsigned, MDNode *>, 2> MDs;
+        F->getAllMetadata(MDs);
+        for (auto &[Kind, Node] : MDs) {
+          // The !dbg attachment from the function definition cannot be
+          // attached to its declaration.
+          if (isa<DISubprogram>(Node))
+            continue;
+
+          NewF->addMetadata(Kind, *Remap(Node));
+        }
+      }
+    } else {
+      const auto *GV = cast<GlobalVariable>(Global);
+      auto *NewGV = cast<GlobalVariable>(New);
+      SmallVector<std::pair<unsigned, MDNode *>, 1> MDs;
+      GV->getAllMetadata(MDs);
+      for (auto &[Kind, Node] : MDs)
+        NewGV->addMetadata(Kind, *Remap(Node));
+
+      if (Define) {
+        NewGV->setInitializer(MapValue(GV->getInitializer(),
+                                       Map,
+                                       RF_None,
+                                       nullptr,
+                                       &Materializer));
+        copyComdat(*NewGV, *GV);
+      }
+    }
+  }
+
+  return Result;
+}
+
+std::unique_ptr<ContainerBase>
+LLVMContainer::cloneFiltered(const TargetsList &Targets) const {
+  using InspectorT = LLVMKind;
+  auto ToClone = InspectorT::functions(Targets, *this->self());
+
+  // Untracked functions are always cloned
+  const auto Filter = [&ToClone](const llvm::GlobalValue *Global) {
+    const auto *F = llvm::dyn_cast<llvm::Function>(Global);
+    return F == nullptr or ToClone.contains(F) or not LLVMKind::hasOwner(*F);
+  };
+
+  revng::verify(Module.get());
+  if (not isMuchSmaller(ToClone.size(), *Module))
+    return std::make_unique<ThisType>(this->name(),
+                                      this->TheContext,
+                                      cloneModule(*Module, Filter));
+
+  // Clone only what the requested functions need, preserving the order of
+  // the original module. Global variables are all cloned, as cloneModule
+  // does, since pipes might look them up by name.
+  std::vector<const llvm::GlobalValue *> Roots;
+  for (const llvm::GlobalVariable &Global : Module->globals())
+    Roots.push_back(&Global);
+  for (const llvm::Function &F : Module->functions())
+    if (ToClone.contains(&F))
+      Roots.push_back(&F);
+
+  auto Cloned = cloneClosure(*Module, Roots, Filter);
+
   return std::make_unique<ThisType>(this->name(),
                                     this->TheContext,
                                     std::move(Cloned));
@@ -125,6 +351,109 @@ static void fixGlobals(llvm::Module &Module,
   }
 }
 
+/// Turns the definition of \p Global into a declaration
+static void dropDefinition(llvm::GlobalObject &Global) {
+  if (auto *F = llvm::dyn_cast<llvm::Function>(&Global)) {
+    F->deleteBody();
+  } else {
+    auto *GV = llvm::cast<llvm::GlobalVariable>(&Global);
+    GV->setInitializer(nullptr);
+    GV->setLinkage(llvm::GlobalValue::ExternalLinkage);
+  }
+  Global.setComdat(nullptr);
+}
+
+/// Links \p Source into \p Destination, giving precedence to the definitions
+/// in \p Source.
+///
+/// The result is the same of linking \p Destination into \p Source, as
+/// mergeBackImpl does in general, but only the symbols of \p Source are
+/// touched, which makes the cost proportional to its size.
+static void linkSmallModule(llvm::Module &Destination,
+                            std::unique_ptr<llvm::Module> Source,
+                            llvm::StringRef GlobalArrayName) {
+  using namespace llvm;
+  revng_assert(Destination.alias_empty() and Destination.ifunc_empty());
+
+  LinkageRestoreMap LinkageRestore;
+  for (GlobalObject &Global : Source->global_objects()) {
+    if (not Global.hasName())
+      continue;
+
+    GlobalValue *Named = Destination.getNamedValue(Global.getName());
+    auto *Existing = cast_or_null<GlobalObject>(Named);
+    if (Existing == nullptr)
+      continue;
+
+    if (not Global.isDeclaration() and not Existing->isDeclaration())
+      dropDefinition(*Existing);
+
+    // Make local definitions visible to the declarations in Source
+    if (Existing->hasLocalLinkage()) {
+      LinkageRestore[Existing->getName().str()] = Existing->getLinkage();
+      Existing->setLinkage(GlobalValue::ExternalLinkage);
+    }
+  }
+
+  // Symbols coming from Source are handled as in the general case
+  fixGlobals(*Source, LinkageRestore);
+  makeGlobalObjectsArray(*Source, GlobalArrayName);
+
+  if (auto *MD = Source->getNamedMetadata("llvm.ident"))
+    MD->eraseFromParent();
+  if (auto *MD = Source->getNamedMetadata("llvm.module.flags"))
+    MD->eraseFromParent();
+
+  if (Source->getDataLayout().isDefault())
+    Source->setDataLayout(Destination.getDataLayout());
+
+  if (Destination.getDataLayout().isDefault())
+    Destination.setDataLayout(Source->getDataLayout());
+
+  llvm::Linker TheLinker(Destination);
+  bool Failure = TheLinker.linkInModule(std::move(Source));
+  revng_assert(not Failure, "Linker failed");
+
+  for (const auto &[Name, Linkage] : LinkageRestore)
+    if (auto *Global = Destination.getNamedValue(Name))
+      cast<GlobalObject>(Global)->setLinkage(Linkage);
+}
+
+/// Collects the names of the functions that linking \p Source into
+/// \p Destination through linkSmallModule might leave duplicated or unused:
+/// those of \p Source and those used by the definitions it replaces
+static std::set<std::string>
+collectAffectedFunctions(const llvm::Module &Destination,
+                         const llvm::Module &Source) {
+  std::set<std::string> Result;
+  for (const llvm::Function &F : Source.functions()) {
+    if (not F.hasName())
+      continue;
+
+    Result.insert(F.getName().str());
+    if (F.isDeclaration())
+      continue;
+
+    const llvm::Function *Replaced = Destination.getFunction(F.getName());
+    if (Replaced == nullptr or Replaced->isDeclaration())
+      continue;
+
+    for (const llvm::Instruction &I : llvm::instructions(Replaced)) {
+      for (const llvm::Value *Operand : I.operands()) {
+        const llvm::Value *Stripped = Operand->stripPointerCasts();
+        if (const auto *Used = llvm::dyn_cast<llvm::Function>(Stripped))
+          Result.insert(Used->getName().str());
+      }
+    }
+  }
+
+  return Result;
+}
+
+/// The whole llvm.dbg.cu is pruned after merging a small module only once it
+/// has doubled since the last time, plus this number of compile units
+static constexpr size_t MinimumCompileUnitsGrowth = 64;
+
 void LLVMContainer::mergeBackImpl(ThisType &&OtherContainer) {
   llvm::Module *ToMerge = &OtherContainer.getModule();
   revng::verify(ToMerge);
@@ -137,68 +466,97 @@ void LLVMContainer::mergeBackImpl(ThisType &&OtherContainer) {
     ToMergeStatistics = ModuleStatistics::analyze(*ToMerge);
   }
 
-  auto BeforeEnumeration = this->enumerate();
-  auto ToMergeEnumeration = OtherContainer.enumerate();
+  std::string GlobalArray1 = "revng.AllSymbolsArrayLeft";
+  std::string GlobalArray2 = "revng.AllSymbolsArrayRight";
 
-  // We must ensure that merge(Module1, Module2).enumerate() ==
-  // merge(Module1.enumerate(), Module2.enumerate())
-  //
-  // So we enumerate now to have it later.
-  auto ExpectedEnumeration = BeforeEnumeration;
-  ExpectedEnumeration.merge(ToMergeEnumeration);
+  // Set when only a small module is linked in: the clean up below is then
+  // restricted to the functions it might have affected and to the ones it
+  // introduced, rather than going through the whole module
+  std::optional<std::set<std::string>> Affected;
+  std::vector<std::string> Introduced;
+
+  if (isMuchSmaller(ToMerge->size(), *Module) and ToMerge->alias_empty()
+      and ToMerge->ifunc_empty()) {
+    // Enumerating the whole module would defeat the purpose of linking only
+    // the smaller module: just check that the merged targets are there.
+    std::vector<std::string> MergedTargets;
+    for (const llvm::Function &F : ToMerge->functions()) {
+      if (not F.isDeclaration() and LLVMKind::hasOwner(F))
+        MergedTargets.push_back(F.getName().str());
+      if (F.hasName() and Module->getFunction(F.getName()) == nullptr)
+        Introduced.push_back(F.getName().str());
+    }
 
-  LinkageRestoreMap LinkageRestore;
+    Affected = collectAffectedFunctions(*Module, *ToMerge);
 
-  // All symbols internal and external symbols myst be transformed into weak
-  // symbols, so that when multiple with the same name exists, one is
-  // dropped.
-  fixGlobals(*ToMerge, LinkageRestore);
-  fixGlobals(*Module, LinkageRestore);
+    linkSmallModule(*Module, std::move(OtherContainer.Module), GlobalArray2);
 
-  // Make a global array of all global objects so that they don't get dropped
-  std::string GlobalArray1 = "revng.AllSymbolsArrayLeft";
-  makeGlobalObjectsArray(*Module, GlobalArray1);
+    for (const std::string &Name : MergedTargets) {
+      const llvm::Function *F = Module->getFunction(Name);
+      revng_assert(F != nullptr and not F->isDeclaration()
+                   and LLVMKind::hasOwner(*F));
+    }
+  } else {
+    auto BeforeEnumeration = this->enumerate();
+    auto ToMergeEnumeration = OtherContainer.enumerate();
 
-  std::string GlobalArray2 = "revng.AllSymbolsArrayRight";
-  makeGlobalObjectsArray(*ToMerge, GlobalArray2);
+    // We must ensure that merge(Module1, Module2).enumerate() ==
+    // merge(Module1.enumerate(), Module2.enumerate())
+    //
+    // So we enumerate now to have it later.
+    auto ExpectedEnumeration = BeforeEnumeration;
+    ExpectedEnumeration.merge(ToMergeEnumeration);
 
-  // Drop certain LLVM named metadata
-  auto DropNamedMetadata = [](llvm::Module *M, llvm::StringRef Name) {
-    if (auto *MD = M->getNamedMetadata(Name))
-      MD->eraseFromParent();
-  };
+    LinkageRestoreMap LinkageRestore;
 
-  // TODO: check it's identical to the existing one, if present in both
-  DropNamedMetadata(&*Module, "llvm.ident");
-  DropNamedMetadata(&*Module, "llvm.module.flags");
+    // All symbols internal and external symbols myst be transformed into weak
+    // symbols, so that when multiple with the same name exists, one is
+    // dropped.
+    fixGlobals(*ToMerge, LinkageRestore);
+    fixGlobals(*Module, LinkageRestore);
 
-  if (ToMerge->getDataLayout().isDefault())
-    ToMerge->setDataLayout(Module->getDataLayout());
+    // Make a global array of all global objects so that they don't get dropped
+    makeGlobalObjectsArray(*Module, GlobalArray1);
+    makeGlobalObjectsArray(*ToMerge, GlobalArray2);
 
-  if (Module->getDataLayout().isDefault())
-    Module->setDataLayout(ToMerge->getDataLayout());
+    // Drop certain LLVM named metadata
+    auto DropNamedMetadata = [](llvm::Module *M, llvm::StringRef Name) {
+      if (auto *MD = M->getNamedMetadata(Name))
+        MD->eraseFromParent();
+    };
 
-  llvm::Linker TheLinker(*ToMerge);
+    // TODO: check it's identical to the existing one, if present in both
+    DropNamedMetadata(&*Module, "llvm.ident");
+    DropNamedMetadata(&*Module, "llvm.module.flags");
 
-  // Actually link
-  bool Failure = TheLinker.linkInModule(std::move(Module));
+    if (ToMerge->getDataLayout().isDefault())
+      ToMerge->setDataLayout(Module->getDataLayout());
 
-  revng_assert(not Failure, "Linker failed");
+    if (Module->getDataLayout().isDefault())
+      Module->setDataLayout(ToMerge->getDataLayout());
 
-  // Restores the initial linkage for local functions
-  for (auto &Global : ToMerge->global_objects()) {
-    auto It = LinkageRestore.find(Global.getName().str());
-    if (It != LinkageRestore.end())
-      Global.setLinkage(It->second);
-  }
+    llvm::Linker TheLinker(*ToMerge);
+
+    // Actually link
+    bool Failure = TheLinker.linkInModule(std::move(Module));
 
-  Module = std::move(OtherContainer.Module);
+    revng_assert(not Failure, "Linker failed");
 
-  // Checks that module merging commutes w.r.t. enumeration, as specified in
-  // the first comment.
-  auto ActualEnumeration = this->enumerate();
-  revng_assert(ExpectedEnumeration.contains(ActualEnumeration));
-  revng_assert(ActualEnumeration.contains(ExpectedEnumeration));
+    // Restores the initial linkage for local functions
+    for (auto &Global : ToMerge->global_objects()) {
+      auto It = LinkageRestore.find(Global.getName().str());
+      if (It != LinkageRestore.end())
+        Global.setLinkage(It->second);
+    }
+
+    Module = std::move(OtherContainer.Module);
+
+    // Checks that module merging commutes w.r.t. enumeration, as specified in
+    // the first comment.
+    auto ActualEnumeration = this->enumerate();
+    revng_assert(ExpectedEnumeration.contains(ActualEnumeration));
+    revng_assert(ActualEnumeration.contains(ExpectedEnumeration));
+  }
 
   // Remove the global arrays since they are no longer needed.
   if (auto *Global = Module->getGlobalVariable(GlobalArray1))
@@ -226,41 +584,67 @@ void LLVMContainer::mergeBackImpl(ThisType &&OtherContainer) {
     }
   };
 
-  // Dedup based on UniquedByPrototype
-  {
-    using namespace llvm;
-    using Key = std::pair<FunctionTags::TagsSet, FunctionType *>;
+  // Functions introduced by linking a small module can only be duplicates of
+  // each other or of functions that were already there, hence only their keys
+  // are considered, if any
+  llvm::SmallVector<llvm::Function *, 8> IntroducedFunctions;
+  for (const std::string &Name : Introduced)
+    if (llvm::Function *F = Module->getFunction(Name))
+      IntroducedFunctions.push_back(F);
 
-    std::multimap<Key, Function *> Map;
-    for (Function &F : FunctionTags::UniquedByPrototype.functions(&*Module)) {
-      Key TheKey = { FunctionTags::TagsSet::from(&F), F.getFunctionType() };
-      Map.emplace(TheKey, &F);
-    }
+  auto Dedup = [&](const FunctionTags::Tag &Tag, auto GetKey) {
+    using namespace llvm;
+    using Key = decltype(GetKey(std::declval<Function &>()));
 
-    MarkDuplicates(Map);
-  }
+    std::set<Key> Keys;
+    if (Affected.has_value()) {
+      for (Function *F : IntroducedFunctions)
+        if (Tag.isTagOf(F))
+          Keys.insert(GetKey(*F));
 
-  // Dedup based on UniquedByMetadata
-  {
-    using namespace llvm;
-    using Key = std::pair<FunctionTags::TagsSet, MDNode *>;
+      if (Keys.empty())
+        return;
+    }
 
     std::multimap<Key, Function *> Map;
-    for (Function &F : FunctionTags::UniquedByMetadata.functions(&*Module)) {
-      MDNode *MD = F.getMetadata(FunctionTags::UniqueIDMDName);
-      revng_assert(MD->isUniqued());
-      Key TheKey = { FunctionTags::TagsSet::from(&F), MD };
-      Map.emplace(TheKey, &F);
+    for (Function &F : Tag.functions(&*Module)) {
+      Key TheKey = GetKey(F);
+      if (not Affected.has_value() or Keys.contains(TheKey))
+        Map.emplace(TheKey, &F);
     }
 
     MarkDuplicates(Map);
-  }
+  };
+
+  // Dedup based on UniquedByPrototype
+  Dedup(FunctionTags::UniquedByPrototype, [](llvm::Function &F) {
+    using Key = std::pair<FunctionTags::TagsSet, llvm::FunctionType *>;
+    return Key{ FunctionTags::TagsSet::from(&F), F.getFunctionType() };
+  });
+
+  // Dedup based on UniquedByMetadata
+  Dedup(FunctionTags::UniquedByMetadata, [](llvm::Function &F) {
+    using Key = std::pair<FunctionTags::TagsSet, llvm::MDNode *>;
+    llvm::MDNode *MD = F.getMetadata(FunctionTags::UniqueIDMDName);
+    revng_assert(MD->isUniqued());
+    return Key{ FunctionTags::TagsSet::from(&F), MD };
+  });
 
   // Purge all unused non-target functions
   // TODO: this should be transitive
-  for (llvm::Function &F : Module->functions())
+  auto PurgeIfUnused = [&ToErase](llvm::Function &F) {
     if (not FunctionTags::Isolated.isTagOf(&F) and F.use_empty())
       ToErase.insert(&F);
+  };
+
+  if (Affected.has_value()) {
+    for (const std::string &Name : *Affected)
+      if (llvm::Function *F = Module->getFunction(Name))
+        PurgeIfUnused(*F);
+  } else {
+    for (llvm::Function &F : Module->functions())
+      PurgeIfUnused(F);
+  }
 
   for (llvm::Function *F : ToErase)
     F->eraseFromParent();
@@ -271,10 +655,19 @@ void LLVMContainer::mergeBackImpl(ThisType &&OtherContainer) {
   //       ValueToValueMap used when we clone in a way that avoids cloning the
   //       metadata altogether. However, this would lead two distinct modules
   //       to share debug metadata, which are not always immutable.
+  // Pruning requires going through the whole module, hence, when linking a
+  // small module, it's done only once in a while.
   auto *NamedMDNode = Module->getOrInsertNamedMetadata("llvm.dbg.cu");
-  pruneDICompileUnits(*Module);
+  size_t Threshold = 2 * PrunedCompileUnits + MinimumCompileUnitsGrowth;
+  if (not Affected.has_value() or NamedMDNode->getNumOperands() > Threshold) {
+    pruneDICompileUnits(*Module);
+    NamedMDNode = Module->getNamedMetadata("llvm.dbg.cu");
+    PrunedCompileUnits = NamedMDNode ? NamedMDNode->getNumOperands() : 0;
+  } else if (NamedMDNode->getNumOperands() == 0) {
+    NamedMDNode->eraseFromParent();
+  }
 
-  revng::verify(ToMerge);
+  revng::verify(Module.get());
 
   if (ModuleStatisticsLogger.isEnabled()) {
     auto PostMergeStatistics = ModuleStatistics::analyze(*Module.get());
@@ -300,20 +693,154 @@ llvm::Error LLVMContainer::extractOne(llvm::raw_ostream &OS,
   return Module->serialize(OS);
 }
 
-llvm::Error LLVMContainer::serialize(llvm::raw_ostream &OS) const {
-  ZstdCompressedOstream CompressedOS(OS, 3);
-  llvm::WriteBitcodeToFile(getModule(), CompressedOS);
-  CompressedOS.flush();
-  return llvm::Error::success();
+//
+// Split bitcode
+//
+// Split bitcode files are laid out as follows:
+//
+//   Magic | Blob... | Index | IndexOffset | IndexEntries | Magic
+//
+// Each blob is an independently zstd-compressed bitcode module. There is a blob
+// for the module without the definitions of target functions (i.e., globals,
+// declarations and untracked functions) and one for each target function,
+// containing only its definition. The whole module is obtained by linking all
+// of them together. Each index entry is
+// composed by the size of the name (32 bits), the name, the offset of the blob
+// and its size (64 bits each). Function blobs are named after their targets.
+// All integers are little endian.
+//
+static constexpr llvm::StringLiteral SplitMagic = "RVNGSBC2";
+static constexpr llvm::StringLiteral GlobalsBlob = "globals";
+static constexpr size_t FooterSize = 2 * sizeof(uint64_t) + SplitMagic.size();
+
+namespace {
+
+struct BlobRange {
+  uint64_t Offset = 0;
+  uint64_t Size = 0;
+};
+
+} // namespace
+
+using SplitIndex = llvm::StringMap<BlobRange>;
+
+static bool isSplitBitcode(llvm::StringRef Data) {
+  return Data.size() >= SplitMagic.size() + FooterSize
+         and Data.startswith(SplitMagic) and Data.endswith(SplitMagic);
 }
 
-llvm::Error LLVMContainer::deserialize(const llvm::MemoryBuffer &Buffer) {
-  llvm::SmallVector<char> DecompressedData = zstdDecompress(Buffer.getBuffer());
+static void writeBlob(llvm::raw_ostream &OS, const llvm::Module &Module) {
+  llvm::SmallVector<char> Bitcode;
+  llvm::raw_svector_ostream BitcodeStream(Bitcode);
+  llvm::WriteBitcodeToFile(Module, BitcodeStream);
+  zstdCompress(OS, llvm::StringRef(Bitcode.data(), Bitcode.size()));
+}
+
+static void serializeSplit(llvm::raw_ostream &OS, const llvm::Module &Module) {
+  uint64_t Start = OS.tell();
+  auto CurrentOffset = [&]() -> uint64_t { return OS.tell() - Start; };
+
+  std::vector<std::pair<std::string, BlobRange>> Index;
+  auto Append = [&](const llvm::Module &ToWrite) -> BlobRange {
+    uint64_t BlobStart = CurrentOffset();
+    writeBlob(OS, ToWrite);
+    return { BlobStart, CurrentOffset() - BlobStart };
+  };
+
+  OS << SplitMagic;
+
+  auto IsNotTarget = [](const llvm::GlobalValue *Global) {
+    const auto *F = llvm::dyn_cast<llvm::Function>(Global);
+    return F == nullptr or not LLVMKind::hasOwner(*F);
+  };
+  Index.emplace_back(GlobalsBlob.str(), Append(*cloneModule(Module,
+                                                            IsNotTarget)));
+
+  for (const llvm::Function &F : Module.functions()) {
+    TargetsList Owners = LLVMKind::owners(F);
+    if (Owners.empty())
+      continue;
+
+    // Everything else is available from the globals blob, except for unnamed
+    // globals, which cannot be resolved by name when linking
+    auto OnlyF = [&F](const llvm::GlobalValue *Global) {
+      return Global == &F
+             or (not llvm::isa<llvm::Function>(Global)
+                 and not Global->hasName());
+    };
+    BlobRange Range;
+    if (Module.alias_empty() and Module.ifunc_empty())
+      Range = Append(*cloneClosure(Module, { &F }, OnlyF));
+    else
+      Range = Append(*cloneModule(Module, OnlyF));
+    for (const Target &Owner : Owners)
+      Index.emplace_back(Owner.toString(), Range);
+  }
+
+  using namespace llvm::support;
+  endian::Writer Writer(OS, little);
+  uint64_t IndexOffset = CurrentOffset();
+  for (const auto &[Name, Range] : Index) {
+    Writer.write<uint32_t>(Name.size());
+    OS << Name;
+    Writer.write<uint64_t>(Range.Offset);
+    Writer.write<uint64_t>(Range.Size);
+  }
+
+  Writer.write<uint64_t>(IndexOffset);
+  Writer.write<uint64_t>(Index.size());
+  OS << SplitMagic;
+}
+
+static llvm::Expected<SplitIndex> readSplitIndex(llvm::StringRef Data) {
+  using namespace llvm::support;
+  revng_assert(isSplitBitcode(Data));
+
+  auto Corrupted = [] { return revng::createError("Corrupted split bitcode"); };
+
+  const char *Footer = Data.end() - FooterSize;
+  auto IndexOffset = endian::read<uint64_t, little, unaligned>(Footer);
+  auto Entries = endian::read<uint64_t, little, unaligned>(Footer + 8);
+
+  uint64_t IndexEnd = Data.size() - FooterSize;
+  if (IndexOffset > IndexEnd)
+    return Corrupted();
+
+  SplitIndex Result;
+  llvm::StringRef Cursor = Data.slice(IndexOffset, IndexEnd);
+  for (uint64_t I = 0; I < Entries; ++I) {
+    if (Cursor.size() < sizeof(uint32_t))
+      return Corrupted();
+    auto NameSize = endian::read<uint32_t, little, unaligned>(Cursor.data());
+    Cursor = Cursor.drop_front(sizeof(uint32_t));
+
+    if (Cursor.size() < NameSize + 2 * sizeof(uint64_t))
+      return Corrupted();
+    llvm::StringRef Name = Cursor.take_front(NameSize);
+    Cursor = Cursor.drop_front(NameSize);
+
+    BlobRange Range;
+    Range.Offset = endian::read<uint64_t, little, unaligned>(Cursor.data());
+    Range.Size = endian::read<uint64_t, little, unaligned>(Cursor.data() + 8);
+    Cursor = Cursor.drop_front(2 * sizeof(uint64_t));
+
+    if (Range.Offset + Range.Size > IndexOffset)
+      return Corrupted();
+
+    Result[Name] = Range;
+  }
+
+  return Result;
+}
+
+static llvm::Expected<std::unique_ptr<llvm::Module>>
+parseModule(llvm::StringRef Compressed, llvm::LLVMContext &Context) {
+  llvm::SmallVector<char> DecompressedData = zstdDecompress(Compressed);
   llvm::MemoryBufferRef Ref{
     { DecompressedData.data(), DecompressedData.size() }, "input"
   };
 
-  auto MaybeModule = llvm::parseBitcodeFile(Ref, Module->getContext());
+  auto MaybeModule = llvm::parseBitcodeFile(Ref, Context);
   if (not MaybeModule) {
     return MaybeModule.takeError();
   }
@@ -327,7 +854,139 @@ llvm::Error LLVMContainer::deserialize(const llvm::MemoryBuffer &Buffer) {
     return revng::createError(ErrorMessage);
   }
 
+  return std::move(MaybeModule.get());
+}
+
+static llvm::Expected<std::unique_ptr<llvm::Module>>
+parseBlob(llvm::StringRef Data,
+          const SplitIndex &Index,
+          llvm::StringRef Name,
+          llvm::LLVMContext &Context) {
+  auto It = Index.find(Name);
+  if (It == Index.end())
+    return revng::createError("Split bitcode has no " + Name.str() + " blob");
+
+  return parseModule(Data.substr(It->second.Offset, It->second.Size), Context);
+}
+
+llvm::Error LLVMContainer::serialize(llvm::raw_ostream &OS) const {
+  if (SplitBitcode) {
+    serializeSplit(OS, getModule());
+    return llvm::Error::success();
+  }
+
+  ZstdCompressedOstream CompressedOS(OS, 3);
+  llvm::WriteBitcodeToFile(getModule(), CompressedOS);
+  CompressedOS.flush();
+  return llvm::Error::success();
+}
+
+llvm::Error LLVMContainer::deserialize(const llvm::MemoryBuffer &Buffer) {
+  llvm::StringRef Data = Buffer.getBuffer();
+  if (isSplitBitcode(Data))
+    return loadSplit(Data, nullptr);
+
+  auto MaybeModule = parseModule(Data, Module->getContext());
+  if (not MaybeModule)
+    return MaybeModule.takeError();
+
   Module = std::move(MaybeModule.get());
 
   return llvm::Error::success();
 }
+
+llvm::Expected<bool> LLVMContainer::loadFiltered(const revng::FilePath &Path,
+                                                 const TargetsList &Targets) {
+  auto MaybeBuffer = Path.getReadableFile();
+  if (not MaybeBuffer)
+    return MaybeBuffer.takeError();
+
+  llvm::StringRef Data = MaybeBuffer.get()->buffer().getBuffer();
+  if (not isSplitBitcode(Data))
+    return false;
+
+  if (auto Error = loadSplit(Data, &Targets))
+    return std::move(Error);
+
+  return true;
+}
+
+llvm::Error LLVMContainer::loadSplit(llvm::StringRef Data,
+                                     const TargetsList *Targets) {
+  auto MaybeIndex = readSplitIndex(Data);
+  if (not MaybeIndex)
+    return MaybeIndex.takeError();
+  const SplitIndex &Index = *MaybeIndex;
+
+  // Functions with multiple owners share their blob, collect each one once,
+  // in the order they appear in the file
+  std::map<uint64_t, BlobRange> Blobs;
+  if (Targets == nullptr) {
+    for (const auto &Entry : Index)
+      if (Entry.first() != GlobalsBlob)
+        Blobs[Entry.second.Offset] = Entry.second;
+  } else {
+    for (const Target &Target : *Targets) {
+      auto It = Index.find(Target.toString());
+      if (It == Index.end())
+        return revng::createError("Split bitcode has no blob for target "
+                                  + Target.toString());
+      Blobs[It->second.Offset] = It->second;
+    }
+  }
+
+  llvm::LLVMContext &Context = Module->getContext();
+  auto MaybeGlobals = parseBlob(Data, Index, GlobalsBlob, Context);
+  if (not MaybeGlobals)
+    return MaybeGlobals.takeError();
+  std::unique_ptr<llvm::Module> Result = std::move(*MaybeGlobals);
+
+  // Link all the blobs at once, rather than through mergeBack, which purges
+  // the untracked functions that are not used yet: the blob of the function
+  // using them might not have been linked yet, or might not be loaded at all.
+  LinkageRestoreMap LinkageRestore;
+  fixGlobals(*Result, LinkageRestore);
+
+  llvm::Linker TheLinker(*Result);
+  std::vector<std::string> GlobalArrays;
+  for (const BlobRange &Range : llvm::make_second_range(Blobs)) {
+    llvm::StringRef Blob = Data.substr(Range.Offset, Range.Size);
+    auto MaybeFunction = parseModule(Blob, Context);
+    if (not MaybeFunction)
+      return MaybeFunction.takeError();
+
+    std::unique_ptr<llvm::Module> Function = std::move(*MaybeFunction);
+    fixGlobals(*Function, LinkageRestore);
+
+    // Make sure the linker does not drop the definitions turned into
+    // linkonce_odr
+    GlobalArrays.push_back("revng.AllSymbolsArray"
+                           + std::to_string(GlobalArrays.size()));
+    makeGlobalObjectsArray(*Function, GlobalArrays.back());
+
+    if (auto *MD = Function->getNamedMetadata("llvm.ident"))
+      MD->eraseFromParent();
+    if (auto *MD = Function->getNamedMetadata("llvm.module.flags"))
+      MD->eraseFromParent();
+
+    if (TheLinker.linkInModule(std::move(Function)))
+      return revng::createError("Cannot link the blobs of split bitcode");
+  }
+
+  for (auto &Global : Result->global_objects()) {
+    auto It = LinkageRestore.find(Global.getName().str());
+    if (It != LinkageRestore.end())
+      Global.setLinkage(It->second);
+  }
+
+  for (const std::string &Name : GlobalArrays)
+    Result->getGlobalVariable(Name)->eraseFromParent();
+
+  // Each blob brings its own copy of the compile units
+  pruneDICompileUnits(*Result);
+
+  revng::verify(Result.get());
+
+  Module = std::move(Result);
+  return llvm::Error::success();
+}
@@ -187,8 +187,19 @@ Error Loader::parseContainerDeclaration(Runner &Pipeline,
                     "with name %s";
     return revng::createError(Message, Dec.Type.c_str());
   }
-  auto &Entry = It->second;
-  Pipeline.addContainerFactory(Dec.Name, Entry);
+  ContainerFactory Factory = It->second;
+  if (not Dec.Encoding.empty()) {
+    if (auto Error = Factory.setEncoding(Dec.Encoding)) {
+      auto *Message = "While parsing container declaration with Name %s of "
+                      "type %s: %s";
+      return revng::createError(Message,
+                                Dec.Name.c_str(),
+                                Dec.Type.c_str(),
+                                llvm::toString(std::move(Error)).c_str());
+    }
+  }
+
+  Pipeline.addContainerFactory(Dec.Name, std::move(Factory));
   if (not Dec.Role.empty())
     ReadOnlyNames[Dec.Name] = Dec.Role;
 
@@ -0,0 +1,280 @@
+/// \file Profiler.cpp
+/// Collection and export of the resources used to run the pipeline.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <sys/resource.h>
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Profiler.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/OnQuit.h"
+#include "revng/Support/YAMLTraits.h"
+
+using namespace llvm;
+using namespace pipeline;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+static cl::opt<std::string> TracePath("pipeline-trace",
+                                      cl::desc("Path where the Chrome trace "
+                                               "events of the execution of "
+                                               "the pipeline are emitted."),
+                                      cl::init(""));
+
+static cl::opt<std::string> ProfilePath("pipeline-profile",
+                                        cl::desc("Path where a YAML summary "
+                                                 "of the resources used by "
+                                                 "each step, pipe and target "
+                                                 "is emitted."),
+                                        cl::init(""));
+
+namespace {
+
+/// Aggregation of all the events sharing category, parent and name. Times are
+/// in microseconds, sizes in bytes.
+class ProfileEntry {
+public:
+  std::string Category;
+  std::string Parent;
+  std::string Name;
+  uint64_t Count = 0;
+  uint64_t WallTime = 0;
+  uint64_t CPUTime = 0;
+  uint64_t PeakRSSDelta = 0;
+  uint64_t BytesRead = 0;
+  uint64_t BytesWritten = 0;
+};
+
+class ProfileSummary {
+public:
+  std::vector<ProfileEntry> Entries;
+};
+
+} // namespace
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(ProfileEntry);
+
+namespace llvm::yaml {
+
+template<>
+struct MappingTraits<ProfileEntry> {
+  static void mapping(IO &IO, ProfileEntry &Entry) {
+    IO.mapRequired("Category", Entry.Category);
+    IO.mapOptional("Parent", Entry.Parent, std::string());
+    IO.mapRequired("Name", Entry.Name);
+    IO.mapRequired("Count", Entry.Count);
+    IO.mapRequired("WallTime", Entry.WallTime);
+    IO.mapOptional("CPUTime", Entry.CPUTime, 0);
+    IO.mapOptional("PeakRSSDelta", Entry.PeakRSSDelta, 0);
+    IO.mapOptional("BytesRead", Entry.BytesRead, 0);
+    IO.mapOptional("BytesWritten", Entry.BytesWritten, 0);
+  }
+};
+
+template<>
+struct MappingTraits<ProfileSummary> {
+  static void mapping(IO &IO, ProfileSummary &Summary) {
+    IO.mapRequired("Entries", Summary.Entries);
+  }
+};
+
+} // namespace llvm::yaml
+
+/// Timestamps in the trace are relative to the start of the program
+static const Profiler::Clock::time_point Origin = Profiler::Clock::now();
+
+namespace {
+
+class EventsRegistry {
+private:
+  std::mutex Mutex;
+  std::vector<Profiler::Event> Events;
+
+public:
+  EventsRegistry() {
+    OnQuit->add([this] { emit(); });
+  }
+
+public:
+  void record(Profiler::Event &&ToRecord) {
+    std::lock_guard Lock(Mutex);
+    Events.push_back(std::move(ToRecord));
+  }
+
+private:
+  void emit() {
+    std::lock_guard Lock(Mutex);
+    if (not TracePath.empty())
+      writeTo(TracePath, [this](raw_ostream &OS) { emitTrace(OS); });
+    if (not ProfilePath.empty())
+      writeTo(ProfilePath, [this](raw_ostream &OS) { emitSummary(OS); });
+  }
+
+  template<typename CallableType>
+  static void writeTo(StringRef Path, CallableType &&Callable) {
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::OF_Text);
+    revng_check(not EC, ("Cannot write " + Path.str()).c_str());
+    Callable(OS);
+  }
+
+  void emitTrace(raw_ostream &OS) const {
+    auto ProcessID = sys::Process::getProcessId();
+    json::OStream JSON(OS);
+    JSON.object([&] {
+      JSON.attribute("displayTimeUnit", "ms");
+      JSON.attributeArray("traceEvents", [&] {
+        for (const Profiler::Event &Event : Events) {
+          JSON.object([&] {
+            JSON.attribute("name", Event.Name);
+            JSON.attribute("cat", Event.Category);
+            JSON.attribute("ph", "X");
+            auto Start = duration_cast<microseconds>(Event.Start - Origin);
+            JSON.attribute("ts", Start.count());
+            auto WallTime = duration_cast<microseconds>(Event.WallTime);
+            JSON.attribute("dur", WallTime.count());
+            JSON.attribute("pid", static_cast<int64_t>(ProcessID));
+            JSON.attribute("tid", static_cast<int64_t>(Event.ThreadID));
+            JSON.attributeObject("args", [&] {
+              if (not Event.Parent.empty())
+                JSON.attribute("parent", Event.Parent);
+              JSON.attribute("cpu_time_us", Event.CPUTime.count());
+              JSON.attribute("peak_rss_delta",
+                             static_cast<int64_t>(Event.PeakRSSDelta));
+              JSON.attribute("bytes_read",
+                             static_cast<int64_t>(Event.BytesRead));
+              JSON.attribute("bytes_written",
+                             static_cast<int64_t>(Event.BytesWritten));
+            });
+          });
+        }
+      });
+    });
+  }
+
+  void emitSummary(raw_ostream &OS) const {
+    using Key = std::tuple<std::string, std::string, std::string>;
+    std::map<Key, ProfileEntry> Aggregated;
+    for (const Profiler::Event &Event : Events) {
+      Key EventKey{ Event.Category, Event.Parent, Event.Name };
+      ProfileEntry &Entry = Aggregated[EventKey];
+      Entry.Category = Event.Category;
+      Entry.Parent = Event.Parent;
+      Entry.Name = Event.Name;
+      Entry.Count += 1;
+      Entry.WallTime += duration_cast<microseconds>(Event.WallTime).count();
+      Entry.CPUTime += Event.CPUTime.count();
+      Entry.PeakRSSDelta += Event.PeakRSSDelta;
+      Entry.BytesRead += Event.BytesRead;
+      Entry.BytesWritten += Event.BytesWritten;
+    }
+
+    ProfileSummary Summary;
+    for (auto &Pair : Aggregated)
+      Summary.Entries.push_back(std::move(Pair.second));
+
+    yaml::Output YAMLOutput(OS);
+    YAMLOutput << Summary;
+  }
+};
+
+} // namespace
+
+static ManagedStatic<EventsRegistry> Registry;
+
+/// The scopes active on the current thread, innermost last
+static thread_local std::vector<const Profiler::Scope *> ActiveScopes;
+
+/// Returns the CPU time used by the current thread, if supported, or by the
+/// process, and the peak RSS of the process, in bytes
+static std::pair<microseconds, uint64_t> getResourceUsage() {
+  struct rusage Usage;
+#ifdef RUSAGE_THREAD
+  // Scopes of concurrent threads must not account each other's CPU time
+  int Result = getrusage(RUSAGE_THREAD, &Usage);
+#else
+  int Result = getrusage(RUSAGE_SELF, &Usage);
+#endif
+  revng_check(Result == 0);
+
+  auto ToMicroseconds = [](const struct timeval &Time) {
+    return microseconds(Time.tv_sec * 1000000 + Time.tv_usec);
+  };
+  microseconds CPUTime = ToMicroseconds(Usage.ru_utime)
+                         + ToMicroseconds(Usage.ru_stime);
+
+  // On Linux ru_maxrss is expressed in kilobytes
+  return { CPUTime, static_cast<uint64_t>(Usage.ru_maxrss) * 1024 };
+}
+
+bool Profiler::isEnabled() {
+  return not TracePath.empty() or not ProfilePath.empty();
+}
+
+void Profiler::record(Event &&ToRecord) {
+  Registry->record(std::move(ToRecord));
+}
+
+void Profiler::recordTarget(StringRef Pipe,
+                            StringRef ContainerName,
+                            StringRef Target,
+                            Clock::time_point Start,
+                            Clock::time_point End) {
+  revng_assert(isEnabled());
+
+  Event ToRecord;
+  ToRecord.Category = "target";
+  ToRecord.Parent = Pipe.str();
+  ToRecord.Name = (ContainerName + "/" + Target).str();
+  ToRecord.ThreadID = get_threadid();
+  ToRecord.Start = Start;
+  ToRecord.WallTime = End - Start;
+  record(std::move(ToRecord));
+}
+
+Profiler::Scope::Scope(StringRef Category, StringRef Name) :
+  Enabled(isEnabled()) {
+  if (not Enabled)
+    return;
+
+  Recorded.Category = Category.str();
+  Recorded.Name = Name.str();
+  if (not ActiveScopes.empty())
+    Recorded.Parent = ActiveScopes.back()->name().str();
+  Recorded.ThreadID = get_threadid();
+
+  std::tie(StartCPUTime, StartPeakRSS) = getResourceUsage();
+  Recorded.Start = Clock::now();
+
+  ActiveScopes.push_back(this);
+}
+
+Profiler::Scope::~Scope() {
+  if (not Enabled)
+    return;
+
+  Recorded.WallTime = Clock::now() - Recorded.Start;
+  auto [CPUTime, PeakRSS] = getResourceUsage();
+  Recorded.CPUTime = CPUTime - StartCPUTime;
+  Recorded.PeakRSSDelta = PeakRSS - StartPeakRSS;
+
+  revng_assert(not ActiveScopes.empty() and ActiveScopes.back() == this);
+  ActiveScopes.pop_back();
+
+  record(std::move(Recorded));
+}
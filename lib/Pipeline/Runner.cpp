@@ -5,11 +5,19 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/Errors.h"
@@ -17,6 +25,7 @@
 #include "revng/Pipeline/Kind.h"
 #include "revng/Pipeline/Runner.h"
 #include "revng/Pipeline/Target.h"
+#include "revng/Support/AccessTracker.h"
 #include "revng/Support/Assert.h"
 #include "revng/TupleTree/TupleTreeReference.h"
 
@@ -24,6 +33,14 @@ using namespace std;
 using namespace llvm;
 using namespace pipeline;
 
+static cl::opt<unsigned> PipelineJobs("pipeline-jobs",
+                                      cl::desc("Number of threads to use to "
+                                               "run independent branches of "
+                                               "the pipeline and independent "
+                                               "analyses. 0 means one per "
+                                               "core."),
+                                      cl::init(1));
+
 class PipelineExecutionEntry {
 public:
   Step *ToExecute = nullptr;
@@ -68,6 +85,53 @@ static Error getObjectives(Runner &Runner,
   return Error::success();
 }
 
+/// Computes the steps that need to be executed in order to produce all the
+/// targets in \p ToProduce.
+///
+/// Steps are visited in post order, so that the requirements of all the
+/// successors of a step are merged before analyzing it: this way each step is
+/// executed at most once, even if it's shared by multiple requests.
+/// The result is in reverse post order, that is, a step always comes after its
+/// predecessor.
+static Error getObjectives(Runner &Runner,
+                           const Runner::State &ToProduce,
+                           std::vector<PipelineExecutionEntry> &ToExec) {
+  llvm::StringMap<ContainerToTargetsMap> Goals;
+  for (const auto &Request : ToProduce)
+    Goals[Request.first()].merge(Request.second);
+
+  std::vector<Step *> ReversePostOrder;
+  for (Step &CurrentStep : Runner)
+    ReversePostOrder.push_back(&CurrentStep);
+
+  for (Step *StepToAnalyze : llvm::reverse(ReversePostOrder)) {
+    Step &CurrentStep = *StepToAnalyze;
+    auto It = Goals.find(CurrentStep.getName());
+    if (It == Goals.end() or It->second.empty())
+      continue;
+
+    ContainerToTargetsMap Output = It->second;
+    auto [Required, PipesExecutionEntries] = CurrentStep.analyzeGoals(Output);
+
+    // Everything is already available, no need to run this step
+    if (Required.empty())
+      continue;
+
+    if (not CurrentStep.hasPredecessor())
+      return make_error<UnsatisfiableRequestError>(Output, Required);
+
+    Goals[CurrentStep.getPredecessor().getName()].merge(Required);
+    ToExec.emplace_back(CurrentStep,
+                        std::move(Output),
+                        std::move(Required),
+                        std::move(PipesExecutionEntries));
+  }
+
+  reverse(ToExec.begin(), ToExec.end());
+
+  return Error::success();
+}
+
 static void explainPipeline(const ContainerToTargetsMap &Targets,
                             ArrayRef<PipelineExecutionEntry> Requirements) {
   if (Requirements.empty())
@@ -136,11 +200,8 @@ Step &Runner::addStep(Step &&NewStep) {
 llvm::Error Runner::getInvalidations(const Target &Target,
                                      TargetInStepSet &Invalidations) const {
   for (const Step &Step : *this)
-    for (const auto &Container : Step.containers()) {
-      if (Container.second == nullptr)
-        continue;
-
-      if (Container.second->enumerate().contains(Target)) {
+    for (const auto &Container : Step.containers().enumerate()) {
+      if (Container.second.contains(Target)) {
         Invalidations[Step.getName()].add(Container.first(), Target);
       }
     }
@@ -236,13 +297,20 @@ Error Runner::load(const revng::DirectoryPath &DirPath) {
   if (auto Error = TheContext->load(ContextDir); !!Error)
     return Error;
 
+  TargetInStepSet Stale;
   for (auto &Step : Steps) {
     revng::DirectoryPath StepDir = DirPath.getDirectory(Step.first());
-    if (auto Error = Step.second.load(StepDir); !!Error)
+    if (auto Error = Step.second.load(StepDir, Stale[Step.first()]); !!Error)
       return Error;
   }
 
-  return Error::success();
+  // Drop the targets that have been produced reading parts of the globals
+  // that have been changed while the pipeline was not running, along with
+  // everything that has been produced from them
+  if (auto Error = getInvalidations(Stale))
+    return Error;
+
+  return invalidate(Stale);
 }
 
 std::vector<revng::FilePath>
@@ -302,6 +370,208 @@ Runner::runAnalysis(llvm::StringRef AnalysisName,
   return std::move(Map);
 }
 
+/// Returns the number of threads to use to run the pipeline
+static unsigned getJobs() {
+  unsigned Jobs = PipelineJobs;
+  if (Jobs == 0)
+    Jobs = llvm::hardware_concurrency().compute_thread_count();
+  return Jobs;
+}
+
+ContainerToTargetsMap
+Runner::getAnalysisTargets(const AnalysisReference &Ref) const {
+  const Step &Step = getStep(Ref.getStepName());
+  const AnalysisWrapper &Analysis = Step.getAnalysis(Ref.getAnalysisName());
+  ContainerToTargetsMap Map;
+  const std::vector<std::string>
+    &Containers = Analysis->getRunningContainersNames();
+  for (size_t I = 0; I < Containers.size(); I++) {
+    for (const Kind *K : Analysis->getAcceptedKinds(I)) {
+      Map.add(Containers[I], TargetsList::allTargets(getContext(), *K));
+    }
+  }
+
+  return Map;
+}
+
+llvm::Error
+Runner::runListedAnalysis(const AnalysisReference &Ref,
+                          TargetInStepSet &InvalidationsMap,
+                          const llvm::StringMap<std::string> &Options) {
+  TargetInStepSet NewInvalidationsMap;
+  auto Result = runAnalysis(Ref.getAnalysisName(),
+                            Ref.getStepName(),
+                            getAnalysisTargets(Ref),
+                            NewInvalidationsMap,
+                            Options);
+  if (not Result)
+    return Result.takeError();
+  for (auto &NewEntry : NewInvalidationsMap)
+    InvalidationsMap[NewEntry.first()].merge(NewEntry.second);
+
+  return llvm::Error::success();
+}
+
+using AnalysesWave = std::vector<const AnalysisReference *>;
+
+/// Splits \p List in sequences of consecutive analyses that can run
+/// concurrently, since they declare to access independent parts of the globals
+static std::vector<AnalysesWave> getWaves(const Runner &Runner,
+                                          const AnalysesList &List) {
+  bool Concurrent = getJobs() > 1 and not ExplanationLogger.isEnabled();
+
+  std::vector<AnalysesWave> Result;
+  std::vector<GlobalsAccess> WaveAccesses;
+  for (const AnalysisReference &Ref : List) {
+    const Step &Step = Runner.getStep(Ref.getStepName());
+    const AnalysisWrapper &Analysis = Step.getAnalysis(Ref.getAnalysisName());
+    std::optional<GlobalsAccess> Access = Analysis->getAccessedGlobals();
+
+    const auto IsIndependent = [&Access](const GlobalsAccess &Before) {
+      return Before.isIndependentFrom(*Access);
+    };
+    bool JoinsWave = Concurrent and Access.has_value()
+                     and not WaveAccesses.empty()
+                     and llvm::all_of(WaveAccesses, IsIndependent);
+    if (not JoinsWave) {
+      Result.emplace_back();
+      WaveAccesses.clear();
+    }
+
+    Result.back().push_back(&Ref);
+    if (Access.has_value())
+      WaveAccesses.push_back(std::move(*Access));
+  }
+
+  return Result;
+}
+
+/// Returns true if any of \p Targets of \p StepName is in \p Invalidations
+static bool isAffected(const TargetInStepSet &Invalidations,
+                       llvm::StringRef StepName,
+                       const ContainerToTargetsMap &Targets) {
+  auto StepIt = Invalidations.find(StepName);
+  if (StepIt == Invalidations.end())
+    return false;
+
+  for (const auto &Invalidated : StepIt->second) {
+    auto It = Targets.find(Invalidated.first());
+    if (It != Targets.end()
+        and not It->second.intersect(Invalidated.second).empty())
+      return true;
+  }
+
+  return false;
+}
+
+llvm::Error
+Runner::runAnalysesConcurrently(llvm::ArrayRef<const AnalysisReference *> Wave,
+                                TargetInStepSet &InvalidationsMap,
+                                const llvm::StringMap<std::string> &Options) {
+  const GlobalsMap Before = getContext().getGlobals();
+
+  // Producing the inputs changes the steps: do it upfront, sequentially
+  std::vector<ContainerToTargetsMap> Targets;
+  for (const AnalysisReference *Ref : Wave) {
+    Targets.push_back(getAnalysisTargets(*Ref));
+    if (llvm::Error Error = run(Ref->getStepName(), Targets.back()))
+      return Error;
+  }
+
+  // Each analysis changes its own copy of the globals
+  std::vector<ContainerSet> Inputs;
+  std::vector<std::unique_ptr<Context>> Contexts;
+  std::vector<bool> IsExclusive;
+  for (size_t I = 0; I < Wave.size(); ++I) {
+    const Step &Step = getStep(Wave[I]->getStepName());
+    Inputs.push_back(Step.cloneAnalysisInputs(Targets[I]));
+    Contexts.push_back(std::make_unique<Context>(*TheContext));
+    llvm::StringRef Name = Wave[I]->getAnalysisName();
+    IsExclusive.push_back(not Step.analysisUsesOnlyThreadSafeContainers(Name));
+  }
+
+  std::vector<std::optional<llvm::Error>> Results(Wave.size());
+  std::mutex ExclusiveAccessMutex;
+  llvm::ThreadPool Pool(llvm::hardware_concurrency(getJobs()));
+  for (size_t I = 0; I < Wave.size(); ++I) {
+    Pool.async([&, I]() {
+      Step &Step = getStep(Wave[I]->getStepName());
+      const auto Run = [&]() {
+        return Step.runAnalysis(*Contexts[I],
+                                Wave[I]->getAnalysisName(),
+                                Inputs[I],
+                                Options);
+      };
+
+      if (IsExclusive[I]) {
+        std::lock_guard Lock(ExclusiveAccessMutex);
+        Results[I].emplace(Run());
+      } else {
+        Results[I].emplace(Run());
+      }
+    });
+  }
+  Pool.wait();
+
+  llvm::Error Failures = llvm::Error::success();
+  for (std::optional<llvm::Error> &Result : Results)
+    Failures = llvm::joinErrors(std::move(Failures), std::move(*Result));
+  if (Failures)
+    return Failures;
+
+  // Apply the changes in list order, so that the outcome is deterministic. An
+  // analysis whose inputs have been changed by the ones preceding it is run
+  // again, as it would have been when running them one by one.
+  TargetInStepSet WaveInvalidations;
+  for (size_t I = 0; I < Wave.size(); ++I) {
+    const AnalysisReference &Ref = *Wave[I];
+    TargetInStepSet NewInvalidations;
+
+    if (isAffected(WaveInvalidations, Ref.getStepName(), Targets[I])
+        or getAnalysisTargets(Ref) != Targets[I]) {
+      if (llvm::Error Error = runListedAnalysis(Ref, NewInvalidations, Options))
+        return Error;
+    } else {
+      llvm::StringRef Name = Ref.getAnalysisName();
+      const Step &Step = getStep(Ref.getStepName());
+      GlobalsAccess Access = *Step.getAnalysis(Name)->getAccessedGlobals();
+
+      DiffMap Changes = Before.diff(Contexts[I]->getGlobals());
+      for (const auto &Entry : Changes) {
+        llvm::StringRef GlobalName = Entry.first();
+        const GlobalTupleTreeDiff &Diff = Entry.second;
+        if (Diff.isEmpty())
+          continue;
+
+        for (const TupleTreePath *Path : Diff.getPaths()) {
+          std::string Changed = GlobalName.str();
+          Changed += Diff.pathAsString(*Path).value_or("");
+          if (not Access.allowsWriting(Changed))
+            return revng::createError("Analysis %s changed %s, which it does "
+                                      "not declare to write",
+                                      Name.str().c_str(),
+                                      Changed.c_str());
+        }
+
+        auto MaybeGlobal = TheContext->getGlobals().get(GlobalName);
+        if (not MaybeGlobal)
+          return MaybeGlobal.takeError();
+        if (llvm::Error Error = (*MaybeGlobal)->applyDiff(Diff))
+          return Error;
+        if (llvm::Error Error = apply(Diff, NewInvalidations))
+          return Error;
+      }
+    }
+
+    for (auto &NewEntry : NewInvalidations) {
+      InvalidationsMap[NewEntry.first()].merge(NewEntry.second);
+      WaveInvalidations[NewEntry.first()].merge(NewEntry.second);
+    }
+  }
+
+  return llvm::Error::success();
+}
+
 /// Run all analysis in reverse post order (that is: parents first),
 llvm::Expected<DiffMap>
 Runner::runAnalyses(const AnalysesList &List,
@@ -309,30 +579,22 @@ Runner::runAnalyses(const AnalysesList &List,
                     const llvm::StringMap<std::string> &Options) {
   GlobalsMap Before = getContext().getGlobals();
 
-  Task T(List.size() + 1, "Analysis list " + List.getName());
-  for (const AnalysisReference &Ref : List) {
-    T.advance(Ref.getAnalysisName(), true);
-    const Step &Step = getStep(Ref.getStepName());
-    const AnalysisWrapper &Analysis = Step.getAnalysis(Ref.getAnalysisName());
-    ContainerToTargetsMap Map;
-    const std::vector<std::string>
-      &Containers = Analysis->getRunningContainersNames();
-    for (size_t I = 0; I < Containers.size(); I++) {
-      for (const Kind *K : Analysis->getAcceptedKinds(I)) {
-        Map.add(Containers[I], TargetsList::allTargets(getContext(), *K));
-      }
+  std::vector<AnalysesWave> Waves = getWaves(*this, List);
+  Task T(Waves.size() + 1, "Analysis list " + List.getName());
+  for (const AnalysesWave &Wave : Waves) {
+    if (Wave.size() == 1) {
+      T.advance(Wave.front()->getAnalysisName(), true);
+      if (llvm::Error Error = runListedAnalysis(*Wave.front(),
+                                                InvalidationsMap,
+                                                Options))
+        return std::move(Error);
+    } else {
+      T.advance("Run " + Twine(Wave.size()) + " analyses concurrently", true);
+      if (llvm::Error Error = runAnalysesConcurrently(Wave,
+                                                      InvalidationsMap,
+                                                      Options))
+        return std::move(Error);
     }
-
-    TargetInStepSet NewInvalidationsMap;
-    auto Result = runAnalysis(Ref.getAnalysisName(),
-                              Step.getName(),
-                              Map,
-                              NewInvalidationsMap,
-                              Options);
-    if (not Result)
-      return Result.takeError();
-    for (auto &NewEntry : NewInvalidationsMap)
-      InvalidationsMap[NewEntry.first()].merge(NewEntry.second);
   }
 
   T.advance("Computing analysis list diff", true);
@@ -340,14 +602,193 @@ Runner::runAnalyses(const AnalysesList &List,
   return Before.diff(After);
 }
 
+/// Clones the inputs of a step from its predecessor.
+///
+/// If \p CloneUnrequested is false, containers from which no target is
+/// required are not cloned from the predecessor.
+static ContainerSet cloneInputs(const PipelineExecutionEntry &Entry,
+                                bool CloneUnrequested = true) {
+  ::Step &Parent = Entry.ToExecute->getPredecessor();
+  return Parent.containers().cloneFiltered(Entry.Input, CloneUnrequested);
+}
+
+/// Runs a step on \p Inputs, cloned from its predecessor.
+static void runStep(PipelineExecutionEntry &Entry, ContainerSet &&Inputs) {
+  auto &[Step, PredictedOutput, Input, PipesInfo] = Entry;
+
+  Task T(2, "Run step");
+
+  // Run the step
+  T.advance("Run the step", true);
+  Step->run(std::move(Inputs), PipesInfo);
+
+  T.advance("Extract the requested targets", true);
+  if (VerifyLog.isEnabled()) {
+    ContainerSet Produced = Step->containers().cloneFiltered(PredictedOutput);
+
+    if (not Produced.enumerate().contains(PredictedOutput)) {
+      dbg << "PredictedOutput:\n";
+      PredictedOutput.dump(dbg, 2, false);
+      dbg << "Produced:\n";
+      Produced.enumerate().dump(dbg, 2, false);
+      revng_abort("Not all the expected targets have been produced");
+    }
+    revng_check(Step->containers().enumerate().contains(PredictedOutput));
+  }
+}
+
+/// Returns true if running \p Entry involves containers that cannot be used
+/// concurrently with the containers of other steps
+static bool requiresExclusiveAccess(const PipelineExecutionEntry &Entry) {
+  const Step &Step = *Entry.ToExecute;
+  const ContainerSet &Containers = Step.containers();
+
+  // Containers cloned from the predecessor
+  for (const auto &Pair : Entry.Input)
+    if (not Pair.second.empty() and not Containers.isThreadSafe(Pair.first()))
+      return true;
+
+  // Containers of the step, which are manipulated after the pipes have run
+  for (const auto &Pair : Containers)
+    if (Containers.contains(Pair.first())
+        and not Containers.isThreadSafe(Pair.first()))
+      return true;
+
+  return not Step.usesOnlyThreadSafeContainers();
+}
+
 Error Runner::run(const State &ToProduce) {
-  Task T(ToProduce.size(), "Multi-step pipeline run");
-  for (const auto &Request : ToProduce) {
-    T.advance(Request.first(), true);
-    if (llvm::Error Error = run(Request.first(), Request.second))
-      return Error;
+  vector<PipelineExecutionEntry> ToExec;
+  if (llvm::Error Error = getObjectives(*this, ToProduce, ToExec))
+    return Error;
+
+  for (PipelineExecutionEntry &Entry : ToExec) {
+    Step &Step = *Entry.ToExecute;
+    if (llvm::Error Error = Step.checkPrecondition()) {
+      return llvm::make_error<AnnotatedError>(std::move(Error),
+                                              "While scheduling step "
+                                                + Step.getName() + ":");
+    }
+  }
+
+  unsigned Jobs = getJobs();
+
+  // Explanations of concurrent steps would be interleaved
+  if (Jobs <= 1 or ToExec.size() <= 1 or ExplanationLogger.isEnabled()) {
+    Task T(ToExec.size(), "Multi-step pipeline run");
+    for (PipelineExecutionEntry &Entry : ToExec) {
+      T.advance(Entry.ToExecute->getName(), true);
+      runStep(Entry, cloneInputs(Entry));
+    }
+
+    return llvm::Error::success();
   }
 
+  Task T(1, "Multi-step pipeline run on " + Twine(Jobs) + " threads");
+  T.advance("Run steps", true);
+
+  // Build the dependency graph: each step depends on its predecessor, if it has
+  // to be executed too. Since ToExec is in reverse post order, predecessors are
+  // always found before their successors.
+  llvm::DenseMap<const Step *, size_t> IndexOf;
+  std::vector<llvm::SmallVector<size_t, 4>> Successors(ToExec.size());
+  llvm::SmallVector<size_t, 4> Roots;
+  for (size_t Index = 0; Index < ToExec.size(); ++Index) {
+    const Step *Current = ToExec[Index].ToExecute;
+    auto It = IndexOf.find(&Current->getPredecessor());
+    if (It == IndexOf.end())
+      Roots.push_back(Index);
+    else
+      Successors[It->second].push_back(Index);
+    IndexOf[Current] = Index;
+  }
+
+  std::vector<bool> IsExclusive(ToExec.size());
+  std::vector<GlobalsAccess> Accesses(ToExec.size());
+  for (size_t Index = 0; Index < ToExec.size(); ++Index) {
+    IsExclusive[Index] = requiresExclusiveAccess(ToExec[Index]);
+    Accesses[Index] = ToExec[Index].ToExecute->getAccessedGlobals();
+  }
+
+  // All the steps run against the globals of the context. Each step records
+  // what it reads on its own, so that model access tracking is not shared.
+  // Steps only read the globals, and hold GlobalsMutex shared, unless they
+  // declare to write some of them, in which case they hold it exclusively.
+  // Cloning the inputs from the predecessor, which might be shared with
+  // sibling steps, is serialized by StateMutex.
+  // Steps touching containers that are not thread safe also hold
+  // ExclusiveAccessMutex for their whole execution.
+  TheContext->getGlobals().prepareForConcurrentReads();
+  std::mutex ExclusiveAccessMutex;
+  std::shared_mutex GlobalsMutex;
+  std::mutex StateMutex;
+  llvm::ThreadPool Pool(llvm::hardware_concurrency(Jobs));
+  std::function<void(size_t)> Schedule = [&](size_t Index) {
+    Pool.async([&, Index]() {
+      PipelineExecutionEntry &Entry = ToExec[Index];
+      const GlobalsAccess &Access = Accesses[Index];
+      std::vector<std::string> Written = Access.getWrittenGlobals();
+
+      std::unique_lock ExclusiveLock(ExclusiveAccessMutex, std::defer_lock);
+      if (IsExclusive[Index])
+        ExclusiveLock.lock();
+
+      std::shared_lock ReadGlobalsLock(GlobalsMutex, std::defer_lock);
+      std::unique_lock WriteGlobalsLock(GlobalsMutex, std::defer_lock);
+      if (Written.empty())
+        ReadGlobalsLock.lock();
+      else
+        WriteGlobalsLock.lock();
+
+      std::optional<ContainerSet> Inputs;
+      {
+        std::lock_guard Lock(StateMutex);
+        Inputs.emplace(cloneInputs(Entry, false));
+      }
+
+      // Only the globals the step declares to write can change
+      GlobalsMap &Globals = TheContext->getGlobals();
+      llvm::StringMap<std::unique_ptr<Global>> Before;
+      for (const std::string &Name : Written)
+        Before[Name] = llvm::cantFail(Globals.get(Name))->clone();
+
+      {
+        revng::DeferredReads Reads;
+        revng::SharedTrackingScope SharedTracking(Reads);
+        runStep(Entry, std::move(*Inputs));
+      }
+
+      for (const auto &Pair : Before) {
+        Global *After = llvm::cantFail(Globals.get(Pair.first()));
+        GlobalTupleTreeDiff Diff = Pair.second->diff(*After);
+        for (const TupleTreePath *Path : Diff.getPaths()) {
+          std::string Changed = Pair.first().str();
+          Changed += Diff.pathAsString(*Path).value_or("");
+          revng_check(Access.allowsWriting(Changed),
+                      "A pipe changed a global it does not declare to write");
+        }
+      }
+
+      // Writing might have evicted what reading the globals lazily caches
+      if (not Written.empty())
+        Globals.prepareForConcurrentReads();
+
+      if (WriteGlobalsLock.owns_lock())
+        WriteGlobalsLock.unlock();
+      if (ReadGlobalsLock.owns_lock())
+        ReadGlobalsLock.unlock();
+      if (ExclusiveLock.owns_lock())
+        ExclusiveLock.unlock();
+
+      for (size_t Successor : Successors[Index])
+        Schedule(Successor);
+    });
+  };
+
+  for (size_t Root : Roots)
+    Schedule(Root);
+  Pool.wait();
+
   return llvm::Error::success();
 }
 
@@ -378,32 +819,8 @@ Error Runner::run(llvm::StringRef EndingStepName,
 
   Task T(ToExec.size() - 1, "Produce steps required up to " + EndingStepName);
   for (PipelineExecutionEntry &StepGoalsPairs : llvm::drop_begin(ToExec)) {
-    auto &[Step, PredictedOutput, Input, PipesInfo] = StepGoalsPairs;
-    T.advance(Step->getName(), true);
-
-    Task T2(3, "Run step");
-    T2.advance("Clone and filter input containers", true);
-
-    ::Step &Parent = Step->getPredecessor();
-    ContainerSet CurrentContainer = Parent.containers().cloneFiltered(Input);
-
-    // Run the step
-    T2.advance("Run the step", true);
-    Step->run(std::move(CurrentContainer), PipesInfo);
-
-    T2.advance("Extract the requested targets", true);
-    if (VerifyLog.isEnabled()) {
-      ContainerSet Produced = Step->containers().cloneFiltered(PredictedOutput);
-
-      if (not Produced.enumerate().contains(PredictedOutput)) {
-        dbg << "PredictedOutput:\n";
-        PredictedOutput.dump(dbg, 2, false);
-        dbg << "Produced:\n";
-        Produced.enumerate().dump(dbg, 2, false);
-        revng_abort("Not all the expected targets have been produced");
-      }
-      revng_check(Step->containers().enumerate().contains(PredictedOutput));
-    }
+    T.advance(StepGoalsPairs.ToExecute->getName(), true);
+    runStep(StepGoalsPairs, cloneInputs(StepGoalsPairs));
   }
 
   if (ExplanationLogger.isEnabled()) {
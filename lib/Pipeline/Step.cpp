@@ -6,15 +6,19 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Progress.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "revng/Pipeline/ArtifactCache.h"
 #include "revng/Pipeline/ContainerSet.h"
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/Errors.h"
+#include "revng/Pipeline/Profiler.h"
 #include "revng/Pipeline/Step.h"
 #include "revng/Pipeline/Target.h"
 #include "revng/Support/Assert.h"
@@ -25,6 +29,12 @@ using namespace llvm;
 using namespace std;
 using namespace pipeline;
 
+static cl::opt<bool> LazyLoad("lazy-load-containers",
+                              cl::desc("Deserialize the containers of a "
+                                       "pipeline only when their content is "
+                                       "accessed for the first time."),
+                              cl::init(true));
+
 namespace pipeline {
 
 class TargetInPipe {
@@ -43,9 +53,20 @@ public:
   }
 };
 
+/// The paths read to produce a target, along with the hash of the values they
+/// pointed to at the time the target was stored.
+class TargetReadPaths {
+public:
+  TargetInPipe Target;
+  std::vector<std::string> ReadPaths;
+
+  /// Either empty (metadata stored by older versions) or as long as ReadPaths
+  std::vector<std::string> Hashes;
+};
+
 class ContainerInvalidationMetadata {
 public:
-  using ValueType = std::pair<pipeline::TargetInPipe, std::vector<std::string>>;
+  using ValueType = TargetReadPaths;
   using Vector = std::vector<ValueType>;
   Vector Data;
 
@@ -55,11 +76,14 @@ public:
   }
 
 public:
+  /// Targets for which the hash of any read path does not match the current
+  /// content of \p Primitives are not deserialized, but reported in \p Stale.
   llvm::Expected<PathTargetBimap>
   deserialize(const Context &Context,
               const Global &Primitives,
               llvm::StringRef PipeName,
-              llvm::StringRef ContainerName) const;
+              llvm::StringRef ContainerName,
+              TargetsList &Stale) const;
 
   static ContainerInvalidationMetadata serialize(const PathTargetBimap &Map,
                                                  const Global &Primitives,
@@ -102,9 +126,10 @@ struct MappingTraits<ContainerInvalidationMetadata::Vector::value_type> {
   mapping(IO &Io,
           pipeline::ContainerInvalidationMetadata::Vector::value_type
             &TargetMap) {
-    Io.mapRequired("Target", TargetMap.first.SerializedTarget);
-    Io.mapRequired("PipeName", TargetMap.first.PipeName);
-    Io.mapRequired("ReadPaths", TargetMap.second);
+    Io.mapRequired("Target", TargetMap.Target.SerializedTarget);
+    Io.mapRequired("PipeName", TargetMap.Target.PipeName);
+    Io.mapRequired("ReadPaths", TargetMap.ReadPaths);
+    Io.mapOptional("Hashes", TargetMap.Hashes);
   }
 };
 
@@ -153,30 +178,44 @@ TargetInPipe::fromTargetInContainer(const TargetInContainer &Target,
   return ToReturn;
 }
 
+static std::string hashPath(const Global &Global, const TupleTreePath &Path) {
+  // Paths that do not exist (e.g., keys that have been looked up without
+  // success) are hashed as the empty string
+  std::optional<uint64_t> Hash = Global.hashPath(Path);
+  return Hash.has_value() ? llvm::utohexstr(*Hash) : std::string();
+}
+
 ContainerInvalidationMetadata
 ContainerInvalidationMetadata::serialize(const PathTargetBimap &Map,
                                          const Global &Global,
                                          llvm::StringRef PipeName,
                                          llvm::StringRef ContainerName) {
   ContainerInvalidationMetadata ToSerialize;
-  std::map<pipeline::TargetInPipe, std::vector<std::string>> TemporaryMap;
+  std::map<pipeline::TargetInPipe, TargetReadPaths> TemporaryMap;
 
   for (const auto &Content : Map) {
+    std::optional<std::string> AsString;
+    std::string Hash;
     for (const TargetInContainer &Entry : Content.second) {
       if (Entry.getContainerName() != ContainerName)
         continue;
 
-      std::optional<std::string> AsString = Global.serializePath(Content.first);
-      revng_check(AsString.has_value());
-      TemporaryMap[TargetInPipe::fromTargetInContainer(Entry, PipeName)]
-        .push_back(*AsString);
+      if (not AsString.has_value()) {
+        AsString = Global.serializePath(Content.first);
+        revng_check(AsString.has_value());
+        Hash = hashPath(Global, Content.first);
+      }
+
+      auto Target = TargetInPipe::fromTargetInContainer(Entry, PipeName);
+      TargetReadPaths &ReadPaths = TemporaryMap[Target];
+      ReadPaths.Target = std::move(Target);
+      ReadPaths.ReadPaths.push_back(*AsString);
+      ReadPaths.Hashes.push_back(Hash);
     }
   }
 
-  for (const auto &Content : TemporaryMap) {
-    std::pair ToEmplace{ Content.first, Content.second };
-    ToSerialize.Data.emplace_back(std::move(ToEmplace));
-  }
+  for (auto &Content : TemporaryMap)
+    ToSerialize.Data.emplace_back(std::move(Content.second));
 
   return ToSerialize;
 }
@@ -185,23 +224,31 @@ llvm::Expected<PathTargetBimap>
 ContainerInvalidationMetadata::deserialize(const Context &Context,
                                            const Global &Global,
                                            llvm::StringRef PipeName,
-                                           llvm::StringRef ContainerName)
-  const {
+                                           llvm::StringRef ContainerName,
+                                           TargetsList &Stale) const {
 
   PathTargetBimap ToReturn;
   for (const ValueType &Entry : Data) {
-    if (Entry.first.PipeName != PipeName) {
+    if (Entry.Target.PipeName != PipeName) {
       continue;
     }
 
     llvm::Expected<SmallVector<TargetInContainer>>
-      MaybeTarget = Entry.first.deserialize(Context, ContainerName);
+      MaybeTarget = Entry.Target.deserialize(Context, ContainerName);
 
     if (not MaybeTarget) {
       return MaybeTarget.takeError();
     }
 
-    for (auto &SerializedPath : Entry.second) {
+    bool HasHashes = not Entry.Hashes.empty();
+    if (HasHashes and Entry.Hashes.size() != Entry.ReadPaths.size())
+      return revng::createError("hashes do not match the read paths of "
+                                + Entry.Target.SerializedTarget);
+
+    std::vector<TupleTreePath> ParsedPaths;
+    bool IsStale = false;
+    for (size_t Index = 0; Index < Entry.ReadPaths.size(); ++Index) {
+      const std::string &SerializedPath = Entry.ReadPaths[Index];
       std::optional<TupleTreePath>
         MaybeParsedPath = Global.deserializePath(SerializedPath);
 
@@ -209,10 +256,29 @@ ContainerInvalidationMetadata::deserialize(const Context &Context,
         return revng::createError("could not parse " + SerializedPath);
       }
 
-      for (const TargetInContainer &Path : *MaybeTarget) {
-        ToReturn.insert(std::move(Path), std::move(*MaybeParsedPath));
+      // The content of the global has changed since the target was produced
+      if (HasHashes
+          and hashPath(Global, *MaybeParsedPath) != Entry.Hashes[Index]) {
+        revng_log(InvalidationLog,
+                  Entry.Target.SerializedTarget
+                    << " in " << ContainerName.str() << " is stale: "
+                    << SerializedPath << " has changed");
+        IsStale = true;
+        break;
       }
+
+      ParsedPaths.push_back(std::move(*MaybeParsedPath));
+    }
+
+    if (IsStale) {
+      for (const TargetInContainer &Target : *MaybeTarget)
+        Stale.push_back(Target.getTarget());
+      continue;
     }
+
+    for (const TupleTreePath &Path : ParsedPaths)
+      for (const TargetInContainer &Target : *MaybeTarget)
+        ToReturn.insert(Target, Path);
   }
 
   return ToReturn;
@@ -279,21 +345,65 @@ void Step::explainExecutedPipe(const InvokableWrapperBase &Wrapper,
 
 ContainerSet Step::run(ContainerSet &&Input,
                        const std::vector<PipeExecutionEntry> &ExecutionInfos) {
+  Profiler::Scope StepScope("step", getName());
   ContainerToTargetsMap InputEnumeration = Input.enumerate();
   explainStartStep(InputEnumeration);
 
+  const ArtifactCache *Cache = ArtifactCache::fromCommandLine();
+
+  // Targets committed by the other pipes might still be altered afterwards
+  const PipeWrapper *Notifying = nullptr;
+  if (Listener)
+    Notifying = getLastPipeWriting(ListenedContainer);
+
   Task T(Pipes.size() + 1, "Step " + getName());
   for (const auto &[Pipe, Info] : llvm::zip(Pipes, ExecutionInfos)) {
     T.advance(Pipe.Pipe->getName(), false);
     explainExecutedPipe(*Pipe.Pipe);
+    Profiler::Scope PipeScope("pipe", Pipe.Pipe->getName());
+
+    // Keys have to be computed before running the pipe, since pipes are
+    // allowed to alter their inputs
+    ContainerToTargetsMap ToProduce = Info.Output;
+    ArtifactCache::KeysMap Keys;
+    ArtifactCache::FetchedMap Fetched;
+    if (Cache != nullptr) {
+      Keys = Cache->computeKeys(*TheContext, Pipe, Input, ToProduce);
+      Fetched = Cache->fetch(*TheContext, Pipe, Keys, Input, ToProduce);
+    }
+
+    // Run the pipe unless the cache provided everything it was asked for
+    if (Fetched.empty() or not ToProduce.empty()) {
+      ExecutionContext EC(*TheContext, &Pipe, ToProduce);
 
-    ExecutionContext EC(*TheContext, &Pipe, Info.Output);
+      // A pipe can keep altering a target after committing it (e.g., through
+      // a later pass): notify the committed targets once the pipe completed
+      TargetsList Committed;
+      if (&Pipe == Notifying) {
+        auto Record = [this, &Committed](const Target &Target,
+                                         llvm::StringRef ContainerName) {
+          if (ContainerName == ListenedContainer)
+            Committed.push_back(Target);
+        };
+        EC.setCommitListener(Record);
+      }
+
+      Pipe.Pipe->deduceResults(*TheContext, EC.getCurrentRequestedTargets());
+
+      cantFail(Pipe.Pipe->run(EC, Input));
+      llvm::cantFail(Input.verify());
+      EC.verify();
+
+      for (const Target &Target : Committed)
+        Listener(Target, Input.at(ListenedContainer));
 
-    Pipe.Pipe->deduceResults(*TheContext, EC.getCurrentRequestedTargets());
+      if (Cache != nullptr)
+        Cache->store(*TheContext, Pipe, Keys, Input, ToProduce);
+    }
 
-    cantFail(Pipe.Pipe->run(EC, Input));
-    llvm::cantFail(Input.verify());
-    EC.verify();
+    // Cached targets are merged only now, so that the pipe does not see them
+    for (auto &Entry : Fetched)
+      Input[Entry.first()].mergeBack(std::move(*Entry.second));
   }
 
   T.advance("Merging back", true);
@@ -304,6 +414,19 @@ ContainerSet Step::run(ContainerSet &&Input,
   return Cloned;
 }
 
+const PipeWrapper *
+Step::getLastPipeWriting(llvm::StringRef ContainerName) const {
+  for (const PipeWrapper &Pipe : llvm::reverse(Pipes)) {
+    const auto &Names = Pipe.Pipe->getRunningContainersNames();
+    for (size_t I = 0; I < Names.size(); ++I)
+      if (Names[I] == ContainerName
+          and not Pipe.Pipe->isContainerArgumentConst(I))
+        return &Pipe;
+  }
+
+  return nullptr;
+}
+
 void Step::pipeInvalidate(const GlobalTupleTreeDiff &Diff,
                           ContainerToTargetsMap &Map) const {
   for (const auto &Pipe : Pipes) {
@@ -311,30 +434,39 @@ void Step::pipeInvalidate(const GlobalTupleTreeDiff &Diff,
   }
 }
 
-llvm::Error Step::runAnalysis(llvm::StringRef AnalysisName,
-                              const ContainerToTargetsMap &Targets,
-                              const llvm::StringMap<std::string> &ExtraArgs) {
-  auto Stream = ExplanationLogger.getAsLLVMStream();
+ContainerSet
+Step::cloneAnalysisInputs(const ContainerToTargetsMap &Targets) const {
   ContainerToTargetsMap Map = Containers.enumerate();
 
-  ContainerToTargetsMap CollapsedTargets = Targets;
-
-  revng_assert(Map.contains(CollapsedTargets),
+  revng_assert(Map.contains(Targets),
                "An analysis was requested, but not all targets are available");
 
+  return Containers.cloneFiltered(Targets);
+}
+
+llvm::Error Step::runAnalysis(llvm::StringRef AnalysisName,
+                              const ContainerToTargetsMap &Targets,
+                              const llvm::StringMap<std::string> &ExtraArgs) {
+  ContainerSet Cloned = cloneAnalysisInputs(Targets);
+  return runAnalysis(*TheContext, AnalysisName, Cloned, ExtraArgs);
+}
+
+llvm::Error Step::runAnalysis(Context &RunContext,
+                              llvm::StringRef AnalysisName,
+                              ContainerSet &Inputs,
+                              const llvm::StringMap<std::string> &ExtraArgs) {
   AnalysisWrapper &TheAnalysis = getAnalysis(AnalysisName);
 
   explainExecutedPipe(*TheAnalysis);
+  Profiler::Scope AnalysisScope("analysis", AnalysisName);
 
-  ContainerSet Cloned = Containers.cloneFiltered(Targets);
-  ExecutionContext EC(*TheContext, nullptr);
-  return TheAnalysis->run(EC, Cloned, ExtraArgs);
+  ExecutionContext EC(RunContext, nullptr);
+  return TheAnalysis->run(EC, Inputs, ExtraArgs);
 }
 
 void Step::removeSatisfiedGoals(TargetsList &RequiredInputs,
-                                const ContainerBase &CachedSymbols,
+                                const TargetsList &EnumeratedSymbols,
                                 TargetsList &ToLoad) {
-  const TargetsList EnumeratedSymbols = CachedSymbols.enumerate();
   const auto IsCached = [&ToLoad,
                          &EnumeratedSymbols](const Target &Target) -> bool {
     bool MustBeLoaded = EnumeratedSymbols.contains(Target);
@@ -354,7 +486,7 @@ void Step::removeSatisfiedGoals(ContainerToTargetsMap &Targets,
     TargetsList &ToLoadFromCurrentContainer = ToLoad[ContainerName];
     if (Containers.contains(ContainerName))
       removeSatisfiedGoals(RequiredInputs,
-                           Containers.at(ContainerName),
+                           Containers.enumerate(ContainerName),
                            ToLoadFromCurrentContainer);
   }
 }
@@ -373,9 +505,13 @@ Error Step::invalidate(const ContainerToTargetsMap &ToRemove) {
 }
 
 Error Step::store(const revng::DirectoryPath &DirPath) const {
+  Profiler::Scope StoreScope("store", getName());
   if (auto Error = Containers.store(DirPath))
     return Error;
 
+  if (auto Error = storeTargetsIndex(DirPath))
+    return Error;
+
   return storeInvalidationMetadata(DirPath);
 }
 
@@ -390,7 +526,8 @@ Error Step::checkPrecondition() const {
   return llvm::Error::success();
 }
 
-Error Step::load(const revng::DirectoryPath &DirPath) {
+Error Step::load(const revng::DirectoryPath &DirPath,
+                 ContainerToTargetsMap &Stale) {
   auto MaybeBool = DirPath.exists();
   if (not MaybeBool)
     return MaybeBool.takeError();
@@ -398,15 +535,23 @@ Error Step::load(const revng::DirectoryPath &DirPath) {
   if (not MaybeBool.get())
     return llvm::Error::success();
 
-  if (auto Error = Containers.load(DirPath))
+  Profiler::Scope LoadScope("load", getName());
+  for (const auto &Container : Containers)
+    if (auto Error = loadContainer(DirPath, Container.first()))
+      return Error;
+
+  if (auto Error = loadInvalidationMetadata(DirPath, Stale))
     return Error;
 
-  return loadInvalidationMetadata(DirPath);
+  // Metadata might refer to targets that are no longer in the containers
+  Containers.intersect(Stale);
+  return llvm::Error::success();
 }
 
 llvm::Error
 Step::loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
-                                   ContainerSet::value_type &Container) {
+                                   ContainerSet::value_type &Container,
+                                   ContainerToTargetsMap &Stale) {
   auto FilePath = Path.getFile(Container.first().str() + ".cache.zst");
   auto MaybeBool = FilePath.exists();
   if (not MaybeBool)
@@ -434,7 +579,8 @@ Step::loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
       auto Parsed(Entry.Map.deserialize(*TheContext,
                                         *Global,
                                         Pipe.Pipe->getName(),
-                                        Container.first()));
+                                        Container.first(),
+                                        Stale[Container.first()]));
       if (not Parsed)
         return Parsed.takeError();
       Pipe.InvalidationMetadata.getPathCache(Global->getName())
@@ -444,13 +590,14 @@ Step::loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
   return llvm::Error::success();
 }
 
-llvm::Error Step::loadInvalidationMetadata(const revng::DirectoryPath &Path) {
+llvm::Error Step::loadInvalidationMetadata(const revng::DirectoryPath &Path,
+                                           ContainerToTargetsMap &Stale) {
 
   for (PipeWrapper &Pipe : Pipes) {
     Pipe.InvalidationMetadata = {};
   }
   for (auto &Container : Containers) {
-    if (llvm::Error Error = loadInvalidationMetadataImpl(Path, Container))
+    if (auto Error = loadInvalidationMetadataImpl(Path, Container, Stale))
       return Error;
   }
 
@@ -460,7 +607,7 @@ llvm::Error Step::loadInvalidationMetadata(const revng::DirectoryPath &Path) {
 llvm::Error
 Step::storeInvalidationMetadata(const revng::DirectoryPath &Path) const {
   for (auto &Container : Containers) {
-    if (Container.second == nullptr)
+    if (not Containers.contains(Container.first()))
       continue;
 
     using Type = llvm::SmallVector<NamedPathTargetBimapVector, 2>;
@@ -504,7 +651,102 @@ Step::storeInvalidationMetadata(const revng::DirectoryPath &Path) const {
 std::vector<revng::FilePath>
 Step::getWrittenFiles(const revng::DirectoryPath &DirPath) const {
   std::vector<revng::FilePath> Result = Containers.getWrittenFiles(DirPath);
-  for (auto &Container : Containers)
+  for (auto &Container : Containers) {
     Result.push_back(DirPath.getFile(Container.first().str() + ".cache.zst"));
+    Result.push_back(DirPath.getFile(Container.first().str() + ".targets.zst"));
+  }
   return Result;
 }
+
+llvm::Error Step::storeTargetsIndex(const revng::DirectoryPath &Path) const {
+  for (const auto &Container : Containers) {
+    revng::FilePath IndexPath = Path.getFile(Container.first().str()
+                                             + ".targets.zst");
+
+    // Without a container there must not be an index, otherwise a stale file
+    // from a previous run would be loaded lazily
+    if (not Containers.contains(Container.first())) {
+      auto MaybeExists = IndexPath.exists();
+      if (not MaybeExists)
+        return MaybeExists.takeError();
+
+      if (MaybeExists.get())
+        if (auto Error = IndexPath.remove())
+          return Error;
+
+      continue;
+    }
+
+    auto File = IndexPath.getWritableFile();
+    if (not File)
+      return File.takeError();
+
+    {
+      ZstdCompressedOstream OS(File->get()->os(), 5);
+      for (const Target &Target : Containers.enumerate(Container.first()))
+        OS << Target.toString() << "\n";
+    }
+
+    if (auto Error = File->get()->commit())
+      return Error;
+  }
+
+  return llvm::Error::success();
+}
+
+llvm::Error Step::loadContainer(const revng::DirectoryPath &Path,
+                                llvm::StringRef ContainerName) {
+  if (not LazyLoad)
+    return Containers.load(Path, ContainerName);
+
+  revng::FilePath ContainerPath = Path.getFile(ContainerName);
+  revng::FilePath IndexPath = Path.getFile(ContainerName.str()
+                                           + ".targets.zst");
+  for (const revng::FilePath &ToCheck : { ContainerPath, IndexPath }) {
+    auto MaybeExists = ToCheck.exists();
+    if (not MaybeExists)
+      return MaybeExists.takeError();
+
+    // Fall back to eager loading, which also handles missing containers
+    if (not MaybeExists.get())
+      return Containers.load(Path, ContainerName);
+  }
+
+  auto File = IndexPath.getReadableFile();
+  if (not File)
+    return File.takeError();
+
+  llvm::MemoryBuffer &Buffer = File.get()->buffer();
+  llvm::SmallVector<char> Decompressed = zstdDecompress(Buffer.getBuffer());
+  llvm::StringRef Index(Decompressed.data(), Decompressed.size());
+
+  llvm::SmallVector<llvm::StringRef, 16> Lines;
+  Index.split(Lines, '\n', -1, false);
+
+  // Collect the targets in a plain list, TargetsList::push_back sorts the
+  // list at each insertion
+  TargetsList::List Enumeration;
+  for (llvm::StringRef Line : Lines) {
+    TargetsList Parsed;
+    if (auto Error = parseTarget(*TheContext,
+                                 Line,
+                                 TheContext->getKindsRegistry(),
+                                 Parsed)) {
+      // The index cannot be trusted, deserialize the container right away
+      revng_log(ExplanationLogger,
+                "Cannot parse the index of " << ContainerName.str() << ": "
+                                             << toString(std::move(Error)));
+      return Containers.load(Path, ContainerName);
+    }
+
+    llvm::append_range(Enumeration, Parsed);
+  }
+
+  llvm::sort(Enumeration);
+  Enumeration.erase(std::unique(Enumeration.begin(), Enumeration.end()),
+                    Enumeration.end());
+  Containers.loadLazily(ContainerName,
+                        ContainerPath,
+                        TargetsList(std::move(Enumeration)));
+  return llvm::Error::success();
+}
@@ -7,6 +7,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <iterator>
+#include <map>
 #include <optional>
 #include <string>
 #include <type_traits>
@@ -14,6 +15,7 @@
 
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
@@ -29,6 +31,7 @@
 #include "revng/Pipes/ModelGlobal.h"
 #include "revng/Pipes/PipelineManager.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/ChunkedOstream.h"
 #include "revng/Support/InitRevng.h"
 #include "revng/TupleTree/TupleTreeDiff.h"
 
@@ -362,6 +365,100 @@ static rp_buffer *_rp_manager_produce_targets(rp_manager *manager,
   return Out;
 }
 
+/// Maps each of \p targets to its pointer, so that callbacks can be handed the
+/// pointers provided by the caller without looking them up in \p targets
+static std::map<Target, const rp_target *>
+mapTargets(uint64_t targets_count, const rp_target *targets[]) {
+  std::map<Target, const rp_target *> Result;
+  for (size_t I = 0; I < targets_count; I++)
+    Result.try_emplace(*targets[I], targets[I]);
+  return Result;
+}
+
+static bool
+_rp_manager_produce_targets_streaming(rp_manager *manager,
+                                      const rp_step *step,
+                                      const rp_container *container,
+                                      uint64_t targets_count,
+                                      const rp_target *targets[],
+                                      rp_produced_target_callback callback,
+                                      void *user_data,
+                                      rp_error *error) {
+  revng_check(manager != nullptr);
+  revng_check(step != nullptr);
+  revng_check(container != nullptr);
+  revng_check(targets_count != 0);
+  revng_check(targets != nullptr);
+
+  TargetsList List;
+  for (size_t I = 0; I < targets_count; I++)
+    List.push_back(*targets[I]);
+
+  // Hand back to the callback the pointers it provided
+  auto Pointers = mapTargets(targets_count, targets);
+  auto OnProduced = [&](const Target &Produced, llvm::StringRef Serialized) {
+    if (callback == nullptr)
+      return;
+
+    auto It = Pointers.find(Produced);
+    revng_assert(It != Pointers.end());
+    callback(It->second, Serialized.data(), Serialized.size(), user_data);
+  };
+
+  auto Error = manager->produceTargets(step->getName(),
+                                       *container,
+                                       List,
+                                       OnProduced);
+  if (Error) {
+    llvmErrorToRpError(std::move(Error), error);
+    return false;
+  }
+
+  return true;
+}
+
+static bool
+_rp_manager_produce_targets_chunked(rp_manager *manager,
+                                    const rp_step *step,
+                                    const rp_container *container,
+                                    uint64_t targets_count,
+                                    const rp_target *targets[],
+                                    rp_target_chunk_callback callback,
+                                    void *user_data,
+                                    rp_error *error) {
+  revng_check(manager != nullptr);
+  revng_check(step != nullptr);
+  revng_check(container != nullptr);
+  revng_check(targets_count != 0);
+  revng_check(targets != nullptr);
+
+  TargetsList List;
+  for (size_t I = 0; I < targets_count; I++)
+    List.push_back(*targets[I]);
+
+  // Hand back to the callback the pointers it provided
+  auto Pointers = mapTargets(targets_count, targets);
+  auto OnChunk = [&](const Target &Produced, llvm::StringRef Chunk) {
+    if (callback == nullptr)
+      return;
+
+    auto It = Pointers.find(Produced);
+    revng_assert(It != Pointers.end());
+    callback(It->second, Chunk.data(), Chunk.size(), user_data);
+  };
+
+  auto Error = manager->produceTargetsInChunks(step->getName(),
+                                               *container,
+                                               List,
+                                               OnChunk);
+  if (Error) {
+    llvmErrorToRpError(std::move(Error), error);
+    return false;
+  }
+
+  return true;
+}
+
 static rp_target *_rp_target_create(const rp_kind *kind,
                                     uint64_t path_components_count,
                                     const char *path_components[]) {
@@ -512,6 +609,72 @@ static rp_buffer *_rp_container_extract_one(const rp_container *container,
   return Out;
 }
 
+static rp_buffer *_rp_container_extract_many(const rp_container *container,
+                                             uint64_t targets_count,
+                                             const rp_target *targets[],
+                                             rp_error *error) {
+  revng_check(container != nullptr);
+  revng_check(targets != nullptr);
+
+  TargetsList Available = container->second->enumerate();
+  for (uint64_t I = 0; I < targets_count; I++) {
+    revng_check(targets[I] != nullptr);
+    if (not Available.contains(*targets[I]))
+      return nullptr;
+  }
+
+  // Reserve the sizes, they are known only once the targets are extracted
+  auto Out = std::make_unique<rp_buffer>();
+  Out->resize(targets_count * sizeof(uint64_t));
+  llvm::raw_svector_ostream Serialized(*Out);
+  for (uint64_t I = 0; I < targets_count; I++) {
+    uint64_t Start = Out->size();
+    auto Error = container->second->extractOne(Serialized, *targets[I]);
+    if (Error) {
+      llvmErrorToRpError(std::move(Error), error);
+      return nullptr;
+    }
+
+    uint64_t Size = Out->size() - Start;
+    llvm::support::endian::write64le(Out->data() + I * sizeof(uint64_t), Size);
+  }
+
+  return Out.release();
+}
+
+static bool
+_rp_container_extract_one_chunked(const rp_container *container,
+                                  const rp_target *target,
+                                  rp_target_chunk_callback callback,
+                                  void *user_data,
+                                  rp_error *error) {
+  revng_check(container != nullptr);
+  revng_check(target != nullptr);
+
+  if (!container->second->enumerate().contains(*target)) {
+    return false;
+  }
+
+  if (callback == nullptr)
+    return true;
+
+  auto OnChunk = [&](llvm::StringRef Chunk) {
+    callback(target, Chunk.data(), Chunk.size(), user_data);
+  };
+
+  {
+    revng::ChunkedOstream Serialized(OnChunk);
+    auto Error = container->second->extractOne(Serialized, *target);
+    if (Error) {
+      llvmErrorToRpError(std::move(Error), error);
+      return false;
+    }
+  }
+
+  callback(target, nullptr, 0, user_data);
+  return true;
+}
+
 static rp_diff_map *
 _rp_manager_run_analyses_list(rp_manager *manager,
                               const char *list_name,
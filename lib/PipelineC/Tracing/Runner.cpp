@@ -245,6 +245,15 @@ private:
     return Pointer;
   }
 
+  // Callbacks cannot be replayed, NULL is passed in their place
+  template<ConstexprString Name, typename ArgT>
+    requires(std::is_pointer_v<ArgT>
+             && (std::is_function_v<std::remove_pointer_t<ArgT>>
+                 || std::is_void_v<remove_constptr<ArgT>>))
+  ArgT parseArgumentImpl(ArgumentRef Argument) {
+    return nullptr;
+  }
+
   template<ConstexprString Name, typename ArgT>
     requires(isList<ArgT>()
              && isRPType<remove_constptr<remove_constptr<ArgT>>>())
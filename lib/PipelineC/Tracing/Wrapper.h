@@ -117,6 +117,16 @@ public:
     printPointer(Ptr);
   }
 
+  // Callbacks and the opaque data passed to them are recorded by address
+  template<typename T>
+    requires(std::is_function_v<T> or std::is_void_v<T>)
+  void printValue(T *Ptr) {
+    OS << PointerPrefix;
+    llvm::write_hex(OS, reinterpret_cast<uintptr_t>(Ptr), PointerStyle);
+    OS << "\n";
+    OS.flush();
+  }
+
   template<typename T>
   void printPointer(const T *Ptr) {
     // NOTE: if reading traces becomes a major task, it might be beneficial to
@@ -6,13 +6,25 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/Model/LoadModelPass.h"
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/ExecutionContext.h"
+#include "revng/Pipeline/LLVMContainer.h"
 #include "revng/Pipeline/LLVMKind.h"
 #include "revng/Pipes/FunctionPass.h"
+#include "revng/Pipes/ModelGlobal.h"
 #include "revng/Pipes/TaggedFunctionKind.h"
 #include "revng/Support/FunctionTags.h"
 
@@ -32,9 +44,13 @@ bool pipeline::detail::runOnModule(llvm::Module &Module,
   using Type = revng::kinds::TaggedFunctionKind;
   auto ContainerName = Analysis.getContainerName();
   auto ToIterOn = Type::getFunctionsAndCommit(*EC, Module, ContainerName);
-  llvm::Task T(Analysis.getRequestedTargets().size(), "Running FunctionPass");
+  // Progress is only reported by the main thread
+  std::optional<llvm::Task> T;
+  if (not EC->isWorker())
+    T.emplace(Analysis.getRequestedTargets().size(), "Running FunctionPass");
   for (const auto &[ModelFunction, LLVMFunction] : ToIterOn) {
-    T.advance(ModelFunction->Entry().toString(), true);
+    if (T)
+      T->advance(ModelFunction->Entry().toString(), true);
     Result = Pipe.runOnFunction(*ModelFunction, *LLVMFunction) or Result;
   }
 
@@ -42,3 +58,147 @@ bool pipeline::detail::runOnModule(llvm::Module &Module,
 
   return Result;
 }
+
+static llvm::cl::opt<unsigned> FunctionPassJobs("function-pass-jobs",
+                                                llvm::cl::desc("Number of "
+                                                               "threads to use "
+                                                               "to run "
+                                                               "function pipes "
+                                                               "supporting it. "
+                                                               "0 means one "
+                                                               "per core."),
+                                                llvm::cl::init(1));
+
+static std::string toBitcode(const llvm::Module &Module) {
+  std::string Result;
+  llvm::raw_string_ostream Stream(Result);
+  llvm::WriteBitcodeToFile(Module, Stream);
+  Stream.flush();
+  return Result;
+}
+
+static std::unique_ptr<llvm::Module> fromBitcode(llvm::StringRef Bitcode,
+                                                 llvm::LLVMContext &Context) {
+  llvm::MemoryBufferRef Buffer(Bitcode, "shard");
+  return llvm::cantFail(llvm::parseBitcodeFile(Buffer, Context));
+}
+
+namespace {
+
+/// A subset of the targets requested to a function pipe, processed by a single
+/// worker
+struct Shard {
+  ContainerToTargetsMap Requested;
+  std::unique_ptr<pipeline::ExecutionContext> WorkerEC;
+
+  /// The bitcode of the input module, replaced by the bitcode of the output
+  /// module once the worker is done
+  std::string Bitcode;
+};
+
+} // namespace
+
+void pipeline::runFunctionPipe(ExecutionContext &EC,
+                               LLVMContainer &Container,
+                               const FunctionPipePopulator &Populate) {
+  runFunctionPipe(EC, Container, Populate, FunctionPassJobs);
+}
+
+void pipeline::runFunctionPipe(ExecutionContext &EC,
+                               LLVMContainer &Container,
+                               const FunctionPipePopulator &Populate,
+                               unsigned Jobs) {
+  revng_assert(not EC.isWorker());
+  const TargetsList &Requested = EC.getRequestedTargetsFor(Container);
+
+  if (Jobs == 0)
+    Jobs = llvm::hardware_concurrency().compute_thread_count();
+  Jobs = std::min<size_t>(Jobs, Requested.size());
+
+  if (Jobs <= 1) {
+    llvm::legacy::PassManager Manager;
+    Populate(Manager, EC, Container);
+    Manager.run(Container.getModule());
+    return;
+  }
+
+  llvm::Task T(3, "Running function pipe on " + llvm::Twine(Jobs) + " shards");
+
+  // Split the requested targets in contiguous shards. Requested is sorted,
+  // therefore the partitioning only depends on the number of jobs.
+  T.advance("Prepare shards", true);
+  std::vector<Shard> Shards(Jobs);
+  for (size_t Index = 0; Index < Requested.size(); ++Index) {
+    Shard &Destination = Shards[Index * Jobs / Requested.size()];
+    Destination.Requested.add(Container.name(), Requested[Index]);
+  }
+
+  for (Shard &Shard : Shards) {
+    const TargetsList &Targets = Shard.Requested.at(Container.name());
+    auto Cloned = Container.cloneFiltered(Targets);
+    Shard.Bitcode = toBitcode(llvm::cast<LLVMContainer>(*Cloned).getModule());
+    Shard.WorkerEC = std::make_unique<ExecutionContext>(EC, Shard.Requested);
+  }
+
+  // Obtaining the model caches its references: do it once, here, so that the
+  // workers only read it
+  using revng::ModelGlobal;
+  const char *ModelName = revng::ModelGlobalName;
+  auto MaybeModel = EC.getContext().getGlobal<ModelGlobal>(ModelName);
+  if (MaybeModel)
+    (*MaybeModel)->get().cacheReferences();
+  else
+    llvm::consumeError(MaybeModel.takeError());
+
+  T.advance("Run on shards", true);
+  {
+    llvm::ThreadPool Pool(llvm::hardware_concurrency(Jobs));
+    for (Shard &Shard : Shards) {
+      Pool.async([&Shard, &EC, &Container, &Populate]() {
+        // All the workers read the globals of EC, each one recording what it
+        // reads on its own
+        auto SharedTracking = Shard.WorkerEC->trackReads();
+
+        llvm::LLVMContext WorkerLLVMContext;
+        auto Module = fromBitcode(Shard.Bitcode, WorkerLLVMContext);
+        LLVMContainer WorkerContainer(Container.name(),
+                                      &EC.getContext(),
+                                      std::move(Module));
+
+        llvm::legacy::PassManager Manager;
+        Populate(Manager, *Shard.WorkerEC, WorkerContainer);
+        Manager.run(WorkerContainer.getModule());
+
+        Shard.Bitcode = toBitcode(WorkerContainer.getModule());
+      });
+    }
+    Pool.wait();
+  }
+
+  // Replace the requested targets with the ones produced by the workers,
+  // preserving everything else
+  T.advance("Merge shards", true);
+  TargetsList Untouched = Container.enumerate();
+  Untouched.erase_if([&Requested](const Target &Target) {
+    return Requested.contains(Target);
+  });
+  auto Result = Container.cloneFiltered(Untouched);
+
+  llvm::LLVMContext &MainContext = Container.getModule().getContext();
+  for (Shard &Shard : Shards) {
+    Shard.WorkerEC->verify();
+    LLVMContainer ShardContainer(Container.name(),
+                                 &EC.getContext(),
+                                 fromBitcode(Shard.Bitcode, MainContext));
+    Result->mergeBack(std::move(ShardContainer));
+  }
+
+  Container.clear();
+  Container.mergeBack(std::move(*Result));
+
+  // Commit the targets of the workers along with the fields read to produce
+  // each of them. Committing from here also runs the commit listener on this
+  // thread, once the targets can be extracted from Container.
+  for (Shard &Shard : Shards)
+    EC.join(std::move(*Shard.WorkerEC));
+}
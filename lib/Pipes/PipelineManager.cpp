@@ -9,6 +9,7 @@
 
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
@@ -461,23 +462,22 @@ PipelineManager::invalidateAllPossibleTargets() {
 llvm::Error PipelineManager::produceAllPossibleTargets(bool ExpandTargets) {
   recalculateAllPossibleTargets(ExpandTargets);
 
+  Runner::State ToProduce;
   for (const auto &Step : CurrentState) {
     for (const auto &Container : Step.second) {
       for (const auto &Target : Container.second) {
-        ContainerToTargetsMap ToProduce;
-        ToProduce.add(Container.first(), Target);
+        ToProduce[Step.first()].add(Container.first(), Target);
         ExplanationLogger << Step.first() << "/" << Container.first() << "/";
         auto Logger = ExplanationLogger.getAsLLVMStream();
         Target.dump(*Logger);
         ExplanationLogger << DoLog;
-
-        if (auto Error = Runner->run(Step.first(), ToProduce))
-          return Error;
       }
     }
   }
 
-  return llvm::Error::success();
+  // Produce everything at once, so that independent branches of the pipeline
+  // can be scheduled concurrently
+  return Runner->run(ToProduce);
 }
 
 const pipeline::Step::AnalysisValueType &
@@ -578,13 +578,116 @@ PipelineManager::produceTargets(const llvm::StringRef StepName,
                                 const pipeline::TargetsList &List) {
   ContainerToTargetsMap Targets;
   for (const pipeline::Target &Target : List)
-    Targets[TheContainer.second->name()].push_back(Target);
+    Targets[TheContainer.first()].push_back(Target);
 
   if (auto Error = materializeTargets(StepName, Targets))
     return Error;
 
-  const auto &ToFilter = Targets.at(TheContainer.second->name());
-  return TheContainer.second->cloneFiltered(ToFilter);
+  // Go through the step, the container might have been loaded lazily
+  const auto &Containers = getRunner().getStep(StepName).containers();
+  const auto &ToFilter = Targets.at(TheContainer.first());
+  return Containers.cloneFiltered(TheContainer.first(), ToFilter);
+}
+
+llvm::Error
+PipelineManager::produceTargets(const llvm::StringRef StepName,
+                                const Container &TheContainer,
+                                const pipeline::TargetsList &List,
+                                ProducedTargetCallback OnProduced) {
+  auto Extract = [&OnProduced](const pipeline::Target &Target,
+                               const pipeline::ContainerBase &Source) {
+    std::string Serialized;
+    llvm::raw_string_ostream OS(Serialized);
+    if (auto Error = Source.extractOne(OS, Target))
+      return Error;
+    OS.flush();
+
+    OnProduced(Target, Serialized);
+    return llvm::Error::success();
+  };
+
+  return deliverTargets(StepName, TheContainer, List, Extract);
+}
+
+llvm::Error
+PipelineManager::produceTargetsInChunks(const llvm::StringRef StepName,
+                                        const Container &TheContainer,
+                                        const pipeline::TargetsList &List,
+                                        TargetChunkCallback OnChunk,
+                                        size_t ChunkSize) {
+  auto Extract = [&OnChunk, ChunkSize](const pipeline::Target &Target,
+                                       const pipeline::ContainerBase &Source) {
+    auto OnTargetChunk = [&](llvm::StringRef Chunk) { OnChunk(Target, Chunk); };
+    llvm::Error Error = [&]() {
+      revng::ChunkedOstream OS(OnTargetChunk, ChunkSize);
+      return Source.extractOne(OS, Target);
+    }();
+
+    // Terminate the target even if its extraction failed, so that whoever is
+    // receiving its chunks does not wait for more of them
+    OnChunk(Target, {});
+    return Error;
+  };
+
+  return deliverTargets(StepName, TheContainer, List, Extract);
+}
+
+llvm::Error PipelineManager::deliverTargets(const llvm::StringRef StepName,
+                                            const Container &TheContainer,
+                                            const pipeline::TargetsList &List,
+                                            ExtractCallback Extract) {
+  if (not getRunner().containsStep(StepName))
+    return revng::createError("Step %s does not exist",
+                              StepName.str().c_str());
+
+  llvm::StringRef ContainerName = TheContainer.first();
+  ContainerToTargetsMap Targets;
+  for (const pipeline::Target &Target : List)
+    Targets[ContainerName].push_back(Target);
+  const TargetsList &Requested = Targets.at(ContainerName);
+
+  // Steps can be run concurrently, serialize the deliveries
+  std::mutex DeliveryMutex;
+  TargetsList Delivered;
+  llvm::Error Failures = llvm::Error::success();
+  auto Deliver = [&](const pipeline::Target &Target,
+                     const pipeline::ContainerBase &Source) {
+    std::lock_guard Guard(DeliveryMutex);
+    if (not Requested.contains(Target) or Delivered.contains(Target))
+      return;
+
+    if (auto Error = Extract(Target, Source)) {
+      Failures = llvm::joinErrors(std::move(Failures), std::move(Error));
+      return;
+    }
+
+    Delivered.push_back(Target);
+  };
+
+  pipeline::Step &Step = getRunner().getStep(StepName);
+  Step.setCommitListener(ContainerName, Deliver);
+  llvm::Error Error = materializeTargets(StepName, Targets);
+  Step.clearCommitListener();
+  if (Error)
+    return llvm::joinErrors(std::move(Error), std::move(Failures));
+  if (Failures)
+    return Failures;
+
+  TargetsList Missing;
+  for (const pipeline::Target &Target : Requested)
+    if (not Delivered.contains(Target))
+      Missing.push_back(Target);
+
+  if (Missing.empty())
+    return llvm::Error::success();
+
+  // Go through the step, the container might have been loaded lazily
+  const auto &Containers = Step.containers();
+  auto Cloned = Containers.cloneFiltered(ContainerName, Missing);
+  for (const pipeline::Target &Target : Missing)
+    Deliver(Target, *Cloned);
+
+  return Failures;
 }
 
 llvm::Error PipelineManager::computeDescription() {
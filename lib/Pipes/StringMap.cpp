@@ -0,0 +1,15 @@
+/// \file StringMap.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/Pipes/StringMap.h"
+
+using namespace llvm;
+
+cl::opt<unsigned> StringMapJobs("string-map-jobs",
+                                cl::desc("Number of threads to use to "
+                                         "compress the entries of string map "
+                                         "archives. 0 means one per core."),
+                                cl::init(0));
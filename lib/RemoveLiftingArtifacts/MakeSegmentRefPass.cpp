@@ -313,12 +313,16 @@ void MakeSegmentRef::run(pipeline::ExecutionContext &EC,
   auto Buffer = cantFail(errorOrToExpected(std::move(BufferOrError)));
   RawBinaryView RawBinary(*Model, Buffer->getBuffer());
 
-  llvm::legacy::PassManager PM;
-  PM.add(new pipeline::LoadExecutionContextPass(&EC, ModuleContainer.name()));
-  PM.add(new LoadModelWrapperPass(Model));
-  PM.add(new LoadBinaryWrapperPass(Buffer->getBuffer()));
-  PM.add(new pipeline::FunctionPass<MakeSegmentRefPassImpl>);
-  PM.run(ModuleContainer.getModule());
+  auto Populate = [&Buffer](llvm::legacy::PassManager &PM,
+                            pipeline::ExecutionContext &EC,
+                            pipeline::LLVMContainer &ModuleContainer) {
+    PM.add(new pipeline::LoadExecutionContextPass(&EC,
+                                                  ModuleContainer.name()));
+    PM.add(new LoadModelWrapperPass(getModelFromContext(EC)));
+    PM.add(new LoadBinaryWrapperPass(Buffer->getBuffer()));
+    PM.add(new pipeline::FunctionPass<MakeSegmentRefPassImpl>);
+  };
+  pipeline::runFunctionPipe(EC, ModuleContainer, Populate);
 }
 
 } // namespace revng::pipes
@@ -5,9 +5,11 @@
 //
 
 #include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
 
 #include "revng/Storage/ReadableFile.h"
 #include "revng/Storage/WritableFile.h"
+#include "revng/Support/Assert.h"
 
 namespace revng {
 
@@ -35,4 +37,50 @@ public:
   llvm::Error commit() override { return llvm::Error::success(); }
 };
 
+/// The content is written to a temporary file, which replaces the destination
+/// on commit. This way, whoever is reading the previous version of the file
+/// (e.g., through a memory mapping) is not affected.
+///
+/// Since the destination is replaced rather than overwritten, its permissions
+/// have to be copied over explicitly, through setPermissions.
+class ReplacingWritableFile : public WritableFile {
+private:
+  llvm::sys::fs::TempFile File;
+  std::string Path;
+  std::unique_ptr<llvm::raw_fd_ostream> OS;
+  bool Committed = false;
+
+public:
+  ReplacingWritableFile(llvm::sys::fs::TempFile &&File, std::string Path) :
+    File(std::move(File)),
+    Path(std::move(Path)),
+    OS(std::make_unique<llvm::raw_fd_ostream>(this->File.FD, false)) {}
+
+  ~ReplacingWritableFile() override {
+    if (not Committed) {
+      OS.reset();
+      llvm::consumeError(File.discard());
+    }
+  }
+
+  llvm::raw_pwrite_stream &os() override { return *OS; }
+
+  std::error_code setPermissions(llvm::sys::fs::perms Permissions) {
+    return llvm::sys::fs::setPermissions(File.FD, Permissions);
+  }
+
+  llvm::Error commit() override {
+    revng_assert(not Committed);
+    OS->flush();
+    if (std::error_code EC = OS->error()) {
+      return llvm::createStringError(EC,
+                                     "Could not write file %s",
+                                     Path.c_str());
+    }
+
+    Committed = true;
+    return File.keep(Path);
+  }
+};
+
 } // namespace revng
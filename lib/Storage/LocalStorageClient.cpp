@@ -90,6 +90,9 @@ llvm::Error LocalStorageClient::copy(llvm::StringRef Source,
 llvm::Expected<std::unique_ptr<ReadableFile>>
 LocalStorageClient::getReadableFile(llvm::StringRef Path) {
   std::string ResolvedPath = resolvePath(Path);
+  // Large files are memory mapped rather than read. Since getWritableFile
+  // replaces files instead of overwriting them, the mapping never changes
+  // under the feet of the users of the buffer, which can hold views into it.
   auto MaybeBuffer = llvm::MemoryBuffer::getFile(ResolvedPath);
   if (not MaybeBuffer) {
     return llvm::createStringError(MaybeBuffer.getError(),
@@ -100,21 +103,51 @@ LocalStorageClient::getReadableFile(llvm::StringRef Path) {
   return std::make_unique<LocalReadableFile>(std::move(MaybeBuffer.get()));
 }
 
+llvm::Expected<std::unique_ptr<ReadableFile>>
+LocalStorageClient::getReadableFileRange(llvm::StringRef Path,
+                                         uint64_t Offset,
+                                         uint64_t Size) {
+  std::string ResolvedPath = resolvePath(Path);
+  auto MaybeBuffer = llvm::MemoryBuffer::getFileSlice(ResolvedPath,
+                                                      Size,
+                                                      Offset);
+  if (not MaybeBuffer) {
+    return llvm::createStringError(MaybeBuffer.getError(),
+                                   "Could not open file %s for reading",
+                                   ResolvedPath.c_str());
+  }
+
+  return std::make_unique<LocalReadableFile>(std::move(MaybeBuffer.get()));
+}
+
 llvm::Expected<std::unique_ptr<WritableFile>>
 LocalStorageClient::getWritableFile(llvm::StringRef Path,
                                     ContentEncoding Encoding) {
   std::string ResolvedPath = resolvePath(Path);
-  std::error_code EC;
-  auto OS = std::make_unique<llvm::raw_fd_ostream>(ResolvedPath,
-                                                   EC,
-                                                   llvm::sys::fs::OF_None);
-  if (EC) {
+  using llvm::sys::fs::TempFile;
+  auto MaybeFile = TempFile::create(ResolvedPath + ".%%%%%%%%.tmp");
+  if (not MaybeFile) {
+    std::error_code EC = llvm::errorToErrorCode(MaybeFile.takeError());
     return llvm::createStringError(EC,
                                    "Could not open file %s for writing",
                                    ResolvedPath.c_str());
   }
 
-  return std::make_unique<LocalWritableFile>(std::move(OS));
+  auto File = std::make_unique<ReplacingWritableFile>(std::move(*MaybeFile),
+                                                      ResolvedPath);
+
+  // The temporary file replaces the destination, which would otherwise lose
+  // its permissions. New files get the default ones, as with open.
+  if (auto MaybePermissions = llvm::sys::fs::getPermissions(ResolvedPath)) {
+    std::error_code EC = File->setPermissions(*MaybePermissions);
+    if (EC) {
+      return llvm::createStringError(EC,
+                                     "Could not set the permissions of %s",
+                                     ResolvedPath.c_str());
+    }
+  }
+
+  return File;
 }
 
 } // namespace revng
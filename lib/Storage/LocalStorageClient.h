@@ -28,6 +28,11 @@ public:
   llvm::Expected<std::unique_ptr<ReadableFile>>
   getReadableFile(llvm::StringRef Path) override;
 
+  llvm::Expected<std::unique_ptr<ReadableFile>>
+  getReadableFileRange(llvm::StringRef Path,
+                       uint64_t Offset,
+                       uint64_t Size) override;
+
   llvm::Expected<std::unique_ptr<WritableFile>>
   getWritableFile(llvm::StringRef Path, ContentEncoding Encoding) override;
 
@@ -5,19 +5,28 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <fstream>
 
 #include "aws/core/Aws.h"
 #include "aws/core/auth/AWSCredentials.h"
 #include "aws/core/auth/AWSCredentialsProvider.h"
 #include "aws/core/utils/logging/FormattedLogSystem.h"
+#include "aws/core/utils/stream/PreallocatedStreamBuf.h"
 #include "aws/s3/S3Client.h"
+#include "aws/s3/model/AbortMultipartUploadRequest.h"
+#include "aws/s3/model/CompleteMultipartUploadRequest.h"
+#include "aws/s3/model/CompletedMultipartUpload.h"
 #include "aws/s3/model/CopyObjectRequest.h"
+#include "aws/s3/model/CreateMultipartUploadRequest.h"
 #include "aws/s3/model/DeleteObjectRequest.h"
 #include "aws/s3/model/GetObjectRequest.h"
 #include "aws/s3/model/HeadObjectRequest.h"
 #include "aws/s3/model/PutObjectRequest.h"
+#include "aws/s3/model/UploadPartRequest.h"
 
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/YAMLTraits.h"
 
@@ -27,6 +36,7 @@
 #include "revng/Support/PathList.h"
 #include "revng/Support/TemporaryFile.h"
 
+#include "LocalFile.h"
 #include "S3StorageClient.h"
 #include "Utils.h"
 
@@ -52,6 +62,11 @@ using Aws::Utils::Logging::LogLevel;
 
 Logger<> Logger("s3-storage");
 
+llvm::cl::opt<unsigned> S3Jobs("s3-jobs",
+                               llvm::cl::desc("Maximum number of concurrent S3 "
+                                              "transfers"),
+                               llvm::cl::init(16));
+
 class LoggerSystem : public FormattedLogSystem {
 private:
   std::mutex Mutex;
@@ -105,6 +120,61 @@ toError(const Aws::Utils::Outcome<T, Aws::S3::S3Error> &Request) {
   return revng::createError(Request.GetError().GetMessage());
 }
 
+// Files larger than this are transferred in parts of this size, in parallel.
+// Note that S3 requires all the parts of a multipart upload, except for the
+// last one, to be at least 5 MiB.
+static constexpr uint64_t PartSize = 16 * 1024 * 1024;
+
+static constexpr auto AllocationTag = "revng-s3-storage";
+
+/// Stream over a fixed chunk of memory, used as the body of the requests and
+/// of the responses to avoid copying the data being transferred
+class MemoryStream : public Aws::IOStream {
+private:
+  Aws::Utils::Stream::PreallocatedStreamBuf Buffer;
+
+public:
+  MemoryStream(const char *Data, uint64_t Size) :
+    Aws::IOStream(&Buffer),
+    Buffer(reinterpret_cast<unsigned char *>(const_cast<char *>(Data)), Size) {
+  }
+};
+
+static std::shared_ptr<Aws::IOStream> makeBody(llvm::StringRef Data) {
+  return std::make_shared<MemoryStream>(Data.data(), Data.size());
+}
+
+static std::string rangeHeader(uint64_t Offset, uint64_t Size) {
+  revng_assert(Size > 0);
+  return "bytes=" + std::to_string(Offset) + "-"
+         + std::to_string(Offset + Size - 1);
+}
+
+/// Downloads \p Size bytes at \p Offset of the object \p Key into \p Output
+static std::optional<std::string> getRange(Aws::S3::S3Client &Client,
+                                           llvm::StringRef Bucket,
+                                           llvm::StringRef Key,
+                                           uint64_t Offset,
+                                           uint64_t Size,
+                                           char *Output) {
+  Aws::S3::Model::GetObjectRequest Request;
+  Request.SetBucket(Bucket.str());
+  Request.SetKey(Key.str());
+  Request.SetRange(rangeHeader(Offset, Size));
+  Request.SetResponseStreamFactory([Output, Size]() -> Aws::IOStream * {
+    return Aws::New<MemoryStream>(AllocationTag, Output, Size);
+  });
+
+  Aws::S3::Model::GetObjectOutcome Result = Client.GetObject(Request);
+  if (not Result.IsSuccess())
+    return Result.GetError().GetMessage();
+
+  if (static_cast<uint64_t>(Result.GetResult().GetContentLength()) != Size)
+    return "Unexpected size of range " + Request.GetRange();
+
+  return std::nullopt;
+}
+
 std::string S3StorageClient::resolvePath(llvm::StringRef Path) {
   if (Path.empty()) {
     return SubPath;
@@ -177,34 +247,204 @@ public:
     Client(Client) {}
 
   llvm::raw_pwrite_stream &os() override { return *OS; }
+
+  /// Starts the upload of the file, which is completed by
+  /// S3StorageClient::commit
   llvm::Error commit() override {
     OS->flush();
 
-    Aws::S3::Model::PutObjectRequest Request;
-    Request.SetBucket(Client.Bucket);
+    using llvm::MemoryBuffer;
+    constexpr bool RequiresNullTerminator = false;
+    auto MaybeBuffer = MemoryBuffer::getFile(TempFile.path(),
+                                             /* IsText */ false,
+                                             RequiresNullTerminator);
+    if (not MaybeBuffer) {
+      return llvm::createStringError(MaybeBuffer.getError(),
+                                     "Could not open temporary file");
+    }
 
-    if (Encoding == ContentEncoding::Gzip)
-      Request.SetContentEncoding("gzip");
+    // The temporary file and its mapping must outlive the upload
+    auto Source = std::make_shared<S3ReadableFile>(std::move(TempFile),
+                                                   std::move(*MaybeBuffer));
+    llvm::StringRef Data = Source->buffer().getBuffer();
 
     std::string NewFilename = generateNewFilename(Path);
-    Request.SetKey(Client.resolvePath(NewFilename));
+    return Client.upload(Path, NewFilename, Data, Source, Encoding);
+  }
+};
+
+llvm::Error S3StorageClient::upload(llvm::StringRef Path,
+                                    llvm::StringRef Filename,
+                                    llvm::StringRef Data,
+                                    std::shared_ptr<void> Keep,
+                                    ContentEncoding Encoding) {
+  PendingUpload Upload;
+  Upload.Path = Path.str();
+  Upload.Filename = Filename.str();
+  Upload.Key = resolvePath(Filename);
+
+  const auto ToUploadedPart = [](const auto &Outcome) {
+    UploadedPart Result;
+    if (Outcome.IsSuccess())
+      Result.ETag = Outcome.GetResult().GetETag();
+    else
+      Result.Error = Outcome.GetError().GetMessage();
+    return Result;
+  };
+
+  if (Data.size() <= PartSize) {
+    auto Task = [this,
+                 ToUploadedPart,
+                 Key = Upload.Key,
+                 Data,
+                 Keep,
+                 Encoding]() {
+      Aws::S3::Model::PutObjectRequest Request;
+      Request.SetBucket(Bucket);
+      Request.SetKey(Key);
+      if (Encoding == ContentEncoding::Gzip)
+        Request.SetContentEncoding("gzip");
+
+      Request.SetBody(makeBody(Data));
+      return ToUploadedPart(Client.PutObject(Request));
+    };
+    Upload.Parts.push_back(Pool.async(std::move(Task)));
+    trackUpload(std::move(Upload));
+    return llvm::Error::success();
+  }
+
+  Aws::S3::Model::CreateMultipartUploadRequest Request;
+  Request.SetBucket(Bucket);
+  Request.SetKey(Upload.Key);
+  if (Encoding == ContentEncoding::Gzip)
+    Request.SetContentEncoding("gzip");
+
+  auto Result = Client.CreateMultipartUpload(Request);
+  if (not Result.IsSuccess())
+    return toError(Result);
+
+  Upload.UploadID = Result.GetResult().GetUploadId();
+  for (uint64_t Offset = 0; Offset < Data.size(); Offset += PartSize) {
+    int PartNumber = Upload.Parts.size() + 1;
+    auto Task = [this,
+                 ToUploadedPart,
+                 Key = Upload.Key,
+                 UploadID = *Upload.UploadID,
+                 PartNumber,
+                 Part = Data.substr(Offset, PartSize),
+                 Keep]() {
+      Aws::S3::Model::UploadPartRequest Request;
+      Request.SetBucket(Bucket);
+      Request.SetKey(Key);
+      Request.SetUploadId(UploadID);
+      Request.SetPartNumber(PartNumber);
+      Request.SetContentLength(Part.size());
+      Request.SetBody(makeBody(Part));
+      return ToUploadedPart(Client.UploadPart(Request));
+    };
+    Upload.Parts.push_back(Pool.async(std::move(Task)));
+  }
+
+  trackUpload(std::move(Upload));
+  return llvm::Error::success();
+}
 
-    auto File = std::make_shared<Aws::FStream>(TempFile.path().str(),
-                                               std::ios_base::in
-                                                 | std::ios_base::binary);
-    if (File->fail()) {
-      return revng::createError("Could not open temporary file");
+void S3StorageClient::trackUpload(PendingUpload &&Upload) {
+  auto It = FilenameMap.find(Upload.Path);
+  if (It != FilenameMap.end())
+    Upload.PreviousFilename = It->second;
+
+  FilenameMap[Upload.Path] = Upload.Filename;
+  Uploads.push_back(std::move(Upload));
+}
+
+llvm::Error S3StorageClient::finishUpload(const PendingUpload &Upload) {
+  Aws::S3::Model::CompletedMultipartUpload Completed;
+  for (size_t I = 0; I < Upload.Parts.size(); I++) {
+    const UploadedPart &Part = Upload.Parts[I].get();
+    if (Part.Error.has_value()) {
+      return llvm::joinErrors(revng::createError("Could not upload %s: %s",
+                                                 Upload.Path.c_str(),
+                                                 Part.Error->c_str()),
+                              abortUpload(Upload));
     }
 
-    Request.SetBody(File);
-    Aws::S3::Model::PutObjectOutcome Result = Client.Client.PutObject(Request);
-    if (not Result.IsSuccess())
-      return toError(Result);
+    Aws::S3::Model::CompletedPart CompletedPart;
+    CompletedPart.SetETag(Part.ETag);
+    CompletedPart.SetPartNumber(I + 1);
+    Completed.AddParts(std::move(CompletedPart));
+  }
 
-    Client.FilenameMap[Path] = NewFilename;
+  if (not Upload.UploadID.has_value())
     return llvm::Error::success();
+
+  Aws::S3::Model::CompleteMultipartUploadRequest Request;
+  Request.SetBucket(Bucket);
+  Request.SetKey(Upload.Key);
+  Request.SetUploadId(*Upload.UploadID);
+  Request.SetMultipartUpload(std::move(Completed));
+  auto Result = Client.CompleteMultipartUpload(Request);
+  if (not Result.IsSuccess())
+    return toError(Result);
+
+  return llvm::Error::success();
+}
+
+llvm::Error S3StorageClient::abortUpload(const PendingUpload &Upload) {
+  for (const std::shared_future<UploadedPart> &Part : Upload.Parts)
+    Part.wait();
+
+  if (not Upload.UploadID.has_value())
+    return llvm::Error::success();
+
+  // Incomplete multipart uploads take up space until they are aborted
+  Aws::S3::Model::AbortMultipartUploadRequest Request;
+  Request.SetBucket(Bucket);
+  Request.SetKey(Upload.Key);
+  Request.SetUploadId(*Upload.UploadID);
+  auto Result = Client.AbortMultipartUpload(Request);
+  if (not Result.IsSuccess())
+    return toError(Result);
+
+  return llvm::Error::success();
+}
+
+llvm::Error
+S3StorageClient::finishUploads(std::optional<llvm::StringRef> Path) {
+  // Move the uploads to finish at the end, preserving their order
+  const auto IsKept = [&](const PendingUpload &Upload) {
+    return Path.has_value() and Upload.Path != *Path;
+  };
+  auto ToFinish = std::stable_partition(Uploads.begin(), Uploads.end(), IsKept);
+
+  llvm::Error Result = llvm::Error::success();
+  for (auto It = ToFinish; It != Uploads.end(); ++It) {
+    llvm::Error Error = finishUpload(*It);
+    if (not Error)
+      continue;
+
+    Result = llvm::joinErrors(std::move(Result), std::move(Error));
+
+    // Map the path back to the file it had before, unless it has been
+    // replaced or removed in the meantime
+    auto MapIt = FilenameMap.find(It->Path);
+    if (MapIt != FilenameMap.end() and MapIt->second == It->Filename) {
+      if (It->PreviousFilename.has_value())
+        MapIt->second = *It->PreviousFilename;
+      else
+        FilenameMap.erase(MapIt);
+    }
+
+    // Later uploads replacing this one will fall back to what it replaced
+    for (auto Later = std::next(It); Later != Uploads.end(); ++Later) {
+      if (Later->Path == It->Path and Later->PreviousFilename == It->Filename)
+        Later->PreviousFilename = It->PreviousFilename;
+    }
   }
-};
+
+  Uploads.erase(ToFinish, Uploads.end());
+  return Result;
+}
 
 class S3CredentialsProvider : public Aws::Auth::AWSCredentialsProvider {
 private:
@@ -217,7 +457,8 @@ public:
   Aws::Auth::AWSCredentials GetAWSCredentials() override { return Credentials; }
 };
 
-S3StorageClient::S3StorageClient(llvm::StringRef RawURL) {
+S3StorageClient::S3StorageClient(llvm::StringRef RawURL) :
+  Pool(llvm::hardware_concurrency(S3Jobs)) {
   // Url format is:
   // s3://<username>:<password>@<region>+<host:port>/<bucket name>/<path>
   revng_assert(isS3URL(RawURL));
@@ -261,6 +502,12 @@ S3StorageClient::S3StorageClient(llvm::StringRef RawURL) {
   RedactedURL += Bucket + '/' + SubPath;
 }
 
+S3StorageClient::~S3StorageClient() {
+  // Uploads that have not been committed are dropped
+  for (const PendingUpload &Upload : Uploads)
+    llvm::consumeError(abortUpload(Upload));
+}
+
 llvm::Expected<std::unique_ptr<S3StorageClient>>
 S3StorageClient::fromURL(llvm::StringRef URL) {
   if (not SDKIsInitialized)
@@ -306,6 +553,9 @@ std::string S3StorageClient::dumpString() const {
 
 llvm::Expected<PathType> S3StorageClient::type(llvm::StringRef Path) {
   if (FilenameMap.count(Path) > 0) {
+    if (auto Error = finishUploads(Path))
+      return std::move(Error);
+
     Aws::S3::Model::HeadObjectRequest Request;
     Request.SetBucket(Bucket);
     Request.SetKey(resolvePath(FilenameMap[Path]));
@@ -351,6 +601,10 @@ llvm::Error S3StorageClient::copy(llvm::StringRef Source,
                               Source.str().c_str());
   }
 
+  // The destination must not refer to a file whose upload could still fail
+  if (auto Error = finishUploads(Source))
+    return Error;
+
   FilenameMap[Destination] = FilenameMap[Source];
   return llvm::Error::success();
 }
@@ -358,17 +612,43 @@ llvm::Error S3StorageClient::copy(llvm::StringRef Source,
 llvm::Expected<std::unique_ptr<ReadableFile>>
 S3StorageClient::getReadableFile(llvm::StringRef Path) {
   using llvm::MemoryBuffer;
+  namespace fs = llvm::sys::fs;
   if (FilenameMap.count(Path) == 0) {
     return revng::createError("File %s does not exist", Path.str().c_str());
   }
 
+  if (auto Error = finishUploads(Path))
+    return std::move(Error);
+
+  // The first part is downloaded on its own, in order to learn the size of
+  // the file from the Content-Range of the response
+  std::string Key = resolvePath(FilenameMap[Path]);
   Aws::S3::Model::GetObjectRequest Request;
   Request.SetBucket(Bucket);
-  Request.SetKey(resolvePath(FilenameMap[Path]));
+  Request.SetKey(Key);
+  Request.SetRange(rangeHeader(0, PartSize));
 
   Aws::S3::Model::GetObjectOutcome Result = Client.GetObject(Request);
-  if (not Result.IsSuccess())
-    return toError(Result);
+  uint64_t Size = 0;
+  uint64_t FirstPartSize = 0;
+  if (Result.IsSuccess()) {
+    const Aws::S3::Model::GetObjectResult &Object = Result.GetResult();
+    FirstPartSize = Object.GetContentLength();
+    llvm::StringRef ContentRange = Object.GetContentRange();
+    if (ContentRange.empty()) {
+      // The server ignored the range and returned the whole file
+      Size = FirstPartSize;
+    } else if (ContentRange.rsplit('/').second.getAsInteger(10, Size)) {
+      return revng::createError("Unexpected Content-Range %s for %s",
+                                ContentRange.str().c_str(),
+                                Path.str().c_str());
+    }
+  } else {
+    // Empty files have no range to return
+    using Aws::Http::HttpResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE;
+    if (Result.GetError().GetResponseCode() != REQUESTED_RANGE_NOT_SATISFIABLE)
+      return toError(Result);
+  }
 
   auto MaybeTemporary = TemporaryFile::make("revng-s3-storage");
   if (!MaybeTemporary) {
@@ -376,23 +656,60 @@ S3StorageClient::getReadableFile(llvm::StringRef Path) {
                                    "Could not create temporary file");
   }
 
-  std::ofstream OS(MaybeTemporary->path().str(), std::ios::binary);
-  if (OS.fail()) {
-    return revng::createError("Could not open temporary file");
-  }
+  int FD = -1;
+  std::error_code EC = fs::openFileForReadWrite(MaybeTemporary->path(),
+                                                FD,
+                                                fs::CD_OpenExisting,
+                                                fs::OF_None);
+  if (EC)
+    return llvm::createStringError(EC, "Could not open temporary file");
 
-  constexpr size_t BufSize = 4096;
-  llvm::SmallVector<char> Buffer;
-  Buffer.resize_for_overwrite(BufSize);
-  auto &Body = Result.GetResult().GetBody();
+  // The parts are downloaded in parallel, directly into a mapping of the
+  // temporary file
+  std::optional<std::string> DownloadError;
+  if (Size > 0) {
+    EC = fs::resize_file(FD, Size);
+    fs::mapped_file_region Region;
+    if (not EC) {
+      Region = fs::mapped_file_region(fs::convertFDToNativeFile(FD),
+                                      fs::mapped_file_region::readwrite,
+                                      Size,
+                                      0,
+                                      EC);
+    }
 
-  while (!Body.eof()) {
-    Body.read(Buffer.data(), BufSize);
-    OS.write(Buffer.data(), Body.gcount());
+    if (EC) {
+      fs::closeFile(FD);
+      return llvm::createStringError(EC, "Could not map temporary file");
+    }
+
+    auto &Body = Result.GetResult().GetBody();
+    Body.read(Region.data(), FirstPartSize);
+    if (static_cast<uint64_t>(Body.gcount()) != FirstPartSize)
+      DownloadError = "Truncated response";
+
+    std::vector<std::shared_future<std::optional<std::string>>> Parts;
+    for (uint64_t Offset = FirstPartSize; Offset < Size; Offset += PartSize) {
+      uint64_t PartLength = std::min(PartSize, Size - Offset);
+      char *Output = Region.data() + Offset;
+      Parts.push_back(Pool.async([this, Key, Offset, PartLength, Output]() {
+        return getRange(Client, Bucket, Key, Offset, PartLength, Output);
+      }));
+    }
+
+    for (const auto &Part : Parts)
+      if (not DownloadError.has_value())
+        DownloadError = Part.get();
+      else
+        Part.wait();
   }
 
-  OS.flush();
-  OS.close();
+  fs::closeFile(FD);
+  if (DownloadError.has_value()) {
+    return revng::createError("Could not download %s: %s",
+                              Path.str().c_str(),
+                              DownloadError->c_str());
+  }
 
   auto MaybeReadableStream = MemoryBuffer::getFile(MaybeTemporary->path());
   if (not MaybeReadableStream) {
@@ -404,6 +721,32 @@ S3StorageClient::getReadableFile(llvm::StringRef Path) {
                                           std::move(MaybeReadableStream.get()));
 }
 
+llvm::Expected<std::unique_ptr<ReadableFile>>
+S3StorageClient::getReadableFileRange(llvm::StringRef Path,
+                                      uint64_t Offset,
+                                      uint64_t Size) {
+  using llvm::WritableMemoryBuffer;
+  if (FilenameMap.count(Path) == 0) {
+    return revng::createError("File %s does not exist", Path.str().c_str());
+  }
+
+  if (auto Error = finishUploads(Path))
+    return std::move(Error);
+
+  auto Buffer = WritableMemoryBuffer::getNewUninitMemBuffer(Size, Path);
+  if (Size > 0) {
+    std::string Key = resolvePath(FilenameMap[Path]);
+    auto Error = getRange(Client, Bucket, Key, Offset, Size, Buffer->data());
+    if (Error.has_value()) {
+      return revng::createError("Could not download %s: %s",
+                                Path.str().c_str(),
+                                Error->c_str());
+    }
+  }
+
+  return std::make_unique<LocalReadableFile>(std::move(Buffer));
+}
+
 llvm::Expected<std::unique_ptr<WritableFile>>
 S3StorageClient::getWritableFile(llvm::StringRef Path,
                                  ContentEncoding Encoding) {
@@ -426,6 +769,10 @@ S3StorageClient::getWritableFile(llvm::StringRef Path,
 }
 
 llvm::Error S3StorageClient::commit() {
+  // The index must refer only to files that have been fully uploaded
+  if (auto Error = finishUploads())
+    return Error;
+
   std::string SerializedIndex;
 
   {
@@ -4,11 +4,17 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <future>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "aws/core/auth/AWSCredentials.h"
 #include "aws/s3/S3Client.h"
 
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ThreadPool.h"
 
 #include "revng/Storage/StorageClient.h"
 
@@ -16,7 +22,33 @@ namespace revng {
 
 class S3WritableFile;
 
+/// StorageClient backed by an S3 bucket.
+///
+/// Committed files are uploaded in the background, concurrently, and large
+/// ones are split in parts that are uploaded in parallel. Reading a file
+/// waits for its upload, while ::commit waits for all of them before writing
+/// the index. If an upload fails, its path goes back to the file it had
+/// before. Similarly, large files are downloaded in parallel parts.
 class S3StorageClient : public StorageClient {
+private:
+  struct UploadedPart {
+    std::string ETag;
+    /// Set if the upload of the part failed
+    std::optional<std::string> Error;
+  };
+
+  struct PendingUpload {
+    std::string Path;
+    std::string Filename;
+    std::string Key;
+    /// The filename \p Path was mapped to before this upload, restored if the
+    /// upload fails
+    std::optional<std::string> PreviousFilename;
+    /// Set if the file is being uploaded through a multipart upload
+    std::optional<std::string> UploadID;
+    std::vector<std::shared_future<UploadedPart>> Parts;
+  };
+
 private:
   Aws::Auth::AWSCredentials Credentials;
   Aws::S3::S3Client Client;
@@ -24,11 +56,15 @@ private:
   std::string SubPath;
   std::string RedactedURL;
   llvm::StringMap<std::string> FilenameMap;
+  std::vector<PendingUpload> Uploads;
   static constexpr auto IndexName = "index.yml";
+  // Declared last, so that it waits for the running transfers before the rest
+  // of the client is destroyed
+  llvm::ThreadPool Pool;
 
 public:
   S3StorageClient(llvm::StringRef URL);
-  ~S3StorageClient() override = default;
+  ~S3StorageClient() override;
 
   static llvm::Expected<std::unique_ptr<S3StorageClient>>
   fromURL(llvm::StringRef URL);
@@ -48,6 +84,13 @@ public:
   llvm::Expected<std::unique_ptr<ReadableFile>>
   getReadableFile(llvm::StringRef Path) override;
 
+  llvm::Expected<std::unique_ptr<ReadableFile>>
+  getReadableFileRange(llvm::StringRef Path,
+                       uint64_t Offset,
+                       uint64_t Size) override;
+
+  bool prefersRangedReads() const override { return true; }
+
   llvm::Expected<std::unique_ptr<WritableFile>>
   getWritableFile(llvm::StringRef Path, ContentEncoding Encoding) override;
 
@@ -60,6 +103,21 @@ public:
 private:
   std::string dumpString() const override;
   std::string resolvePath(llvm::StringRef Path);
+
+  /// Starts uploading \p Data as \p Filename and maps \p Path to it, \p Keep
+  /// is kept alive until the upload is done
+  llvm::Error upload(llvm::StringRef Path,
+                     llvm::StringRef Filename,
+                     llvm::StringRef Data,
+                     std::shared_ptr<void> Keep,
+                     ContentEncoding Encoding);
+
+  /// Waits for the pending uploads of \p Path, or all of them if not set
+  llvm::Error finishUploads(std::optional<llvm::StringRef> Path = std::nullopt);
+  llvm::Error finishUpload(const PendingUpload &Upload);
+  void trackUpload(PendingUpload &&Upload);
+  llvm::Error abortUpload(const PendingUpload &Upload);
+
   friend class S3WritableFile;
 };
 
@@ -7,6 +7,7 @@
 
 #include "revng/Storage/StorageClient.h"
 
+#include "LocalFile.h"
 #include "LocalStorageClient.h"
 #include "S3StorageClient.h"
 
@@ -19,3 +20,24 @@ revng::StorageClient::fromPathOrURL(llvm::StringRef URL) {
     return std::make_unique<revng::LocalStorageClient>(URL);
   }
 }
+
+llvm::Expected<std::unique_ptr<revng::ReadableFile>>
+revng::StorageClient::getReadableFileRange(llvm::StringRef Path,
+                                           uint64_t Offset,
+                                           uint64_t Size) {
+  auto MaybeFile = getReadableFile(Path);
+  if (not MaybeFile)
+    return MaybeFile.takeError();
+
+  llvm::StringRef Data = MaybeFile.get()->buffer().getBuffer();
+  if (Offset > Data.size() or Size > Data.size() - Offset) {
+    return revng::createError("Range [%zu, %zu) of %s is out of bounds",
+                              static_cast<size_t>(Offset),
+                              static_cast<size_t>(Offset + Size),
+                              Path.str().c_str());
+  }
+
+  using llvm::MemoryBuffer;
+  auto Buffer = MemoryBuffer::getMemBufferCopy(Data.substr(Offset, Size), Path);
+  return std::make_unique<LocalReadableFile>(std::move(Buffer));
+}
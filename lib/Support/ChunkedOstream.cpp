@@ -0,0 +1,33 @@
+/// \file ChunkedOstream.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/ChunkedOstream.h"
+
+using namespace revng;
+
+ChunkedOstream::ChunkedOstream(ChunkCallback Callback, size_t ChunkSize) :
+  llvm::raw_ostream(), Callback(Callback), ChunkSize(ChunkSize) {
+  revng_assert(ChunkSize != 0);
+  SetBufferSize(ChunkSize);
+}
+
+ChunkedOstream::~ChunkedOstream() {
+  flush();
+}
+
+void ChunkedOstream::write_impl(const char *Ptr, size_t Size) {
+  // Writes bigger than the buffer bypass it, split them
+  while (Size != 0) {
+    size_t ToWrite = std::min(Size, ChunkSize);
+    Callback({ Ptr, ToWrite });
+    Ptr += ToWrite;
+    Size -= ToWrite;
+    Position += ToWrite;
+  }
+}
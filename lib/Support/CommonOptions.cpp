@@ -11,3 +11,9 @@ using namespace llvm;
 cl::opt<bool> DebugNames("debug-names",
                          cl::desc("Use friendly names in non-user artifacts"),
                          cl::init(false));
+
+cl::opt<bool> BinaryTupleTrees("binary-tuple-trees",
+                               cl::desc("Store the model and the other tuple "
+                                        "trees in a compact binary format "
+                                        "instead of YAML"),
+                               cl::init(false));
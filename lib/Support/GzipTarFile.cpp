@@ -7,6 +7,8 @@
 
 // Some snippets of code were adapted from llvm/llvm/lib/Support/TarWriter.cpp
 
+#include <optional>
+
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/Path.h"
@@ -140,25 +142,87 @@ static void compressedPadding(llvm::raw_ostream &OS, size_t Size) {
   return gzipCompress(OS, Buffer);
 }
 
+namespace {
+
+/// The gzip streams making up a file of the archive
+class CompressedFile {
+private:
+  llvm::SmallVector<char, 0> Header;
+  llvm::SmallVector<char, 0> CompressedData;
+  // The data compressed by someone else, used in place of CompressedData
+  std::optional<llvm::ArrayRef<char>> Precompressed;
+  llvm::SmallVector<char, 0> Padding;
+
+public:
+  CompressedFile() = default;
+
+  CompressedFile(llvm::StringRef Path,
+                 llvm::ArrayRef<char> Data,
+                 size_t Size,
+                 bool IsCompressed) {
+    llvm::raw_svector_ostream HeaderOS(Header);
+    writeFileHeader(HeaderOS, Path, Size);
+
+    if (IsCompressed) {
+      Precompressed = Data;
+    } else {
+      llvm::raw_svector_ostream DataOS(CompressedData);
+      gzipCompress(DataOS, Data);
+    }
+
+    size_t PaddingSize = computePadding(Size);
+    if (PaddingSize % BlockSize != 0) {
+      llvm::raw_svector_ostream PaddingOS(Padding);
+      compressedPadding(PaddingOS, PaddingSize);
+    }
+  }
+
+  revng::OffsetDescriptor write(llvm::raw_ostream &OS) const {
+    revng::OffsetDescriptor Result = { .Start = OS.tell() };
+    OS << toStringRef(Header);
+
+    Result.DataStart = OS.tell();
+    OS << toStringRef(Precompressed.value_or(CompressedData));
+
+    Result.PaddingStart = OS.tell();
+    OS << toStringRef(Padding);
+
+    Result.End = OS.tell();
+    return Result;
+  }
+
+private:
+  static llvm::StringRef toStringRef(llvm::ArrayRef<char> Data) {
+    return { Data.data(), Data.size() };
+  }
+};
+
+} // namespace
+
 namespace revng {
 
 // Append a given file to an archive.
 OffsetDescriptor GzipTarWriter::append(llvm::StringRef Path,
                                        llvm::ArrayRef<char> Data) {
-  revng_assert(OS != nullptr);
-  revng_assert(not Filenames.contains(Path));
-
-  OffsetDescriptor Result = { .Start = OS->tell() };
-  writeFileHeader(*OS, Path, Data.size());
+  return appendImpl(Path, Data, Data.size(), false);
+}
 
-  Result.DataStart = OS->tell();
-  gzipCompress(*OS, Data);
+OffsetDescriptor
+GzipTarWriter::appendCompressed(llvm::StringRef Path,
+                                llvm::ArrayRef<char> CompressedData,
+                                size_t Size) {
+  return appendImpl(Path, CompressedData, Size, true);
+}
 
-  Result.PaddingStart = OS->tell();
-  if (size_t Padding = computePadding(Data.size()); Padding % BlockSize != 0)
-    compressedPadding(*OS, Padding);
+OffsetDescriptor GzipTarWriter::appendImpl(llvm::StringRef Path,
+                                           llvm::ArrayRef<char> Data,
+                                           size_t Size,
+                                           bool IsCompressed) {
+  revng_assert(OS != nullptr);
+  revng_assert(not Filenames.contains(Path));
 
-  Result.End = OS->tell();
+  OffsetDescriptor Result = CompressedFile(Path, Data, Size, IsCompressed)
+                              .write(*OS);
   Filenames.insert(Path);
   return Result;
 }
@@ -171,6 +235,97 @@ void GzipTarWriter::close() {
   OS = nullptr;
 }
 
+struct ParallelGzipTarWriter::PendingFile {
+  std::string Path;
+  llvm::ArrayRef<char> Data;
+  size_t Size = 0;
+  bool IsCompressed = false;
+  CompressedFile Result;
+  std::shared_future<void> Done;
+};
+
+ParallelGzipTarWriter::ParallelGzipTarWriter(llvm::raw_ostream &OS,
+                                             unsigned Jobs) :
+  OS(&OS) {
+  llvm::ThreadPoolStrategy Strategy = llvm::hardware_concurrency(Jobs);
+  unsigned ThreadCount = Strategy.compute_thread_count();
+  if (ThreadCount > 1)
+    Pool.emplace(Strategy);
+
+  // Bound the memory used by the files waiting to be written
+  MaxInFlight = 4 * ThreadCount;
+}
+
+ParallelGzipTarWriter::~ParallelGzipTarWriter() {
+  revng_assert(OS == nullptr);
+}
+
+void ParallelGzipTarWriter::append(llvm::StringRef Path,
+                                   llvm::ArrayRef<char> Data) {
+  auto File = std::make_unique<PendingFile>();
+  File->Path = Path.str();
+  File->Data = Data;
+  File->Size = Data.size();
+  enqueue(std::move(File));
+}
+
+void ParallelGzipTarWriter::appendCompressed(llvm::StringRef Path,
+                                             llvm::ArrayRef<char> Data,
+                                             size_t Size) {
+  auto File = std::make_unique<PendingFile>();
+  File->Path = Path.str();
+  File->Data = Data;
+  File->Size = Size;
+  File->IsCompressed = true;
+  enqueue(std::move(File));
+}
+
+void ParallelGzipTarWriter::enqueue(std::unique_ptr<PendingFile> &&File) {
+  revng_assert(OS != nullptr);
+  revng_assert(not Filenames.contains(File->Path));
+  Filenames.insert(File->Path);
+
+  while (InFlight.size() >= MaxInFlight)
+    writeOldest();
+
+  PendingFile *Pending = File.get();
+  auto Compress = [Pending]() {
+    Pending->Result = CompressedFile(Pending->Path,
+                                     Pending->Data,
+                                     Pending->Size,
+                                     Pending->IsCompressed);
+  };
+
+  // Going through the pool is pure overhead with a single thread
+  if (not Pool.has_value()) {
+    Compress();
+    Offsets.push_back(Pending->Result.write(*OS));
+    return;
+  }
+
+  Pending->Done = Pool->async(Compress);
+  InFlight.push_back(std::move(File));
+}
+
+void ParallelGzipTarWriter::writeOldest() {
+  PendingFile &Oldest = *InFlight.front();
+  Oldest.Done.wait();
+  Offsets.push_back(Oldest.Result.write(*OS));
+  InFlight.pop_front();
+}
+
+std::vector<OffsetDescriptor> ParallelGzipTarWriter::close() {
+  revng_assert(OS != nullptr);
+  while (not InFlight.empty())
+    writeOldest();
+
+  // The tar archive needs to be ended with two blocks of zeros
+  compressedPadding(*OS, BlockSize * 2);
+  OS->flush();
+  OS = nullptr;
+  return std::move(Offsets);
+}
+
 GzipTarReader::GzipTarReader(llvm::ArrayRef<char> Ref) {
   Archive = archive_read_new();
   revng_assert(Archive != NULL);
@@ -0,0 +1,134 @@
+/// \file OffsetIndex.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/Error.h"
+#include "revng/Support/OffsetIndex.h"
+
+using namespace revng;
+namespace endian = llvm::support::endian;
+
+static constexpr char Magic[4] = { 'R', 'V', 'I', 'X' };
+static constexpr uint32_t Version = 1;
+// Magic + Version + entries count
+static constexpr size_t HeaderSize = 4 + 4 + 8;
+// Key offset + key size + uncompressed size + start + end
+static constexpr size_t RecordSize = 4 + 4 + 8 + 8 + 8;
+
+void revng::writeOffsetIndex(llvm::raw_ostream &OS,
+                             std::vector<OffsetIndexEntry> Entries) {
+  const auto ByKey = [](const OffsetIndexEntry &LHS,
+                        const OffsetIndexEntry &RHS) {
+    return LHS.Key < RHS.Key;
+  };
+  llvm::sort(Entries, ByKey);
+
+  const auto Write32 = [&OS](uint32_t Value) {
+    endian::write<uint32_t>(OS, Value, llvm::support::little);
+  };
+  const auto Write64 = [&OS](uint64_t Value) {
+    endian::write<uint64_t>(OS, Value, llvm::support::little);
+  };
+
+  OS.write(Magic, sizeof(Magic));
+  Write32(Version);
+  Write64(Entries.size());
+
+  uint64_t KeyOffset = HeaderSize + RecordSize * Entries.size();
+  for (size_t I = 0; I < Entries.size(); ++I) {
+    const OffsetIndexEntry &Entry = Entries[I];
+    revng_assert(I == 0 or Entry.Key != Entries[I - 1].Key);
+
+    revng_check(KeyOffset + Entry.Key.size() <= UINT32_MAX);
+    Write32(KeyOffset);
+    Write32(Entry.Key.size());
+    Write64(Entry.UncompressedSize);
+    Write64(Entry.Start);
+    Write64(Entry.End);
+    KeyOffset += Entry.Key.size();
+  }
+
+  for (const OffsetIndexEntry &Entry : Entries)
+    OS << Entry.Key;
+}
+
+bool OffsetIndexReader::isOffsetIndex(llvm::ArrayRef<char> Data) {
+  return Data.size() >= HeaderSize
+         and llvm::ArrayRef<char>(Magic) == Data.take_front(sizeof(Magic));
+}
+
+llvm::Expected<OffsetIndexReader>
+OffsetIndexReader::create(llvm::ArrayRef<char> Data) {
+  if (not isOffsetIndex(Data))
+    return revng::createError("Not an offset index");
+
+  uint32_t IndexVersion = endian::read32le(Data.data() + sizeof(Magic));
+  if (IndexVersion != Version)
+    return revng::createError("Unsupported offset index version %u",
+                              IndexVersion);
+
+  uint64_t Count = endian::read64le(Data.data() + 8);
+  if (Count > (Data.size() - HeaderSize) / RecordSize)
+    return revng::createError("Truncated offset index");
+
+  OffsetIndexReader Result(Data, Count);
+
+  // Check that the keys are in bounds and sorted, so that they can be accessed
+  // and searched without further checks
+  uint64_t KeysStart = HeaderSize + RecordSize * Count;
+  for (size_t I = 0; I < Count; ++I) {
+    const char *Record = Data.data() + HeaderSize + RecordSize * I;
+    uint64_t KeyOffset = endian::read32le(Record);
+    uint64_t KeySize = endian::read32le(Record + 4);
+    if (KeyOffset < KeysStart or KeyOffset + KeySize > Data.size())
+      return revng::createError("Key %zu of the offset index is out of bounds",
+                                I);
+
+    if (I > 0 and Result.key(I) <= Result.key(I - 1))
+      return revng::createError("Offset index is not sorted");
+  }
+
+  return Result;
+}
+
+llvm::StringRef OffsetIndexReader::key(size_t Index) const {
+  const char *Record = Data.data() + HeaderSize + RecordSize * Index;
+  uint32_t KeyOffset = endian::read32le(Record);
+  uint32_t KeySize = endian::read32le(Record + 4);
+  return { Data.data() + KeyOffset, KeySize };
+}
+
+OffsetIndexEntry OffsetIndexReader::operator[](size_t Index) const {
+  revng_assert(Index < Count);
+  const char *Record = Data.data() + HeaderSize + RecordSize * Index;
+  return { .Key = key(Index),
+           .UncompressedSize = endian::read64le(Record + 8),
+           .Start = endian::read64le(Record + 16),
+           .End = endian::read64le(Record + 24) };
+}
+
+std::optional<OffsetIndexEntry>
+OffsetIndexReader::find(llvm::StringRef Key) const {
+  size_t Low = 0;
+  size_t High = Count;
+  while (Low < High) {
+    size_t Middle = Low + (High - Low) / 2;
+    llvm::StringRef MiddleKey = key(Middle);
+    if (MiddleKey == Key)
+      return (*this)[Middle];
+
+    if (MiddleKey < Key)
+      Low = Middle + 1;
+    else
+      High = Middle;
+  }
+
+  return std::nullopt;
+}
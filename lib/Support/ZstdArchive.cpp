@@ -0,0 +1,327 @@
+/// \file ZstdArchive.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <utility>
+
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+
+#include "revng/Support/Error.h"
+#include "revng/Support/ZstdArchive.h"
+
+#include "zdict.h"
+
+using namespace revng;
+namespace endian = llvm::support::endian;
+
+static constexpr char Magic[4] = { 'R', 'V', 'Z', 'A' };
+static constexpr uint32_t Version = 1;
+// Magic + Version + dictionary size
+static constexpr size_t HeaderSize = 4 + 4 + 8;
+// Index offset + entries count + Magic + Version
+static constexpr size_t FooterSize = 8 + 8 + 4 + 4;
+static constexpr uint32_t ZstdFrameMagic = 0xFD2FB528;
+
+static void zstdFree(ZSTD_CCtx *Ctx) {
+  size_t RC = ZSTD_freeCCtx(Ctx);
+  revng_assert(ZSTD_isError(RC) == 0);
+}
+
+static void zstdFree(ZSTD_DCtx *Ctx) {
+  size_t RC = ZSTD_freeDCtx(Ctx);
+  revng_assert(ZSTD_isError(RC) == 0);
+}
+
+static void zstdFree(ZSTD_CDict *Dictionary) {
+  size_t RC = ZSTD_freeCDict(Dictionary);
+  revng_assert(ZSTD_isError(RC) == 0);
+}
+
+static void zstdFree(ZSTD_DDict *Dictionary) {
+  size_t RC = ZSTD_freeDDict(Dictionary);
+  revng_assert(ZSTD_isError(RC) == 0);
+}
+
+static void writeU32(llvm::raw_ostream &OS, uint32_t Value) {
+  endian::write<uint32_t>(OS, Value, llvm::support::little);
+}
+
+static void writeU64(llvm::raw_ostream &OS, uint64_t Value) {
+  endian::write<uint64_t>(OS, Value, llvm::support::little);
+}
+
+llvm::SmallVector<char>
+revng::zstdTrainDictionary(llvm::ArrayRef<llvm::ArrayRef<char>> Samples,
+                           size_t MaxSize) {
+  std::vector<char> Buffer;
+  std::vector<size_t> Sizes;
+  Sizes.reserve(Samples.size());
+  for (llvm::ArrayRef<char> Sample : Samples) {
+    Buffer.insert(Buffer.end(), Sample.begin(), Sample.end());
+    Sizes.push_back(Sample.size());
+  }
+
+  llvm::SmallVector<char> Result;
+  Result.resize_for_overwrite(MaxSize);
+  size_t RC = ZDICT_trainFromBuffer(Result.data(),
+                                    Result.size(),
+                                    Buffer.data(),
+                                    Sizes.data(),
+                                    Sizes.size());
+  if (ZDICT_isError(RC))
+    return {};
+
+  Result.truncate(RC);
+  return Result;
+}
+
+ZstdArchiveWriter::ZstdArchiveWriter(llvm::raw_ostream &OS,
+                                     llvm::ArrayRef<char> DictionaryData,
+                                     int CompressionLevel) :
+  OS(&OS),
+  ArchiveStart(OS.tell()),
+  CompressionLevel(CompressionLevel),
+  Ctx(ZSTD_createCCtx(), zstdFree),
+  Dictionary(nullptr, zstdFree) {
+  revng_assert(CompressionLevel >= 1 and CompressionLevel <= 19);
+
+  if (not DictionaryData.empty()) {
+    Dictionary.reset(ZSTD_createCDict(DictionaryData.data(),
+                                      DictionaryData.size(),
+                                      CompressionLevel));
+    revng_assert(Dictionary != nullptr);
+  }
+
+  OS.write(Magic, sizeof(Magic));
+  writeU32(OS, Version);
+  writeU64(OS, DictionaryData.size());
+  OS.write(DictionaryData.data(), DictionaryData.size());
+}
+
+ZstdArchiveWriter::ZstdArchiveWriter(ZstdArchiveWriter &&Other) :
+  OS(std::exchange(Other.OS, nullptr)),
+  ArchiveStart(Other.ArchiveStart),
+  CompressionLevel(Other.CompressionLevel),
+  Filenames(std::move(Other.Filenames)),
+  Entries(std::move(Other.Entries)),
+  Ctx(std::move(Other.Ctx)),
+  Dictionary(std::move(Other.Dictionary)),
+  Buffer(std::move(Other.Buffer)) {
+}
+
+ZstdArchiveWriter &ZstdArchiveWriter::operator=(ZstdArchiveWriter &&Other) {
+  // The archive being replaced must have been terminated
+  revng_assert(OS == nullptr);
+
+  OS = std::exchange(Other.OS, nullptr);
+  ArchiveStart = Other.ArchiveStart;
+  CompressionLevel = Other.CompressionLevel;
+  Filenames = std::move(Other.Filenames);
+  Entries = std::move(Other.Entries);
+  Ctx = std::move(Other.Ctx);
+  Dictionary = std::move(Other.Dictionary);
+  Buffer = std::move(Other.Buffer);
+  return *this;
+}
+
+void ZstdArchiveWriter::append(llvm::StringRef Name,
+                               llvm::ArrayRef<char> Data) {
+  revng_assert(OS != nullptr);
+
+  Buffer.resize_for_overwrite(ZSTD_compressBound(Data.size()));
+  size_t RC = 0;
+  if (Dictionary != nullptr) {
+    RC = ZSTD_compress_usingCDict(&*Ctx,
+                                  Buffer.data(),
+                                  Buffer.size(),
+                                  Data.data(),
+                                  Data.size(),
+                                  &*Dictionary);
+  } else {
+    RC = ZSTD_compressCCtx(&*Ctx,
+                           Buffer.data(),
+                           Buffer.size(),
+                           Data.data(),
+                           Data.size(),
+                           CompressionLevel);
+  }
+  revng_assert(ZSTD_isError(RC) == 0);
+
+  write(Name, { Buffer.data(), RC }, Data.size());
+}
+
+void ZstdArchiveWriter::appendCompressed(llvm::StringRef Name,
+                                         llvm::ArrayRef<char> Frame,
+                                         size_t Size) {
+  revng_assert(OS != nullptr);
+  write(Name, Frame, Size);
+}
+
+void ZstdArchiveWriter::write(llvm::StringRef Name,
+                              llvm::ArrayRef<char> Frame,
+                              size_t Size) {
+  auto [_, Inserted] = Filenames.insert(Name);
+  revng_assert(Inserted);
+
+  uint64_t Start = OS->tell() - ArchiveStart;
+  OS->write(Frame.data(), Frame.size());
+  Entries.push_back({ .Name = Name.str(),
+                      .Start = Start,
+                      .CompressedSize = Frame.size(),
+                      .Size = Size });
+}
+
+void ZstdArchiveWriter::close() {
+  revng_assert(OS != nullptr);
+
+  uint64_t IndexStart = OS->tell() - ArchiveStart;
+  for (const ZstdArchiveEntry &Entry : Entries) {
+    writeU64(*OS, Entry.Name.size());
+    OS->write(Entry.Name.data(), Entry.Name.size());
+    writeU64(*OS, Entry.Start);
+    writeU64(*OS, Entry.CompressedSize);
+    writeU64(*OS, Entry.Size);
+  }
+
+  writeU64(*OS, IndexStart);
+  writeU64(*OS, Entries.size());
+  OS->write(Magic, sizeof(Magic));
+  writeU32(*OS, Version);
+  OS->flush();
+
+  OS = nullptr;
+}
+
+ZstdArchiveReader::ZstdArchiveReader(llvm::ArrayRef<char> Data) :
+  Data(Data), Dictionary(nullptr, zstdFree) {
+}
+
+bool ZstdArchiveReader::isZstdArchive(llvm::ArrayRef<char> Data) {
+  return Data.size() >= HeaderSize + FooterSize
+         and llvm::ArrayRef<char>(Magic) == Data.take_front(sizeof(Magic));
+}
+
+llvm::Expected<ZstdArchiveReader>
+ZstdArchiveReader::create(llvm::ArrayRef<char> Data) {
+  if (not isZstdArchive(Data))
+    return revng::createError("Not a zstd archive");
+
+  const char *Footer = Data.data() + Data.size() - FooterSize;
+  uint64_t IndexStart = endian::read64le(Footer);
+  uint64_t EntriesCount = endian::read64le(Footer + 8);
+  uint32_t HeaderVersion = endian::read32le(Data.data() + sizeof(Magic));
+  uint32_t FooterVersion = endian::read32le(Footer + 20);
+  if (llvm::ArrayRef<char>(Magic) != llvm::ArrayRef(Footer + 16, 4))
+    return revng::createError("Truncated zstd archive");
+
+  if (HeaderVersion != Version or FooterVersion != Version)
+    return revng::createError("Unsupported zstd archive version %u",
+                              HeaderVersion);
+
+  uint64_t DictionarySize = endian::read64le(Data.data() + 8);
+  uint64_t IndexEnd = Data.size() - FooterSize;
+  if (DictionarySize > IndexEnd - HeaderSize
+      or IndexStart < HeaderSize + DictionarySize or IndexStart > IndexEnd)
+    return revng::createError("Malformed zstd archive header");
+
+  ZstdArchiveReader Result(Data);
+  Result.DictionaryData = Data.slice(HeaderSize, DictionarySize);
+  if (DictionarySize != 0) {
+    Result.Dictionary.reset(ZSTD_createDDict(Result.DictionaryData.data(),
+                                             DictionarySize));
+    if (Result.Dictionary == nullptr)
+      return revng::createError("Invalid zstd archive dictionary");
+  }
+
+  // Parse the index, checking that each entry points to a zstd frame between
+  // the header and the index
+  llvm::ArrayRef<char> Index = Data.slice(IndexStart, IndexEnd - IndexStart);
+  const auto ReadU64 = [&Index](uint64_t &Value) {
+    if (Index.size() < 8)
+      return false;
+    Value = endian::read64le(Index.data());
+    Index = Index.drop_front(8);
+    return true;
+  };
+
+  uint64_t FramesStart = HeaderSize + DictionarySize;
+  for (uint64_t I = 0; I < EntriesCount; ++I) {
+    ZstdArchiveEntry Entry;
+    uint64_t NameSize = 0;
+    if (not ReadU64(NameSize) or NameSize > Index.size())
+      return revng::createError("Malformed zstd archive index");
+
+    Entry.Name = std::string(Index.data(), NameSize);
+    Index = Index.drop_front(NameSize);
+
+    if (not ReadU64(Entry.Start) or not ReadU64(Entry.CompressedSize)
+        or not ReadU64(Entry.Size))
+      return revng::createError("Malformed zstd archive index");
+
+    if (Entry.Start < FramesStart or Entry.Start > IndexStart
+        or Entry.CompressedSize < 4
+        or Entry.CompressedSize > IndexStart - Entry.Start
+        or endian::read32le(Data.data() + Entry.Start) != ZstdFrameMagic)
+      return revng::createError("Entry %s of the zstd archive is out of "
+                                "bounds",
+                                Entry.Name.c_str());
+
+    Result.Entries.push_back(std::move(Entry));
+  }
+
+  if (not Index.empty())
+    return revng::createError("Malformed zstd archive index");
+
+  return Result;
+}
+
+llvm::Error ZstdArchiveReader::decompress(llvm::raw_ostream &OS,
+                                          llvm::ArrayRef<char> Frame,
+                                          size_t Size) const {
+  std::unique_ptr<ZSTD_DCtx, DCtxDeleter> Ctx(ZSTD_createDCtx(), zstdFree);
+  if (Dictionary != nullptr) {
+    size_t RC = ZSTD_DCtx_refDDict(&*Ctx, &*Dictionary);
+    if (ZSTD_isError(RC))
+      return revng::createError("Cannot use the zstd archive dictionary: %s",
+                                ZSTD_getErrorName(RC));
+  }
+
+  // Decompress in chunks, so that big files never need to be entirely in
+  // memory
+  llvm::SmallVector<char> Buffer;
+  Buffer.resize_for_overwrite(std::clamp<size_t>(Size,
+                                                 1,
+                                                 ZSTD_DStreamOutSize()));
+
+  ZSTD_inBuffer Input = { Frame.data(), Frame.size(), 0 };
+  size_t Decompressed = 0;
+  while (true) {
+    ZSTD_outBuffer Output = { Buffer.data(), Buffer.size(), 0 };
+    size_t RC = ZSTD_decompressStream(&*Ctx, &Output, &Input);
+    if (ZSTD_isError(RC))
+      return revng::createError("Corrupt zstd frame: %s",
+                                ZSTD_getErrorName(RC));
+
+    OS.write(Buffer.data(), Output.pos);
+    Decompressed += Output.pos;
+
+    // The frame is complete
+    if (RC == 0)
+      break;
+
+    // No progress can be made, the frame is truncated
+    if (Input.pos == Input.size and Output.pos < Output.size)
+      return revng::createError("Truncated zstd frame");
+  }
+
+  if (Decompressed != Size)
+    return revng::createError("The zstd frame holds %zu bytes instead of %zu",
+                              Decompressed,
+                              Size);
+
+  return llvm::Error::success();
+}
@@ -15,11 +15,10 @@
 #include "revng/Support/Statistics.h"
 #include "revng/ValueMaterializer/AdvancedValueInfo.h"
 #include "revng/ValueMaterializer/DataFlowGraph.h"
+#include "revng/ValueMaterializer/Helpers.h"
 
 using namespace llvm;
 
-static Logger<> AVILogger("avi");
-
 inline RunningStatistics AVICFEGSizeStatitistics("avi-cfeg-size");
 
 AdvancedValueInfoMFI::LatticeElement
@@ -122,7 +122,7 @@ class Manager:
         target: None | str | List[str],
         container_name: Optional[str] = None,
         only_if_ready=False,
-    ) -> Dict[str, str | bytes] | Error:
+    ) -> Dict[str, str | memoryview] | Error:
         step = self.step_from_name(step_name)
         if step is None:
             raise RevngException(f"Invalid step {step_name}")
@@ -164,13 +164,14 @@ class Manager:
         if product == ffi.NULL:
             return error
 
-        result = {}
-        for produced_target in targets:
-            extracted_target = produced_target.extract()
-            if extracted_target is None:
-                raise RevngException(f"Target {produced_target.serialize()} extraction failed")
-            result[produced_target.serialize()] = extracted_target
-        return result
+        extracted = Target.extract_many(_container, targets)
+        if extracted is None:
+            # Find out which target could not be extracted
+            for produced_target in targets:
+                if produced_target.extract() is None:
+                    raise RevngException(f"Target {produced_target.serialize()} extraction failed")
+            raise RevngException("Targets extraction failed")
+        return {t.serialize(): e for t, e in zip(targets, extracted)}
 
     def create_target(
         self, step_name: str, container_name: str, target_path: str, use_artifact_kind: bool
@@ -2,11 +2,13 @@
 # This file is distributed under the MIT License. See LICENSE.md for details.
 #
 
+import struct
 from collections.abc import Sequence
 from typing import Any, Generator, List, Optional
 
 from ._capi import _api, ffi
-from .utils import convert_buffer, make_c_string, make_python_string
+from .errors import Error
+from .utils import buffer_view, convert_buffer, make_c_string, make_python_string
 
 
 class Target:
@@ -53,14 +55,44 @@ class Target:
         _serialized = _api.rp_target_create_serialized_string(self._target)
         return make_python_string(_serialized)
 
-    def extract(self) -> str | bytes | None:
+    def extract(self) -> str | memoryview | None:
         _buffer = _api.rp_container_extract_one(self._container, self._target)
         if _buffer == ffi.NULL:
             return None
         size = _api.rp_buffer_size(_buffer)
         data = _api.rp_buffer_data(_buffer)
         _mime = _api.rp_container_get_mime(self._container)
-        return convert_buffer(data, size, make_python_string(_mime))
+        return convert_buffer(buffer_view(_buffer, data, size), make_python_string(_mime))
+
+    @staticmethod
+    def extract_many(container, targets: List["Target"]) -> List[str | memoryview] | None:
+        """Extracts all the targets from container with a single call, the
+        binary contents are views on the returned buffer, not copies"""
+        if len(targets) == 0:
+            return []
+
+        error = Error()
+        _buffer = _api.rp_container_extract_many(
+            container, len(targets), [t._target for t in targets], error._error
+        )
+        if _buffer == ffi.NULL:
+            if not error.is_success():
+                raise error.to_exception()
+            return None
+
+        size = _api.rp_buffer_size(_buffer)
+        view = buffer_view(_buffer, _api.rp_buffer_data(_buffer), size)
+        mime = make_python_string(_api.rp_container_get_mime(container))
+
+        # The buffer starts with the sizes of the targets, followed by their
+        # contents
+        sizes = struct.unpack_from(f"<{len(targets)}Q", view)
+        offset = struct.calcsize(f"<{len(targets)}Q")
+        result: List[str | memoryview] = []
+        for target_size in sizes:
+            result.append(convert_buffer(view[offset : offset + target_size], mime))
+            offset += target_size
+        return result
 
     def as_dict(self):
         return {
@@ -31,12 +31,24 @@ def save_file(path: Path, content: bytes | str):
             bytes_f.write(content)
 
 
-def convert_buffer(ptr: ffi.CData, size: int, mime: str) -> str | bytes:
-    if ptr == ffi.NULL:
-        return b""
+def buffer_view(owner: ffi.CData, ptr: ffi.CData, size: int) -> memoryview:
+    """Wraps the size bytes at ptr, which belong to owner, in a memoryview
+    without copying them. The view keeps owner alive."""
+    if ptr == ffi.NULL or size == 0:
+        return memoryview(b"")
 
-    data = ffi.unpack(ptr, size)
-    if mime.startswith("text/") or mime == "image/svg":
-        return data.decode("utf-8")
+    # ffi.buffer keeps alive the pointer it has been created from, tie the
+    # lifetime of owner to it
+    keeper = ffi.gc(ptr, lambda _, owner=owner: None)
+    return memoryview(ffi.buffer(keeper, size))
+
+
+def is_text_mime(mime: str) -> bool:
+    return mime.startswith("text/") or mime == "image/svg"
+
+
+def convert_buffer(view: memoryview, mime: str) -> str | memoryview:
+    if is_text_mime(mime):
+        return str(view, "utf-8")
     else:
-        return data
+        return view
@@ -12,7 +12,7 @@ def project_workdir() -> Optional[str]:
     return os.environ.get("REVNG_DATA_DIR")
 
 
-def produce_serializer(input_: Dict[str, str | bytes]) -> str:
+def produce_serializer(input_: Dict[str, str | memoryview]) -> str:
     return json.dumps(
         {
             key: (value if isinstance(value, str) else b64encode(value).decode("utf-8"))
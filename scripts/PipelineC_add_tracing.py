@@ -8,7 +8,7 @@ from dataclasses import dataclass
 from pathlib import Path
 from typing import List
 
-from pycparser.c_ast import FuncDecl, NodeVisitor, TypeDecl, Typedef
+from pycparser.c_ast import FuncDecl, NodeVisitor, PtrDecl, TypeDecl, Typedef
 from pycparser.c_generator import CGenerator
 from pycparser.c_parser import CParser
 
@@ -52,6 +52,9 @@ class Visitor(NodeVisitor):
         self.functions.append(Function(name, arguments, return_type))
 
     def visit_Typedef(self, node: Typedef):  # noqa: N802
+        # Function pointers (i.e. callbacks) are not opaque types
+        if isinstance(node.type, PtrDecl) and isinstance(node.type.type, FuncDecl):
+            return
         if node.name not in {"bool", "uint8_t", "uint32_t", "uint64_t"}:
             self.types.append(node.name)
 
@@ -195,6 +195,9 @@ std::optional<TupleTreePath> stringAsPath</*= base_namespace =*/::/*= root_type
 template
 std::optional<std::string> pathAsString</*= base_namespace =*/::/*= root_type =*/>(const TupleTreePath &Path);
 
+template
+std::optional<uint64_t> hashByPath</*= base_namespace =*/::/*= root_type =*/>(const TupleTreePath &Path, const /*= base_namespace =*/::/*= root_type =*/ &M);
+
 template
 bool TupleTree</*= base_namespace =*/::/*= root_type =*/>::verifyReferences(bool Assert) const;
 
@@ -299,6 +299,9 @@ std::optional<TupleTreePath> stringAsPath</*= base_namespace =*/::/*= root_type
 extern template
 std::optional<std::string> pathAsString</*= base_namespace =*/::/*= root_type =*/>(const TupleTreePath &Path);
 
+extern template
+std::optional<uint64_t> hashByPath</*= base_namespace =*/::/*= root_type =*/>(const TupleTreePath &Path, const /*= base_namespace =*/::/*= root_type =*/ &M);
+
 extern template
 bool TupleTree</*= base_namespace =*/::/*= root_type =*/>::verifyReferences(bool Assert) const;
 
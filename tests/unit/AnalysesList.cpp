@@ -0,0 +1,128 @@
+/// \file AnalysesList.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Pipeline/AnalysesList.h"
+#include "revng/Pipeline/Analysis.h"
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/ExecutionContext.h"
+#include "revng/Pipeline/Runner.h"
+#include "revng/Pipes/ModelGlobal.h"
+#include "revng/Support/MetaAddress.h"
+
+#define BOOST_TEST_MODULE AnalysesList
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace pipeline;
+
+/// The thread that runs the analyses list
+static std::thread::id MainThread;
+
+/// How many analyses have run on a thread other than MainThread
+static std::atomic<unsigned> RunOnOtherThreads = 0;
+
+static void recordThread() {
+  if (std::this_thread::get_id() != MainThread)
+    ++RunOnOtherThreads;
+}
+
+/// Sets the architecture of the model
+struct SetArchitectureAnalysis {
+  static constexpr auto Name = "set-architecture";
+
+  std::vector<std::vector<Kind *>> AcceptedKinds = {};
+
+  GlobalsAccess AccessedGlobals = { .Read = {},
+                                    .Written = { "model.yml/Architecture" } };
+
+  llvm::Error run(ExecutionContext &EC) {
+    recordThread();
+    auto &Model = revng::getWritableModelFromContext(EC);
+    Model->Architecture() = model::Architecture::x86_64;
+    return llvm::Error::success();
+  }
+};
+
+/// Sets the entry point of the model, depending on its default ABI
+struct SetEntryPointAnalysis {
+  static constexpr auto Name = "set-entry-point";
+
+  std::vector<std::vector<Kind *>> AcceptedKinds = {};
+
+  GlobalsAccess AccessedGlobals = { .Read = { "model.yml/DefaultABI" },
+                                    .Written = { "model.yml/EntryPoint" } };
+
+  llvm::Error run(ExecutionContext &EC) {
+    recordThread();
+    auto &Model = revng::getWritableModelFromContext(EC);
+    bool HasABI = Model->DefaultABI() != model::ABI::Invalid;
+    auto EntryPoint = HasABI ? "0x2000:Code_x86_64" : "0x1000:Code_x86_64";
+    Model->EntryPoint() = MetaAddress::fromString(EntryPoint);
+    return llvm::Error::success();
+  }
+};
+
+/// Runs the two analyses above as an analyses list using \p Jobs threads and
+/// returns the resulting model
+static std::string runAnalysesList(unsigned Jobs) {
+  auto *Option = llvm::cl::getRegisteredOptions()["pipeline-jobs"];
+  auto &PipelineJobs = *static_cast<llvm::cl::opt<unsigned> *>(Option);
+  unsigned OldJobs = PipelineJobs;
+  PipelineJobs = Jobs;
+
+  Context Context;
+  Context.addGlobal<revng::ModelGlobal>(revng::ModelGlobalName);
+
+  Runner Pipeline(Context);
+  Step &Begin = Pipeline.emplaceStep("", "begin", "");
+  Begin.addAnalysis(SetArchitectureAnalysis::Name,
+                    AnalysisWrapper::make<SetArchitectureAnalysis>({}));
+  Begin.addAnalysis(SetEntryPointAnalysis::Name,
+                    AnalysisWrapper::make<SetEntryPointAnalysis>({}));
+
+  AnalysesList List("test-list");
+  List.addAnalysisReference("begin", SetArchitectureAnalysis::Name);
+  List.addAnalysisReference("begin", SetEntryPointAnalysis::Name);
+
+  MainThread = std::this_thread::get_id();
+  RunOnOtherThreads = 0;
+  TargetInStepSet Invalidations;
+  auto MaybeDiff = Pipeline.runAnalyses(List, Invalidations);
+  BOOST_TEST(!!MaybeDiff);
+  if (not MaybeDiff)
+    llvm::consumeError(MaybeDiff.takeError());
+
+  PipelineJobs = OldJobs;
+
+  std::string Result;
+  llvm::raw_string_ostream Stream(Result);
+  llvm::cantFail(Context.getGlobals().serialize(revng::ModelGlobalName,
+                                                Stream));
+  Stream.flush();
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(IndependentAnalysesRunConcurrently) {
+  std::string Serial = runAnalysesList(1);
+  BOOST_TEST(RunOnOtherThreads.load() == 0U);
+
+  std::string Concurrent = runAnalysesList(2);
+  BOOST_TEST(RunOnOtherThreads.load() == 2U);
+
+  BOOST_TEST(Serial == Concurrent);
+  BOOST_TEST(Serial.find("x86_64") != std::string::npos);
+  BOOST_TEST(Serial.find("0x1000:Code_x86_64") != std::string::npos);
+}
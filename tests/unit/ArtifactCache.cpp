@@ -0,0 +1,256 @@
+/// \file ArtifactCache.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <map>
+#include <string>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/ArtifactCache.h"
+#include "revng/Pipeline/Container.h"
+#include "revng/Pipeline/ContainerFactory.h"
+#include "revng/Pipeline/ContainerSet.h"
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Contract.h"
+#include "revng/Pipeline/ExecutionContext.h"
+#include "revng/Pipeline/Kind.h"
+#include "revng/Pipeline/Pipe.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/Pipes/ModelGlobal.h"
+
+#define BOOST_TEST_MODULE ArtifactCache
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace pipeline;
+
+static auto Root = defineRootRank<"root">();
+static auto FunctionRank = defineRank<"function", std::string>(Root);
+
+static SingleElementKind RootKind("root-kind", Root, {}, {});
+
+class FunctionKindType : public Kind {
+public:
+  using Kind::Kind;
+
+  void appendAllTargets(const pipeline::Context &Context,
+                        pipeline::TargetsList &Out) const override {
+    Out.push_back(Target("f1", *this));
+    Out.push_back(Target("f2", *this));
+  }
+};
+
+static FunctionKindType FunctionKind("function-kind", FunctionRank, {}, {});
+
+static const Target F1("f1", FunctionKind);
+static const Target F2("f2", FunctionKind);
+
+/// A container associating a string to each target, serialized one target per
+/// line
+class ValuesContainer : public Container<ValuesContainer> {
+public:
+  static inline const llvm::StringRef MIMEType = "application/x.test.values";
+  static inline const char *Name = "Name";
+  static char ID;
+
+private:
+  std::map<Target, std::string> Map;
+
+public:
+  ValuesContainer(llvm::StringRef Name) : Container<ValuesContainer>(Name) {}
+
+  static std::vector<pipeline::Kind *> possibleKinds() {
+    return { &RootKind, &FunctionKind };
+  }
+
+public:
+  std::string &get(const Target &Target) { return Map[Target]; }
+  const std::map<Target, std::string> &getMap() const { return Map; }
+
+public:
+  std::unique_ptr<ContainerBase>
+  cloneFiltered(const TargetsList &Targets) const final {
+    auto Result = std::make_unique<ValuesContainer>(name());
+    for (const Target &Target : Targets)
+      if (Map.contains(Target))
+        Result->Map[Target] = Map.at(Target);
+    return Result;
+  }
+
+  TargetsList enumerate() const final {
+    TargetsList Result;
+    for (const auto &Entry : Map)
+      Result.push_back(Entry.first);
+    return Result;
+  }
+
+  bool remove(const TargetsList &Targets) final {
+    bool RemovedAll = true;
+    for (const Target &Target : Targets)
+      RemovedAll = Map.erase(Target) != 0 and RemovedAll;
+    return RemovedAll;
+  }
+
+  llvm::Error extractOne(llvm::raw_ostream &OS,
+                         const Target &Target) const final {
+    OS << Map.at(Target);
+    return llvm::Error::success();
+  }
+
+  llvm::Error serialize(llvm::raw_ostream &OS) const final {
+    for (const auto &[Target, Value] : Map)
+      OS << Target.getKind().name() << " " << Target.toString() << " " << Value
+         << "\n";
+    return llvm::Error::success();
+  }
+
+  llvm::Error deserialize(const llvm::MemoryBuffer &Buffer) final {
+    llvm::SmallVector<llvm::StringRef> Lines;
+    Buffer.getBuffer().split(Lines, '\n', -1, false);
+    for (llvm::StringRef Line : Lines) {
+      auto [KindName, Rest] = Line.split(' ');
+      auto [TargetName, Value] = Rest.split(' ');
+      if (KindName == RootKind.name())
+        Map[Target(RootKind)] = Value.str();
+      else
+        Map[Target(TargetName.split(':').first, FunctionKind)] = Value.str();
+    }
+    return llvm::Error::success();
+  }
+
+  void clear() final { Map.clear(); }
+
+private:
+  void mergeBackImpl(ValuesContainer &&Other) final {
+    Other.Map.merge(std::move(Map));
+    Map = std::move(Other.Map);
+  }
+};
+
+char ValuesContainer::ID;
+
+/// Appends the architecture of the model to the value of the root target
+struct DecoratePipe {
+  static constexpr auto Name = "decorate";
+
+  /// How many times the pipe has actually run
+  static inline unsigned Runs = 0;
+
+  std::vector<ContractGroup> getContract() const {
+    return { ContractGroup(RootKind,
+                           0,
+                           FunctionKind,
+                           1,
+                           InputPreservation::Preserve) };
+  }
+
+  void run(ExecutionContext &EC,
+           const ValuesContainer &Input,
+           ValuesContainer &Out) {
+    ++Runs;
+    const std::string &Prefix = Input.getMap().at(Target(RootKind));
+    for (const Target &Requested : EC.getRequestedTargetsFor(Out)) {
+      const auto &Model = revng::getModelFromContext(EC);
+      auto Architecture = static_cast<int>(Model->Architecture());
+      Out.get(Requested) = Prefix + "-" + std::to_string(Architecture);
+      EC.commit(Requested, Out);
+    }
+  }
+};
+
+struct CachedRun {
+  std::map<Target, std::string> Output;
+  bool PipeHasRun = false;
+};
+
+/// Produces F1 and F2 through DecoratePipe, going through \p Cache the same
+/// way Step::run does
+static CachedRun runCached(const ArtifactCache &Cache,
+                           Context &Context,
+                           llvm::StringRef InputValue) {
+  auto Factory = ContainerFactory::create<ValuesContainer>();
+  ContainerSet Containers;
+  Containers.add("input", Factory, Factory("input"));
+  Containers.add("output", Factory, Factory("output"));
+  auto &Input = llvm::cast<ValuesContainer>(Containers["input"]);
+  Input.get(Target(RootKind)) = InputValue.str();
+
+  auto Pipe = PipeWrapper::bind<DecoratePipe>("input", "output");
+  ContainerToTargetsMap ToProduce;
+  ToProduce.add("output", F1);
+  ToProduce.add("output", F2);
+
+  auto Keys = Cache.computeKeys(Context, Pipe, Containers, ToProduce);
+  BOOST_TEST(Keys.size() == 2U);
+  auto Fetched = Cache.fetch(Context, Pipe, Keys, Containers, ToProduce);
+
+  CachedRun Result;
+  if (not ToProduce.empty()) {
+    ExecutionContext EC(Context, &Pipe, ToProduce);
+    llvm::cantFail(Pipe.Pipe->run(EC, Containers));
+    EC.verify();
+    Cache.store(Context, Pipe, Keys, Containers, ToProduce);
+    Result.PipeHasRun = true;
+  }
+
+  for (auto &Entry : Fetched)
+    Containers[Entry.first()].mergeBack(std::move(*Entry.second));
+
+  Result.Output = llvm::cast<ValuesContainer>(Containers["output"]).getMap();
+  return Result;
+}
+
+static void setArchitecture(Context &Context, model::Architecture::Values V) {
+  revng::getWritableModelFromContext(Context)->Architecture() = V;
+}
+
+BOOST_AUTO_TEST_CASE(ArtifactCacheHitMissAndInvalidation) {
+  llvm::SmallString<128> Directory;
+  auto ErrorCode = llvm::sys::fs::createUniqueDirectory("artifact-cache",
+                                                        Directory);
+  revng_check(not ErrorCode);
+
+  {
+    ArtifactCache Cache(Directory);
+    Context Context;
+    Context.addGlobal<revng::ModelGlobal>(revng::ModelGlobalName);
+    setArchitecture(Context, model::Architecture::x86_64);
+
+    // The first run populates the cache
+    CachedRun First = runCached(Cache, Context, "input");
+    BOOST_TEST(First.PipeHasRun);
+    BOOST_TEST(First.Output.size() == 2U);
+
+    // The second one reuses what has been stored
+    CachedRun Second = runCached(Cache, Context, "input");
+    BOOST_TEST(not Second.PipeHasRun);
+    BOOST_TEST((Second.Output == First.Output));
+
+    // Changing a field read by the pipe invalidates the cached artifacts
+    setArchitecture(Context, model::Architecture::aarch64);
+    CachedRun Changed = runCached(Cache, Context, "input");
+    BOOST_TEST(Changed.PipeHasRun);
+    BOOST_TEST((Changed.Output != First.Output));
+
+    // Both variants are now available
+    BOOST_TEST(not runCached(Cache, Context, "input").PipeHasRun);
+    setArchitecture(Context, model::Architecture::x86_64);
+    CachedRun Restored = runCached(Cache, Context, "input");
+    BOOST_TEST(not Restored.PipeHasRun);
+    BOOST_TEST((Restored.Output == First.Output));
+
+    // Changing the input is a miss too
+    BOOST_TEST(runCached(Cache, Context, "other-input").PipeHasRun);
+  }
+
+  llvm::sys::fs::remove_directories(Directory);
+}
@@ -0,0 +1,217 @@
+/// \file FunctionPipe.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Contract.h"
+#include "revng/Pipeline/ExecutionContext.h"
+#include "revng/Pipeline/LLVMContainer.h"
+#include "revng/Pipeline/LLVMKind.h"
+#include "revng/Pipeline/Pipe.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/Pipes/FunctionPass.h"
+#include "revng/Pipes/ModelGlobal.h"
+
+#define BOOST_TEST_MODULE FunctionPipe
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace pipeline;
+
+static auto Root = defineRootRank<"root">();
+static auto FunctionRank = defineRank<"function", std::string>(Root);
+
+static constexpr unsigned FunctionsCount = 8;
+
+static std::string functionName(unsigned Index) {
+  return "f" + std::to_string(Index);
+}
+
+class FunctionKindType : public LLVMKind {
+public:
+  using LLVMKind::LLVMKind;
+
+  std::optional<Target>
+  symbolToTarget(const llvm::Function &Symbol) const override {
+    if (Symbol.getName().startswith("f"))
+      return Target(Symbol.getName().str(), *this);
+    return std::nullopt;
+  }
+
+  void appendAllTargets(const pipeline::Context &Context,
+                        pipeline::TargetsList &Out) const override {
+    for (unsigned I = 0; I < FunctionsCount; ++I)
+      Out.push_back(Target(functionName(I), *this));
+  }
+
+  ~FunctionKindType() override {}
+};
+
+static FunctionKindType FunctionKind("function-kind", FunctionRank);
+
+static std::string CName = "container-name";
+
+static MetaAddress functionAddress(unsigned Index) {
+  return MetaAddress::fromPC(model::Architecture::x86_64, 0x1000 * (Index + 1));
+}
+
+/// Renames the entry block of each requested function, committing it.
+/// Each function reads a different set of fields of the model.
+struct ProcessFunctionsPass : public llvm::ModulePass {
+  static char ID;
+  ProcessFunctionsPass() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.addRequired<LoadExecutionContextPass>();
+  }
+
+  bool runOnModule(llvm::Module &M) override {
+    auto &LECP = getAnalysis<LoadExecutionContextPass>();
+    const auto &Model = revng::getModelFromContext(*LECP.get());
+    for (const Target &Target : LECP.getRequestedTargets()) {
+      auto Name = Target.getPathComponents()[0];
+      unsigned Index = std::stoul(Name.substr(1));
+      if (Index % 2 == 0)
+        Model->Architecture();
+      Model->Functions().tryGet(functionAddress(Index));
+
+      llvm::Function *F = M.getFunction(Name);
+      F->getEntryBlock().setName("processed");
+      LECP.get()->commit(Target, LECP.getContainerName());
+    }
+    return true;
+  }
+};
+char ProcessFunctionsPass::ID = '_';
+
+struct ProcessFunctions {
+  static constexpr auto Name = "process-functions";
+
+  std::vector<ContractGroup> getContract() const {
+    return { ContractGroup(FunctionKind) };
+  }
+
+  void run(ExecutionContext &EC, LLVMContainer &Container) {}
+};
+
+static void populate(llvm::legacy::PassManager &Manager,
+                     ExecutionContext &EC,
+                     LLVMContainer &Container) {
+  Manager.add(new LoadExecutionContextPass(&EC, Container.name()));
+  Manager.add(new ProcessFunctionsPass());
+}
+
+static void makeF(llvm::Module &M, llvm::StringRef FName) {
+  auto VoidType = llvm::Type::getVoidTy(M.getContext());
+  auto *FType = llvm::FunctionType::get(VoidType, {});
+  auto F = M.getOrInsertFunction(FName, FType);
+  auto *Fun = llvm::dyn_cast<llvm::Function>(F.getCallee());
+  auto *BB = llvm::BasicBlock::Create(M.getContext(), "bb", Fun);
+  llvm::IRBuilder<> Builder(BB);
+  Builder.CreateRetVoid();
+}
+
+struct FunctionPipeResult {
+  std::string Module;
+  std::vector<std::string> Committed;
+  std::vector<size_t> ExtractedSizes;
+  /// Pairs of target and path of a global field the target depends on
+  std::set<std::pair<std::string, std::string>> ReadFields;
+  bool CommittedOnCallingThread = true;
+};
+
+/// Runs ProcessFunctionsPass on all the functions but f0 using \p Jobs threads
+static FunctionPipeResult runOnFunctions(unsigned Jobs) {
+  llvm::LLVMContext LLVMContext;
+  Context Context;
+  Context.addGlobal<revng::ModelGlobal>(revng::ModelGlobalName);
+  LLVMContainer Container(CName, &Context, &LLVMContext);
+  for (unsigned I = 0; I < FunctionsCount; ++I)
+    makeF(Container.getModule(), functionName(I));
+
+  ContainerToTargetsMap Requested;
+  for (unsigned I = 1; I < FunctionsCount; ++I)
+    Requested.add(CName, Target(functionName(I), FunctionKind));
+
+  FunctionPipeResult Result;
+  auto Wrapper = PipeWrapper::bind<ProcessFunctions>(CName);
+  {
+    ExecutionContext EC(Context, &Wrapper, Requested);
+    auto CallingThread = std::this_thread::get_id();
+    EC.setCommitListener([&](const Target &Target, llvm::StringRef Name) {
+      if (std::this_thread::get_id() != CallingThread)
+        Result.CommittedOnCallingThread = false;
+      Result.Committed.push_back(Target.toString());
+
+      std::string Extracted;
+      llvm::raw_string_ostream Stream(Extracted);
+      llvm::cantFail(Container.extractOne(Stream, Target));
+      Stream.flush();
+      Result.ExtractedSizes.push_back(Extracted.size());
+    });
+
+    runFunctionPipe(EC, Container, populate, Jobs);
+    EC.verify();
+  }
+
+  const auto &Globals = Context.getGlobals();
+  for (const auto &Entry : Wrapper.InvalidationMetadata.getPathCache()) {
+    Global *TheGlobal = llvm::cantFail(Globals.get(Entry.getKey()));
+    for (const auto &[Path, Targets] : Entry.getValue()) {
+      std::string SerializedPath = *TheGlobal->serializePath(Path);
+      for (const TargetInContainer &Read : Targets)
+        Result.ReadFields.emplace(Read.getTarget().toString(),
+                                  SerializedPath);
+    }
+  }
+
+  // Print the functions in a fixed order, since merging the shards back does
+  // not preserve the order of the functions in the module
+  llvm::raw_string_ostream Stream(Result.Module);
+  for (unsigned I = 0; I < FunctionsCount; ++I)
+    Container.getModule().getFunction(functionName(I))->print(Stream);
+  Stream.flush();
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(ShardedFunctionPipeMatchesSerial) {
+  FunctionPipeResult Serial = runOnFunctions(1);
+  FunctionPipeResult Sharded = runOnFunctions(3);
+
+  BOOST_TEST(Serial.Committed.size() == FunctionsCount - 1);
+  BOOST_TEST(Sharded.Committed == Serial.Committed);
+  auto IsNotEmpty = [](size_t Size) { return Size != 0; };
+  BOOST_TEST(llvm::all_of(Sharded.ExtractedSizes, IsNotEmpty));
+  BOOST_TEST(Sharded.Module == Serial.Module);
+  BOOST_TEST(Serial.CommittedOnCallingThread);
+  BOOST_TEST(Sharded.CommittedOnCallingThread);
+
+  // Each target depends on the fields it has read, as in the serial run
+  BOOST_TEST(not Serial.ReadFields.empty());
+  BOOST_TEST(Sharded.ReadFields == Serial.ReadFields);
+
+  // The function that has not been requested is preserved as is
+  BOOST_TEST(Sharded.Module.find("processed:") != std::string::npos);
+  BOOST_TEST(Sharded.Module.find("bb:") != std::string::npos);
+}
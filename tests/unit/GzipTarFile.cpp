@@ -62,3 +62,87 @@ BOOST_AUTO_TEST_CASE(GzipTarFileTest) {
   checkOffset(Buffer, Offset1.DataStart, Offset1.dataSize(), "foo2");
   checkOffset(Buffer, Offset2.DataStart, Offset2.dataSize(), "bar2");
 }
+
+BOOST_AUTO_TEST_CASE(GzipTarFileAppendCompressedTest) {
+  using revng::ArchiveEntry;
+  using revng::OffsetDescriptor;
+
+  llvm::SmallVector<char> Source;
+  llvm::raw_svector_ostream SourceOS(Source);
+  revng::GzipTarWriter SourceWriter(SourceOS);
+  const char Data[5] = "foo2";
+  OffsetDescriptor SourceOffset = SourceWriter.append("foo", { Data, 4 });
+  SourceWriter.close();
+
+  // Copy the compressed data of foo into another archive
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  revng::GzipTarWriter Writer(OS);
+  llvm::ArrayRef<char> Compressed{ Source.data() + SourceOffset.DataStart,
+                                   SourceOffset.dataSize() };
+  OffsetDescriptor Offset1 = Writer.appendCompressed("foo", Compressed, 4);
+
+  const char Data2[5] = "bar2";
+  OffsetDescriptor Offset2 = Writer.append("bar", { Data2, 4 });
+  Writer.close();
+
+  {
+    revng::GzipTarReader Reader({ Buffer.data(), Buffer.size() });
+
+    cppcoro::generator<ArchiveEntry> Gen = Reader.entries();
+    std::vector<ArchiveEntry> Entries(Gen.begin(), Gen.end());
+    BOOST_TEST(Entries.size() == 2ULL);
+
+    llvm::StringRef RefData1(Entries[0].Data.data(), Entries[0].Data.size());
+    BOOST_TEST(Entries[0].Filename == "foo");
+    BOOST_TEST(RefData1.str() == "foo2");
+
+    llvm::StringRef RefData2(Entries[1].Data.data(), Entries[1].Data.size());
+    BOOST_TEST(Entries[1].Filename == "bar");
+    BOOST_TEST(RefData2.str() == "bar2");
+  }
+
+  checkOffset(Buffer, Offset1.DataStart, Offset1.dataSize(), "foo2");
+  checkOffset(Buffer, Offset2.DataStart, Offset2.dataSize(), "bar2");
+}
+
+BOOST_AUTO_TEST_CASE(ParallelGzipTarFileTest) {
+  using revng::OffsetDescriptor;
+
+  std::vector<std::string> Files;
+  for (unsigned I = 0; I < 100; ++I)
+    Files.push_back(std::string(I * 37, 'a' + I % 26));
+
+  llvm::SmallVector<char> Expected;
+  llvm::raw_svector_ostream ExpectedOS(Expected);
+  revng::GzipTarWriter Writer(ExpectedOS);
+  std::vector<OffsetDescriptor> ExpectedOffsets;
+  for (unsigned I = 0; I < Files.size(); ++I) {
+    llvm::ArrayRef<char> Data{ Files[I].data(), Files[I].size() };
+    ExpectedOffsets.push_back(Writer.append(std::to_string(I), Data));
+  }
+  Writer.close();
+
+  // Regardless of the order in which they are compressed, the result must be
+  // the same of the sequential writer, including when no pool is used
+  for (unsigned Jobs : { 1, 4 }) {
+    llvm::SmallVector<char> Buffer;
+    llvm::raw_svector_ostream OS(Buffer);
+    revng::ParallelGzipTarWriter ParallelWriter(OS, Jobs);
+    for (unsigned I = 0; I < Files.size(); ++I) {
+      llvm::ArrayRef<char> Data{ Files[I].data(), Files[I].size() };
+      ParallelWriter.append(std::to_string(I), Data);
+    }
+    std::vector<OffsetDescriptor> Offsets = ParallelWriter.close();
+
+    BOOST_TEST((Buffer == Expected));
+    BOOST_TEST(Offsets.size() == ExpectedOffsets.size());
+    for (unsigned I = 0; I < Files.size(); ++I) {
+      BOOST_TEST(Offsets[I].Start == ExpectedOffsets[I].Start);
+      BOOST_TEST(Offsets[I].DataStart == ExpectedOffsets[I].DataStart);
+      BOOST_TEST(Offsets[I].End == ExpectedOffsets[I].End);
+      auto Size = Offsets[I].dataSize();
+      checkOffset(Buffer, Offsets[I].DataStart, Size, Files[I]);
+    }
+  }
+}
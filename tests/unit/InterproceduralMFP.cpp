@@ -0,0 +1,188 @@
+/// \file InterproceduralMFP.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "revng/MFP/InterproceduralMFP.h"
+
+#define BOOST_TEST_MODULE InterproceduralMFP
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+struct TestFunction {
+  std::string Name;
+  std::set<int> Own;
+  std::vector<TestFunction *> Callees;
+  std::vector<TestFunction *> Callers;
+};
+
+template<>
+struct llvm::GraphTraits<TestFunction *> {
+  using NodeRef = TestFunction *;
+  using ChildIteratorType = std::vector<TestFunction *>::iterator;
+
+  static NodeRef getEntryNode(TestFunction *Function) { return Function; }
+
+  static ChildIteratorType child_begin(NodeRef N) { return N->Callees.begin(); }
+
+  static ChildIteratorType child_end(NodeRef N) { return N->Callees.end(); }
+};
+
+template<>
+struct llvm::GraphTraits<llvm::Inverse<TestFunction *>> {
+  using NodeRef = TestFunction *;
+  using ChildIteratorType = std::vector<TestFunction *>::iterator;
+
+  static NodeRef getEntryNode(llvm::Inverse<TestFunction *> Function) {
+    return Function.Graph;
+  }
+
+  static ChildIteratorType child_begin(NodeRef N) { return N->Callers.begin(); }
+
+  static ChildIteratorType child_end(NodeRef N) { return N->Callers.end(); }
+};
+
+struct ByName {
+  bool operator()(const TestFunction *LHS, const TestFunction *RHS) const {
+    return LHS->Name < RHS->Name;
+  }
+};
+
+/// The summary of a function is the union of its own elements, the summaries
+/// of its callees and what its callers push to it
+struct TestInstance {
+  using Label = TestFunction *;
+  using LatticeElement = std::set<int>;
+
+  std::map<Label, LatticeElement> Summaries;
+  std::map<Label, std::vector<std::pair<Label, LatticeElement>>> Pushes;
+
+  LatticeElement combineValues(const LatticeElement &LHS,
+                               const LatticeElement &RHS) const {
+    LatticeElement Result = LHS;
+    Result.insert(RHS.begin(), RHS.end());
+    return Result;
+  }
+
+  bool isLessOrEqual(const LatticeElement &LHS,
+                     const LatticeElement &RHS) const {
+    return std::includes(RHS.begin(), RHS.end(), LHS.begin(), LHS.end());
+  }
+
+  const LatticeElement &getSummary(Label Function) {
+    return Summaries[Function];
+  }
+
+  void setSummary(Label Function, const LatticeElement &Value) {
+    Summaries[Function] = Value;
+  }
+
+  std::vector<MFP::InstanceResult<TestInstance>>
+  analyze(llvm::ArrayRef<Label> Wave) {
+    std::vector<MFP::InstanceResult<TestInstance>> Results;
+    for (Label Function : Wave) {
+      LatticeElement Summary = Function->Own;
+      for (Label Callee : Function->Callees)
+        Summary = combineValues(Summary, getSummary(Callee));
+
+      Results.push_back({ std::move(Summary), Pushes[Function] });
+    }
+    return Results;
+  }
+};
+
+BOOST_AUTO_TEST_CASE(InterproceduralFixedPoint) {
+  // main calls a and c, a and b are mutually recursive, main pushes 5 to c
+  TestFunction Main{ "main", { 1 } };
+  TestFunction A{ "a", { 2 } };
+  TestFunction B{ "b", { 3 } };
+  TestFunction C{ "c", { 4 } };
+
+  const auto AddCall = [](TestFunction &Caller, TestFunction &Callee) {
+    Caller.Callees.push_back(&Callee);
+    Callee.Callers.push_back(&Caller);
+  };
+  AddCall(Main, A);
+  AddCall(Main, C);
+  AddCall(A, B);
+  AddCall(B, A);
+
+  auto Waves = MFP::computeWaves(&Main);
+  BOOST_TEST(Waves.size() == 4U);
+  BOOST_TEST(Waves[&A] == 0U);
+  BOOST_TEST(Waves[&B] == 0U);
+  BOOST_TEST(Waves[&C] == 0U);
+  BOOST_TEST(Waves[&Main] == 1U);
+
+  TestInstance Instance;
+  Instance.Pushes[&Main].push_back({ &C, { 5 } });
+
+  std::vector<TestFunction *> Functions = { &Main, &A, &B, &C };
+  auto Iterations = MFP::getInterproceduralFixedPoint<TestInstance,
+                                                      ByName>(Instance,
+                                                              Waves,
+                                                              Functions);
+
+  BOOST_TEST((Instance.Summaries[&A] == std::set<int>{ 2, 3 }));
+  BOOST_TEST((Instance.Summaries[&B] == std::set<int>{ 2, 3 }));
+  BOOST_TEST((Instance.Summaries[&C] == std::set<int>{ 4, 5 }));
+
+  // main is re-analyzed after its push to c has changed the summary of c
+  BOOST_TEST((Instance.Summaries[&Main] == std::set<int>{ 1, 2, 3, 4, 5 }));
+  BOOST_TEST(Iterations[&Main] == 2U);
+
+  // The SCC is stabilized before moving to main, which is analyzed only after
+  // all of its callees
+  BOOST_TEST(Iterations[&A] == 3U);
+  BOOST_TEST(Iterations[&B] == 3U);
+  BOOST_TEST(Iterations[&C] == 2U);
+}
+
+BOOST_AUTO_TEST_CASE(InterproceduralFixedPointPropagatesContributions) {
+  // pusher and reader both call callee, pusher pushes to callee elements it
+  // partly has already
+  TestFunction Callee{ "callee", { 4, 5 } };
+  TestFunction Pusher{ "pusher", { 1 } };
+  TestFunction Reader{ "reader", { 2 } };
+
+  const auto AddCall = [](TestFunction &Caller, TestFunction &Callee) {
+    Caller.Callees.push_back(&Callee);
+    Callee.Callers.push_back(&Caller);
+  };
+  AddCall(Pusher, Callee);
+  AddCall(Reader, Callee);
+
+  MFP::WavesMap<TestFunction *> Waves;
+  Waves[&Callee] = 0;
+  Waves[&Pusher] = 1;
+  Waves[&Reader] = 1;
+
+  TestInstance Instance;
+  Instance.Pushes[&Pusher].push_back({ &Callee, { 5, 6, 7 } });
+
+  std::vector<TestFunction *> Functions = { &Callee, &Pusher, &Reader };
+  auto Iterations = MFP::getInterproceduralFixedPoint<TestInstance,
+                                                      ByName>(Instance,
+                                                              Waves,
+                                                              Functions);
+
+  // All the elements of a contribution end up in the summary, not only the
+  // first new one
+  BOOST_TEST((Instance.Summaries[&Callee] == std::set<int>{ 4, 5, 6, 7 }));
+
+  // Once the summary of callee changes due to pusher, its other callers are
+  // analyzed again too
+  BOOST_TEST((Instance.Summaries[&Reader] == std::set<int>{ 2, 4, 5, 6, 7 }));
+  BOOST_TEST(Iterations[&Callee] == 2U);
+  BOOST_TEST(Iterations[&Pusher] == 2U);
+  BOOST_TEST(Iterations[&Reader] == 2U);
+}
@@ -249,6 +249,42 @@ BOOST_AUTO_TEST_CASE(TestModelDeduplication) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestBinarySerializationRoundTrip) {
+  TupleTree<model::Binary> Model;
+  Model->Architecture() = model::Architecture::x86_64;
+  Model->EntryPoint() = MetaAddress::fromString("0x1000:Code_x86_64");
+
+  // Polymorphic type definitions, with polymorphic types referring to them
+  auto UInt32 = model::PrimitiveType::makeGeneric(4);
+  auto [Struct, StructType] = Model->makeStructDefinition();
+  Struct.OriginalName() = "Recursive";
+  Struct.Fields()[0].Type() = model::PointerType::make(StructType.copy(), 8);
+  Struct.Fields()[8].Type() = UInt32.copy();
+
+  auto [Function, FunctionType] = Model->makeCABIFunctionDefinition();
+  Function.ABI() = model::ABI::SystemV_x86_64;
+  Function.Arguments()[0].Type() = std::move(StructType);
+  Function.ReturnType() = UInt32.copy();
+  Model->makeTypedefDefinition(std::move(FunctionType));
+
+  std::string Buffer;
+  llvm::raw_string_ostream Stream(Buffer);
+  Model.serializeBinary(Stream);
+  Stream.flush();
+  revng_check(tupletree::binary::isBinary(Buffer));
+
+  auto MaybeLoaded = TupleTree<model::Binary>::fromString(Buffer);
+  if (not MaybeLoaded)
+    BOOST_FAIL(llvm::toString(MaybeLoaded.takeError()));
+
+  std::string Expected;
+  Model.serialize(Expected);
+  std::string Actual;
+  MaybeLoaded->serialize(Actual);
+  BOOST_TEST(Expected == Actual);
+  BOOST_TEST((*MaybeLoaded)->TypeDefinitions().size() == 3U);
+}
+
 BOOST_AUTO_TEST_CASE(TestTupleTreeDiff) {
   model::Binary Left;
   model::Binary Right;
@@ -406,3 +442,32 @@ BOOST_AUTO_TEST_CASE(CollectReadFieldsShouldCollectAllSegments) {
   };
   BOOST_TEST(Collected.ExactVectors == Paths);
 }
+
+BOOST_AUTO_TEST_CASE(HashByPathShouldFollowDiffs) {
+  model::Binary Model;
+  Model.Functions().insert(Function(ARM1000));
+
+  auto FunctionsPath = *stringAsPath<model::Binary>("/Functions");
+  auto NamePath = *stringAsPath<model::Binary>("/Functions/0x1000:Code_arm/"
+                                               "CustomName");
+  auto MissingPath = *stringAsPath<model::Binary>("/Functions/0x2000:Code_arm/"
+                                                  "CustomName");
+
+  auto FunctionsHash = hashByPath(FunctionsPath, Model);
+  auto NameHash = hashByPath(NamePath, Model);
+  BOOST_TEST(FunctionsHash.has_value());
+  BOOST_TEST(NameHash.has_value());
+  BOOST_TEST(not hashByPath(MissingPath, Model).has_value());
+
+  // Renaming a function changes only the hash of its name
+  Model.Functions().at(ARM1000).CustomName() = "Renamed";
+  BOOST_TEST((hashByPath(FunctionsPath, Model) == FunctionsHash));
+  BOOST_TEST((hashByPath(NamePath, Model) != NameHash));
+  NameHash = hashByPath(NamePath, Model);
+
+  // Adding a function changes only the hash of the list of functions
+  Model.Functions().insert(Function(ARM2000));
+  BOOST_TEST((hashByPath(FunctionsPath, Model) != FunctionsHash));
+  BOOST_TEST((hashByPath(NamePath, Model) == NameHash));
+  BOOST_TEST(hashByPath(MissingPath, Model).has_value());
+}
@@ -0,0 +1,58 @@
+/// \file OffsetIndex.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/StringExtras.h"
+
+#include "revng/Support/OffsetIndex.h"
+
+#define BOOST_TEST_MODULE OffsetIndex
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+BOOST_AUTO_TEST_CASE(OffsetIndexTest) {
+  std::vector<std::string> Keys;
+  for (unsigned I = 0; I < 1000; ++I)
+    Keys.push_back("0x" + llvm::utohexstr(I * 16) + ":Generic64");
+
+  // Entries are sorted by the writer
+  std::vector<revng::OffsetIndexEntry> Entries;
+  for (unsigned I = Keys.size(); I > 0; --I) {
+    Entries.push_back({ .Key = Keys[I - 1],
+                        .UncompressedSize = I,
+                        .Start = I * 100,
+                        .End = I * 100 + 99 });
+  }
+
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  revng::writeOffsetIndex(OS, Entries);
+
+  auto MaybeIndex = revng::OffsetIndexReader::create(Buffer);
+  BOOST_TEST_REQUIRE(!!MaybeIndex);
+  BOOST_TEST(MaybeIndex->size() == Keys.size());
+
+  for (unsigned I = 1; I < MaybeIndex->size(); ++I)
+    BOOST_TEST(((*MaybeIndex)[I - 1].Key < (*MaybeIndex)[I].Key));
+
+  for (unsigned I = 1; I <= Keys.size(); ++I) {
+    auto Entry = MaybeIndex->find(Keys[I - 1]);
+    BOOST_TEST_REQUIRE(Entry.has_value());
+    BOOST_TEST((Entry->Key == Keys[I - 1]));
+    BOOST_TEST(Entry->UncompressedSize == I);
+    BOOST_TEST(Entry->Start == I * 100);
+    BOOST_TEST(Entry->End == I * 100 + 99);
+  }
+
+  BOOST_TEST(not MaybeIndex->find("0x1:Generic64").has_value());
+
+  // A truncated index must be rejected
+  llvm::ArrayRef<char> Truncated{ Buffer.data(), Buffer.size() - 1 };
+  auto MaybeTruncated = revng::OffsetIndexReader::create(Truncated);
+  BOOST_TEST(!MaybeTruncated);
+  llvm::consumeError(MaybeTruncated.takeError());
+}
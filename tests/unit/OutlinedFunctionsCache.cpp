@@ -0,0 +1,128 @@
+/// \file OutlinedFunctionsCache.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Triple.h"
+
+#include "revng/EarlyFunctionAnalysis/OutlinedFunctionsCache.h"
+#include "revng/Support/MetaAddress.h"
+
+#define BOOST_TEST_MODULE OutlinedFunctionsCache
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+/// A function keeping track of how many functions are alive
+struct TestFunction {
+  static inline size_t Alive = 0;
+  static inline size_t MaxAlive = 0;
+
+  MetaAddress Address;
+  bool MovedFrom = false;
+
+  explicit TestFunction(const MetaAddress &Address) : Address(Address) {
+    ++Alive;
+    MaxAlive = std::max(MaxAlive, Alive);
+  }
+
+  TestFunction(TestFunction &&Other) : Address(Other.Address) {
+    Other.MovedFrom = true;
+  }
+
+  ~TestFunction() {
+    if (not MovedFrom)
+      --Alive;
+  }
+};
+
+using Cache = efa::OutlinedFunctionsCache<TestFunction>;
+
+static MetaAddress address(unsigned Index) {
+  return MetaAddress::fromPC(llvm::Triple::x86_64, 0x1000 * (Index + 1));
+}
+
+static std::vector<MetaAddress> addresses(unsigned Begin, unsigned End) {
+  std::vector<MetaAddress> Result;
+  for (unsigned I = Begin; I < End; ++I)
+    Result.push_back(address(I));
+  return Result;
+}
+
+struct CacheRun {
+  std::map<MetaAddress, unsigned> Outlined;
+  size_t MaxSize = 0;
+};
+
+/// Goes through \p Waves the way DetectABI does, one batch at a time
+static CacheRun run(size_t Budget,
+                    const std::vector<std::vector<MetaAddress>> &Waves) {
+  CacheRun Result;
+  TestFunction::Alive = 0;
+  TestFunction::MaxAlive = 0;
+
+  {
+    auto Outline = [&Result](const MetaAddress &Address) {
+      ++Result.Outlined[Address];
+      return TestFunction(Address);
+    };
+    Cache Functions(Outline, Budget);
+
+    for (llvm::ArrayRef<MetaAddress> Wave : Waves) {
+      for (llvm::ArrayRef<MetaAddress> Batch : Functions.batches(Wave)) {
+        BOOST_TEST((Budget == 0 or Batch.size() <= Budget));
+        Functions.makeRoomFor(Batch);
+
+        // All the functions of the batch are alive at the same time
+        std::vector<TestFunction *> Used;
+        for (const MetaAddress &Address : Batch)
+          Used.push_back(&Functions.get(Address));
+
+        for (auto [Function, Address] : llvm::zip(Used, Batch))
+          BOOST_TEST((Function->Address == Address));
+
+        Result.MaxSize = std::max(Result.MaxSize, Functions.size());
+      }
+    }
+  }
+
+  BOOST_TEST(TestFunction::Alive == 0U);
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(OutlinedFunctionsNeverExceedTheBudget) {
+  constexpr size_t Budget = 3;
+  CacheRun Run = run(Budget,
+                     { addresses(0, 7), addresses(5, 9), addresses(0, 1) });
+  BOOST_TEST(Run.MaxSize <= Budget);
+  BOOST_TEST(TestFunction::MaxAlive <= Budget);
+
+  // The most recently used functions of a wave are still there for the next
+  // one, the others are outlined again
+  BOOST_TEST(Run.Outlined.at(address(5)) == 1U);
+  BOOST_TEST(Run.Outlined.at(address(6)) == 1U);
+  BOOST_TEST(Run.Outlined.at(address(0)) == 2U);
+}
+
+BOOST_AUTO_TEST_CASE(OutlinedFunctionsAreReusedWithinTheBudget) {
+  CacheRun Run = run(4, { addresses(0, 2), addresses(1, 4), addresses(0, 4) });
+  BOOST_TEST(Run.MaxSize == 4U);
+  for (unsigned I = 0; I < 4; ++I)
+    BOOST_TEST(Run.Outlined.at(address(I)) == 1U);
+}
+
+BOOST_AUTO_TEST_CASE(OutlinedFunctionsAreNotEvictedWithoutBudget) {
+  CacheRun Run = run(0, { addresses(0, 7), addresses(0, 9) });
+  BOOST_TEST(Run.MaxSize == 9U);
+  BOOST_TEST(TestFunction::MaxAlive == 9U);
+  for (unsigned I = 0; I < 9; ++I)
+    BOOST_TEST(Run.Outlined.at(address(I)) == 1U);
+}
@@ -5,6 +5,9 @@
 //
 
 #include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
 #include <memory>
 
 #include "llvm/ADT/STLExtras.h"
@@ -18,6 +21,8 @@
 #include "llvm/InitializePasses.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -40,7 +45,9 @@
 #include "revng/Pipeline/Loader.h"
 #include "revng/Pipeline/Runner.h"
 #include "revng/Pipeline/Target.h"
+#include "revng/Storage/Path.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
 
 #define BOOST_TEST_MODULE Pipeline
 bool init_unit_test();
@@ -100,6 +107,26 @@ public:
 };
 static SingleFunctionKind FunctionKind("function-kind", FunctionRank);
 
+/// Tracks any function whose name starts with `benchmark-`
+class BenchmarkFunctionKind : public LLVMKind {
+public:
+  using LLVMKind::LLVMKind;
+
+  std::optional<Target>
+  symbolToTarget(const llvm::Function &Symbol) const override {
+    if (Symbol.getName().startswith("benchmark-"))
+      return Target(Symbol.getName().str(), *this);
+    return std::nullopt;
+  }
+
+  void appendAllTargets(const pipeline::Context &Context,
+                        pipeline::TargetsList &Out) const override {}
+
+  ~BenchmarkFunctionKind() override {}
+};
+static BenchmarkFunctionKind BenchmarkKind("benchmark-function-kind",
+                                           FunctionRank);
+
 static std::string CName = "container-name";
 
 class MapContainer : public Container<MapContainer> {
@@ -234,6 +261,30 @@ BOOST_AUTO_TEST_CASE(ContainersCanBeCreated) {
   BOOST_TEST(cast<MapContainer>(Containers.at(CName)).get(ExampleTarget) == 1);
 }
 
+BOOST_AUTO_TEST_CASE(ContainersCanBeLoadedLazily) {
+  ContainerSet Containers;
+  auto Factory = getMapFactoryContainer();
+  Containers.add(CName, Factory);
+  BOOST_TEST(not Containers.contains(CName));
+
+  auto File = revng::FilePath::fromLocalStorage("dont-care");
+  Containers.loadLazily(CName, File, TargetsList::List{ ExampleTarget });
+  BOOST_TEST(Containers.contains(CName));
+  BOOST_TEST(Containers.isPending(CName));
+  BOOST_TEST(Containers.contains(ExampleTarget));
+  BOOST_TEST(Containers.enumerate(CName).contains(ExampleTarget));
+
+  // Cloning without requesting any target must not deserialize the container
+  ContainerSet Cloned = Containers.cloneFiltered({});
+  BOOST_TEST(Containers.isPending(CName));
+  BOOST_TEST(not Cloned.contains(CName));
+
+  // Accessing the container deserializes it
+  Containers.at(CName);
+  BOOST_TEST(not Containers.isPending(CName));
+  BOOST_TEST(Containers.contains(CName));
+}
+
 class TestPipe {
 
 public:
@@ -798,6 +849,171 @@ BOOST_AUTO_TEST_CASE(LLVMPurePipe) {
   BOOST_TEST(F != nullptr);
 }
 
+BOOST_AUTO_TEST_CASE(LLVMContainerClonesOnlyWhatIsReferenced) {
+  llvm::LLVMContext C;
+  Context Context;
+  LLVMContainer Container(CName, &Context, &C);
+  llvm::Module &M = Container.getModule();
+
+  // Enough untracked functions to have a single function cloned on its own
+  for (unsigned I = 0; I < 32; ++I)
+    makeF(M, "unused" + std::to_string(I));
+  makeF(M, "helper");
+  makeF(M, "f2");
+  makeF(M, "f1");
+
+  // Merging back purges the functions that are neither used nor isolated
+  FunctionTags::Isolated.addTo(M.getFunction("f1"));
+  FunctionTags::Isolated.addTo(M.getFunction("f2"));
+
+  llvm::Function *F1 = M.getFunction("f1");
+  llvm::IRBuilder<> Builder(F1->getEntryBlock().getTerminator());
+  Builder.CreateCall(M.getFunction("helper"));
+  Builder.CreateCall(M.getFunction("f2"));
+
+  TargetsList ToClone({ Target("f1", FunctionKind) });
+  auto Cloned = Container.cloneFiltered(ToClone);
+  const auto &ClonedModule = llvm::cast<LLVMContainer>(*Cloned).getModule();
+  BOOST_TEST(not ClonedModule.getFunction("f1")->isDeclaration());
+  BOOST_TEST(not ClonedModule.getFunction("helper")->isDeclaration());
+  BOOST_TEST(ClonedModule.getFunction("f2")->isDeclaration());
+  BOOST_TEST(ClonedModule.getFunction("unused0") == nullptr);
+  BOOST_TEST(Cloned->enumerate().size() == 1U);
+
+  Container.mergeBack(std::move(*Cloned));
+  BOOST_TEST(not M.getFunction("f1")->isDeclaration());
+  BOOST_TEST(not M.getFunction("f2")->isDeclaration());
+  BOOST_TEST(Container.enumerate().size() == 2U);
+}
+
+BOOST_AUTO_TEST_CASE(LLVMContainerSplitBitcodeRoundTrip) {
+  auto *Option = llvm::cl::getRegisteredOptions()["split-llvm-containers"];
+  auto &SplitBitcode = *static_cast<llvm::cl::opt<bool> *>(Option);
+
+  llvm::LLVMContext C;
+  Context Context;
+  LLVMContainer Container(CName, &Context, &C);
+  llvm::Module &M = Container.getModule();
+  makeF(M, "helper");
+  makeF(M, "f2-helper");
+  makeF(M, "f2");
+  makeF(M, "f1");
+
+  llvm::Function *F1 = M.getFunction("f1");
+  llvm::IRBuilder<> Builder(F1->getEntryBlock().getTerminator());
+  Builder.CreateCall(M.getFunction("helper"));
+  Builder.CreateCall(M.getFunction("f2"));
+
+  // An untracked function used by a single function lives only in the globals
+  // blob
+  llvm::Function *F2 = M.getFunction("f2");
+  Builder.SetInsertPoint(F2->getEntryBlock().getTerminator());
+  Builder.CreateCall(M.getFunction("f2-helper"));
+
+  llvm::SmallString<128> Path;
+  auto ErrorCode = llvm::sys::fs::createTemporaryFile("split", "bc", Path);
+  revng_check(not ErrorCode);
+  auto File = revng::FilePath::fromLocalStorage(Path);
+
+  SplitBitcode = true;
+  BOOST_TEST((!Container.store(File)));
+  SplitBitcode = false;
+
+  // Loading the whole file links all the functions back together
+  LLVMContainer Loaded(CName, &Context, &C);
+  BOOST_TEST((!Loaded.load(File)));
+  BOOST_TEST((Loaded.enumerate() == Container.enumerate()));
+  for (llvm::StringRef Name : { "f1", "f2", "helper", "f2-helper" })
+    BOOST_TEST(not Loaded.getModule().getFunction(Name)->isDeclaration());
+
+  // Loading a single function does not link the other ones
+  LLVMContainer Filtered(CName, &Context, &C);
+  TargetsList OnlyF2({ Target("f2", FunctionKind) });
+  BOOST_TEST(llvm::cantFail(Filtered.loadFiltered(File, OnlyF2)));
+  BOOST_TEST(not Filtered.getModule().getFunction("f2")->isDeclaration());
+  const llvm::Module &FilteredModule = Filtered.getModule();
+  const llvm::Function *F2Helper = FilteredModule.getFunction("f2-helper");
+  BOOST_TEST((F2Helper != nullptr and not F2Helper->isDeclaration()));
+  const llvm::Function *FilteredF1 = Filtered.getModule().getFunction("f1");
+  BOOST_TEST((FilteredF1 == nullptr or FilteredF1->isDeclaration()));
+
+  // Requesting a target that is not in the file is an error
+  LLVMContainer Missing(CName, &Context, &C);
+  TargetsList Unknown({ Target("f3", FunctionKind) });
+  auto MaybeLoaded = Missing.loadFiltered(File, Unknown);
+  BOOST_TEST(not MaybeLoaded);
+  llvm::consumeError(MaybeLoaded.takeError());
+
+  llvm::sys::fs::remove(Path);
+}
+
+BOOST_AUTO_TEST_CASE(LLVMContainerSingleFunctionBenchmark) {
+  using namespace std::chrono;
+
+  llvm::LLVMContext C;
+  Context Context;
+  LLVMContainer Container(CName, &Context, &C);
+  llvm::Module &M = Container.getModule();
+
+  // Each function calls the previous one and a helper of its own
+  constexpr unsigned FunctionsCount = 4000;
+  auto FunctionName = [](unsigned I) {
+    return "benchmark-" + std::to_string(I);
+  };
+  for (unsigned I = 0; I < FunctionsCount; ++I) {
+    std::string HelperName = "untracked-helper." + std::to_string(I);
+    makeF(M, HelperName);
+    makeF(M, FunctionName(I));
+
+    llvm::Function *F = M.getFunction(FunctionName(I));
+    FunctionTags::Isolated.addTo(F);
+    llvm::IRBuilder<> Builder(F->getEntryBlock().getTerminator());
+    for (unsigned J = 0; J < 8; ++J)
+      Builder.CreateCall(M.getFunction(HelperName));
+    if (I > 0)
+      Builder.CreateCall(M.getFunction(FunctionName(I - 1)));
+  }
+
+  auto Time = [](auto &&Callable) {
+    auto Start = high_resolution_clock::now();
+    Callable();
+    auto End = high_resolution_clock::now();
+    std::cout << duration_cast<microseconds>(End - Start).count() << "us\n";
+  };
+
+  auto CloneAndMergeBack = [&Container](const TargetsList &Targets) {
+    auto Cloned = Container.cloneFiltered(Targets);
+    Container.mergeBack(std::move(*Cloned));
+  };
+
+  constexpr unsigned Requests = 100;
+  std::cout << "Single function requests (x" << Requests << "): ";
+  Time([&]() {
+    for (unsigned I = 0; I < Requests; ++I) {
+      unsigned Index = (I * 37) % FunctionsCount;
+      CloneAndMergeBack(TargetsList({ Target(FunctionName(Index),
+                                             BenchmarkKind) }));
+    }
+  });
+
+  TargetsList All;
+  for (unsigned I = 0; I < FunctionsCount; ++I)
+    All.push_back(Target(FunctionName(I), BenchmarkKind));
+
+  std::cout << "Whole module request (x1): ";
+  Time([&]() { CloneAndMergeBack(All); });
+
+  // Nothing has been lost along the way. Merging back the whole module
+  // replaces it.
+  const llvm::Module &Merged = Container.getModule();
+  BOOST_TEST(Container.enumerate().size() == FunctionsCount);
+  for (unsigned I = 0; I < FunctionsCount; ++I) {
+    std::string HelperName = "untracked-helper." + std::to_string(I);
+    BOOST_TEST(not Merged.getFunction(FunctionName(I))->isDeclaration());
+    BOOST_TEST(not Merged.getFunction(HelperName)->isDeclaration());
+  }
+}
+
 BOOST_AUTO_TEST_CASE(SingleElementPipelineForwardFinedGrained) {
   Context Context;
   Runner Pipeline(Context);
@@ -1369,4 +1585,164 @@ BOOST_AUTO_TEST_CASE(PipeOptions) {
     BOOST_FAIL("unreachable");
 }
 
+BOOST_AUTO_TEST_CASE(IndependentAnalysesAccess) {
+  GlobalsAccess ImportLike{ {}, { "model.yml/Functions" } };
+  GlobalsAccess ReadsFunctions{ { "model.yml/Functions/0x1000:Generic64" },
+                                { "model.yml/TypeDefinitions" } };
+  GlobalsAccess ReadsSegments{ { "model.yml/Segments" },
+                               { "model.yml/ImportedDynamicFunctions" } };
+  GlobalsAccess ReadsAll{ { "model.yml" }, {} };
+
+  BOOST_TEST(not ImportLike.isIndependentFrom(ReadsFunctions));
+  BOOST_TEST(ImportLike.isIndependentFrom(ReadsSegments));
+  BOOST_TEST(ReadsFunctions.isIndependentFrom(ImportLike));
+  BOOST_TEST(not ImportLike.isIndependentFrom(ReadsAll));
+  BOOST_TEST(not ImportLike.isIndependentFrom(ImportLike));
+
+  BOOST_TEST(ImportLike.allowsWriting("model.yml/Functions/0x1000:Generic64"));
+  BOOST_TEST(not ImportLike.allowsWriting("model.yml/FunctionsAndMore"));
+  BOOST_TEST(not ImportLike.allowsWriting("model.yml"));
+}
+
+BOOST_AUTO_TEST_CASE(StepNotifiesCommittedTargets) {
+  Context Context;
+  Runner Pipeline(Context);
+  Pipeline.addDefaultConstructibleFactory<MapContainer>(CName);
+
+  const std::string Name = "first-step";
+  Pipeline.emplaceStep("", Name, "");
+  Pipeline.emplaceStep(Name,
+                       "end",
+                       "",
+                       PipeWrapper::bind<FineGrainPipe>(CName, CName));
+
+  auto &Container(Pipeline[Name].containers().getOrCreate<MapContainer>(CName));
+  Container.get(Target(RootKind)) = 1;
+
+  Target F1({ "f1" }, FunctionKind);
+  TargetsList Notified;
+  auto Listener = [&](const Target &Committed, const ContainerBase &Content) {
+    // The target must be available while the step is still running
+    BOOST_TEST(Content.enumerate().contains(Committed));
+    Notified.push_back(Committed);
+  };
+  Pipeline["end"].setCommitListener(CName, Listener);
+
+  ContainerToTargetsMap Targets;
+  Targets.add(CName, F1);
+  auto Error = Pipeline.run("end", Targets);
+  BOOST_TEST(!Error);
+  Pipeline["end"].clearCommitListener();
+
+  BOOST_TEST((Notified == TargetsList({ F1 })));
+}
+
+/// Commits f1 before assigning it its final value
+class CommitEarlyPipe {
+public:
+  static constexpr auto Name = "commit-early";
+
+  std::vector<ContractGroup> getContract() const {
+    return {
+      ContractGroup(RootKind, 0, FunctionKind, 1, InputPreservation::Preserve)
+    };
+  }
+
+  void
+  run(ExecutionContext &EC, const MapContainer &Source, MapContainer &Out) {
+    Target F1({ "f1" }, FunctionKind);
+    Out.get(F1) = 0;
+    EC.commit(F1, Out);
+    Out.get(F1) = Source.get(Target(RootKind));
+  }
+};
+
+BOOST_AUTO_TEST_CASE(StepNotifiesTargetsOncePipeCompletes) {
+  Context Context;
+  Runner Pipeline(Context);
+  Pipeline.addDefaultConstructibleFactory<MapContainer>(CName);
+
+  const std::string Name = "first-step";
+  Pipeline.emplaceStep("", Name, "");
+  Pipeline.emplaceStep(Name,
+                       "end",
+                       "",
+                       PipeWrapper::bind<CommitEarlyPipe>(CName, CName));
+
+  auto &Container(Pipeline[Name].containers().getOrCreate<MapContainer>(CName));
+  Container.get(Target(RootKind)) = 1;
+
+  std::vector<int> NotifiedValues;
+  auto Listener = [&](const Target &Committed, const ContainerBase &Content) {
+    NotifiedValues.push_back(cast<MapContainer>(Content).get(Committed));
+  };
+  Pipeline["end"].setCommitListener(CName, Listener);
+
+  ContainerToTargetsMap Targets;
+  Targets.add(CName, Target({ "f1" }, FunctionKind));
+  auto Error = Pipeline.run("end", Targets);
+  BOOST_TEST(!Error);
+  Pipeline["end"].clearCommitListener();
+
+  // The target is notified in its final form
+  BOOST_TEST((NotifiedValues == std::vector<int>{ 1 }));
+}
+
+/// Produces targets of all the branches of a pipeline forking after its first
+/// step using \p Jobs threads, and returns the content of each step
+static std::map<std::string, std::map<Target, int>>
+runBranches(unsigned Jobs) {
+  auto *Option = llvm::cl::getRegisteredOptions()["pipeline-jobs"];
+  auto &PipelineJobs = *static_cast<llvm::cl::opt<unsigned> *>(Option);
+  unsigned OldJobs = PipelineJobs;
+  PipelineJobs = Jobs;
+
+  Context Context;
+  Runner Pipeline(Context);
+  Pipeline.addDefaultConstructibleFactory<MapContainer>(CName);
+
+  Pipeline.emplaceStep("", "begin", "");
+  Pipeline.emplaceStep("begin",
+                       "left",
+                       "",
+                       PipeWrapper::bind<FineGrainPipe>(CName, CName));
+  Pipeline.emplaceStep("begin",
+                       "right",
+                       "",
+                       PipeWrapper::bind<TestPipe>(CName, CName));
+  Pipeline.emplaceStep("right",
+                       "right-end",
+                       "",
+                       PipeWrapper::bind<FineGrainPipe>(CName, CName));
+
+  auto &Begin = Pipeline["begin"].containers().getOrCreate<MapContainer>(CName);
+  Begin.get(Target(RootKind)) = 3;
+
+  Runner::State ToProduce;
+  ToProduce["left"].add(CName, Target({ "f1" }, FunctionKind));
+  ToProduce["right"].add(CName, Target(RootKind2));
+  ToProduce["right-end"].add(CName, Target({ "f2" }, FunctionKind));
+  auto Error = Pipeline.run(ToProduce);
+  BOOST_TEST(!Error);
+
+  PipelineJobs = OldJobs;
+
+  std::map<std::string, std::map<Target, int>> Result;
+  for (llvm::StringRef Name : { "left", "right", "right-end" }) {
+    const auto &Containers = Pipeline[Name].containers();
+    Result[Name.str()] = Containers.get<MapContainer>(CName).getMap();
+  }
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentBranchesMatchSerialRun) {
+  auto Serial = runBranches(1);
+  auto Concurrent = runBranches(4);
+
+  BOOST_TEST(Serial["left"].contains(Target({ "f1" }, FunctionKind)));
+  BOOST_TEST(Serial["right"].contains(Target(RootKind2)));
+  BOOST_TEST(Serial["right-end"].contains(Target({ "f2" }, FunctionKind)));
+  BOOST_TEST((Concurrent == Serial));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
+#include <iostream>
+#include <random>
+
 #define BOOST_TEST_MODULE RegisterUsageAnalyses
 bool init_unit_test();
 #include "boost/test/unit_test.hpp"
@@ -395,3 +399,94 @@ BOOST_AUTO_TEST_CASE(ReachingDefinitionsTest) {
                          { Operation(OperationType::Write, 0) });
   revng_assert(Result[0]);
 }
+
+/// Creates a function with \p BlocksCount blocks, each one reading, writing
+/// and clobbering random registers, connected by a chain of edges plus random
+/// forward and backward edges
+static TestAnalysisResult createRandom(unsigned BlocksCount) {
+  std::mt19937 Generator(42);
+  auto Random = [&Generator](unsigned Max) {
+    return std::uniform_int_distribution<unsigned>(0, Max - 1)(Generator);
+  };
+
+  using namespace model::Register;
+  rua::Function F;
+  for (Values Register : { rax_x86_64, rbx_x86_64, rcx_x86_64, rdx_x86_64,
+                           rsi_x86_64, rdi_x86_64, r8_x86_64, r9_x86_64,
+                           r10_x86_64, r11_x86_64, r12_x86_64, r13_x86_64 })
+    F.registerIndex(Register);
+
+  std::vector<rua::BlockNode *> Blocks;
+  for (unsigned I = 0; I < BlocksCount; ++I) {
+    auto *Block = F.addNode();
+    for (unsigned J = 0; J < 6; ++J) {
+      auto Type = static_cast<OperationType::Values>(OperationType::Read
+                                                     + Random(3));
+      Block->Operations.push_back(Operation(Type,
+                                            Random(F.registersCount())));
+    }
+    Blocks.push_back(Block);
+  }
+
+  F.setEntryNode(Blocks.front());
+  for (unsigned I = 0; I + 1 < BlocksCount; ++I) {
+    Blocks[I]->addSuccessor(Blocks[I + 1]);
+    if (Random(3) == 0)
+      Blocks[I]->addSuccessor(Blocks[Random(BlocksCount)]);
+  }
+
+  return { std::move(F), Blocks.front(), Blocks.back(), Blocks.back() };
+}
+
+BOOST_AUTO_TEST_CASE(DenseMFPBenchmark) {
+  using namespace std::chrono;
+  using MFP::getDenseMaximalFixedPoint;
+  using MFP::getMaximalFixedPoint;
+
+  auto F = createRandom(2000);
+  auto Time = [](auto &&Callable) {
+    auto Start = high_resolution_clock::now();
+    auto Result = Callable();
+    auto End = high_resolution_clock::now();
+    std::cout << duration_cast<microseconds>(End - Start).count() << "us\n";
+    return Result;
+  };
+
+  {
+    Liveness LA(F.Function);
+    auto Default = LA.defaultValue();
+    std::cout << "Liveness (map-based): ";
+    auto Results = Time([&]() {
+      return getMaximalFixedPoint(LA, &F.Function, Default, Default, {});
+    });
+    std::cout << "Liveness (dense): ";
+    auto DenseResults = Time([&]() {
+      return getDenseMaximalFixedPoint(LA, &F.Function, Default, Default, {});
+    });
+
+    revng_check(Results.size() == DenseResults.size());
+    for (const auto &[Label, Result] : Results) {
+      revng_check(Result.InValue == DenseResults.at(Label).InValue);
+      revng_check(Result.OutValue == DenseResults.at(Label).OutValue);
+    }
+  }
+
+  {
+    ReachingDefinitions RD(F.Function);
+    auto Default = RD.defaultValue();
+    std::cout << "ReachingDefinitions (map-based): ";
+    auto Results = Time([&]() {
+      return getMaximalFixedPoint(RD, &F.Function, Default, Default, {});
+    });
+    std::cout << "ReachingDefinitions (dense): ";
+    auto DenseResults = Time([&]() {
+      return getDenseMaximalFixedPoint(RD, &F.Function, Default, Default, {});
+    });
+
+    revng_check(Results.size() == DenseResults.size());
+    for (const auto &[Label, Result] : Results) {
+      revng_check(Result.InValue == DenseResults.at(Label).InValue);
+      revng_check(Result.OutValue == DenseResults.at(Label).OutValue);
+    }
+  }
+}
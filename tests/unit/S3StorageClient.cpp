@@ -0,0 +1,148 @@
+/// \file S3StorageClient.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Process.h"
+
+#include "revng/Storage/StorageClient.h"
+
+#define BOOST_TEST_MODULE S3StorageClient
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using revng::ContentEncoding;
+using revng::PathType;
+using revng::StorageClient;
+
+/// These tests need an S3-compatible server, e.g., MinIO. They run only if
+/// REVNG_TEST_S3_URL is set to the URL of an existing bucket, such as
+/// `s3://minioadmin:minioadmin@us-east-1+localhost:9000/revng-test`
+static const char *URLVariable = "REVNG_TEST_S3_URL";
+
+static bool hasS3Server() {
+  return std::getenv(URLVariable) != nullptr;
+}
+
+/// Returns a URL pointing to a fresh directory of the test bucket
+static std::string makeTestURL() {
+  std::string URL = std::getenv(URLVariable);
+  if (llvm::StringRef(URL).endswith("/"))
+    URL.pop_back();
+  return URL + "/test-" + std::to_string(llvm::sys::Process::GetRandomNumber());
+}
+
+static std::unique_ptr<StorageClient> connect(llvm::StringRef URL) {
+  auto MaybeClient = StorageClient::fromPathOrURL(URL);
+  revng_check(!!MaybeClient);
+  return std::move(*MaybeClient);
+}
+
+static llvm::Error
+write(StorageClient &Client, llvm::StringRef Path, llvm::StringRef Data) {
+  auto MaybeFile = Client.getWritableFile(Path, ContentEncoding::None);
+  if (not MaybeFile)
+    return MaybeFile.takeError();
+
+  MaybeFile.get()->os() << Data;
+  return MaybeFile.get()->commit();
+}
+
+static std::string read(StorageClient &Client, llvm::StringRef Path) {
+  auto MaybeFile = Client.getReadableFile(Path);
+  revng_check(!!MaybeFile);
+  return MaybeFile.get()->buffer().getBuffer().str();
+}
+
+static std::string readRange(StorageClient &Client,
+                             llvm::StringRef Path,
+                             uint64_t Offset,
+                             uint64_t Size) {
+  auto MaybeFile = Client.getReadableFileRange(Path, Offset, Size);
+  revng_check(!!MaybeFile);
+  return MaybeFile.get()->buffer().getBuffer().str();
+}
+
+static auto RequiresS3 = boost::unit_test::precondition([](auto) {
+  return hasS3Server();
+});
+
+BOOST_AUTO_TEST_CASE(S3FilesRoundTrip, *RequiresS3) {
+  std::string URL = makeTestURL();
+
+  // Larger than a part, so that it goes through a multipart upload and is
+  // downloaded in parallel parts
+  std::string Large(40 * 1024 * 1024 + 3, '\0');
+  for (size_t I = 0; I < Large.size(); ++I)
+    Large[I] = static_cast<char>(I * 7 + I / 4096);
+
+  {
+    auto Client = connect(URL);
+    llvm::cantFail(write(*Client, "small.txt", "small"));
+    llvm::cantFail(write(*Client, "dir/large.bin", Large));
+    llvm::cantFail(Client->copy("small.txt", "copy.txt"));
+
+    // Files can be read back before the client is committed
+    BOOST_TEST(read(*Client, "small.txt") == "small");
+    llvm::cantFail(Client->commit());
+  }
+
+  auto Client = connect(URL);
+  BOOST_TEST((llvm::cantFail(Client->type("small.txt")) == PathType::File));
+  BOOST_TEST((llvm::cantFail(Client->type("dir")) == PathType::Directory));
+  BOOST_TEST((llvm::cantFail(Client->type("missing")) == PathType::Missing));
+  BOOST_TEST(read(*Client, "small.txt") == "small");
+  BOOST_TEST(read(*Client, "copy.txt") == "small");
+  BOOST_TEST((read(*Client, "dir/large.bin") == Large));
+
+  // Ranged reads only download the requested bytes
+  BOOST_TEST(Client->prefersRangedReads());
+  BOOST_TEST(readRange(*Client, "small.txt", 1, 3) == "mal");
+  uint64_t Offset = 20 * 1024 * 1024 - 5;
+  BOOST_TEST((readRange(*Client, "dir/large.bin", Offset, 10)
+              == Large.substr(Offset, 10)));
+}
+
+BOOST_AUTO_TEST_CASE(S3FailedUploadsAreRolledBack, *RequiresS3) {
+  std::string URL = makeTestURL();
+  std::string Credentials = llvm::StringRef(URL)
+                              .split("://")
+                              .second.split('@')
+                              .first.str();
+
+  auto Client = connect(URL);
+  llvm::cantFail(write(*Client, "replaced.txt", "old"));
+  llvm::cantFail(Client->commit());
+
+  // Uploads fail with the wrong credentials
+  llvm::cantFail(Client->setCredentials("wrong:credentials"));
+  llvm::cantFail(write(*Client, "replaced.txt", "new"));
+  llvm::cantFail(write(*Client, "added.txt", "new"));
+
+  // Large files might fail as soon as their multipart upload is created
+  llvm::consumeError(write(*Client, "large.bin", std::string(20 << 20, 'x')));
+  llvm::Error Error = Client->commit();
+  BOOST_TEST(!!Error);
+  llvm::consumeError(std::move(Error));
+
+  // The failed uploads do not replace or add anything, and the index can be
+  // written again
+  llvm::cantFail(Client->setCredentials(Credentials));
+  BOOST_TEST(read(*Client, "replaced.txt") == "old");
+  BOOST_TEST((llvm::cantFail(Client->type("added.txt")) == PathType::Missing));
+  BOOST_TEST((llvm::cantFail(Client->type("large.bin")) == PathType::Missing));
+  llvm::cantFail(Client->commit());
+
+  auto Reopened = connect(URL);
+  BOOST_TEST(read(*Reopened, "replaced.txt") == "old");
+  PathType AddedType = llvm::cantFail(Reopened->type("added.txt"));
+  BOOST_TEST((AddedType == PathType::Missing));
+}
@@ -0,0 +1,286 @@
+/// \file StringMap.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Target.h"
+#include "revng/Pipes/FunctionKind.h"
+#include "revng/Pipes/Ranks.h"
+#include "revng/Pipes/StringMap.h"
+#include "revng/Storage/Path.h"
+#include "revng/Support/MetaAddress.h"
+
+#define BOOST_TEST_MODULE StringMap
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace revng;
+using pipeline::Target;
+using pipeline::TargetsList;
+
+static kinds::FunctionKind TestKind("test-string-map", ranks::Function, {}, {});
+
+static constexpr char TestName[] = "test-string-map";
+static constexpr char TestMIME[] = "application/x.test.tar+gz";
+static constexpr char TestSuffix[] = ".txt";
+
+using TestMap = pipes::FunctionStringMap<&TestKind,
+                                         TestName,
+                                         TestMIME,
+                                         TestSuffix>;
+
+static const MetaAddress A = MetaAddress::fromString("0x1000:Code_x86_64");
+static const MetaAddress B = MetaAddress::fromString("0x2000:Code_x86_64");
+static const MetaAddress C = MetaAddress::fromString("0x10000:Code_x86_64");
+static const MetaAddress D = MetaAddress::fromString("0x3000:Code_x86_64");
+
+static Target toTarget(const MetaAddress &Address) {
+  return Target(Address.toString(), TestKind);
+}
+
+/// A temporary directory holding the files written by a test
+struct TemporaryDirectory {
+  llvm::SmallString<128> Path;
+
+  TemporaryDirectory() {
+    auto ErrorCode = llvm::sys::fs::createUniqueDirectory("string-map", Path);
+    revng_check(not ErrorCode);
+  }
+
+  ~TemporaryDirectory() { llvm::sys::fs::remove_directories(Path); }
+
+  std::string localPath(llvm::StringRef Name) const {
+    llvm::SmallString<128> Result = Path;
+    llvm::sys::path::append(Result, Name);
+    return Result.str().str();
+  }
+
+  FilePath file(llvm::StringRef Name) const {
+    return FilePath::fromLocalStorage(localPath(Name));
+  }
+};
+
+static TestMap makeMap() {
+  TestMap Result(TestName);
+  Result.insert_or_assign(A, "a");
+  Result.insert_or_assign(B, "b");
+  Result.insert_or_assign(C, "c");
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(StringMapLoadsEntriesThroughTheIndex) {
+  TemporaryDirectory Directory;
+  FilePath Path = Directory.file("map.tar.gz");
+  TestMap Map = makeMap();
+  BOOST_TEST_REQUIRE(!Map.store(Path));
+
+  // The keys are not sorted as their string representation is, the order
+  // must still be the one of MetaAddress
+  TestMap Loaded(TestName);
+  BOOST_TEST_REQUIRE(!Loaded.load(Path));
+  BOOST_TEST((Loaded.enumerate() == Map.enumerate()));
+  BOOST_TEST(Loaded.contains(B));
+  BOOST_TEST(not Loaded.contains(D));
+
+  std::string Extracted;
+  llvm::raw_string_ostream Stream(Extracted);
+  BOOST_TEST(!Loaded.extractOne(Stream, toTarget(C)));
+  Stream.flush();
+  BOOST_TEST(Extracted == "c");
+
+  // Cloning only looks up the requested entries
+  auto Clone = Loaded.cloneFiltered(TargetsList({ toTarget(B) }));
+  BOOST_TEST((Clone->enumerate() == TargetsList({ toTarget(B) })));
+  BOOST_TEST(llvm::cast<TestMap>(*Clone).at(B) == "b");
+
+  BOOST_TEST(Loaded.remove(TargetsList({ toTarget(A) })));
+  BOOST_TEST(not Loaded.contains(A));
+  BOOST_TEST((Loaded.enumerate()
+              == TargetsList({ toTarget(B), toTarget(C) })));
+
+  // Entries that are still pending are copied when serializing
+  std::string Serialized;
+  llvm::raw_string_ostream SerializedStream(Serialized);
+  BOOST_TEST(!Loaded.serialize(SerializedStream));
+  SerializedStream.flush();
+
+  TestMap Deserialized(TestName);
+  auto Buffer = llvm::MemoryBuffer::getMemBuffer(Serialized, "", false);
+  BOOST_TEST(!Deserialized.deserialize(*Buffer));
+  BOOST_TEST(Deserialized.at(B) == "b");
+  BOOST_TEST(Deserialized.at(C) == "c");
+  BOOST_TEST(not Deserialized.contains(A));
+}
+
+static constexpr unsigned EntriesCount = 8;
+
+static MetaAddress address(unsigned Index) {
+  return MetaAddress::fromString("0x" + llvm::utohexstr(0x1000 * (Index + 1))
+                                 + ":Code_x86_64");
+}
+
+/// Incompressible data, so that the size of an archive is about the size of
+/// its entries
+static std::string randomData(unsigned Seed) {
+  std::string Result(1024, '\0');
+  uint64_t State = Seed + 1;
+  for (char &Byte : Result) {
+    State = State * 6364136223846793005ULL + 1442695040888963407ULL;
+    Byte = static_cast<char>(State >> 56);
+  }
+  return Result;
+}
+
+/// A zstd map holding EntriesCount entries, generated from \p Seed
+static TestMap makeZstdMap(unsigned Seed) {
+  TestMap Result(TestName);
+  Result.setEncoding("zstd");
+  for (unsigned I = 0; I < EntriesCount; ++I)
+    Result.insert_or_assign(address(I), randomData(Seed + I));
+  return Result;
+}
+
+static TestMap loadZstdMap(const FilePath &Path) {
+  TestMap Result(TestName);
+  Result.setEncoding("zstd");
+  BOOST_TEST_REQUIRE(!Result.load(Path));
+  return Result;
+}
+
+static bool fileExists(const FilePath &Path) {
+  return llvm::cantFail(Path.exists());
+}
+
+static std::string readFile(const FilePath &Path) {
+  auto MaybeFile = Path.getReadableFile();
+  revng_check(!!MaybeFile);
+  return MaybeFile.get()->buffer().getBuffer().str();
+}
+
+/// Checks that \p Map holds the entries of makeZstdMap(\p Seed), but for the
+/// ones in \p Expected
+static void checkEntries(const TestMap &Map,
+                         unsigned Seed,
+                         const std::map<unsigned, std::string> &Expected = {}) {
+  BOOST_TEST(Map.enumerate().size() == EntriesCount);
+  for (unsigned I = 0; I < EntriesCount; ++I) {
+    auto It = Expected.find(I);
+    std::string Data = It != Expected.end() ? It->second : randomData(Seed + I);
+    BOOST_TEST((Map.at(address(I)) == Data));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(StringMapStoresZstdArchives) {
+  TemporaryDirectory Directory;
+  FilePath Path = Directory.file("map.zstd");
+  TestMap Map = makeZstdMap(0);
+  BOOST_TEST_REQUIRE(!Map.store(Path));
+  BOOST_TEST(not fileExists(Path.addExtension("delta")));
+
+  // Storing does not change the content of the container
+  checkEntries(Map, 0);
+  checkEntries(loadZstdMap(Path), 0);
+}
+
+BOOST_AUTO_TEST_CASE(StringMapStoresChangedEntriesInADelta) {
+  TemporaryDirectory Directory;
+  FilePath Path = Directory.file("map.zstd");
+  FilePath DeltaPath = Path.addExtension("delta");
+  BOOST_TEST_REQUIRE(!makeZstdMap(0).store(Path));
+  std::string Archive = readFile(Path);
+
+  // Only the changed entry is written, next to the archive
+  TestMap Loaded = loadZstdMap(Path);
+  Loaded[address(0)] = randomData(100);
+  BOOST_TEST_REQUIRE(!Loaded.store(Path));
+  BOOST_TEST(fileExists(DeltaPath));
+  BOOST_TEST((readFile(Path) == Archive));
+  checkEntries(loadZstdMap(Path), 0, { { 0, randomData(100) } });
+
+  // The next delta carries over the entries of the previous one
+  Loaded[address(1)] = randomData(101);
+  BOOST_TEST_REQUIRE(!Loaded.store(Path));
+  BOOST_TEST((readFile(Path) == Archive));
+  std::map<unsigned, std::string> Changed = { { 0, randomData(100) },
+                                              { 1, randomData(101) } };
+  checkEntries(Loaded, 0, Changed);
+  checkEntries(loadZstdMap(Path), 0, Changed);
+
+  // Removed entries are recorded in the delta too
+  BOOST_TEST(Loaded.remove(TargetsList({ toTarget(address(2)) })));
+  BOOST_TEST_REQUIRE(!Loaded.store(Path));
+  BOOST_TEST((readFile(Path) == Archive));
+  TestMap Reloaded = loadZstdMap(Path);
+  BOOST_TEST(not Reloaded.contains(address(2)));
+  BOOST_TEST(Reloaded.enumerate().size() == EntriesCount - 1);
+}
+
+BOOST_AUTO_TEST_CASE(StringMapCompactsBigDeltas) {
+  TemporaryDirectory Directory;
+  FilePath Path = Directory.file("map.zstd");
+  FilePath DeltaPath = Path.addExtension("delta");
+  BOOST_TEST_REQUIRE(!makeZstdMap(0).store(Path));
+  std::string Archive = readFile(Path);
+
+  // Changing more than 1/CompactionRatio of the archive rewrites it
+  constexpr unsigned ToChange = EntriesCount / TestMap::CompactionRatio + 1;
+  TestMap Loaded = loadZstdMap(Path);
+  std::map<unsigned, std::string> Changed;
+  for (unsigned I = 0; I < ToChange; ++I) {
+    Changed[I] = randomData(100 + I);
+    Loaded[address(I)] = Changed[I];
+  }
+
+  BOOST_TEST_REQUIRE(!Loaded.store(Path));
+  BOOST_TEST(not fileExists(DeltaPath));
+  BOOST_TEST((readFile(Path) != Archive));
+  checkEntries(loadZstdMap(Path), 0, Changed);
+
+  // So does removing more than 1/CompactionRatio of the entries
+  Archive = readFile(Path);
+  TargetsList ToRemove;
+  for (unsigned I = 0; I < ToChange; ++I)
+    ToRemove.push_back(toTarget(address(I)));
+  BOOST_TEST(Loaded.remove(ToRemove));
+  BOOST_TEST_REQUIRE(!Loaded.store(Path));
+  BOOST_TEST(not fileExists(DeltaPath));
+  BOOST_TEST((readFile(Path) != Archive));
+  BOOST_TEST(loadZstdMap(Path).enumerate().size() == EntriesCount - ToChange);
+}
+
+BOOST_AUTO_TEST_CASE(StringMapIgnoresStaleDeltas) {
+  TemporaryDirectory Directory;
+  FilePath Path = Directory.file("map.zstd");
+  BOOST_TEST_REQUIRE(!makeZstdMap(0).store(Path));
+
+  TestMap Loaded = loadZstdMap(Path);
+  Loaded[address(0)] = randomData(100);
+  BOOST_TEST(Loaded.remove(TargetsList({ toTarget(address(1)) })));
+  BOOST_TEST_REQUIRE(!Loaded.store(Path));
+
+  // Replace the archive, putting back the delta written for the previous one
+  std::string DeltaFile = Directory.localPath("map.zstd.delta");
+  std::string SavedDelta = Directory.localPath("saved.delta");
+  revng_check(not llvm::sys::fs::copy_file(DeltaFile, SavedDelta));
+  BOOST_TEST_REQUIRE(!makeZstdMap(1000).store(Path));
+  BOOST_TEST(not fileExists(Path.addExtension("delta")));
+  revng_check(not llvm::sys::fs::copy_file(SavedDelta, DeltaFile));
+
+  // The fingerprint of the delta does not match the archive, the delta is
+  // ignored
+  checkEntries(loadZstdMap(Path), 1000);
+}
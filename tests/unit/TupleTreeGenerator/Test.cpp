@@ -9,6 +9,7 @@ bool init_unit_test();
 
 #include "llvm/Support/YAMLTraits.h"
 
+#include "revng/TupleTree/BinarySerialization.h"
 #include "revng/TupleTree/VisitsImpl.h"
 #include "revng/UnitTestHelpers/UnitTestHelpers.h"
 
@@ -43,3 +44,46 @@ BOOST_AUTO_TEST_CASE(YAMLSerializationRoundTripTest) {
 
   revng_assert(ReferenceInstance == DeserializedInstance);
 }
+
+/// Ensures that TestClass survives a round trip through the binary format
+BOOST_AUTO_TEST_CASE(BinarySerializationRoundTripTest) {
+  using namespace ttgtest;
+  TestClass ReferenceInstance;
+  ReferenceInstance.RequiredField() = 1;
+  ReferenceInstance.OptionalField() = 2;
+  ReferenceInstance.EnumField() = ttgtest::TestEnum::MemberOne;
+  ReferenceInstance.SequenceField() = { 1, 2, 3, 4, 5 };
+  using RefType = TupleTreeReference<uint64_t, TestClass>;
+  ReferenceInstance.ReferenceField() = RefType::fromString(&ReferenceInstance,
+                                                           "/SequenceField/1");
+
+  std::string Buffer;
+  llvm::raw_string_ostream OutputStream(Buffer);
+  tupletree::binary::serialize(OutputStream, ReferenceInstance);
+  OutputStream.flush();
+  revng_check(tupletree::binary::isBinary(Buffer));
+
+  TestClass DeserializedInstance;
+  if (auto Error = tupletree::binary::deserialize(Buffer, DeserializedInstance))
+    BOOST_FAIL(llvm::toString(std::move(Error)));
+  revng_check(ReferenceInstance == DeserializedInstance);
+
+  // Truncated buffers must be rejected
+  TestClass TruncatedInstance;
+  llvm::StringRef Truncated = llvm::StringRef(Buffer).drop_back();
+  llvm::Error Error = tupletree::binary::deserialize(Truncated,
+                                                     TruncatedInstance);
+  revng_check(static_cast<bool>(Error));
+  llvm::consumeError(std::move(Error));
+
+  // So are buffers written with a different schema. The hash of the schema
+  // follows the magic and the version, flip a bit of its first byte.
+  std::string OtherSchema = Buffer;
+  OtherSchema[5] ^= 1;
+  TestClass OtherSchemaInstance;
+  llvm::Error SchemaError = tupletree::binary::deserialize(OtherSchema,
+                                                           OtherSchemaInstance);
+  revng_check(static_cast<bool>(SchemaError));
+  std::string Message = llvm::toString(std::move(SchemaError));
+  revng_check(llvm::StringRef(Message).contains("different schema"));
+}
@@ -0,0 +1,177 @@
+/// \file ZstdArchive.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/Support/ChunkedOstream.h"
+#include "revng/Support/ZstdArchive.h"
+
+#define BOOST_TEST_MODULE ZstdArchive
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+static std::vector<std::string> makeFiles() {
+  std::vector<std::string> Result;
+  for (unsigned I = 0; I < 200; ++I) {
+    std::string File;
+    for (unsigned J = 0; J < I % 10 + 1; ++J) {
+      File += "int function_" + std::to_string(I * J);
+      File += "(void) { return 0; }\n";
+    }
+    Result.push_back(std::move(File));
+  }
+  return Result;
+}
+
+static std::string decompress(const revng::ZstdArchiveReader &Reader,
+                              const revng::ZstdArchiveEntry &Entry) {
+  std::string Result;
+  llvm::raw_string_ostream OS(Result);
+  llvm::cantFail(Reader.decompress(OS, Entry));
+  OS.flush();
+  return Result;
+}
+
+static void checkArchive(llvm::ArrayRef<char> Buffer,
+                         const std::vector<std::string> &Files) {
+  BOOST_TEST(revng::ZstdArchiveReader::isZstdArchive(Buffer));
+  auto MaybeReader = revng::ZstdArchiveReader::create(Buffer);
+  BOOST_TEST_REQUIRE(!!MaybeReader);
+
+  const auto &Entries = MaybeReader->entries();
+  BOOST_TEST_REQUIRE(Entries.size() == Files.size());
+  for (unsigned I = 0; I < Files.size(); ++I) {
+    BOOST_TEST(Entries[I].Name == std::to_string(I));
+    BOOST_TEST(Entries[I].Size == Files[I].size());
+    BOOST_TEST(decompress(*MaybeReader, Entries[I]) == Files[I]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ZstdArchiveTest) {
+  std::vector<std::string> Files = makeFiles();
+
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  revng::ZstdArchiveWriter Writer(OS);
+  for (unsigned I = 0; I < Files.size(); ++I)
+    Writer.append(std::to_string(I), { Files[I].data(), Files[I].size() });
+  Writer.close();
+
+  checkArchive(Buffer, Files);
+
+  // A truncated archive must be rejected
+  llvm::ArrayRef<char> Truncated{ Buffer.data(), Buffer.size() - 1 };
+  auto MaybeReader = revng::ZstdArchiveReader::create(Truncated);
+  BOOST_TEST(!MaybeReader);
+  llvm::consumeError(MaybeReader.takeError());
+}
+
+BOOST_AUTO_TEST_CASE(ZstdArchiveDictionaryTest) {
+  std::vector<std::string> Files = makeFiles();
+
+  std::vector<llvm::ArrayRef<char>> Samples;
+  for (const std::string &File : Files)
+    Samples.push_back({ File.data(), File.size() });
+  llvm::SmallVector<char> Dictionary = revng::zstdTrainDictionary(Samples,
+                                                                  4096);
+  BOOST_TEST_REQUIRE(not Dictionary.empty());
+
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  revng::ZstdArchiveWriter Writer(OS, Dictionary);
+  for (unsigned I = 0; I < Files.size(); ++I)
+    Writer.append(std::to_string(I), Samples[I]);
+  Writer.close();
+
+  checkArchive(Buffer, Files);
+
+  // Frames can be copied among archives sharing the same dictionary
+  auto MaybeReader = revng::ZstdArchiveReader::create(Buffer);
+  BOOST_TEST_REQUIRE(!!MaybeReader);
+  BOOST_TEST((MaybeReader->dictionary() == llvm::ArrayRef<char>(Dictionary)));
+
+  llvm::SmallVector<char> Copy;
+  llvm::raw_svector_ostream CopyOS(Copy);
+  revng::ZstdArchiveWriter CopyWriter(CopyOS, MaybeReader->dictionary());
+  for (const revng::ZstdArchiveEntry &Entry : MaybeReader->entries()) {
+    CopyWriter.appendCompressed(Entry.Name,
+                                MaybeReader->compressedData(Entry),
+                                Entry.Size);
+  }
+  CopyWriter.close();
+
+  BOOST_TEST((Copy == Buffer));
+}
+
+BOOST_AUTO_TEST_CASE(ZstdArchiveChunkedDecompressionTest) {
+  // Make a file bigger than the chunks zstd decompresses at once
+  std::string File;
+  for (unsigned I = 0; File.size() < 4 * ZSTD_DStreamOutSize(); ++I)
+    File += "int function_" + std::to_string(I) + "(void) { return 0; }\n";
+
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  revng::ZstdArchiveWriter Writer(OS);
+  Writer.append("file", { File.data(), File.size() });
+  Writer.close();
+
+  auto MaybeReader = revng::ZstdArchiveReader::create(Buffer);
+  BOOST_TEST_REQUIRE(!!MaybeReader);
+
+  constexpr size_t ChunkSize = 4096;
+  std::string Result;
+  size_t Chunks = 0;
+  auto OnChunk = [&](llvm::StringRef Chunk) {
+    BOOST_TEST(not Chunk.empty());
+    BOOST_TEST(Chunk.size() <= ChunkSize);
+    Result += Chunk;
+    ++Chunks;
+  };
+
+  {
+    revng::ChunkedOstream Chunked(OnChunk, ChunkSize);
+    const revng::ZstdArchiveEntry &Entry = MaybeReader->entries().front();
+    llvm::cantFail(MaybeReader->decompress(Chunked, Entry));
+  }
+
+  BOOST_TEST(Result == File);
+  BOOST_TEST(Chunks == (File.size() + ChunkSize - 1) / ChunkSize);
+}
+
+BOOST_AUTO_TEST_CASE(ZstdArchiveCorruptFrameTest) {
+  std::vector<std::string> Files = makeFiles();
+
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  revng::ZstdArchiveWriter Writer(OS);
+  Writer.append("file", { Files.back().data(), Files.back().size() });
+
+  // Moving the writer leaves the moved-from one closed
+  revng::ZstdArchiveWriter MovedWriter(std::move(Writer));
+  MovedWriter.close();
+
+  auto MaybeReader = revng::ZstdArchiveReader::create(Buffer);
+  BOOST_TEST_REQUIRE(!!MaybeReader);
+  const revng::ZstdArchiveEntry &Entry = MaybeReader->entries().front();
+  llvm::ArrayRef<char> Frame = MaybeReader->compressedData(Entry);
+
+  const auto Decompress = [&](llvm::ArrayRef<char> Data, size_t Size) {
+    std::string Result;
+    llvm::raw_string_ostream Stream(Result);
+    llvm::Error Error = MaybeReader->decompress(Stream, Data, Size);
+    bool Failed = static_cast<bool>(Error);
+    llvm::consumeError(std::move(Error));
+    return Failed;
+  };
+
+  BOOST_TEST(not Decompress(Frame, Entry.Size));
+
+  // Truncated frames, frames of the wrong size and garbage are errors
+  BOOST_TEST(Decompress(Frame.drop_back(4), Entry.Size));
+  BOOST_TEST(Decompress(Frame, Entry.Size + 1));
+  std::string Garbage(Frame.size(), 'x');
+  BOOST_TEST(Decompress({ Garbage.data(), Garbage.size() }, Entry.Size));
+}